@@ -59,6 +59,29 @@ data_en =
         "$timer_id$ - Timer ID",
       },
       ret = "1 if the timer may be used to trigger the ADC channel, 0 if not",
+    },
+
+    { sig = "u32 #platform_adc_stream_start#( unsigned timer_id, u32 frequency );",
+      desc = [[Starts a continuous conversion of the channels of a stream (only needed if $BUILD_ADC_STREAM$ is defined). The channels, the block size and the
+  two blocks (ping-pong buffers) are in the structure returned by $adc_get_stream_state$ (%inc/elua_adc.h%). Each time the timer fires, all the channels of the stream
+  are converted in order and the results are written in the block that is being filled. The platform code can write the samples in the blocks directly (for example
+  with a DMA channel in circular mode over both blocks) and call $adc_stream_block_done$ when a block is complete, or give each sample to $adc_stream_add_sample$
+  from the ADC interrupt handler. The generic code handles the rest (block switching, overruns, the $INT_ADC_BLOCK$ interrupt).]],
+      args = 
+      {
+        "$timer_id$ - the timer that triggers the conversions.",
+        "$frequency$ - the number of scans (conversions of all the channels) per second."
+      },
+      ret = "the actual scan frequency, or 0 if the stream can't be started."
+    },
+
+    { sig = "void #platform_adc_stream_stop#();",
+      desc = "Stops the conversions started by @#platform_adc_stream_start@platform_adc_stream_start@ and returns the converter to the state expected by $platform_adc_op$ and $adc.sample$."
+    },
+
+    { sig = "void #platform_adc_stream_poll#();",
+      desc = [[Only needed if $ADC_STREAM_POLLED$ is defined, for platforms that can't fill the blocks from an interrupt (like the simulator). It's called by the generic
+  code while it waits for a complete block and must generate all the samples that should have been converted since the previous call.]]
     }
   }
 }
@@ -24,6 +24,10 @@ enum
 ]],
       name = "CAN ID types",
       desc = "Constants used to define whether the message ID is standard or extended.."
+    },
+    { text = "#define PLATFORM_CAN_FILTER_OFF               ( -1 )",
+      name = "CAN filter off",
+      desc = "Used as the $idtype$ argument of @#platform_can_set_filter@platform_can_set_filter@ to disable a filter."
     }
   },
 
@@ -72,6 +76,54 @@ enum
        },
        ret = "PLATFORM_OK for success, PLATFORM_UNDERFLOW for error. (see @arch_platform_ll.html@here@ for details)"
     },
+
+    { sig = "int #platform_s_can_recv#( unsigned id, u32 *canid, u8 *idtype, u8 *len, u8 *data );",
+      desc = [[Receive a CAN bus message directly from the CAN controller. This function is platform-specific, $platform_can_recv$ is implemented in
+  %src/common_can.c% and reads the message from the RX buffer if buffering is enabled on the interface, or calls this function otherwise. If the platform
+  defines $BUF_ENABLE_CAN$ in %platform_conf.h%, the C handler of the $INT_CAN_RX$ interrupt also calls this function to move the received messages to the RX
+  buffer. The messages lost by the controller (FIFO overrun) must be reported with %cmn_can_rx_dropped%.]],
+      args =
+      {
+        "$id$ - CAN interface ID.",
+        "$canid$ - pointer where CAN identifier number will be written.",
+        "$canidtype$ - pointer where identifier type as defined @#can_id_types@here@ will be written",
+        "$len$ - pointer where message length in bytes will be written",
+        "$message$ - pointer to message buffer (8 bytes in lenth)"
+      },
+      ret = "PLATFORM_OK if a message was received, PLATFORM_UNDERFLOW if no message is waiting."
+    },
+
+    { sig = "int #platform_can_set_filter#( unsigned id, unsigned filter, u32 canid, u32 mask, int idtype );",
+      desc = [[Configure a hardware acceptance filter. A message is accepted if it matches at least one of the active filters: it has the identifier type $idtype$
+  and %( msg_canid XOR canid ) AND mask% is 0. $platform_can_setup$ must configure filter 0 to accept all the messages and disable the others. The number of
+  filters is given by $CAN_NUM_FILTERS$ in %platform_conf.h%.]],
+      args =
+      {
+        "$id$ - CAN interface ID.",
+        "$filter$ - the filter number (0 to $CAN_NUM_FILTERS$ - 1).",
+        "$canid$ - the identifier accepted by the filter.",
+        "$mask$ - the bits of the identifier that must match.",
+        "$idtype$ - identifier type as defined @#can_id_types@here@, or $PLATFORM_CAN_FILTER_OFF$ to disable the filter."
+      },
+      ret = "PLATFORM_OK for success, PLATFORM_ERR if the filter doesn't exist."
+    },
+
+    { sig = "int #platform_can_set_buffer#( unsigned id, unsigned log2size );",
+      desc = [[Sets the size of the RX buffer and enables the $INT_CAN_RX$ interrupt that fills it (or disables both if $log2size$ is 0). Implemented in
+  %src/common_can.c%, works only if $BUF_ENABLE_CAN$ is defined in %platform_conf.h%. If $CAN_BUF_SIZE$ is also defined, the buffers are enabled at startup.]],
+      args =
+      {
+        "$id$ - CAN interface ID.",
+        "$log2size$ - the base 2 logarithm of the buffer size (in messages), or 0 to disable the buffer."
+      },
+      ret = "PLATFORM_OK for success, PLATFORM_ERR for error."
+    },
+
+    { sig = "u32 #platform_can_get_dropped#( unsigned id );",
+      desc = "Returns the number of received messages that were lost (RX buffer full or FIFO overrun in the controller). Implemented in %src/common_can.c%.",
+      args = "$id$ - CAN interface ID.",
+      ret = "The number of lost messages."
+    }
   }
 }
 
@@ -0,0 +1,56 @@
+-- eLua platform interface - internal flash
+-- Make a full description for each language
+
+data_en =
+{
+  -- Menu name
+  menu_name = "Flash",
+
+  -- Title
+  title = "eLua platform interface - internal flash",
+
+  -- Overview
+  overview = [[This part of the platform interface groups functions that erase and write the internal flash of the MCU. They are used by the write once
+  file system (WOFS), which keeps its files in the flash sectors after the eLua image. The flash is divided in sectors (the smallest area that can be erased),
+  numbered from 0. The flash must be memory mapped, because it is read directly at the addresses returned by @#platform_flash_get_sector_start@platform_flash_get_sector_start@.
+  These functions are only needed if $BUILD_WOFS$ is defined.]],
+
+  -- Functions
+  funcs =
+  {
+    { sig = "u32 #platform_flash_get_num_sectors#();",
+      desc = "Returns the number of sectors of the internal flash.",
+      ret = "the number of sectors (0 if the flash can't be used)."
+    },
+
+    { sig = "u32 #platform_flash_get_sector_start#( u32 sectid );",
+      desc = "Returns the address of a sector. The sectors don't need to have the same size.",
+      args = "$sectid$ - the sector number. If it's equal to the number of sectors the function returns the address of the end of the flash.",
+      ret = "the address of the first byte of the sector."
+    },
+
+    { sig = "u32 #platform_flash_get_first_free_sector#();",
+      desc = "Returns the first sector that is not used by the eLua image (the first sector after the code and the initial values of the data).",
+      ret = "the number of the first free sector."
+    },
+
+    { sig = "int #platform_flash_erase#( u32 sectid );",
+      desc = "Erases a sector (all its bytes become 0xFF).",
+      args = "$sectid$ - the sector number.",
+      ret = "$PLATFORM_OK$ for success, $PLATFORM_ERR$ for error."
+    },
+
+    { sig = "int #platform_flash_write#( const void *from, u32 toaddr, u32 size );",
+      desc = [[Writes data to the flash. A write can only change bits from 1 to 0, a word that was already written can be written again to clear more bits.
+  The address and the size are always multiples of 4 and the source buffer is always word aligned.]],
+      args =
+      {
+        "$from$ - the data to write.",
+        "$toaddr$ - the flash address.",
+        "$size$ - the number of bytes to write."
+      },
+      ret = "$PLATFORM_OK$ for success, $PLATFORM_ERR$ for error."
+    }
+  }
+}
+
@@ -36,6 +36,17 @@ enum
       desc = "Constants used to select the I2C master transfer direction (transmitter or receiver)."
     }, 
 
+    { text = [[// I2C transfer segment
+typedef struct
+{
+  u8 *data;                     // data to send or buffer for the received data
+  u32 len;                      // number of bytes to send or to receive
+  int direction;                // PLATFORM_I2C_DIRECTION_TRANSMITTER or PLATFORM_I2C_DIRECTION_RECEIVER
+} platform_i2c_segment;]],
+      name = "I2C transfer segment",
+      desc = "A part of an I2C transaction (see @#platform_i2c_transfer@platform_i2c_transfer@)."
+    },
+
   },
 
   -- Functions
@@ -98,6 +109,22 @@ enum
         "$ack$ - 1 to send ACK, 0 to send NAK. If $ACK$ is 0 a STOP condition will automatically be generated after the NAK."
       },
       ret = "1 for success, 0 for error."
+    },
+
+    { sig = "int #platform_i2c_transfer#( unsigned id, u16 address, const platform_i2c_segment *segs, unsigned nsegs );",
+      desc = [[Do a complete I2C transaction made of one or more segments. Each segment starts with a START (a repeated START for all the segments except the first)
+  followed by $address$ in the direction of the segment, then the data of the segment is sent or received. The last byte of a receive segment is not
+  acknowledged. A STOP is sent after the last segment, or as soon as the slave doesn't acknowledge the address or a byte. A generic implementation that uses the
+  byte level functions above is provided in %src/common_i2c.c%; a platform that can do better (for example with interrupts or DMA) defines
+  $I2C_PLATFORM_TRANSFER$ in its %platform_conf.h% file and implements this function.]],
+      args =
+      {
+        "$id$ - I2C interface ID.",
+        "$address$ - I2C peripheral address.",
+        "$segs$ - the segments of the transaction.",
+        "$nsegs$ - the number of segments."
+      },
+      ret = "PLATFORM_OK for success, PLATFORM_ERR if the slave didn't acknowledge the address or a byte."
     }
   }
 }
@@ -40,6 +40,25 @@ data_en =
       name = "PIO data type",
       desc = [[This is the type used for the actual I/O operations. Currently defined as an unsigned 32-bit type, thus no port can have more than 32 pins. If this happens, it is possible to split 
   it in two or more parts and adding the new parts as "virtual ports" (logical ports that don't have a direct hardware equivalent). The "virtual port" technique is used in the AVR32 backend.]]
+    },
+
+    { text = [[enum
+{
+  PLATFORM_PIO_STEP_SET,                $// Set the pins in 'mask'$
+  PLATFORM_PIO_STEP_CLEAR,              $// Clear the pins in 'mask'$
+  PLATFORM_PIO_STEP_WRITE,              $// Set the pins in 'mask' to their values in 'data'$
+  PLATFORM_PIO_STEP_DELAY               $// Wait 'data' ticks of PIO_PROG_CLOCK$
+};
+
+typedef struct
+{
+  u8 op;                                $// One of the operations above$
+  u8 port;                              $// Port number$
+  pio_type mask;                        $// Pins changed by the step$
+  u32 data;                             $// Port value or number of ticks$
+} platform_pio_step;]],
+      name = "PIO program steps",
+      desc = "The steps of a pin program (see @#platform_pio_run@platform_pio_run@)."
     }
   },
 
@@ -102,6 +121,20 @@ data_en =
         when caled with the $PLATFORM_IO_PIN_PULLDOWN$ operation.]]
      }
     },
+
+    { sig = "void #platform_pio_run#( const platform_pio_step *steps, unsigned nsteps );",
+      link = "platform_pio_run",
+      desc = [[Runs a pin program: a sequence of port writes and delays, used by @refman_gen_pio.html#pio.prog.new@pio.prog@ to generate waveforms that are too fast
+  or too precise for Lua code. It is called with the interrupts disabled. A delay of $n$ ticks must end $n$ ticks after the end of the previous delay (or after the
+  start of the program), so the time spent on the port writes doesn't accumulate; Cortex-M3 platforms use the DWT cycle counter for this. Only needed if the platform
+  defines $BUILD_PIO_PROG$ in its %platform_conf.h% file, together with the frequency of the delay clock:</p>
+  ~#define PIO_PROG_CLOCK    CPU_FREQUENCY    $// the delays are counted in CPU cycles$~<p>]],
+      args = 
+      {
+        "$steps$ - the steps of the program, as defined @#pio_program_steps@here@",
+        "$nsteps$ - the number of steps",
+      }
+    },
   }
 }
 
@@ -70,6 +70,39 @@ enum
         "the value of the base clock when $op$ == $PLATFORM_PWM_OP_GET_CLOCK$",
         "irellevant for other operations"
       }  
+    },
+
+    { sig = "u32 #platform_pwm_seq_start#( unsigned id, const u16 *duty, u32 count, u32 rate, int mode );",
+      desc = [[Plays a sequence of duty cycles on a PWM channel (only if $BUILD_PWM_SEQ$ is defined in %platform_conf.h%). Implemented in %src/common_pwm.c%:
+  it copies the duty values to a buffer that belongs to the sequence and calls $platform_s_pwm_seq_start$, that must be implemented by the platform. This
+  function gets the same arguments (and the copy of the duty values, that it can convert in place to its native format) and must start to apply a new
+  value at each period of $1 / rate$ seconds, for example with a DMA channel triggered by the PWM timer. At the end of each pass of the sequence it must call
+  $cmn_pwm_seq_pass_done( id, finished )$ (with $finished$ set to 1 if it stopped). Platforms without interrupts for this define $PWM_SEQ_POLLED$ and implement
+  $platform_pwm_seq_poll( id )$, which is called when the state of the sequence is checked.]],
+      args = 
+      {
+        "$id$ - PWM channel ID",
+        "$duty$ - the duty values, from 0 (0%) to $PLATFORM_PWM_SEQ_DUTY_MAX$ (100%)",
+        "$count$ - the number of duty values",
+        "$rate$ - the number of duty values applied each second",
+        "$mode$ - $PLATFORM_PWM_SEQ_ONESHOT$ to play the sequence once or $PLATFORM_PWM_SEQ_LOOP$ to play it until it's stopped"
+      },
+      ret = "the actual rate of the sequence or 0 if the sequence can't be played"
+    },
+
+    { sig = "void #platform_pwm_seq_stop#( unsigned id );",
+      desc = "Stops the sequence played on a PWM channel (implemented in %src/common_pwm.c%, it calls $platform_s_pwm_seq_stop$, that must be implemented by the platform).",
+      args = "$id$ - PWM channel ID"
+    },
+
+    { sig = "int #platform_pwm_seq_get_status#( unsigned id, u32 *ppasses );",
+      desc = "Returns the state of the sequence played on a PWM channel (implemented in %src/common_pwm.c%).",
+      args = 
+      {
+        "$id$ - PWM channel ID",
+        "$ppasses$ - if not NULL, receives the number of times the sequence was played until the end"
+      },
+      ret = "1 if the sequence is playing, 0 otherwise"
     }
   }
 }
@@ -155,6 +155,33 @@ $period_us$ microseconds]]
         "$PLATFORM_TIMER_INT_TOO_SHORT$ if the specified period is too short.",
         "$PLATFORM_TIMER_INT_INVALID_ID$ if the specified timer cannot handle this operation."
       }
+    },
+
+    { sig = "u64 #platform_timebase_read#();",
+      desc = [[Read the timebase of the platform, a free-running 64-bit counter that runs at $TIMEBASE_CLOCK$ Hz (usually the CPU cycle counter). Implement this function and define
+  $TIMEBASE_CLOCK$ in $platform_conf.h$ to enable $tmr.cycles$, $tmr.elapsed$ and $os.clock$. If the hardware counter has only 32 bits, extend it with $cmn_timebase_extend$ (in
+  %src/common_tmr.c%), with the interrupts disabled, and call this function at least once per counter period (for example from the SysTick interrupt).]],
+      ret = "the value of the timebase"
+    },
+
+    { sig = "int #platform_timer_set_match_cb#( unsigned id, u32 period_us, int type, elua_int_c_handler cb );",
+      desc = [[Setup a timer match that calls a C function instead of generating an eLua interrupt. Only @#virtual@virtual timers@ support this operation, which doesn't need interrupt
+  support to be enabled. This function is generic for all platforms, thus it is implemented in %src/common_tmr.c%.]],
+      args = 
+      {
+        "$id$ - the timer ID",
+        "$period_us$ - the period (in microseconds) of the timer match. Setting this to 0 disables the timer match.",
+        [[$type$ - $PLATFORM_TIMER_INT_ONESHOT$ for a match that occurs only once after $period_us$ microseconds, or $PLATFORM_TIMER_INT_CYCLIC$ for a match that occurs every
+$period_us$ microseconds]],
+        "$cb$ - the function called (from the timer interrupt handler, with the timer ID as argument) at each match. If $NULL$ the timer generates eLua timer match interrupts instead."
+      },
+      ret = 
+      {
+        "$PLATFORM_TIMER_INT_OK$ if the operation was successful.",
+        "$PLATFORM_TIMER_INT_TOO_SHORT$ if the specified period is too short.",
+        "$PLATFORM_TIMER_INT_TOO_LONG$ if the specified period is too long.",
+        "$PLATFORM_TIMER_INT_INVALID_ID$ if the specified timer is not a virtual timer."
+      }
     }
   },
 
@@ -195,9 +222,22 @@ $period_us$ microseconds]]
   <p>Note that because of step 2 above you are limited by practical constraints on the value of $VTMR_FREQ_HZ$. If set too high, the timer interrupt will fire too often, thus taking too much
   CPU time. The maximum value depends largely on the hardware and the desired behaviour of the virtual timers, but in practice values larger than 10 might visibly change the behaviour of your 
   system.</p>
+  <p>If the hardware has a free-running counter and a way to request an interrupt at a given counter value, the virtual timers can run $tickless$ instead: the interrupt fires only when
+  a virtual timer reaches its deadline, so $VTMR_FREQ_HZ$ can be the (high) frequency of the counter, for example 1MHz for virtual timers with microsecond resolution. To enable this mode,
+  define $VTMR_TICKLESS$ in $platform_conf.h$ and implement these functions in your platform port:</p>
+  <ul>
+    <li>$u32 platform_vtmr_get_count()$: return the value of the free-running counter, which must count at $VTMR_FREQ_HZ$ and use all 32 bits (extend it in software if needed).</li>
+    <li>$void platform_vtmr_set_alarm( u32 count )$: call $cmn_virtual_timer_cb$ from an interrupt handler when the counter reaches $count$ (as soon as possible if it is already past
+        $count$). Calling it earlier is allowed, the alarm is set again in that case.</li>
+    <li>$void platform_vtmr_stop_alarm()$: cancel the alarm (no virtual timer is armed).</li>
+  </ul>
+  <p>A platform without interrupts (like the simulator) can also define $VTMR_POLLED$ (together with $VTMR_TICKLESS$). In this case the deadlines are checked by the timer functions and
+  the platform only needs to implement $platform_vtmr_get_count$.</p>
+  <p>In both modes the armed virtual timers are kept ordered by deadline, so the interrupt handler only checks the first one. The periods of the virtual timers are limited to 2<sup>31</sup> counts.</p>
   <p>To $use$ a virtual timer, identify it with the constant $VTMR_FIRST_ID$ (defined in %inc/common.h%) plus an offset. For example, $VTMR_FIRST_ID+0$ (or simply
   $VTMR_FIRST_ID$) is the ID of the first virtual timer in the system, and $VTMR_FIRST_ID+2$ is the ID of the third virtual timer in the system.</p>
-  <p>Virtual timers are capable of generating timer match interrupts just like regular timers, check @#platform_timer_set_match_int@here@ for details.
+  <p>Virtual timers are capable of generating timer match interrupts just like regular timers, check @#platform_timer_set_match_int@here@ for details. They can also call a C function
+  when they match, check @#platform_timer_set_match_cb@here@ for details.
   ]]
     }
   }
@@ -12,6 +12,7 @@ data_en =
   -- Overview
   overview = [[This module contains functions that access analog to digital converter (ADC) peripherals.</p>
   <p>When utilizing this module, acquiring ADC data is a two step process: requesting sample conversions (using $adc.sample$) and extraction of conversion results from a conversion buffer (using $adc.getsample$, $adc.getsamples$ or $adc.insertsamples$). Various configuration parameters are available to set conversion rate, how results are extracted from the buffer and how these results are processed prior to extraction.</p>
+  <p>For continuous acquisition at higher rates the module also has a streaming mode ($adc.stream$): a timer triggers the conversion of a group of channels and the samples are written in two blocks that are filled alternately, without per-sample processing. Lua gets the completed blocks with $adc.getblock$, as @refman_gen_sbuf.html@sample buffers@. A block must be read before the other block is complete, otherwise it's lost (an overrun, see $adc.streamstats$). On platforms with Lua interrupt support the $cpu.INT_ADC_BLOCK$ interrupt is generated when a block is complete (see @inthandlers.html@here@). Streaming is available only if $BUILD_ADC_STREAM$ is defined in the platform configuration; on the simulator the channels are synthetic waveforms (channel $n$ is a sine wave of 50 * ($n$ + 1) Hz).</p>
   <p>This module can be utilized if the device in use has a supported ADC peripheral (see @status.html@status@ for details) and if ADC functionality is enabled at build time (see @building.html@building@).</p>
 <p><span class="warning">IMPORTANT</span>: Platform support varies for this module (see @status.html#plat_notes@status notes@ for details) .
   ]],
@@ -35,21 +36,21 @@ data_en =
       },
       ret = "$sample$ - numeric value of conversion, or nil if sample was not available."
     },
-    { sig = "samples = #adc.getsamples#( id, count )",
+    { sig = "samples = #adc.getsamples#( id, [count] )",
       desc = "Get multiple conversion values from the buffer associated with a given channel.",
       args = 
       {
         "$id$ - ADC channel ID.",
         "$count$ - optional parameter to indicate number of samples to return. If not included, all available samples are returned."
       },
-      ret = "$samples$ - table containing integer conversion values. If not enough samples are available, remaining indices will be nil."
+      ret = "$samples$ - a @refman_gen_sbuf.html@sample buffer@ with 16-bit unsigned elements that contains the conversion values. If not enough samples are available the buffer is shorter than $count$ (use $#samples$ to get the number of samples). Use $sbuf.totable$ to convert it to a table."
     },
     { sig = "#adc.insertsamples#( id, table, idx, count )",
-      desc = "Get multiple conversion values from a channel's buffer, and write them into a table.",
+      desc = "Get multiple conversion values from a channel's buffer, and write them into a table or into a @refman_gen_sbuf.html@sample buffer@ with 16-bit unsigned elements (without creating new Lua values).",
       args = 
       {
         "$id$ - ADC channel ID.",
-        "$table$ - table to write samples to. Values at $table$[$idx$] to $table$[$idx$ + $count$ -1] will be overwritten with samples (or nil if not enough samples are available).",
+        "$table$ - table or sample buffer to write samples to. Values at $table$[$idx$] to $table$[$idx$ + $count$ -1] will be overwritten with samples (or nil if not enough samples are available). A sample buffer must have at least $idx$ + $count$ - 1 elements and the elements that can't be filled are left unchanged.",
         "$idx$ - first index to use in the table for writing samples.",
         "$count$ - number of samples to return. If not enough samples are available (after blocking, if enabled) remaining values will be nil."
       }
@@ -95,6 +96,39 @@ data_en =
         "$id$ - ADC channel ID.",
         "$length$ - number of preceding samples to include in moving average filter (must be a power of 2). If 1, filter is disabled. When enabled, a filter buffer is filled before the main conversion buffer, so that averages are always over the same number of samples."
       }
+    },
+    { sig = "rate = #adc.stream#( id, blocksize, rate, timer_id )",
+      desc = "Start streaming one or more channels. Any previous stream is stopped. $adc.sample$ can't be used while a stream is active.",
+      args = 
+      {
+        "$id$ - ADC channel ID, or a table with a list of channel IDs that are converted together each time the timer fires.",
+        "$blocksize$ - number of samples in a block for each channel.",
+        "$rate$ - number of conversions per second (for each channel).",
+        "$timer_id$ - the ID of the timer that triggers the conversions."
+      },
+      ret = "$rate$ - actual number of conversions per second."
+    },
+    { sig = "#adc.streamstop#()",
+      desc = "Stop streaming. The blocks that were not read are lost."
+    },
+    { sig = "buf1, [buf2], ..., [bufn] = #adc.getblock#( [timeout], [timer_id] )",
+      desc = "Wait for a completed block and return its samples.",
+      args = 
+      {
+        [[$timeout (optional)$ - timeout of the operation, can be either $adc.NO_TIMEOUT$ or 0 to return immediately, $adc.INF_TIMEOUT$ to wait for a block, or a
+positive number that specifies the timeout in microseconds (in this case, the $timer_id$ parameter is also required). The default value of this argument is
+$adc.INF_TIMEOUT$.]],
+        "$timer_id (optional)$ - the ID of the timer for the timeout, needed if $timeout$ is neither $adc.NO_TIMEOUT$, nor $adc.INF_TIMEOUT$."
+      },
+      ret = "$buf1$, $buf2$, ... - a $sbuf.U16$ sample buffer with $blocksize$ samples for each channel of the stream, in the order given to $adc.stream$, or nothing if there was no completed block before the timeout."
+    },
+    { sig = "blocks, overruns = #adc.streamstats#()",
+      desc = "Get the statistics of the current (or last) stream.",
+      ret = 
+      {
+        "$blocks$ - number of blocks completed since the stream was started.",
+        "$overruns$ - number of blocks that were lost because they were not read in time."
+      }
     }
   }
 }
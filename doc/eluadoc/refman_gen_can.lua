@@ -10,7 +10,14 @@ data_en =
   menu_name = "can",
 
   -- Overview
-  overview = [[This module contains functions for accessing the CAN interfaces of the eLua CPU]],
+  overview = [[This module contains functions for accessing the CAN interfaces of the eLua CPU.</p>
+<p>On platforms that support it (currently STM32 and LM3S) the received frames are moved from the CAN controller to a RX queue by the CAN receive interrupt,
+so frames are not lost when Lua doesn't read them fast enough. The size of the queue is set by $CAN_BUF_SIZE$ in %platform_conf.h% and can be changed with
+@#can.set_buffer@can.set_buffer@. The frames that arrive when the queue (or the FIFO of the controller) is full are counted, see @#can.dropped@can.dropped@.
+On platforms with Lua interrupt support the $cpu.INT_CAN_RX$ interrupt is generated when a frame is received (see @inthandlers.html@here@). The hardware acceptance filters of the controller
+can be configured with @#can.setfilter@can.setfilter@, so the unwanted frames don't even get to the queue.</p>
+<p>On the simulator the CAN interface is a loopback interface: the frames sent with @#can.send@can.send@ are received on the same interface (there is no
+RX queue and no $INT_CAN_RX$ interrupt, the interface has a FIFO of 16 frames).]],
   
   -- Structures
   structures =
@@ -62,8 +69,48 @@ enum
         "$canidtype$ - identifier type as defined @#can_id_types@here@.",
         "$message$ - message in string format, 8 or fewer bytes."
       }
+    },
+
+    { sig = "frames = #can.recvmany#( id, [max] )",
+      desc = "Receive all the CAN bus messages that are waiting (or at most $max$ messages). This is faster than calling @#can.recv@can.recv@ for each message.",
+      args =
+      {
+        "$id$ - the ID of the CAN interface.",
+        "$max (optional)$ - the maximum number of messages to receive. If not specified (or 0) all the waiting messages are received."
+      },
+      ret = [[An array with the received messages (empty if no message is waiting). Each message is a table ${ canid, canidtype, message }$ with the same values
+as the ones returned by @#can.recv@can.recv@.]]
+    },
+
+    { sig = "#can.setfilter#( id, filter, [canid, mask, canidtype] )",
+      desc = [[Configure a hardware acceptance filter. A message is accepted if it matches at least one of the active filters. A message matches a filter if it has
+the same identifier type and if %( msg_canid XOR canid ) AND mask% is 0 (so the bits of $mask$ that are 0 are ignored). If only $id$ and $filter$ are given, the filter
+is disabled. After @#can.setup@can.setup@ filter 0 accepts all the messages and the other filters are disabled. The number of filters is given by $CAN_NUM_FILTERS$ in
+%platform_conf.h% (14 on STM32, 8 on LM3S, 4 on the simulator).]],
+      args =
+      {
+        "$id$ - the ID of the CAN interface.",
+        "$filter$ - the filter number (from 0 to the number of filters - 1).",
+        "$canid (optional)$ - the identifier that the filter accepts.",
+        "$mask (optional)$ - the bits of the identifier that must match $canid$.",
+        "$canidtype (optional)$ - identifier type as defined @#can_id_types@here@."
+      }
+    },
+
+    { sig = "#can.set_buffer#( id, bufsize )",
+      desc = "Sets the size of the RX queue of the CAN interface (in messages). The messages that are waiting in the queue are lost.",
+      args =
+      {
+        "$id$ - the ID of the CAN interface.",
+        "$bufsize$ - the size of the queue (must be a power of 2) or 0 to disable the queue and the $INT_CAN_RX$ interrupt on the specified interface."
+      }
+    },
+
+    { sig = "count = #can.dropped#( id )",
+      desc = "Returns the number of received messages that were lost because the RX queue or the FIFO of the CAN controller was full.",
+      args = "$id$ - the ID of the CAN interface.",
+      ret = "The number of lost messages since the start of eLua."
     }
-   
   },
 }
 
@@ -0,0 +1,111 @@
+-- eLua reference manual - dsp
+
+data_en =
+{
+
+  -- Title
+  title = "eLua reference manual - dsp",
+
+  -- Menu name
+  menu_name = "dsp",
+
+  -- Overview
+  overview = [[This module implements signal processing functions (filters, FFT, statistics) that work on @refman_gen_sbuf.html@sample buffers@, for example on the
+results of an ADC conversion returned by $adc.getsamples$. The functions are implemented in C and are much faster than the same processing done with Lua loops
+(run $test/dsp_bench.lua$ to compare them).</p>
+<p>The filters and the FFT only accept buffers with 16-bit elements ($sbuf.U16$ or $sbuf.S16$) and use fixed point arithmetic. The results are saturated to the
+range of the element type. The filter coefficients can be given as a table of numbers or as a $sbuf.S16$ buffer that already contains fixed point values
+(Q15 for the FIR coefficients, Q14 for the IIR coefficients); the latter is needed on integer only builds ("lualong"). On Cortex-M3/M4 CPUs the functions use the
+saturation and (on Cortex-M4) the SIMD multiply instructions of the CPU. The other functions work on all the buffer types.]],
+
+  -- Functions
+  funcs =
+  {
+    { sig = "out = #dsp.fir#( buf, coefs, [decim] )",
+      desc = [[Filter a buffer with a FIR filter: %out[ n ] = coefs[ 1 ] * buf[ n ] + coefs[ 2 ] * buf[ n - 1 ] + ...%. The samples before the start of the buffer are
+  considered 0. If $decim$ is specified, only one of every $decim$ outputs is computed (so the filter can also be used to decimate the signal).]],
+      args =
+      {
+        "$buf$ - the buffer to filter.",
+        "$coefs$ - the filter coefficients, between -1 and 1.",
+        "$decim (optional)$ - the decimation factor (1 if not specified)."
+      },
+      ret = "$out$ - a new buffer with the same type as $buf$ that contains the filtered samples."
+    },
+
+    { sig = "out = #dsp.iir#( buf, coefs )",
+      desc = [[Filter a buffer with an IIR filter made of one or more second order sections (biquads) applied one after the other. Each section is described by 5
+  coefficients ($b0, b1, b2, a1, a2$) and computes %y[ n ] = b0 * x[ n ] + b1 * x[ n - 1 ] + b2 * x[ n - 2 ] - a1 * y[ n - 1 ] - a2 * y[ n - 2 ]%. The filter
+  starts with all its state variables set to 0.]],
+      args =
+      {
+        "$buf$ - the buffer to filter.",
+        "$coefs$ - the coefficients of all the sections (5 for each section), between -2 and 2."
+      },
+      ret = "$out$ - a new buffer with the same type as $buf$ that contains the filtered samples."
+    },
+
+    { sig = "out = #dsp.movavg#( buf, n )",
+      desc = "Compute the moving average of the last $n$ elements of a buffer. The first $n$ - 1 outputs are the averages of the elements that are available.",
+      args =
+      {
+        "$buf$ - the buffer.",
+        "$n$ - the size of the averaging window."
+      },
+      ret = "$out$ - a new buffer with the same type as $buf$ that contains the averages."
+    },
+
+    { sig = "re, im = #dsp.fft#( buf )",
+      desc = [[Compute the FFT of a buffer with a fixed point radix 2 algorithm. The size of the buffer must be a power of 2 between 2 and 1024. To avoid overflows the
+  result is divided by the size of the buffer. The values in $sbuf.U16$ buffers are divided by 2 before computing the FFT.]],
+      args = "$buf$ - the buffer with the samples.",
+      ret =
+      {
+        "$re$ - a $sbuf.S16$ buffer with the real part of the result.",
+        "$im$ - a $sbuf.S16$ buffer with the imaginary part of the result."
+      }
+    },
+
+    { sig = "pwr = #dsp.power#( re, im )",
+      desc = "Compute the power of a complex signal (%re[ i ] ^ 2 + im[ i ] ^ 2%), for example the power spectrum from the result of @#dsp.fft@dsp.fft@.",
+      args =
+      {
+        "$re$ - a $sbuf.S16$ buffer with the real part of the signal.",
+        "$im$ - a $sbuf.S16$ buffer with the imaginary part of the signal (same size as $re$)."
+      },
+      ret = "$pwr$ - a new $sbuf.U32$ buffer with the power of each element."
+    },
+
+    { sig = "min, max, mean, rms = #dsp.stats#( buf, [i], [j] )",
+      desc = "Compute statistics over the elements from $i$ to $j$ of a buffer. $i$ and $j$ can be negative, like in $string.sub$.",
+      args =
+      {
+        "$buf$ - the buffer.",
+        "$i (optional)$ - the first element (1 if not specified).",
+        "$j (optional)$ - the last element (-1, the last element of the buffer, if not specified)."
+      },
+      ret =
+      {
+        "$min$ - the minimum value.",
+        "$max$ - the maximum value.",
+        "$mean$ - the mean value.",
+        "$rms$ - the root mean square."
+      }
+    },
+
+    { sig = "idx = #dsp.crossings#( buf, level, [dir], [hyst] )",
+      desc = [[Find the places where the signal crosses a threshold. A rising crossing happens when the signal gets to $level$ after being under $level - hyst$,
+  a falling crossing happens when the signal goes under $level - hyst$ after being over $level$ (like a Schmitt trigger).]],
+      args =
+      {
+        "$buf$ - the buffer.",
+        "$level$ - the threshold.",
+        "$dir (optional)$ - the crossings to find: $dsp.RISING$, $dsp.FALLING$ or $dsp.BOTH$ (default).",
+        "$hyst (optional)$ - the hysteresis (0 if not specified)."
+      },
+      ret = "$idx$ - a new $sbuf.U32$ buffer with the indexes of the elements where the crossings happen."
+    }
+  }
+}
+
+data_pt = data_en
@@ -24,6 +24,12 @@ data_en =
       },
     },
     
+    { sig = "map = #elua.map#( filename )",
+      desc = "Returns a read-only view of the contents of a file, without copying it to RAM. Only the file systems that keep their files in memory can do this (currently only the @arch_romfs.html@ROM file system@), so this is useful for large read-only data such as lookup tables or fonts. The returned object can be used like a string: $#map$ returns its length, $map[ i ]$ returns the byte at position $i$ (or $nil$ if $i$ is outside the data), $map:sub( [i], [j] )$ and $map:byte( [i], [j] )$ work like $string.sub$ and $string.byte$ (only the resulting part of the data is copied) and $map:find( str, [init] )$ looks for $str$ in the data (without patterns).",
+      args = "$filename$ - the name of the file (for example $/rom/data.bin$).",
+      ret = "the map object, or $nil$ and an error message if the file can't be mapped."
+    },
+
     { sig = "#elua.save_history#( filename )",
       desc = "Save the interpreter line history. Only available if linenoise is enabled, check @linenoise.html@here@ for details.",
       args = "$filename$ - the name of the file where the history will be saved. $CAUTION$: the file will be overwritten.",
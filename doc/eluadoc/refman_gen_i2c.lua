@@ -67,8 +67,24 @@ data_en =
         "$numbytes$ - the number of bytes to read."
       },
       ret = "a string with all the data read from the I2C interface."
+    },
+
+    { sig = "data = #i2c.transfer#( id, address, [wdata], [numbytes] )",
+      desc = [[Does a complete I2C transaction in a single call: START, address, write $wdata$, then (if $numbytes$ is given) repeated START, address and read $numbytes$
+  bytes, and STOP at the end. This is much faster than the same sequence done with the functions above, since the whole transaction runs in C (or with the
+  interrupt or DMA driver of the platform, if it has one). For example, to read the 14 registers of an IMU starting with register $0x3B$:
+  ~data = i2c.transfer( 0, 0xD0, 0x3B, 14 )~
+  Calling it only with $id$, $address$ and an empty $wdata$ checks if a device acknowledges the address.]],
+      args =
+      {
+        "$id$ - the ID of the I2C interface.",
+        "$address$ - the address of the slave (as for @#i2c.address@i2c.address@).",
+        "$wdata (optional)$ - the data to write. It can be either a number between 0 and 255 (for example a register number), a string or a table (array).",
+        "$numbytes (optional)$ - the number of bytes to read (0 if not specified)."
+      },
+      ret = "a string with the data read (an empty string if $numbytes$ is 0), or $nil$ if the slave didn't acknowledge the address or the written data."
     }
-   
+
   },
 
 }
@@ -127,7 +127,7 @@ be specified.]]
       args = 
       {
         "$sock$ - the socket.",
-        "$str$ - the data to send."
+        "$str$ - the data to send (a string or a @refman_gen_sbuf.html@sample buffer@)."
       },
       ret = 
       {
@@ -120,7 +120,7 @@ data specifier is applied to a single variable that must be packed/unpacked. The
       desc = "Unpacks a string",
       args = 
       {
-        "$string$ - the string to unpack.",
+        "$string$ - the string to unpack. It can also be a @refman_gen_sbuf.html@sample buffer@ (the bytes of its elements are unpacked).",
         "$format$ - format specifier (as described @#overview@here@).",
         "$init$ - $(optional)$ marks where in $string$ the unpacking should start (1 if not specified)."
       },
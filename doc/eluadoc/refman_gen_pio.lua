@@ -151,6 +151,46 @@ data_en =
         "$portn (optional)$ - the %n%-th port"
       }
     },
+
+    { sig = "prog = #pio.prog.new#( entry1, [entry2], ..., [entryn] )",
+      desc = [[Builds a pin program: a sequence of pin changes and delays that runs in C with the interrupts disabled, for waveforms that are too fast or too precise
+  for Lua code (bit-banged protocols like the WS2812 LEDs, for example). The delays are counted from the end of the previous delay, so the time spent on the pin changes
+  doesn't accumulate. Only available on the platforms that define $BUILD_PIO_PROG$.]],
+      args = 
+      {
+        [[$entry1$ - the first entry of the program, one of:
+  <ul>
+    <li>${ pio.prog.SETHIGH, pin1, pin2, ..., pinn }$: set the pins to 1 (high). The pins on the same port change at the same time.</li>
+    <li>${ pio.prog.SETLOW, pin1, pin2, ..., pinn }$: set the pins to 0 (low). The pins on the same port change at the same time.</li>
+    <li>${ pio.prog.SETPORT, port, value, [mask] }$: set the pins of $port$ selected by $mask$ (all the pins if not given) to their values in $value$.</li>
+    <li>${ pio.prog.DELAY, ns }$: wait $ns$ nanoseconds. The resolution depends on the platform (a CPU cycle on Cortex-M3 CPUs).</li>
+    <li>another program, its entries are copied.</li>
+  </ul>]],
+        "$entry2 (optional)$ - the second entry",
+        "$entryn (optional)$ - the %n%-th entry"
+      },
+      ret = "the program"
+    },
+
+    { sig = "#pio.prog.run#( prog, [count] )",
+      desc = "Runs a program. Can also be called as $prog:run( [count] )$.",
+      args = 
+      {
+        "$prog$ - the program",
+        "$count (optional)$ - number of times to run the program, 1 if not given"
+      }
+    },
+
+    { sig = "#pio.prog.send#( prog0, prog1, data, [nbits] )",
+      desc = "Sends the bits of a string (most significant bit first) by running $prog0$ for each 0 bit and $prog1$ for each 1 bit. The interrupts are disabled until all the bits are sent.",
+      args = 
+      {
+        "$prog0$ - the program for the 0 bits",
+        "$prog1$ - the program for the 1 bits",
+        "$data$ - the data to send",
+        "$nbits (optional)$ - number of bits to send, all the bits in $data$ if not given"
+      }
+    },
    
   }
 
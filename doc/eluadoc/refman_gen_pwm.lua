@@ -51,6 +51,38 @@ duty cycles (particulary 0 and 100) might not be achievable.]]
        desc = "Get the base clock of the given PWM module.",
        args = "$id$ - the ID of the PWM module.",
        ret = "The base clock of the PWM module."
+    },
+
+    { sig = "realrate = #pwm.seqstart#( id, duties, rate, [mode] )",
+      desc = [[Plays a sequence of duty cycles on the given module: the duty cycle changes to the next value of the sequence $rate$ times per second, without
+  any CPU work from Lua (DMA or interrupt driven, depending on the platform). Useful for LED fades, motor ramps and audio output. The module must be set up with
+  @#pwm.setup@pwm.setup@ first, the duty values are applied at the start of a PWM period. A new sequence replaces the current one. Only available on the platforms
+  that define $BUILD_PWM_SEQ$; some platforms can play a single sequence at a time. The end of the sequence (of each pass in loop mode) raises the
+  $INT_PWM_SEQ_DONE$ interrupt if the platform has it (the resource number is the ID of the PWM module).]],
+      args = 
+      {
+        "$id$ - the ID of the PWM module.",
+        [[$duties$ - the duty cycles, as an array of numbers or a $U16$ @refman_gen_sbuf.html@sample buffer@. A duty value can be between 0 (0%) and
+  $pwm.SEQ_MAX$ (100%). The values are copied, so the array can be changed while the sequence is playing.]],
+        "$rate$ - number of duty cycle changes per second. It can't be larger than the PWM frequency.",
+        "$mode (optional)$ - $pwm.ONESHOT$ (default) to play the sequence once (the last duty cycle remains set) or $pwm.LOOP$ to play it until @#pwm.seqstop@pwm.seqstop@ is called."
+      },
+      ret = "The actual rate of the sequence. Depending on the hardware, this might have a different value than the $rate$ argument."
+    },
+
+    { sig = "#pwm.seqstop#( id )",
+      desc = "Stops the sequence played on the given module. The current duty cycle remains set.",
+      args = "$id$ - the ID of the PWM module."
+    },
+
+    { sig = "playing, passes = #pwm.seqstatus#( id )",
+      desc = "Returns the state of the sequence played on the given module.",
+      args = "$id$ - the ID of the PWM module.",
+      ret = 
+      {
+        "$playing$ - $true$ if the sequence is playing, $false$ otherwise.",
+        "$passes$ - number of times the sequence was played until the end."
+      }
     }
   },
 
@@ -0,0 +1,82 @@
+-- eLua reference manual - sbuf
+
+data_en =
+{
+
+  -- Title
+  title = "eLua reference manual - sbuf",
+
+  -- Menu name
+  menu_name = "sbuf",
+
+  -- Overview
+  overview = [[This module implements packed sample buffers: fixed size arrays of numbers that keep their elements in a C array instead of a Lua table. A buffer with 1000
+16-bit elements takes about 2KB of RAM, while a Lua table with the same data takes about 16KB and creates 1000 new values for the garbage collector. Buffers are
+used by the @refman_gen_adc.html@adc@ module to return the results of a conversion ($adc.getsamples$) and can be given directly to functions that send raw data
+($uart.write$, $net.send$, $pack.unpack$), in which case the elements are sent as bytes in the native byte order of the CPU.</p>
+<p>The elements of a buffer are accessed with the usual Lua indexing syntax ($buf[ i ]$, $buf[ i ] = value$, with $i$ between 1 and $#buf$). The type of the
+elements is chosen when the buffer is created and it can be one of:</p>
+<ul>
+  <li>$sbuf.U16$: unsigned 16-bit integers (the default).</li>
+  <li>$sbuf.S16$: signed 16-bit integers.</li>
+  <li>$sbuf.U32$: unsigned 32-bit integers.</li>
+  <li>$sbuf.FLOAT$: single precision floating point numbers.</li>
+</ul>
+<p>Values that are written to integer buffers are truncated to the size of the element.]],
+
+  -- Functions
+  funcs =
+  {
+    { sig = "buf = #sbuf.new#( count, [type], [fill] )",
+      desc = "Create a new buffer. The first argument can also be a string (its bytes are copied in the buffer) or a table (its elements are copied in the buffer).",
+      args =
+      {
+        "$count$ - the number of elements in the buffer, a string with the initial data of the buffer (its length must be a multiple of the element size) or a table with the initial values of the elements.",
+        "$type (optional)$ - the type of the elements, as described in the overview ($sbuf.U16$ if not specified).",
+        "$fill (optional)$ - the initial value of the elements (0 if not specified). Only used if $count$ is a number."
+      },
+      ret = "$buf$ - the new buffer."
+    },
+
+    { sig = "newbuf = #sbuf.sub#( buf, [i], [j] )",
+      desc = "Return a new buffer with a copy of the elements from $i$ to $j$ of a buffer. $i$ and $j$ can be negative, like in $string.sub$.",
+      args =
+      {
+        "$buf$ - the buffer.",
+        "$i (optional)$ - the first element (1 if not specified).",
+        "$j (optional)$ - the last element (-1, the last element of the buffer, if not specified)."
+      },
+      ret = "$newbuf$ - the new buffer (with the same type of elements as $buf$)."
+    },
+
+    { sig = "str = #sbuf.tostring#( buf, [i], [j] )",
+      desc = "Return the elements from $i$ to $j$ of a buffer as a string (in the native byte order of the CPU).",
+      args =
+      {
+        "$buf$ - the buffer.",
+        "$i (optional)$ - the first element (1 if not specified).",
+        "$j (optional)$ - the last element (-1, the last element of the buffer, if not specified)."
+      },
+      ret = "$str$ - the binary data of the elements."
+    },
+
+    { sig = "table = #sbuf.totable#( buf, [i], [j] )",
+      desc = "Return the elements from $i$ to $j$ of a buffer as a Lua table.",
+      args =
+      {
+        "$buf$ - the buffer.",
+        "$i (optional)$ - the first element (1 if not specified).",
+        "$j (optional)$ - the last element (-1, the last element of the buffer, if not specified)."
+      },
+      ret = "$table$ - a new table with the values of the elements."
+    },
+
+    { sig = "type = #sbuf.type#( buf )",
+      desc = "Return the type of the elements of a buffer.",
+      args = "$buf$ - the buffer.",
+      ret = "$type$ - the type of the elements ($sbuf.U16$, $sbuf.S16$, $sbuf.U32$ or $sbuf.FLOAT$)."
+    }
+  }
+}
+
+data_pt = data_en
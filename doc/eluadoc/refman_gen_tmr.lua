@@ -87,6 +87,23 @@ $NOTE:$ this function does not work with virtual timers.]]
       ret = "The timer clock (in Hz)."
     },
 
+    { sig = "count = #tmr.cycles#()",
+      desc = [[Read the system timebase, a free-running 64-bit counter that doesn't depend on the timers (the CPU cycle counter on Cortex-M3 CPUs, the host monotonic clock
+  on the simulator). It is cheap to read and has the best resolution available on the platform, so it is the preferred way to profile code. $os.clock$ uses the same timebase.
+  Only available if the platform has a timebase.]],
+      ret = "The value of the timebase. If Lua was compiled with integer numbers only the lower 32 bits of the timebase are returned."
+    },
+
+    { sig = "time = #tmr.elapsed#( start, [end] )",
+      desc = "Compute the time between two values returned by @#tmr.cycles@tmr.cycles@. Only available if the platform has a timebase.",
+      args = 
+      {
+        "$start$ - the first timebase value.",
+        "$end (optional)$ - the second timebase value. If not specified the current value of the timebase is used."
+      },
+      ret = "The time between $start$ and $end$ in microseconds (with a fractional part, unless Lua was compiled with integer numbers only)."
+    },
+
     { sig = "#tmr.set_match_int#( id, period, type )",
       desc = "Setup the timer match interrupt. Only available if interrupt support is enabled, check @inthandlers.html@here@ for details.",
       args = 
@@ -43,7 +43,8 @@ to the IDs of the virtual UARTs in the system.]]
     },
 
     { sig = "#uart.write#( id, data1, [data2], ..., [datan] )",
-      desc = [[Write one or more strings or 8-bit integers (raw data) to the serial port. If writing raw data, its value (represented by an integer) must be between 0 and 255.]],
+      desc = [[Write one or more strings or 8-bit integers (raw data) to the serial port. If writing raw data, its value (represented by an integer) must be between 0 and 255.
+  A @refman_gen_sbuf.html@sample buffer@ can be used instead of a string, in which case the bytes of its elements are written in the native byte order of the CPU.]],
       args = 
       {
         "$id$ - the ID of the serial port.",
@@ -13,8 +13,9 @@ enum
 {
   BUF_ID_UART = 0,
   BUF_ID_ADC = 1,
+  BUF_ID_CAN = 2,
   BUF_ID_FIRST = BUF_ID_UART,
-  BUF_ID_LAST = BUF_ID_ADC,
+  BUF_ID_LAST = BUF_ID_CAN,
   BUF_ID_TOTAL = BUF_ID_LAST - BUF_ID_FIRST + 1
 };
 
@@ -52,7 +53,9 @@ enum
 {
   BUF_DSIZE_U8 = 0,
   BUF_DSIZE_U16,
-  BUF_DSIZE_U32
+  BUF_DSIZE_U32,
+  BUF_DSIZE_U64,
+  BUF_DSIZE_U128
 };
 
 
@@ -64,6 +67,7 @@ unsigned buf_get_size( unsigned resid, unsigned resnum );
 unsigned buf_get_count( unsigned resid, unsigned resnum );
 int buf_write( unsigned resid, unsigned resnum, t_buf_data *data );
 int buf_read( unsigned resid, unsigned resnum, t_buf_data *data );
+unsigned buf_read_block( unsigned resid, unsigned resnum, t_buf_data *data, unsigned count );
 void buf_flush( unsigned resid, unsigned resnum );
 
 #endif
@@ -18,7 +18,15 @@ void cmn_int_handler( elua_int_id id, elua_int_resnum resnum );
 int cmn_tmr_int_set_status( elua_int_resnum resnum, int status );
 int cmn_tmr_int_get_status( elua_int_resnum resnum );
 int cmn_tmr_int_get_flag( elua_int_resnum resnum, int clear );
+u64 cmn_timebase_extend( u32 count );
 void cmn_uart_setup_sermux();
+// CAN-specific functions
+void cmn_can_rx_dropped( unsigned id, unsigned count );
+// PWM-specific functions
+void cmn_pwm_seq_pass_done( unsigned id, int finished );
+int cmn_pwm_seq_int_set_status( elua_int_resnum resnum, int status );
+int cmn_pwm_seq_int_get_status( elua_int_resnum resnum );
+int cmn_pwm_seq_int_get_flag( elua_int_resnum resnum, int clear );
 
 unsigned int intlog2( unsigned int v );
 
@@ -3,6 +3,7 @@
 
 #include "type.h"
 #include "platform_conf.h"
+#include "elua_int.h"
 
 
 typedef struct 
@@ -39,6 +40,31 @@ typedef struct
   volatile u8         seq_ctr, seq_len;
 } elua_adc_dev_state;
 
+// Streaming state: the converter is triggered by a timer and fills two
+// blocks alternately (ping-pong), each block has 'blocksize' samples for each
+// channel in the stream, interleaved in channel order
+#define ADC_STREAM_BLOCKS             2
+#define ADC_STREAM_INF_TIMEOUT        ( -1 )
+
+typedef struct
+{
+  u16                 *data;        // ADC_STREAM_BLOCKS blocks of 'blocklen' samples
+  u32                 blocklen;     // samples in a block (all the channels)
+  u16                 blocksize;    // samples for each channel in a block
+  u8                  chans[ NUM_ADC ];
+  u8                  nchans;
+  // The flags below are also written from the ADC interrupt, so they are
+  // separate bytes and not bitfields
+  volatile u8         active;       // Is the stream running?
+  volatile u8         int_enabled;  // Notify completed blocks with INT_ADC_BLOCK
+  volatile u8         int_flag;     // A block was completed (interrupt flag)
+  volatile u8         fill;         // block that is being filled
+  volatile u8         ready;        // bit mask of complete blocks that were not read yet
+  volatile u32        idx;          // next sample in the block being filled
+  volatile u32        blocks;       // number of completed blocks
+  volatile u32        overruns;     // number of blocks lost (not read in time)
+} elua_adc_stream_state;
+
 // Channel Management
 #define ACTIVATE_CHANNEL( d, id ) ( d->ch_active |= ( ( u32 )1 << ( id ) ) )
 #define INACTIVATE_CHANNEL( d, id ) ( d->ch_active &= ~( ( u32 )1 << ( id ) ) )
@@ -51,6 +77,7 @@ elua_adc_dev_state *adc_get_dev_state( unsigned dev_id );
 void adc_smooth_data( unsigned id );
 elua_adc_ch_state *adc_get_ch_state( unsigned id );
 u16 adc_get_processed_sample( unsigned id );
+u16 adc_get_processed_samples( unsigned id, u16 *dest, u16 count );
 void adc_init_ch_state( unsigned id );
 int adc_update_smoothing( unsigned id, u8 loglen );
 void adc_flush_smoothing( unsigned id );
@@ -58,5 +85,16 @@ u16 adc_samples_requested( unsigned id );
 u16 adc_samples_available( unsigned id );
 u16 adc_wait_samples( unsigned id, unsigned samples );
 
+// Streaming
+elua_adc_stream_state *adc_get_stream_state();
+int adc_stream_start( const u8 *chans, unsigned nchans, u16 blocksize, unsigned timer_id, u32 *pfreq );
+void adc_stream_stop();
+void adc_stream_add_sample( u16 sample );
+void adc_stream_block_done();
+int adc_stream_get_block( u16 *const *dest, unsigned timer_id, s32 timeout );
+int adc_stream_int_set_status( elua_int_resnum resnum, int status );
+int adc_stream_int_get_status( elua_int_resnum resnum );
+int adc_stream_int_get_flag( elua_int_resnum resnum, int clear );
+
 #endif
 
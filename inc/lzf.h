@@ -0,0 +1,36 @@
+// Small LZ77 codec (LZF compatible format) used to compress RFS and XMODEM data
+
+#ifndef __LZF_H__
+#define __LZF_H__
+
+#include "type.h"
+
+// Error codes
+#define LZF_OK                0
+#define LZF_ERR               1
+
+// Compression methods (as negotiated by RFS)
+#define LZF_METHOD_NONE       0
+#define LZF_METHOD_LZF        1
+
+// Header of a compressed XMODEM transfer: the magic below followed by
+// the size of the uncompressed data (u32, little endian)
+#define LZF_FILE_MAGIC        "\x1BLZF"
+#define LZF_FILE_MAGIC_SIZE   4
+#define LZF_FILE_HEADER_SIZE  8
+
+// Decompressor state (the data can be given to the decompressor in chunks)
+typedef struct
+{
+  u8 state;
+  u16 len;
+  u16 off;
+} LZF_STATE;
+
+// Public interface
+u32 lzf_compress( const u8 *src, u32 srclen, u8 *dest, u32 destlen );
+u32 lzf_decompress( const u8 *src, u32 srclen, u8 *dest, u32 destlen );
+void lzf_stream_init( LZF_STATE *ps );
+int lzf_stream_decompress( LZF_STATE *ps, const u8 *src, u32 srclen, u8 *dest, u32 *pdestpos, u32 destlen );
+
+#endif // #ifndef __LZF_H__
@@ -9,7 +9,6 @@
 
 // Maximum number of devices in the system
 #define DM_MAX_DEVICES        16
-#define DM_MAX_DEVICES_BITS   4
 
 // Maximum number of a device name
 #define DM_MAX_DEV_NAME       12
@@ -17,13 +16,6 @@
 // GLOBAL maximum file length (on ALL supported filesystem)
 #define DM_MAX_FNAME_LENGTH   30
 
-// Pack/unpack descriptions
-// Even if a file descriptor is an 'int', newlib treats it as a short, so we need to stuff
-// everything into 16 bits. Actually 15, since negative fd's are actually error indications
-#define DM_MAKE_DESC( devid, fd ) ( ( ( devid ) << ( 15 - DM_MAX_DEVICES_BITS ) ) | ( fd ) )
-#define DM_GET_DEVID( desc )      ( ( desc ) >> ( 15 - DM_MAX_DEVICES_BITS ) )
-#define DM_GET_FD( desc )         ( ( desc ) & ( ( 1 << ( 15 - DM_MAX_DEVICES_BITS ) ) - 1 ) )
-
 // STDIO file number
 #define DM_STDIN_NUM              0
 #define DM_STDOUT_NUM             1
@@ -52,6 +44,9 @@ typedef struct
   void* ( *p_opendir_r )( struct _reent *r, const char* name );
   struct dm_dirent* ( *p_readdir_r )( struct _reent *r, void *dir );  
   int ( *p_closedir_r )( struct _reent *r, void* dir );  
+  // Optional: get a pointer to the data of a file that is directly accessible
+  // in memory (and stays there while the system runs). Returns 0 for OK.
+  int ( *p_map_r )( struct _reent *r, const char *path, const void **pdata, u32 *psize );
 } DM_DEVICE;
 
 // Errors
@@ -72,11 +67,26 @@ const DM_DEVICE* dm_get_device_at( int idx );
 int dm_get_num_devices();
 // Initialize device manager
 int dm_init();
+// Get the device of a file name ('/<device>/<file>') and the file name on the device
+int dm_get_device_id( const char *name, const char **pactname );
+// Set/get the size of the file descriptor table
+int dm_set_max_files( unsigned n );
+unsigned dm_get_max_files();
+
+// File descriptor layer (used by the newlib stubs). The descriptors are indexes
+// in a table kept by the device manager, each entry has the device ID, the
+// descriptor returned by the device and an optional read buffer.
+int dm_fd_open( struct _reent *r, const char *name, int flags, int mode );
+int dm_fd_close( struct _reent *r, int file );
+_ssize_t dm_fd_read( struct _reent *r, int file, void *ptr, size_t len );
+_ssize_t dm_fd_write( struct _reent *r, int file, const void *ptr, size_t len );
+off_t dm_fd_lseek( struct _reent *r, int file, off_t off, int whence );
 
 // DM specific functions (uniform over all the installed filesystems)
 DM_DIR *dm_opendir( const char* dirname );
 struct dm_dirent* dm_readdir( DM_DIR *d );
 int dm_closedir( DM_DIR *d );
+int dm_map( const char* path, const void **pdata, u32 *psize );
 
 #endif
 
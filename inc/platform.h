@@ -68,6 +68,25 @@ const char* platform_pio_get_prefix( unsigned port );
 int platform_pio_has_pin( unsigned port, unsigned pin );
 pio_type platform_pio_op( unsigned port, pio_type pinmask, int op );
 
+// PIO programs: sequences of port writes and delays (see platform_pio_run)
+enum
+{
+  PLATFORM_PIO_STEP_SET,                // set the pins in 'mask'
+  PLATFORM_PIO_STEP_CLEAR,              // clear the pins in 'mask'
+  PLATFORM_PIO_STEP_WRITE,              // set the pins in 'mask' to their values in 'data'
+  PLATFORM_PIO_STEP_DELAY               // wait 'data' ticks of PIO_PROG_CLOCK
+};
+
+typedef struct
+{
+  u8 op;
+  u8 port;
+  pio_type mask;
+  u32 data;
+} platform_pio_step;
+
+void platform_pio_run( const platform_pio_step *steps, unsigned nsteps );
+
 // *****************************************************************************
 // CAN subsection
 
@@ -81,10 +100,19 @@ enum
   ELUA_CAN_ID_EXT
 };
 
+// Pass this as 'idtype' to platform_can_set_filter to disable a filter
+#define PLATFORM_CAN_FILTER_OFF               ( -1 )
+
 int platform_can_exists( unsigned id );
 u32 platform_can_setup( unsigned id, u32 clock );
 void platform_can_send( unsigned id, u32 canid, u8 idtype, u8 len, const u8 *data );
 int platform_can_recv( unsigned id, u32 *canid, u8 *idtype, u8 *len, u8 *data );
+int platform_can_set_filter( unsigned id, unsigned filter, u32 canid, u32 mask, int idtype );
+int platform_can_set_buffer( unsigned id, unsigned log2size );
+u32 platform_can_get_dropped( unsigned id );
+
+// Platform-specific function(s)
+int platform_s_can_recv( unsigned id, u32 *canid, u8 *idtype, u8 *len, u8 *data );
 
 // *****************************************************************************
 // SPI subsection
@@ -190,8 +218,19 @@ u32 platform_timer_op( unsigned id, int op, u32 data );
 u32 platform_s_timer_op( unsigned id, int op, u32 data );
 int platform_timer_set_match_int( unsigned id, u32 period_us, int type );
 int platform_s_timer_set_match_int( unsigned id, u32 period_us, int type );
+int platform_timer_set_match_cb( unsigned id, u32 period_us, int type, elua_int_c_handler cb );
 u32 platform_timer_get_diff_us( unsigned id, timer_data_type end, timer_data_type start );
 
+// Free-running 64-bit timebase (usually the CPU cycle counter), available if
+// the platform defines TIMEBASE_CLOCK (the frequency of the timebase in Hz)
+u64 platform_timebase_read();
+
+// Tickless virtual timers (VTMR_TICKLESS): free-running counter at VTMR_FREQ_HZ
+// and alarm that calls cmn_virtual_timer_cb when the counter reaches 'count'
+u32 platform_vtmr_get_count();
+void platform_vtmr_set_alarm( u32 count );
+void platform_vtmr_stop_alarm();
+
 // *****************************************************************************
 // PWM subsection
 
@@ -212,6 +251,24 @@ int platform_pwm_exists( unsigned id );
 u32 platform_pwm_setup( unsigned id, u32 frequency, unsigned duty );
 u32 platform_pwm_op( unsigned id, int op, u32 data );
 
+// PWM sequences (only needed if BUILD_PWM_SEQ is defined)
+// A sequence is an array of duty values (in 1/PLATFORM_PWM_SEQ_DUTY_MAX units)
+// applied to the channel at a fixed rate
+#define PLATFORM_PWM_SEQ_DUTY_MAX             10000
+
+enum
+{
+  PLATFORM_PWM_SEQ_ONESHOT,
+  PLATFORM_PWM_SEQ_LOOP
+};
+
+u32 platform_pwm_seq_start( unsigned id, const u16 *duty, u32 count, u32 rate, int mode );
+void platform_pwm_seq_stop( unsigned id );
+int platform_pwm_seq_get_status( unsigned id, u32 *ppasses );
+u32 platform_s_pwm_seq_start( unsigned id, u16 *duty, u32 count, u32 rate, int mode );
+void platform_s_pwm_seq_stop( unsigned id );
+void platform_pwm_seq_poll( unsigned id );
+
 // *****************************************************************************
 // CPU specific functions
 
@@ -252,6 +309,11 @@ int platform_adc_start_sequence();
 void platform_adc_stop( unsigned id );
 u32 platform_adc_setclock( unsigned id, u32 frequency);
 
+// Streaming functions (only needed if BUILD_ADC_STREAM is defined)
+u32 platform_adc_stream_start( unsigned timer_id, u32 frequency );
+void platform_adc_stream_stop();
+void platform_adc_stream_poll();
+
 // ADC Common Functions
 int platform_adc_exists( unsigned id );
 int platform_adc_check_timer_id( unsigned id, unsigned timer_id );
@@ -282,6 +344,32 @@ int platform_i2c_send_address( unsigned id, u16 address, int direction );
 int platform_i2c_send_byte( unsigned id, u8 data );
 int platform_i2c_recv_byte( unsigned id, int ack );
 
+// I2C transfer segment (see platform_i2c_transfer)
+typedef struct
+{
+  u8 *data;                     // data to send or buffer for the received data
+  u32 len;                      // number of bytes to send or to receive
+  int direction;                // PLATFORM_I2C_DIRECTION_TRANSMITTER or PLATFORM_I2C_DIRECTION_RECEIVER
+} platform_i2c_segment;
+
+int platform_i2c_transfer( unsigned id, u16 address, const platform_i2c_segment *segs, unsigned nsegs );
+
+// *****************************************************************************
+// Internal flash subsection
+// The flash is divided in sectors (the erase units), numbered from 0. It must
+// be memory mapped (it is read directly at the addresses returned by
+// platform_flash_get_sector_start). Writes can only change bits from 1 to 0
+// (a word that was already written can be written again to clear more bits),
+// the address and the size of a write are always multiples of 4.
+
+u32 platform_flash_get_num_sectors();
+// Returns the address of a sector (sectid == number of sectors returns the end of the flash)
+u32 platform_flash_get_sector_start( u32 sectid );
+// Returns the first sector after the firmware image
+u32 platform_flash_get_first_free_sector();
+int platform_flash_erase( u32 sectid );
+int platform_flash_write( const void *from, u32 toaddr, u32 size );
+
 // *****************************************************************************
 // Ethernet specific functions
 
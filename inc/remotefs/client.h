@@ -24,6 +24,7 @@ int rfsc_close( int fd );
 u32 rfsc_opendir( const char* name );
 void rfsc_readdir( u32 d, const char **pname, u32 *psize, u32 *ptime );
 int rfsc_closedir( u32 d );
+u32 rfsc_dirstamp( const char *name );
 
 #endif
 
@@ -15,7 +15,10 @@
 #define   RFS_OP_OPENDIR  0x06
 #define   RFS_OP_READDIR  0x07
 #define   RFS_OP_CLOSEDIR 0x08
-#define   RFS_OP_LAST     RFS_OP_CLOSEDIR
+#define   RFS_OP_READZ    0x09
+#define   RFS_OP_WRITEZ   0x0A
+#define   RFS_OP_DIRSTAMP 0x0B
+#define   RFS_OP_LAST     RFS_OP_DIRSTAMP
 #define   RFS_OP_RES_MOD  0x80
 
 // Platform independent constants for "flags" in "open"
@@ -27,6 +30,8 @@
 #define   RFS_OPEN_FLAG_RDONLY      0x20
 #define   RFS_OPEN_FLAG_WRONLY      0x40
 #define   RFS_OPEN_FLAG_RDWR        0x80
+// Not a real open flag: asks the server to compress the file data (see RFS_OP_READZ/RFS_OP_WRITEZ)
+#define   RFS_OPEN_FLAG_COMPRESS    0x100
 
 // Platform independent seek modes for "seek"
 #define   RFS_LSEEK_SET             0x01
@@ -45,6 +50,10 @@ void remotefs_open_write_response( u8 *p, int result );
 int remotefs_open_read_response( const u8 *p, int *presult );
 void remotefs_open_write_request( u8 *p, const char* pathname, int flags, int mode );
 int remotefs_open_read_request( const u8 *p, const char **ppathname, int *pflags, int *pmode );
+// The response to an open request with RFS_OPEN_FLAG_COMPRESS also has the compression
+// method accepted by the server (servers without compression support ignore the flag)
+void remotefs_open_write_response_method( u8 *p, int result, int method );
+int remotefs_open_read_response_method( const u8 *p, int *presult, int *pmethod );
 
 // Function: ssize_t write(int fd, const void *buf, size_t count)
 void remotefs_write_write_response( u8 *p, u32 result );
@@ -58,6 +67,21 @@ int remotefs_read_read_response( const u8 *p, const u8 **ppdata, u32 *preadbytes
 void remotefs_read_write_request( u8 *p, int fd, u32 count );
 int remotefs_read_read_request( const u8 *p, int *pfd, u32 *pcount );
                                  
+// Function: ssize_t read(int fd, void *buf, size_t count) with compressed data
+// 'datalen' is the size of the data in the packet, 'readbytes' the size of the
+// uncompressed data (if they are equal the data is not compressed)
+void remotefs_readz_write_response( u8 *p, u32 datalen, u32 readbytes );
+int remotefs_readz_read_response( const u8 *p, const u8 **ppdata, u32 *pdatalen, u32 *preadbytes );
+void remotefs_readz_write_request( u8 *p, int fd, u32 count );
+int remotefs_readz_read_request( const u8 *p, int *pfd, u32 *pcount );
+
+// Function: ssize_t write(int fd, const void *buf, size_t count) with compressed data
+// Same convention as readz for 'datalen' and 'count'
+void remotefs_writez_write_response( u8 *p, u32 result );
+int remotefs_writez_read_response( const u8 *p, u32 *presult );
+void remotefs_writez_write_request( u8 *p, int fd, const void *buf, u32 datalen, u32 count );
+int remotefs_writez_read_request( const u8 *p, int *pfd, const void **pbuf, u32 *pdatalen, u32 *pcount );
+
 // Function: int close( int fd )
 void remotefs_close_write_response( u8 *p, int result );
 int remotefs_close_read_response( const u8 *p, int *presult );
@@ -89,5 +113,13 @@ int remotefs_closedir_read_response( const u8 *p, int *pd );
 void remotefs_closedir_write_request( u8 *p, u32 d );
 int remotefs_closedir_read_request( const u8 *p, u32 *pd );
 
+// Function: u32 dirstamp( const char *name )
+// Returns a hash of the listing of the directory (file names and sizes), or 0
+// if the directory can't be read. Used to revalidate cached listings.
+void remotefs_dirstamp_write_response( u8 *p, u32 stamp );
+int remotefs_dirstamp_read_response( const u8 *p, u32 *pstamp );
+void remotefs_dirstamp_write_request( u8 *p, const char *name );
+int remotefs_dirstamp_read_request( const u8 *p, const char **pname );
+
 #endif
 
@@ -8,14 +8,43 @@
 
 /*******************************************************************************
 The Read-Only "filesystem" resides in a contiguous zone of memory, with the
-following structure, repeated for each file:
+following structure (all the numbers are little endian):
 
-Filename: ASCIIZ, max length is DM_MAX_FNAME_LENGTH defined here, empty if last file
-File size: (2 bytes)
-File data: (file size bytes)
+Header:
+  Magic: ROMFS_MAGIC (4 bytes)
+  Number of files: N (2 bytes)
+  Number of hash buckets: H (2 bytes, a power of 2)
+  Bucket table: H + 1 entries (2 bytes each). The files in bucket 'b' are the
+    directory entries from 'table[ b ]' to 'table[ b + 1 ] - 1'.
+  Padding up to a multiple of 4 bytes
+Directory: N entries, sorted by bucket, each entry is:
+  Offset of the file name: 4 bytes (ASCIIZ)
+  Offset of the file data: 4 bytes (a multiple of ROMFS_ALIGN)
+  File size: 4 bytes
+File names and file data
+
+The bucket of a file is ROMFS_HASH( name ) & ( H - 1 ), where the hash is
+computed on the lower case version of the name (file names are not case
+sensitive). Finding a file only needs to look at the entries in its bucket.
+
+The file names can contain directories ('lib/net/http.lua'), the separator
+is always '/' and each part of the name is at most DM_MAX_FNAME_LENGTH chars
+long. Directories don't have their own entries, the full name is hashed, so
+opening a file in a subdirectory (for example 'require "net.http"' with
+'/rom/lib/?.lua' in package.path) costs the same as in the root directory.
+The image is generated by utils/mkfs.lua (or mkfs.py).
 
 *******************************************************************************/
 
+#define ROMFS_MAGIC             "eRFS"
+#define ROMFS_MAGIC_SIZE        4
+#define ROMFS_HEADER_SIZE       8
+#define ROMFS_DIRENT_SIZE       12
+#define ROMFS_ALIGN             4
+
+// Hash function: 'h' is the current hash (initially 0), 'c' the next char
+#define ROMFS_HASH_STEP( h, c ) ( ( h ) * 33 + ( c ) )
+
 enum
 {
   FS_FILE_NOT_FOUND,
@@ -31,7 +60,7 @@ typedef struct
 {
   u32 baseaddr;
   u32 offset;
-  u16 size;
+  u32 size;
   p_read_fs_byte p_read_func;
 } FS;
   
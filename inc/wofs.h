@@ -0,0 +1,12 @@
+// Write once file system (internal flash)
+
+#ifndef __WOFS_H__
+#define __WOFS_H__
+
+#include "type.h"
+#include "devman.h"
+
+// FS functions
+const DM_DEVICE* wofs_init();
+
+#endif
@@ -18,10 +18,15 @@
 #define XMODEM_ERROR_OUTOFSYNC        (-2)
 #define XMODEM_ERROR_RETRYEXCEED      (-3)
 #define XMODEM_ERROR_OUTOFMEM         (-4)
+#define XMODEM_ERROR_DECOMPRESS       (-5)
+#define XMODEM_ERROR_WRITE            (-6)
 
 typedef void ( *p_xm_send_func )( u8 );
 typedef int ( *p_xm_recv_func )( u32 );
+// Receives the data of each block, returns 0 or an error code to cancel the transfer
+typedef int ( *p_xm_data_func )( void *pdata, const u8 *p, u32 size );
 long xmodem_receive( char** dest );
+long xmodem_receive_stream( p_xm_data_func func, void *pdata );
 void xmodem_init( p_xm_send_func send_func, p_xm_recv_func recv_func );
 
 #endif // #ifndef __XMODEM_H__
@@ -9,6 +9,10 @@ _bytecnt = 0
 
 maxlen = 30
 
+# Image format constants (see inc/romfs.h)
+ROMFS_MAGIC = "eRFS"
+ROMFS_ALIGN = 4
+
 # Line output function
 def _add_data( data, outfile, moredata = True ):
   global _crtline, _numdata, _bytecnt
@@ -23,9 +27,79 @@ def _add_data( data, outfile, moredata = True ):
     _crtline = '  '
     _numdata = 0
 
+# Write a 16-bit or a 32-bit number (little endian)
+def _add_number( data, nbytes, outfile ):
+  for i in range( nbytes ):
+    _add_data( data & 0xFF, outfile )
+    data = data >> 8
+
+# Write 0s until the image size is a multiple of 'align'
+def _add_padding( align, outfile ):
+  while _bytecnt % align != 0:
+    _add_data( 0, outfile )
+
+# Hash of a file name (must match ROMFS_HASH_STEP in inc/romfs.h)
+def _hash( name ):
+  h = 0
+  for c in name.lower():
+    h = ( h * 33 + ord( c ) ) & 0xFFFFFFFF
+  return h
+
+# Check the length of each part of a file name ('a/b/c.lua')
+def _check_name( name ):
+  for part in name.split( '/' ):
+    if len( part ) > maxlen:
+      return False
+  return True
+
+# Write the whole image: header, hash buckets, directory, names and data
+def _write_image( files, outfile ):
+  nbuckets = 1
+  while nbuckets < len( files ):
+    nbuckets = nbuckets * 2
+  # Sort the files by bucket (the sort is stable)
+  files.sort( key = lambda f: _hash( f[ 0 ] ) % nbuckets )
+  buckets = [ _hash( f[ 0 ] ) % nbuckets for f in files ]
+  # Header
+  for c in ROMFS_MAGIC:
+    _add_data( ord( c ), outfile )
+  _add_number( len( files ), 2, outfile )
+  _add_number( nbuckets, 2, outfile )
+  # Bucket table: index of the first file in each bucket
+  crt = 0
+  for b in range( nbuckets + 1 ):
+    while crt < len( files ) and buckets[ crt ] < b:
+      crt = crt + 1
+    _add_number( crt, 2, outfile )
+  _add_padding( ROMFS_ALIGN, outfile )
+  # Compute the name and data offsets
+  offset = _bytecnt + len( files ) * 12
+  nameoffsets, dataoffsets = [], []
+  for fname, filedata in files:
+    nameoffsets.append( offset )
+    offset = offset + len( fname ) + 1
+  for fname, filedata in files:
+    offset = ( offset + ROMFS_ALIGN - 1 ) & ~( ROMFS_ALIGN - 1 )
+    dataoffsets.append( offset )
+    offset = offset + len( filedata )
+  # Directory
+  for i in range( len( files ) ):
+    _add_number( nameoffsets[ i ], 4, outfile )
+    _add_number( dataoffsets[ i ], 4, outfile )
+    _add_number( len( files[ i ][ 1 ] ), 4, outfile )
+  # Names and data
+  for fname, filedata in files:
+    for c in fname:
+      _add_data( ord( c ), outfile )
+    _add_data( 0, outfile ) # ASCIIZ
+  for fname, filedata in files:
+    _add_padding( ROMFS_ALIGN, outfile )
+    for c in filedata:
+      _add_data( ord( c ), outfile )
+
 # dirname - the directory where the files are located.
 # outname - the name of the C output
-# flist - list of files
+# flist - list of files (names relative to 'dirname', subdirectories are kept in the image)
 # mode - preprocess the file system:
 #   "verbatim" - copy the files directly to the FS as they are
 #   "compile" - precompile all files to Lua bytecode and then copy them
@@ -52,8 +126,11 @@ def mkfs( dirname, outname, flist, mode, compcmd ):
   outfile.write( "const unsigned char %s_fs[] = \n{\n" % ( outname.lower() ) )
   
   # Process all files
+  files = []
   for fname in flist:
-    if len( fname ) > maxlen:
+    # The directory separator in the image is always '/'
+    fname = fname.replace( '\\', '/' ).lstrip( '/' )
+    if not _check_name( fname ):
       print "Skipping %s (name longer than %d chars)" % ( fname, maxlen )
       continue 
       
@@ -106,23 +183,12 @@ def mkfs( dirname, outname, flist, mode, compcmd ):
     if fextpart == ".lua" and mode != "verbatim":
       os.remove( newname )
 
-    # Write name, size, id, numpars
-    for c in fname:
-      _add_data( ord( c ), outfile )
-    _add_data( 0, outfile ) # ASCIIZ
-    size_l = len( filedata ) & 0xFF
-    size_h = ( len( filedata ) >> 8 ) & 0xFF
-    _add_data( size_l, outfile )
-    _add_data( size_h, outfile )
-    # Then write the rest of the file
-    for c in filedata:
-      _add_data( ord( c ), outfile )
-    
-    # Report
+    files.append( ( fname, filedata ) )
     print "Encoded file %s (%d bytes)" % ( fname, len( filedata ) )
     
-  # All done, write the final "0" (terminator)
-  _add_data( 0, outfile, False )
+  # All done, write the image
+  _write_image( files, outfile )
+  _add_data( 0, outfile, False ) # the array can't be empty
   outfile.write( "};\n\n#endif\n" );
   outfile.close()
   print "Done, total size is %d bytes" % _bytecnt
@@ -2,12 +2,15 @@ local args = { ... }
 local b = require "utils.build"
 local builder = b.new_builder( ".build/mux" )
 local utils = b.utils
+
+-- Set builder options BEFORE calling builder:init
+builder:add_option( 'bench', 'build the throughput benchmark (test/mux_bench.c) instead of the multiplexer', false )
 builder:init( args )
 builder:set_build_mode( builder.BUILD_DIR_LINEARIZED )
 
 local flist = "main.c"
 local rfs_flist = "main.c server.c log.c deskutils.c rfs_transports.c"
-local cdefs = "RFS_UDP_TRANSPORT RFS_INSIDE_MUX_MODE"
+local cdefs = "RFS_UDP_TRANSPORT RFS_INSIDE_MUX_MODE LZF_HLOG=12"
 local socklib
 if utils.is_windows() then
   cdefs = cdefs .. " WIN32_BUILD"
@@ -19,7 +22,19 @@ else
   exeprefix = ""
 end
 
-local full_files = utils.prepend_path( flist, "mux_src" ) .. utils.prepend_path( rfs_flist, "rfs_server_src" ) .. "src/remotefs/remotefs.c src/eluarpc.c"
+if builder:get_option( 'bench' ) then
+  if utils.is_windows() then
+    print "The benchmark is not supported under Windows"
+    os.exit( 1 )
+  end
+  builder:set_compile_cmd( builder:compile_cmd{ flags = "-O2 -Wall", includes = "inc rfs_server_src" } )
+  builder:set_link_cmd( builder:link_cmd{} )
+  builder:make_exe_target( "mux_bench", "test/mux_bench.c" )
+  builder:build()
+  return
+end
+
+local full_files = utils.prepend_path( flist, "mux_src" ) .. utils.prepend_path( rfs_flist, "rfs_server_src" ) .. "src/remotefs/remotefs.c src/eluarpc.c src/lzf.c"
 local local_include = "mux_src rfs_server_src inc inc/remotefs"
 local compcmd = builder:compile_cmd{ flags = "-m32 -O0 -Wall -g", defines = cdefs, includes = local_include }
 local linkcmd = builder:link_cmd{ flags = "-m32", libraries = socklib }
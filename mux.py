@@ -2,7 +2,7 @@ import os, sys, platform
 
 flist = "main.c"
 rfs_flist = "main.c server.c log.c deskutils.c rfs_transports.c"
-cdefs = "-DRFS_UDP_TRANSPORT -DRFS_INSIDE_MUX_MODE"
+cdefs = "-DRFS_UDP_TRANSPORT -DRFS_INSIDE_MUX_MODE -DLZF_HLOG=12"
 socklib = ''
 ptlib = ''
 if platform.system() == "Windows":
@@ -18,7 +18,7 @@ else:
 output = "mux%s" % exeprefix
 
 rfs_full_files = " " + " ".join( [ "rfs_server_src/%s" % name for name in rfs_flist.split() ] )
-full_files = " " + " ".join( [ "mux_src/%s" % name for name in flist.split() ] ) + rfs_full_files + " src/remotefs/remotefs.c src/eluarpc.c"
+full_files = " " + " ".join( [ "mux_src/%s" % name for name in flist.split() ] ) + rfs_full_files + " src/remotefs/remotefs.c src/eluarpc.c src/lzf.c"
 local_include = "-Imux_src -Irfs_server_src -Iinc -Iinc/remotefs"
 
 # Compiler/linker options
@@ -9,5 +9,11 @@
 #define NET_TIMEOUT_MS              100
 #define MEM_BUF_SIZE                ( 6 * 1024 )
 
+// Multiplexer I/O: size of a read block, size of the output queue of each
+// service port and retry interval for the queues that can't be written
+#define MUX_BLOCK_SIZE              1024
+#define MUX_QUEUE_SIZE              ( 16 * 1024 )
+#define MUX_RETRY_MS                10
+
 #endif
 
@@ -24,17 +24,17 @@
 #define HND_TRANSPORT_OFFSET  0
 #define HND_FIRST_VOFFSET     1
 
-#define RFS_PSEUDO_SELIDX     0xFF
-
 // Send/receive/init function pointers
 typedef u32 ( *p_recv_func )( u8 *p, u32 size );
 typedef u32 ( *p_send_func )( const u8 *p, u32 size );
 typedef int ( *p_init_func )( void );
 
-// Serial thread buffer structure
+// Service port data (with its output queue)
 typedef struct {
   const char *pname;
   ser_handler fd;
+  u8 *queue;
+  unsigned qstart, qlen;
 } SERVICE_DATA;
 
 // Serial transport data structure
@@ -53,12 +53,17 @@ static p_send_func transport_send;
 static p_init_func transport_init;
 
 static int service_id_in = -1, service_id_out = -1;
+static int prev_sent = -1, got_esc;
  
 static ser_handler transport_hnd = SER_HANDLER_INVALID;
 static int mux_mode;
 static int verbose_mode;
 static int rfs_service_id = -1, service_offset;
 
+// Transport output buffer
+static u8 mux_tx_buf[ 2 * MUX_BLOCK_SIZE + 16 ];
+static unsigned mux_tx_len;
+
 // ***************************************************************************
 // Serial transport implementation
 
@@ -92,9 +97,191 @@ static int transport_ser_init()
 // ****************************************************************************
 // Utility functions and helpers
 
+static void transport_flush()
+{
+  if( mux_tx_len > 0 )
+  {
+    transport_send( mux_tx_buf, mux_tx_len );
+    mux_tx_len = 0;
+  }
+}
+
 static void transport_send_byte( u8 data )
 {
-  transport_send( &data, 1 );
+  if( mux_tx_len == sizeof( mux_tx_buf ) )
+    transport_flush();
+  mux_tx_buf[ mux_tx_len ++ ] = data;
+}
+
+// Send a block of data from the given service to the transport
+// The service ID is sent only if it's different from the previous one
+static void transport_send_data( int sid, const u8 *p, u32 size )
+{
+  u8 c;
+
+  if( size == 0 )
+    return;
+  if( sid != service_id_out )
+  {
+    log_msg( "Changed service_id_out from %d(%X) to %d(%X).\n", service_id_out, service_id_out, sid, sid );
+    transport_send_byte( sid );
+    service_id_out = sid;
+  }
+  while( size -- )
+  {
+    c = *p ++;
+    // Escape the data byte if needed
+    if( c == SERMUX_ESCAPE_CHAR || c == SERMUX_FORCE_SID_CHAR || ( c >= SERMUX_SERVICE_ID_FIRST && c <= SERMUX_SERVICE_ID_LAST ) )
+    {
+      transport_send_byte( SERMUX_ESCAPE_CHAR );
+      transport_send_byte( c ^ SERMUX_ESCAPE_XOR_MASK );
+      prev_sent = SERMUX_ESC_MASK | ( c ^ SERMUX_ESCAPE_XOR_MASK );
+    }
+    else
+    {
+      transport_send_byte( c );
+      prev_sent = c;
+    }
+  }
+}
+
+// Add data to the output queue of a service (the data that doesn't fit is lost,
+// as well as the data for a closed service)
+static void service_queue_put( SERVICE_DATA *ps, const u8 *p, u32 size )
+{
+  if( ps->fd == SER_HANDLER_INVALID )
+    return;
+  if( size > MUX_QUEUE_SIZE - ps->qlen )
+  {
+    log_msg( "Output queue of %s is full, %u byte(s) lost.\n", ps->pname, ( unsigned )( size - ( MUX_QUEUE_SIZE - ps->qlen ) ) );
+    size = MUX_QUEUE_SIZE - ps->qlen;
+  }
+  if( ps->qstart + ps->qlen + size > MUX_QUEUE_SIZE )
+  {
+    memmove( ps->queue, ps->queue + ps->qstart, ps->qlen );
+    ps->qstart = 0;
+  }
+  memcpy( ps->queue + ps->qstart + ps->qlen, p, size );
+  ps->qlen += size;
+}
+
+// Write as much as possible from the output queue of a service, without
+// blocking. Returns the number of bytes still in the queue.
+static unsigned service_queue_flush( SERVICE_DATA *ps )
+{
+  u32 written;
+
+  if( ps->qlen > 0 )
+  {
+    written = ser_try_write( ps->fd, ps->queue + ps->qstart, ps->qlen );
+    ps->qstart += written;
+    if( ( ps->qlen -= written ) == 0 )
+      ps->qstart = 0;
+  }
+  return ps->qlen;
+}
+
+// Close a service port after its other side was closed or got an error
+// The other services keep running
+static void service_close( SERVICE_DATA *ps )
+{
+  log_msg( "Service port %s was closed, ignoring it from now on.\n", ps->pname );
+  ser_close( ps->fd );
+  ps->fd = SER_HANDLER_INVALID;
+  ps->qstart = ps->qlen = 0;
+}
+
+// Send a run of data bytes received for the current service_id_in
+static void service_send_run( const u8 *p, u32 size )
+{
+  u16 rfs_size;
+  u8 *rfs_ptr;
+
+  if( size == 0 )
+    return;
+  if( service_id_in == rfs_service_id ) // this request is for the RFS server
+  {
+    while( size -- )
+    {
+      rfs_mem_read_request_packet( *p ++ );
+      if( rfs_mem_has_response() ) // we have a response from the RFS server
+      {
+        rfs_mem_write_response( &rfs_size, &rfs_ptr );
+        transport_send_data( rfs_service_id, rfs_ptr, rfs_size );
+        rfs_mem_start_request(); // initialize the RFS server for a new request
+      }
+    }
+  }
+  else
+    service_queue_put( services + service_id_in - SERMUX_SERVICE_ID_FIRST - service_offset, p, size );
+}
+
+// Interpret a block of data received on the transport. The data bytes are
+// grouped in runs (all the bytes between two service ID changes), each run
+// is sent to its service at once. Returns 0 for protocol error.
+static int transport_receive( const u8 *p, u32 size )
+{
+  u8 run[ MUX_BLOCK_SIZE ];
+  unsigned runlen = 0;
+  int c;
+
+  while( size -- )
+  {
+    c = *p ++;
+    if( got_esc )
+    {
+      // Got an escape last time, check the char now (with the 5th bit flipped)
+      c ^= SERMUX_ESCAPE_XOR_MASK;
+      if( c != SERMUX_ESCAPE_CHAR && c != SERMUX_FORCE_SID_CHAR && ( c < SERMUX_SERVICE_ID_FIRST || c > SERMUX_SERVICE_ID_LAST ) )
+      {
+        log_err( "Protocol error: invalid escape sequence\n" );
+        return 0;
+      }
+      got_esc = 0;
+    }
+    else if( c == SERMUX_ESCAPE_CHAR )
+    {
+      got_esc = 1;
+      continue;
+    }
+    else if( c >= SERMUX_SERVICE_ID_FIRST && c <= SERMUX_SERVICE_ID_LAST )
+    {
+      if( c != service_id_in )
+      {
+        service_send_run( run, runlen );
+        runlen = 0;
+        log_msg( "Changed service_id_in from %d(%X) to %d(%X).\n", service_id_in, service_id_in, c, c );
+        service_id_in = c;
+      }
+      continue;
+    }
+    else if( c == SERMUX_FORCE_SID_CHAR )
+    {
+      if( prev_sent == -1 )
+      {
+        log_err( "Protocol error: got request to resend service ID when the last char sent was not set.\n" );
+        return 0;
+      }
+      log_msg( "Got request to resend service_id_out %d(%X).\n", service_id_out, service_id_out );
+      // Re-transmit the last data AND the service ID
+      transport_send_byte( service_id_out );
+      if( prev_sent & SERMUX_ESC_MASK )
+        transport_send_byte( SERMUX_ESCAPE_CHAR );
+      transport_send_byte( prev_sent & 0xFF );
+      prev_sent = -1;
+      continue;
+    }
+    // Got a data byte
+    if( service_id_in == -1 )
+    {
+      transport_send_byte( SERMUX_FORCE_SID_CHAR );
+      log_msg( "Requested resend of service ID for byte %3d ('%c').\n", c, isprint( c ) ? c : ' ' );
+    }
+    else
+      run[ runlen ++ ] = c;
+  }
+  service_send_run( run, runlen );
+  return 1;
 }
 
 // Transport parser
@@ -152,16 +339,14 @@ int main( int argc, char *argv[] )
 int main( int argc, char **argv )
 #endif
 {
-  unsigned i;
+  unsigned i, pending;
   SERVICE_DATA *tservice;
-  int c, prev_sent = -1;
-  int temp;
-  int got_esc = 0;
   char* rfs_dir_name;
   ser_handler *phandlers;
+  unsigned *hndsvc, nhandlers;
   int selidx;
-  u16 rfs_size = 0;
-  u8 *rfs_ptr;
+  u8 buf[ MUX_BLOCK_SIZE ];
+  u32 readbytes;
 
   // Interpret arguments
   setvbuf( stdout, NULL, _IONBF, 0 );  
@@ -223,12 +408,16 @@ int main( int argc, char **argv )
     log_err( "Not enough memory\n" );
     return 1;
   }
-  if( ( phandlers = ( ser_handler* )malloc( sizeof( ser_handler ) * ( vport_num + 1 ) ) ) == NULL )
+  // phandlers has the transport followed by the open service ports, hndsvc
+  // the index of the service of each of them
+  if( ( phandlers = ( ser_handler* )malloc( sizeof( ser_handler ) * ( vport_num + 1 ) ) ) == NULL ||
+      ( hndsvc = ( unsigned* )malloc( sizeof( unsigned ) * ( vport_num + 1 ) ) ) == NULL )
   {
     log_err( "Not enough memory\n" );
     return 1;  
   }
   phandlers[ HND_TRANSPORT_OFFSET ] = transport_hnd;
+  nhandlers = vport_num + 1;
 
   memset( services, 0, sizeof( SERVICE_DATA ) * vport_num );
   for( i = 0; i < vport_num; i ++ ) 
@@ -245,7 +434,13 @@ int main( int argc, char **argv )
       return 1;
     }
     tservice->pname = argv[ i + FIRST_SERVICE_IDX ];
+    if( ( tservice->queue = ( u8* )malloc( MUX_QUEUE_SIZE ) ) == NULL )
+    {
+      log_err( "Not enough memory\n" );
+      return 1;
+    }
     phandlers[ i + HND_FIRST_VOFFSET ] = tservice->fd;
+    hndsvc[ i + HND_FIRST_VOFFSET ] = i;
   }
   
   // Setup RFS server in RFSMUX mode
@@ -263,113 +458,41 @@ int main( int argc, char **argv )
   // Main service thread
   while( 1 )
   {
-    if( rfs_size > 0 ) // Response packet from RFS
+    // Try to empty the output queues of the service ports first
+    for( i = pending = 0; i < vport_num; i ++ )
+      pending += service_queue_flush( services + i );
+    // Then wait for data (if some queues are not empty, retry them later)
+    selidx = ser_select_read( phandlers, nhandlers, buf, MUX_BLOCK_SIZE, &readbytes, pending > 0 ? MUX_RETRY_MS : SER_INF_TIMEOUT );
+    if( selidx == SER_SELECT_TIMEOUT )
+      continue;
+    if( selidx < 0 )
     {
-      c = *rfs_ptr ++;
-      rfs_size --;
-      selidx = RFS_PSEUDO_SELIDX;
+      log_err( "Error on select, aborting program\n" );
+      return 1;
     }
-    else
+    if( selidx == HND_TRANSPORT_OFFSET ) // Got data on transport interface
     {
-      if( ( c = ser_select_byte( phandlers, vport_num + 1, SER_INF_TIMEOUT ) ) == -1 )
+      if( readbytes == 0 )
       {
-        log_err( "Error on select, aborting program\n" );
+        log_err( "Transport port closed, aborting program\n" );
         return 1;
       }
-      selidx = c >> 8;
-      c = c & 0xFF;
+      if( transport_receive( buf, readbytes ) == 0 )
+        return 1;
     }
-    //log_msg( "Got byte %d from idx %d\n", c, selidx );
-    if( selidx == HND_TRANSPORT_OFFSET ) // Got byte on transport interface
+    else if( readbytes == 0 ) // A service port was closed, remove it from the list
     {
-      // Interpret byte
-      if( c != SERMUX_ESCAPE_CHAR )
+      service_close( services + hndsvc[ selidx ] );
+      for( i = selidx; i < nhandlers - 1; i ++ )
       {
-        if( c >= SERMUX_SERVICE_ID_FIRST && c <= SERMUX_SERVICE_ID_LAST )
-        {
-          log_msg( "Changed service_id_in from %d(%X) to %d(%X).\n", service_id_in, service_id_in, c, c );
-          service_id_in = c;
-        } 
-        else if( c == SERMUX_FORCE_SID_CHAR )
-        {
-          if( prev_sent == -1 )
-          {
-            log_err( "Protocol error: got request to resend service ID when the last char sent was not set.\n" );
-            return 1;
-          }
-          log_msg( "Got request to resend service_id_out %d(%X).\n", service_id_out, service_id_out );
-          // Re-transmit the last data AND the service ID
-          transport_send_byte( service_id_out );
-          if( prev_sent & SERMUX_ESC_MASK )
-            transport_send_byte( SERMUX_ESCAPE_CHAR );
-          transport_send_byte( prev_sent & 0xFF );
-          prev_sent = -1;
-        }          
-        else
-        {
-          if( got_esc )
-          {
-            // Got an escape last time, check the char now (with the 5th bit flipped)
-            c ^= SERMUX_ESCAPE_XOR_MASK;
-            if( c != SERMUX_ESCAPE_CHAR && c != SERMUX_FORCE_SID_CHAR && ( c < SERMUX_SERVICE_ID_FIRST || c > SERMUX_SERVICE_ID_LAST ) )
-            {
-               log_err( "Protocol error: invalid escape sequence\n" );
-               return 1;
-            }
-            got_esc = 0;
-          }  
-          if( service_id_in == -1 )
-          {
-            transport_send_byte( SERMUX_FORCE_SID_CHAR );
-            log_msg( "Requested resend of service ID for byte %3d ('%c').\n", c, isprint( c ) ? c : ' ' );
-          }
-          else
-          {
-            if( service_id_in == rfs_service_id ) // this request is for the RFS server
-            {
-              rfs_mem_read_request_packet( c );
-              if( rfs_mem_has_response() ) // we have a response from the RFS server
-              {
-                rfs_mem_write_response( &rfs_size, &rfs_ptr );                  
-                rfs_mem_start_request(); // initialize the RFS server for a new request  
-              }
-            }
-            else
-            {
-              //log_msg( "Sending byte %d to %s\n", c, services[ service_id_in - SERMUX_SERVICE_ID_FIRST - service_offset ].pname );
-              ser_write_byte( services[ service_id_in - SERMUX_SERVICE_ID_FIRST - service_offset ].fd, c );
-            }
-          }
-        }
-      }
-      else
-        got_esc = 1;                          
-    }
-    else
-    {
-      // No byte to read, there must be something to send
-      if( selidx == RFS_PSEUDO_SELIDX )
-        temp = SERMUX_SERVICE_ID_FIRST;
-      else        
-        temp = SERMUX_SERVICE_ID_FIRST + selidx - HND_FIRST_VOFFSET + service_offset;
-      prev_sent = c;
-      // Send the service ID first if needed
-      if( temp != service_id_out )
-      {
-        log_msg( "Changed service_id_out from %d(%X) to %d(%X).\n", service_id_out, service_id_out, temp, temp );
-        transport_send_byte( temp );
-      }
-      // Then send the actual data byte, escaping it if needed
-      if( c == SERMUX_ESCAPE_CHAR || c == SERMUX_FORCE_SID_CHAR || ( c >= SERMUX_SERVICE_ID_FIRST && c <= SERMUX_SERVICE_ID_LAST ) )
-      {
-        transport_send_byte( SERMUX_ESCAPE_CHAR );
-        transport_send_byte( ( u8 )c ^ SERMUX_ESCAPE_XOR_MASK );
-        prev_sent = SERMUX_ESC_MASK | ( ( u8 )c ^ SERMUX_ESCAPE_XOR_MASK );
+        phandlers[ i ] = phandlers[ i + 1 ];
+        hndsvc[ i ] = hndsvc[ i + 1 ];
       }
-      else
-        transport_send_byte( c );
-      service_id_out = temp;
+      nhandlers --;
     }
+    else // Got data from a service port, send it to the transport
+      transport_send_data( SERMUX_SERVICE_ID_FIRST + hndsvc[ selidx ] + service_offset, buf, readbytes );
+    transport_flush();
   }
 
   return 0;
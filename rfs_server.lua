@@ -5,14 +5,16 @@ local utils = b.utils
 
 -- Set builder options BEFORE calling builder:init
 builder:add_option( 'sim', 'run under the eLua simulator', false )
+builder:add_option( 'loadtest', 'build the multi-client load test (test/rfs_loadtest.c) instead of the server', false )
 builder:init( args )
 builder:set_build_mode( builder.BUILD_DIR_LINEARIZED )
 
 local sim = builder:get_option( 'sim' )
 sim = sim and 1 or 0
+local loadtest = builder:get_option( 'loadtest' )
 
 local flist, socklib
-local cdefs = "RFS_STANDALONE_MODE"
+local cdefs = "RFS_STANDALONE_MODE LZF_HLOG=12"
 local mainname = sim == 0 and 'main.c' or 'main_sim.c'
 local exeprefix = ""
 if utils.is_windows() then
@@ -25,12 +27,14 @@ if utils.is_windows() then
   exeprefix = "exe"
   socklib = 'ws2_32'
 else
-  flist = mainname .. " server.c os_io_posix.c log.c net_posix.c serial_posix.c deskutils.c"
+  if loadtest then mainname = '../test/rfs_loadtest.c' end
+  flist = mainname .. " server.c os_io_posix.c log.c net_posix.c serial_posix.c deskutils.c rfs_transports.c"
 end
 
 local output = sim == 0 and 'rfs_server' or 'rfs_sim_server'
+if loadtest then output = 'rfs_loadtest' end
 local local_include = "rfs_server_src inc/remotefs inc"
-local full_files = utils.prepend_path( flist, 'rfs_server_src' ) .. " src/remotefs/remotefs.c src/eluarpc.c"
+local full_files = utils.prepend_path( flist, 'rfs_server_src' ) .. " src/remotefs/remotefs.c src/eluarpc.c src/lzf.c"
 local compcmd = builder:compile_cmd{ flags = "-m32 -O0 -Wall -g", defines = cdefs, includes = local_include }
 local linkcmd = builder:link_cmd{ flags = "-m32", libraries = socklib }
 builder:set_compile_cmd( compcmd )
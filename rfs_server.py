@@ -3,7 +3,7 @@ import os, sys, platform
 sim = ARGUMENTS.get( 'sim', '0' )
 
 flist = ""
-cdefs = "-DRFS_STANDALONE_MODE"
+cdefs = "-DRFS_STANDALONE_MODE -DLZF_HLOG=12"
 socklib = ''
 if sim == '0':
   mainname = "main.c"
@@ -18,7 +18,7 @@ if platform.system() == "Windows":
   exeprefix = ".exe"
   socklib = '-lws2_32'
 else:
-  flist = "%s server.c os_io_posix.c log.c net_posix.c serial_posix.c deskutils.c" % mainname
+  flist = "%s server.c os_io_posix.c log.c net_posix.c serial_posix.c deskutils.c rfs_transports.c" % mainname
   exeprefix = ""
 
 if sim == '0':
@@ -28,7 +28,7 @@ else:
 #endif
 
 full_files = " " + " ".join( [ "rfs_server_src/%s" % name for name in flist.split() ] )
-full_files = full_files + " src/remotefs/remotefs.c src/eluarpc.c"
+full_files = full_files + " src/remotefs/remotefs.c src/eluarpc.c src/lzf.c"
 local_include = "-Irfs_server_src -Iinc/remotefs -Iinc"
 
 # Compiler/linker options
@@ -31,6 +31,7 @@ int main( int argc, const char **argv )
     return 1;
   }
   
+#ifdef WIN32_BUILD
   // Enter the server endless loop
   while( 1 )
   {
@@ -41,5 +42,8 @@ int main( int argc, const char **argv )
 
   p_transport_data->f_cleanup();
   return 0;
+#else
+  return rfs_server_loop();
+#endif
 }
 #endif
@@ -11,6 +11,19 @@
 #include "remotefs.h"
 #include "eluarpc.h"
 
+// The directory handles are indexes (starting at 1) in this table, since a
+// DIR* doesn't fit in an u32 on 64-bit hosts
+#define OS_MAX_DIRS           64
+static DIR* os_dirs[ OS_MAX_DIRS ];
+
+// Return the DIR* of handle 'd' (NULL if invalid)
+static DIR* os_get_dir( u32 d )
+{
+  if( d == 0 || d > OS_MAX_DIRS )
+    return NULL;
+  return os_dirs[ d - 1 ];
+}
+
 int os_open( const char *pathname, int flags, int mode )
 {
   int realflags = 0;
@@ -111,8 +124,17 @@ int os_isdir( const char* name )
 
 u32 os_opendir( const char* name )
 {
+  u32 i;
+
   if( name || strlen( name ) == 0 || ( strlen( name ) == 1 && !strcmp( name, "/" ) ) )
-    return ( u32 )opendir( name );
+  {
+    for( i = 0; i < OS_MAX_DIRS; i ++ )
+      if( os_dirs[ i ] == NULL )
+        break;
+    if( i == OS_MAX_DIRS || ( os_dirs[ i ] = opendir( name ) ) == NULL )
+      return 0;
+    return i + 1;
+  }
   return 0;
 }
 
@@ -120,10 +142,11 @@ void os_readdir( u32 d, const char **pname )
 {
   struct dirent *ent;
   static char realname[ RFS_MAX_FNAME_SIZE + 1 ]; 
+  DIR *dir = os_get_dir( d );
 
   while( 1 )
   {
-    ent = readdir( ( DIR* )d );
+    ent = dir ? readdir( dir ) : NULL;
     if( ent == NULL )
     {
       *pname = NULL;
@@ -141,6 +164,11 @@ void os_readdir( u32 d, const char **pname )
 
 int os_closedir( u32 d )
 {
-  return closedir( ( DIR* )d );
+  DIR *dir = os_get_dir( d );
+
+  if( dir == NULL )
+    return -1;
+  os_dirs[ d - 1 ] = NULL;
+  return closedir( dir );
 }
 
@@ -16,6 +16,10 @@
 #include "rfs.h"
 #include "deskutils.h"
 #include "rfs_transports.h"
+#ifndef WIN32_BUILD
+#include <poll.h>
+#include <arpa/inet.h>
+#endif
 
 // ****************************************************************************
 // Local variables
@@ -24,6 +28,26 @@
 u8 rfs_buffer[ MAX_PACKET_SIZE + ELUARPC_WRITE_REQUEST_EXTRA ];
 const RFS_TRANSPORT_DATA *p_transport_data; 
 
+// Transport types
+enum
+{
+  RFS_TRANSPORT_SER,
+  RFS_TRANSPORT_UDP,
+  RFS_TRANSPORT_MEM
+};
+
+// Transport instance data
+typedef struct
+{
+  int type;
+  ser_handler ser;
+  NET_SOCKET sock;
+  int client;                           // client index (serial transport only)
+} RFS_TRANSPORT;
+
+static RFS_TRANSPORT rfs_transports[ RFS_MAX_TRANSPORTS ];
+static unsigned rfs_num_transports;
+
 // ****************************************************************************
 // Serial transport implementation
 
@@ -299,6 +323,203 @@ static int mem_server_init()
 
 const RFS_TRANSPORT_DATA mem_transport_data = { NULL, NULL, NULL };
 
+// ****************************************************************************
+// Multi-client event loop (POSIX only)
+// All the transports are watched with poll(). Each serial port is a client,
+// each different UDP peer (address and port) is also a client. Every client
+// has its own request buffer and its own server file/directory tables.
+
+#ifndef WIN32_BUILD
+
+// RFS client data
+typedef struct
+{
+  SERVER_CLIENT sdata;                  // server data (file and directory handles)
+  unsigned transport;                   // index in rfs_transports
+  struct sockaddr_in addr;              // peer address (UDP clients only)
+  u16 readlen, expected;                // request assembly state
+  u32 lastused;                         // for replacing the oldest UDP client
+  int active;
+  u8 buf[ MAX_PACKET_SIZE + ELUARPC_WRITE_REQUEST_EXTRA ];
+} RFS_CLIENT;
+
+static RFS_CLIENT rfs_clients[ RFS_MAX_CLIENTS ];
+static u32 rfs_client_tick;
+
+// Allocate a new client for the given transport (NULL if no more clients are available)
+static RFS_CLIENT* rfs_client_new( unsigned transport )
+{
+  unsigned i;
+  RFS_CLIENT *pc;
+
+  for( i = 0, pc = rfs_clients; i < RFS_MAX_CLIENTS; i ++, pc ++ )
+    if( !pc->active )
+    {
+      memset( pc, 0, sizeof( RFS_CLIENT ) - sizeof( pc->buf ) );
+      server_client_init( &pc->sdata );
+      pc->transport = transport;
+      pc->active = 1;
+      pc->lastused = rfs_client_tick;
+      return pc;
+    }
+  return NULL;
+}
+
+// Find the client that corresponds to the given UDP peer, allocate a new one if needed
+static RFS_CLIENT* rfs_client_get_udp( unsigned transport, const struct sockaddr_in *paddr )
+{
+  unsigned i;
+  RFS_CLIENT *pc, *poldest = NULL;
+
+  for( i = 0, pc = rfs_clients; i < RFS_MAX_CLIENTS; i ++, pc ++ )
+  {
+    if( !pc->active || pc->transport != transport )
+      continue;
+    if( pc->addr.sin_addr.s_addr == paddr->sin_addr.s_addr && pc->addr.sin_port == paddr->sin_port )
+      return pc;
+    if( poldest == NULL || rfs_client_tick - pc->lastused > rfs_client_tick - poldest->lastused )
+      poldest = pc;
+  }
+  if( ( pc = rfs_client_new( transport ) ) == NULL )
+  {
+    // Replace the UDP client that was inactive for the longest time
+    if( ( pc = poldest ) == NULL )
+      return NULL;
+    log_msg( "RFS: too many clients, dropping client %s:%u\n", inet_ntoa( pc->addr.sin_addr ), ( unsigned )ntohs( pc->addr.sin_port ) );
+    server_client_cleanup( &pc->sdata );
+    pc->active = 0;
+    pc = rfs_client_new( transport );
+  }
+  pc->addr = *paddr;
+  log_msg( "RFS: new UDP client %s:%u\n", inet_ntoa( paddr->sin_addr ), ( unsigned )ntohs( paddr->sin_port ) );
+  return pc;
+}
+
+// Send the response in the client buffer
+static void rfs_client_send_response( RFS_CLIENT *pc )
+{
+  u16 temp16;
+  const RFS_TRANSPORT *pt = rfs_transports + pc->transport;
+
+  if( eluarpc_get_packet_size( pc->buf, &temp16 ) == ELUARPC_ERR )
+    return;
+  log_msg( "send_response_packet: sending response packet of %u bytes\n", ( unsigned )temp16 );
+  if( pt->type == RFS_TRANSPORT_SER )
+    ser_write( pt->ser, pc->buf, temp16 );
+  else
+    net_sendto( pt->sock, ( char* )pc->buf, temp16, 0, ( struct sockaddr* )&pc->addr, sizeof( pc->addr ) );
+}
+
+// Add data to the client request, execute the request when it is complete
+static void rfs_client_feed( RFS_CLIENT *pc, const u8 *p, unsigned len )
+{
+  u16 temp16;
+  unsigned chunk;
+
+  pc->lastused = ++ rfs_client_tick;
+  while( len )
+  {
+    chunk = ( pc->expected ? pc->expected : ELUARPC_START_OFFSET ) - pc->readlen;
+    if( chunk > len )
+      chunk = len;
+    memcpy( pc->buf + pc->readlen, p, chunk );
+    pc->readlen += chunk;
+    p += chunk;
+    len -= chunk;
+    if( pc->expected == 0 && pc->readlen == ELUARPC_START_OFFSET )
+    {
+      // Got the length
+      if( eluarpc_get_packet_size( pc->buf, &temp16 ) == ELUARPC_ERR || temp16 <= ELUARPC_START_OFFSET || temp16 > sizeof( pc->buf ) )
+      {
+        // Invalid request, discard all the data that we got
+        log_msg( "read_request_packet: ERROR getting packet size.\n" );
+        pc->readlen = 0;
+        return;
+      }
+      pc->expected = temp16;
+    }
+    else if( pc->expected && pc->readlen == pc->expected )
+    {
+      // Got a full request
+      server_execute_client_request( &pc->sdata, pc->buf );
+      rfs_client_send_response( pc );
+      pc->readlen = pc->expected = 0;
+    }
+  }
+}
+
+int rfs_server_loop()
+{
+  struct pollfd fds[ RFS_MAX_TRANSPORTS ];
+  u8 data[ MAX_PACKET_SIZE + ELUARPC_WRITE_REQUEST_EXTRA ];
+  struct sockaddr_in from;
+  socklen_t fromlen;
+  unsigned i;
+  int readbytes;
+  RFS_TRANSPORT *pt;
+  RFS_CLIENT *pc;
+
+  // Serial transports have a single client, allocate it now
+  for( i = 0, pt = rfs_transports; i < rfs_num_transports; i ++, pt ++ )
+  {
+    if( pt->type == RFS_TRANSPORT_MEM )
+    {
+      log_err( "Invalid transport in standalone mode.\n" );
+      return 1;
+    }
+    fds[ i ].fd = pt->type == RFS_TRANSPORT_SER ? ( int )pt->ser : net_socket( pt->sock );
+    fds[ i ].events = POLLIN;
+    if( pt->type == RFS_TRANSPORT_SER )
+    {
+      if( ( pc = rfs_client_new( i ) ) == NULL )
+      {
+        log_err( "Too many clients\n" );
+        return 1;
+      }
+      pt->client = pc - rfs_clients;
+    }
+  }
+
+  while( 1 )
+  {
+    if( poll( fds, rfs_num_transports, -1 ) < 0 )
+    {
+      if( errno == EINTR )
+        continue;
+      log_err( "Error on poll, aborting program\n" );
+      return 1;
+    }
+    for( i = 0, pt = rfs_transports; i < rfs_num_transports; i ++, pt ++ )
+    {
+      if( fds[ i ].revents & ( POLLERR | POLLHUP | POLLNVAL ) )
+      {
+        // Stop watching this transport
+        log_err( "Transport %u closed\n", i );
+        fds[ i ].fd = -1;
+        continue;
+      }
+      if( !( fds[ i ].revents & POLLIN ) )
+        continue;
+      if( pt->type == RFS_TRANSPORT_SER )
+      {
+        readbytes = ( int )ser_read( pt->ser, data, sizeof( data ), SER_NO_TIMEOUT );
+        if( readbytes > 0 )
+          rfs_client_feed( rfs_clients + pt->client, data, readbytes );
+      }
+      else
+      {
+        fromlen = sizeof( from );
+        readbytes = recvfrom( net_socket( pt->sock ), ( char* )data, sizeof( data ), 0, ( struct sockaddr* )&from, &fromlen );
+        if( readbytes > 0 && ( pc = rfs_client_get_udp( i, &from ) ) != NULL )
+          rfs_client_feed( pc, data, readbytes );
+      }
+    }
+  }
+  return 0;
+}
+
+#endif // #ifndef WIN32_BUILD
+
 // ****************************************************************************
 // Helper functions
 
@@ -310,6 +531,11 @@ static int parse_transport_and_init( const char* s )
   long tempi = 0;
   int flow;
   
+  if( rfs_num_transports == RFS_MAX_TRANSPORTS )
+  {
+    log_err( "Too many transports\n" );
+    return 0;
+  }
   if( strstr( s, "ser:" ) == s )
   {
     p_transport_data = &ser_transport_data;
@@ -343,6 +569,8 @@ static int parse_transport_and_init( const char* s )
     }
     tempi = ser_server_init( temps, tempi, flow );
     free( temps );    
+    rfs_transports[ rfs_num_transports ].type = RFS_TRANSPORT_SER;
+    rfs_transports[ rfs_num_transports ++ ].ser = ser;
     return tempi;
   }
   else if( strstr( s, "udp:" ) == s )
@@ -359,12 +587,17 @@ static int parse_transport_and_init( const char* s )
       log_err( "Unable to initialize network\n" );
       return 0;
     }
-    return udp_server_init( tempi );   
+    if( udp_server_init( tempi ) == 0 )
+      return 0;
+    rfs_transports[ rfs_num_transports ].type = RFS_TRANSPORT_UDP;
+    rfs_transports[ rfs_num_transports ++ ].sock = trans_socket;
+    return 1;
   }
   else if( !strcmp( s, "mem" ) )
   {
     // Direct memory transport, only used with mux in rfsmux mode
     p_transport_data = &mem_transport_data;
+    rfs_transports[ rfs_num_transports ++ ].type = RFS_TRANSPORT_MEM;
     return mem_server_init( tempi ); 
   }  
   log_err( "Error: unsupported transport\n" );
@@ -375,39 +608,56 @@ static int parse_transport_and_init( const char* s )
 // Entry point
 
 #define TRANSPORT_ARG_IDX     1
-#define DIRNAME_ARG_IDX       2
-#define VERBOSE_ARG_IDX       3
 #define MIN_ARGC_COUNT        3
-#define VERBOSE_ARGC_COUNT    4
 
 int rfs_init( int argc, const char **argv )
 {
+  int i, dirname_idx;
+
   setvbuf( stdout, NULL, _IONBF, 0 );
   if( argc < MIN_ARGC_COUNT )
   {
-    log_err( "Usage: %s <transport> <dirname> [-v]\n", argv[ 0 ] );
+    log_err( "Usage: %s <transport> [<transport> ...] <dirname> [-v]\n", argv[ 0 ] );
     log_err( "  Serial transport: 'ser:<sername>,<serspeed>,<flow> ('flow' defines the flow control and can be either 'none' or 'rtscts')\n" );
     log_err( "  UDP transport: 'udp:<port>'\n" );
+    log_err( "More than one transport can be given (POSIX only), all of them are served at the same time.\n" );
     log_err( "Use -v for verbose output.\n" );
     return 1;
   }
   
-  if( ( argc >= VERBOSE_ARGC_COUNT ) && !strcmp( argv[ VERBOSE_ARG_IDX ], "-v" ) )
+  // The directory name is the last argument (before the optional '-v')
+  dirname_idx = argc - 1;
+  if( !strcmp( argv[ dirname_idx ], "-v" ) )
+  {
+    dirname_idx --;
     log_init( LOG_ALL );
+  }
   else
     log_init( LOG_NONE );  
+  if( dirname_idx <= TRANSPORT_ARG_IDX )
+  {
+    log_err( "No transport specified\n" );
+    return 1;
+  }
+#ifdef WIN32_BUILD
+  if( dirname_idx - TRANSPORT_ARG_IDX > 1 )
+  {
+    log_err( "Multiple transports are not supported on this platform\n" );
+    return 1;
+  }
+#endif
   
-  if( !os_isdir( argv[ DIRNAME_ARG_IDX ] ) )
+  if( !os_isdir( argv[ dirname_idx ] ) )
   {
-    log_err( "Invalid directory %s\n", argv[ DIRNAME_ARG_IDX ] );
+    log_err( "Invalid directory %s\n", argv[ dirname_idx ] );
     return 1;
   }  
-  if( parse_transport_and_init( argv[ TRANSPORT_ARG_IDX ] ) == 0 )
-    return 1;
+  for( i = TRANSPORT_ARG_IDX; i < dirname_idx; i ++ )
+    if( parse_transport_and_init( argv[ i ] ) == 0 )
+      return 1;
     
     // Setup RFS server
-  server_setup( argv[ DIRNAME_ARG_IDX ] );   
-  log_msg( "Sharing directory %s\n", argv[ DIRNAME_ARG_IDX ] );
+  server_setup( argv[ dirname_idx ] );   
+  log_msg( "Sharing directory %s\n", argv[ dirname_idx ] );
   return 0;
-} 
-
+}
@@ -13,10 +13,17 @@ typedef struct
 
 #define   MAX_PACKET_SIZE     4096
 
+// Maximum number of transports and clients served at the same time
+#define   RFS_MAX_TRANSPORTS  8
+#define   RFS_MAX_CLIENTS     16
+
 extern const RFS_TRANSPORT_DATA *p_transport_data; 
 extern const RFS_TRANSPORT_DATA mem_transport_data;
 extern const RFS_TRANSPORT_DATA udp_transport_data;
 extern const RFS_TRANSPORT_DATA ser_transport_data;
 extern u8 rfs_buffer[ MAX_PACKET_SIZE + ELUARPC_WRITE_REQUEST_EXTRA ];
 
+// Serve all the transports given to rfs_init (POSIX only)
+int rfs_server_loop();
+
 #endif
\ No newline at end of file
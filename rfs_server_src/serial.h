@@ -10,6 +10,9 @@
 #define SER_OK                  0
 #define SER_ERR                 1
 
+// Returned by ser_select_read when the timeout expires (or there's no data)
+#define SER_SELECT_TIMEOUT      ( -2 )
+
 // Serial interface modes (blocking or non blocking)
 #define SER_MODE_BLOCKING       0
 #define SER_MODE_NONBLOCKING    1
@@ -39,7 +42,9 @@ u32 ser_read( ser_handler id, u8* dest, u32 maxsize, u32 timeout );
 int ser_read_byte( ser_handler id, u32 timeout );
 u32 ser_write( ser_handler id, const u8 *src, u32 size );
 u32 ser_write_byte( ser_handler id, u8 data );
+u32 ser_try_write( ser_handler id, const u8 *src, u32 size );
 int ser_select_byte( ser_handler *pobjects, unsigned nobjects, int timeout );
+int ser_select_read( ser_handler *pobjects, unsigned nobjects, u8 *dest, u32 maxsize, u32 *preadbytes, u32 timeout );
 
 #endif
 
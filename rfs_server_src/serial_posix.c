@@ -167,14 +167,37 @@ int ser_read_byte( ser_handler id, u32 timeout )
   return res == 1 ? data : -1;
 }
 
-// Write up to the specified number of bytes, return bytes actually written
+// Write the specified number of bytes (waiting for the port to accept them,
+// since it's in non-blocking mode), return bytes actually written
 u32 ser_write( ser_handler id, const u8 *src, u32 size )
 {
-  u32 res;
-  
-  res = ( u32 )write( ( int )id, src, size );
-  tcdrain( ( int )id );
-  return res;
+  u32 total = 0;
+  int res;
+  fd_set writefs;
+
+  while( total < size )
+  {
+    res = write( ( int )id, src + total, size - total );
+    if( res > 0 )
+      total += res;
+    else if( res == -1 && ( errno == EAGAIN || errno == EINTR ) )
+    {
+      FD_ZERO( &writefs );
+      FD_SET( ( int )id, &writefs );
+      select( ( int )id + 1, NULL, &writefs, NULL, NULL );
+    }
+    else
+      break;
+  }
+  return total;
+}
+
+// Write as many bytes as possible without blocking, return bytes actually written
+u32 ser_try_write( ser_handler id, const u8 *src, u32 size )
+{
+  int res = write( ( int )id, src, size );
+
+  return res > 0 ? ( u32 )res : 0;
 }
 
 // Write a byte to the serial port
@@ -220,3 +243,50 @@ int ser_select_byte( ser_handler *pobjects, unsigned nobjects, int timeout )
   return res;
 }
 
+// Perform 'select' on the specified handler(s) and read up to 'maxsize' bytes
+// from one of the handlers that have data (the search starts after the
+// handler returned by the previous call, so all of them get a chance to be
+// read). Returns the index of the handler (and the number of bytes read in
+// *preadbytes), SER_SELECT_TIMEOUT or -1 for error. If the handler was
+// closed by the other side or has a read error, its index is returned with
+// *preadbytes set to 0. A read that would block counts as a timeout.
+int ser_select_read( ser_handler *pobjects, unsigned nobjects, u8 *dest, u32 maxsize, u32 *preadbytes, u32 timeout )
+{
+  static unsigned next;
+  unsigned i, idx;
+  int maxfd = -1, res;
+  fd_set readfs;
+  struct timeval tv;
+
+  FD_ZERO( &readfs );
+  for( i = 0; i < nobjects; i ++ )
+  {
+    FD_SET( pobjects[ i ], &readfs );
+    if( pobjects[ i ] > maxfd )
+      maxfd = pobjects[ i ];
+  }
+  tv.tv_sec = timeout / 1000;
+  tv.tv_usec = ( timeout % 1000 ) * 1000;
+  res = select( maxfd + 1, &readfs, NULL, NULL, timeout == SER_INF_TIMEOUT ? NULL : &tv );
+  if( res == 0 )
+    return SER_SELECT_TIMEOUT;
+  if( res < 0 )
+    return errno == EINTR ? SER_SELECT_TIMEOUT : -1;
+  for( i = 0; i < nobjects; i ++ )
+  {
+    idx = ( next + i ) % nobjects;
+    if( FD_ISSET( pobjects[ idx ], &readfs ) )
+    {
+      next = idx + 1;
+      if( ( res = read( pobjects[ idx ], dest, maxsize ) ) < 0 )
+      {
+        if( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR )
+          return SER_SELECT_TIMEOUT;
+        res = 0;
+      }
+      *preadbytes = ( u32 )res;
+      return ( int )idx;
+    }
+  }
+  return -1;
+}
@@ -298,3 +298,27 @@ int ser_select_byte( ser_handler *pobjects, unsigned nobjects, int timeout )
   return res;    
 }
 
+// Write as many bytes as possible without blocking, return bytes actually written
+// (the Win32 implementation always waits for the write to finish)
+u32 ser_try_write( ser_handler id, const u8 *src, u32 size )
+{
+  return ser_write( id, src, size );
+}
+
+// Perform 'select' on the specified handler(s) and read up to 'maxsize' bytes
+// from one of the handlers that have data. Returns the index of the handler
+// (and the number of bytes read in *preadbytes), SER_SELECT_TIMEOUT or -1 for error
+int ser_select_read( ser_handler *pobjects, unsigned nobjects, u8 *dest, u32 maxsize, u32 *preadbytes, u32 timeout )
+{
+  int res, idx;
+
+  if( ( res = ser_select_byte( pobjects, nobjects, ( int )timeout ) ) == -1 )
+    return timeout == SER_INF_TIMEOUT ? -1 : SER_SELECT_TIMEOUT;
+  idx = res >> 8;
+  dest[ 0 ] = ( u8 )res;
+  *preadbytes = 1;
+  // Get the rest of the data that is already available
+  if( maxsize > 1 )
+    *preadbytes += ser_read( pobjects[ idx ], dest + 1, maxsize - 1, SER_NO_TIMEOUT );
+  return idx;
+}
@@ -8,20 +8,74 @@
 #include "type.h"
 #include "os_io.h"
 #include "log.h"
+#include "lzf.h"
 
 static char* server_basedir;
-static char server_fullname[ PLATFORM_MAX_FNAME_LEN + 1 ];
+static SERVER_CLIENT server_default_client;
+static u8 server_zbuf[ SERVER_MAX_READ_SIZE ];
 
-typedef int ( *p_server_handler )( u8 *p );
+typedef int ( *p_server_handler )( SERVER_CLIENT *pclient, u8 *p );
+
+// *****************************************************************************
+// Internal helpers: handle tables and file names
+
+// Build the real name of 'name' (relative to the shared directory) in 'dest'
+static void server_get_fullname( char *dest, const char *name )
+{
+  char separator[ 2 ] = { PLATFORM_PATH_SEPARATOR, 0 };
+
+  dest[ 0 ] = dest[ PLATFORM_MAX_FNAME_LEN ] = 0;
+  strncpy( dest, server_basedir, PLATFORM_MAX_FNAME_LEN );
+  if( name && strlen( name ) > 0 )
+  {
+    if( dest[ strlen( dest ) - 1 ] != PLATFORM_PATH_SEPARATOR )
+      strncat( dest, separator, PLATFORM_MAX_FNAME_LEN - strlen( dest ) );
+    strncat( dest, name, PLATFORM_MAX_FNAME_LEN - strlen( dest ) );
+  }
+}
+
+// Return the OS file descriptor of the client file descriptor 'fd' (-1 if invalid)
+static int server_get_os_fd( SERVER_CLIENT *pclient, int fd )
+{
+  if( fd < 0 || fd >= SERVER_MAX_FDS )
+    return -1;
+  return pclient->fds[ fd ];
+}
+
+// Return the OS directory handle of the client directory handle 'd' (0 if invalid)
+static u32 server_get_os_dir( SERVER_CLIENT *pclient, u32 d )
+{
+  if( d == 0 || d > SERVER_MAX_DIRS )
+    return 0;
+  return pclient->dirs[ d - 1 ];
+}
+
+// Get the size of the file 'name' (relative to the shared directory) in
+// '*psize'. Returns 0 if OK, -1 if the file can't be opened.
+static int server_get_file_size( const char *name, u32 *psize )
+{
+  char fullname[ PLATFORM_MAX_FNAME_LEN + 1 ];
+  int fd;
+
+  server_get_fullname( fullname, name );
+  if( ( fd = os_open( fullname, RFS_OPEN_FLAG_RDONLY, 0 ) ) == -1 )
+  {
+    log_msg( "server_get_file_size: unable to open file %s\n", fullname );
+    return -1;
+  }
+  *psize = os_lseek( fd, 0, RFS_LSEEK_END );
+  os_close( fd );
+  return 0;
+}
 
 // *****************************************************************************
 // Internal helpers: execute the given request, build the response
 
-static int server_open( u8 *p )
+static int server_open( SERVER_CLIENT *pclient, u8 *p )
 {
   const char *filename;
-  int mode, flags, fd;
-  char separator[ 2 ] = { PLATFORM_PATH_SEPARATOR, 0 };
+  int mode, flags, fd, i;
+  char fullname[ PLATFORM_MAX_FNAME_LEN + 1 ];
   
   // Validate request
   log_msg( "server_open: request handler starting\n" );
@@ -30,23 +84,34 @@ static int server_open( u8 *p )
     log_msg( "server_open: unable to read request\n" );
     return SERVER_ERR;
   }
-  // Get real filename
-  server_fullname[ 0 ] = server_fullname[ PLATFORM_MAX_FNAME_LEN ] = 0;
-  strncpy( server_fullname, server_basedir, PLATFORM_MAX_FNAME_LEN );
-  if( filename && strlen( filename ) > 0 )
+  // Get a free client file descriptor
+  for( i = 0; i < SERVER_MAX_FDS; i ++ )
+    if( pclient->fds[ i ] == -1 )
+      break;
+  if( i == SERVER_MAX_FDS )
   {
-    if( server_fullname[ strlen( server_fullname ) - 1 ] != PLATFORM_PATH_SEPARATOR )
-      strncat( server_fullname, separator, PLATFORM_MAX_FNAME_LEN );
-    strncat( server_fullname, filename, PLATFORM_MAX_FNAME_LEN );
+    log_msg( "server_open: too many open files\n" );
+    remotefs_open_write_response( p, -1 );
+    return SERVER_OK;
   }
-  log_msg( "server_open: full file path is %s\n", server_fullname ); 
-  fd = os_open( server_fullname, flags, mode );
+  // Get real filename
+  server_get_fullname( fullname, filename );
+  log_msg( "server_open: full file path is %s\n", fullname ); 
+  fd = os_open( fullname, flags, mode );
   log_msg( "server_open: OS file handler is %d\n", fd );
-  remotefs_open_write_response( p, fd );
+  if( fd != -1 )
+  {
+    pclient->fds[ i ] = fd;
+    fd = i;
+  }
+  if( flags & RFS_OPEN_FLAG_COMPRESS )
+    remotefs_open_write_response_method( p, fd, LZF_METHOD_LZF );
+  else
+    remotefs_open_write_response( p, fd );
   return SERVER_OK;
 }
 
-static int server_write( u8 *p )
+static int server_write( SERVER_CLIENT *pclient, u8 *p )
 {
   int fd;
   const void *buf;
@@ -59,16 +124,17 @@ static int server_write( u8 *p )
     return SERVER_ERR;
   }
   log_msg( "server_write: fd = %d, buf = %p, count = %u\n", fd, buf, ( unsigned )count );
-  count = ( u32 )os_write( fd, buf, count );
+  count = ( u32 )os_write( server_get_os_fd( pclient, fd ), buf, count );
   log_msg( "server_write: OS response is %u\n", ( unsigned )count );
   remotefs_write_write_response( p, count );
   return SERVER_OK;
 }
 
-static int server_read( u8 *p )
+static int server_read( SERVER_CLIENT *pclient, u8 *p )
 {
   int fd;
   u32 count;
+  s32 readbytes;
   
   log_msg( "server_read: request handler starting\n" );
   if( remotefs_read_read_request( p, &fd, &count ) == ELUARPC_ERR )
@@ -77,13 +143,75 @@ static int server_read( u8 *p )
     return SERVER_ERR;
   }
   log_msg( "server_read: fd = %d, count = %u\n", fd, ( unsigned )count );
-  count = ( u32 )os_read( fd, p + ELUARPC_READ_BUF_OFFSET, count );
-  log_msg( "server_read: OS response is %u\n", ( unsigned )count );
+  if( count > SERVER_MAX_READ_SIZE )
+    count = SERVER_MAX_READ_SIZE;
+  readbytes = os_read( server_get_os_fd( pclient, fd ), p + ELUARPC_READ_BUF_OFFSET, count );
+  log_msg( "server_read: OS response is %d\n", ( int )readbytes );
+  // A read error can't be sent back in the response, so report it as EOF
+  count = readbytes == -1 ? 0 : ( u32 )readbytes;
   remotefs_read_write_response( p, count );
   return SERVER_OK;
 }
 
-static int server_close( u8 *p )
+static int server_writez( SERVER_CLIENT *pclient, u8 *p )
+{
+  int fd;
+  const void *buf;
+  u32 datalen, count;
+
+  log_msg( "server_writez: request handler starting\n" );
+  if( remotefs_writez_read_request( p, &fd, &buf, &datalen, &count ) == ELUARPC_ERR )
+  {
+    log_msg( "server_writez: unable to read request\n" );
+    return SERVER_ERR;
+  }
+  log_msg( "server_writez: fd = %d, datalen = %u, count = %u\n", fd, ( unsigned )datalen, ( unsigned )count );
+  if( datalen != count )
+  {
+    if( count > SERVER_MAX_READ_SIZE || lzf_decompress( buf, datalen, server_zbuf, count ) != count )
+    {
+      log_msg( "server_writez: invalid compressed data\n" );
+      remotefs_writez_write_response( p, 0 );
+      return SERVER_OK;
+    }
+    buf = server_zbuf;
+  }
+  count = ( u32 )os_write( server_get_os_fd( pclient, fd ), buf, count );
+  log_msg( "server_writez: OS response is %u\n", ( unsigned )count );
+  remotefs_writez_write_response( p, count );
+  return SERVER_OK;
+}
+
+static int server_readz( SERVER_CLIENT *pclient, u8 *p )
+{
+  int fd;
+  u32 count, datalen;
+  s32 readbytes;
+
+  log_msg( "server_readz: request handler starting\n" );
+  if( remotefs_readz_read_request( p, &fd, &count ) == ELUARPC_ERR )
+  {
+    log_msg( "server_readz: unable to read request\n" );
+    return SERVER_ERR;
+  }
+  log_msg( "server_readz: fd = %d, count = %u\n", fd, ( unsigned )count );
+  if( count > SERVER_MAX_READ_SIZE )
+    count = SERVER_MAX_READ_SIZE;
+  readbytes = os_read( server_get_os_fd( pclient, fd ), server_zbuf, count );
+  log_msg( "server_readz: OS response is %d\n", ( int )readbytes );
+  count = readbytes == -1 ? 0 : ( u32 )readbytes;
+  // Send the data uncompressed if compression doesn't make it smaller
+  if( count == 0 || ( datalen = lzf_compress( server_zbuf, count, p + ELUARPC_READ_BUF_OFFSET, count - 1 ) ) == 0 )
+  {
+    memcpy( p + ELUARPC_READ_BUF_OFFSET, server_zbuf, count );
+    datalen = count;
+  }
+  log_msg( "server_readz: sending %u bytes\n", ( unsigned )datalen );
+  remotefs_readz_write_response( p, datalen, count );
+  return SERVER_OK;
+}
+
+static int server_close( SERVER_CLIENT *pclient, u8 *p )
 {
   int fd;
   
@@ -94,13 +222,20 @@ static int server_close( u8 *p )
     return SERVER_ERR;
   }
   log_msg( "server_close: fd = %d\n", fd );
-  fd = os_close( fd );
+  if( server_get_os_fd( pclient, fd ) != -1 )
+  {
+    os_close( pclient->fds[ fd ] );
+    pclient->fds[ fd ] = -1;
+    fd = 0;
+  }
+  else
+    fd = -1;
   log_msg( "server_close: OS response is %d\n", fd );
   remotefs_close_write_response( p, fd );
   return SERVER_OK;
 }
 
-static int server_lseek( u8 *p )
+static int server_lseek( SERVER_CLIENT *pclient, u8 *p )
 {
   int fd, whence;
   s32 offset;
@@ -112,17 +247,18 @@ static int server_lseek( u8 *p )
     return SERVER_ERR;
   }
   log_msg( "server_lseek: fd = %d, offset = %d, whence = %d\n", fd, ( int )offset, whence );
-  offset = os_lseek( fd, offset, whence );
+  offset = os_lseek( server_get_os_fd( pclient, fd ), offset, whence );
   log_msg( "server_lseek: OS response is %d\n", ( int )offset );
   remotefs_lseek_write_response( p, offset );
   return SERVER_OK;
 }
 
-static int server_opendir( u8 *p )
+static int server_opendir( SERVER_CLIENT *pclient, u8 *p )
 {
   const char* name;
   u32 d;
-  char separator[ 2 ] = { PLATFORM_PATH_SEPARATOR, 0 };
+  unsigned i;
+  char fullname[ PLATFORM_MAX_FNAME_LEN + 1 ];
 
   log_msg( "server_opendir: request handler starting\n" );
   if( remotefs_opendir_read_request( p, &name ) == ELUARPC_ERR )
@@ -130,28 +266,34 @@ static int server_opendir( u8 *p )
     log_msg( "server_opendir: unable to read request\n" );
     return SERVER_ERR;
   }
+  // Get a free client directory handle
+  for( i = 0; i < SERVER_MAX_DIRS; i ++ )
+    if( pclient->dirs[ i ] == 0 )
+      break;
+  if( i == SERVER_MAX_DIRS )
+  {
+    log_msg( "server_opendir: too many open directories\n" );
+    remotefs_opendir_write_response( p, 0 );
+    return SERVER_OK;
+  }
   // Get real filename
-  server_fullname[ 0 ] = server_fullname[ PLATFORM_MAX_FNAME_LEN ] = 0;
-  strncpy( server_fullname, server_basedir, PLATFORM_MAX_FNAME_LEN );
-  if( name && strlen( name ) > 0 )
+  server_get_fullname( fullname, name );
+  log_msg( "server_opendir: full dirname is %s\n", fullname );
+  d = os_opendir( fullname );
+  log_msg( "server_opendir: OS response is %08X\n", ( unsigned )d );
+  if( d != 0 )
   {
-    if( server_fullname[ strlen( server_fullname ) - 1 ] != PLATFORM_PATH_SEPARATOR )
-      strncat( server_fullname, separator, PLATFORM_MAX_FNAME_LEN );
-    strncat( server_fullname, name, PLATFORM_MAX_FNAME_LEN );
+    pclient->dirs[ i ] = d;
+    d = i + 1;
   }
-  log_msg( "server_opendir: full dirname is %s\n", server_fullname );
-  d = os_opendir( server_fullname );
-  log_msg( "server_opendir: OS response is %08X\n", d );
   remotefs_opendir_write_response( p, d );
   return SERVER_OK;
 }
 
-static int server_readdir( u8 *p )
+static int server_readdir( SERVER_CLIENT *pclient, u8 *p )
 {
-  const char* name;
+  const char* name = NULL;
   u32 fsize = 0, d;
-  int fd;
-  char separator[ 2 ] = { PLATFORM_PATH_SEPARATOR, 0 };
 
   log_msg( "server_readdir: request handler starting\n" );
   if( remotefs_readdir_read_request( p, &d ) == ELUARPC_ERR )
@@ -159,38 +301,18 @@ static int server_readdir( u8 *p )
     log_msg( "server_readdir: unable to read request\n" );
     return SERVER_ERR;
   }
-  log_msg( "server_readdir: DIR = %08X\n", d );
-  os_readdir( d, &name );
-  if( name )
-  {
-    // Need to compute size now
-    // Get real filename
-    server_fullname[ 0 ] = server_fullname[ PLATFORM_MAX_FNAME_LEN ] = 0;
-    strncpy( server_fullname, server_basedir, PLATFORM_MAX_FNAME_LEN );
-    if( name && strlen( name ) > 0 )
-    {
-      if( server_fullname[ strlen( server_fullname ) - 1 ] != PLATFORM_PATH_SEPARATOR )
-        strncat( server_fullname, separator, PLATFORM_MAX_FNAME_LEN );
-      strncat( server_fullname, name, PLATFORM_MAX_FNAME_LEN );
-    }
-    fd = os_open( server_fullname, RFS_OPEN_FLAG_RDONLY, 0 );
-    if( fd )
-    {
-      fsize = os_lseek( fd, 0, RFS_LSEEK_END );
-      os_close( fd );
-    }
-    else
-    {
-      log_msg( "server_readdir: unable to open file %s\n", server_fullname );
-      name = NULL;
-    }
-  }
+  log_msg( "server_readdir: DIR = %08X\n", ( unsigned )d );
+  if( ( d = server_get_os_dir( pclient, d ) ) != 0 )
+    os_readdir( d, &name );
+  // Need to compute size now
+  if( name && server_get_file_size( name, &fsize ) == -1 )
+    name = NULL;
   log_msg( "server_readdir: OS response is fname = %s, fsize = %u\n", name, ( unsigned )fsize );
   remotefs_readdir_write_response( p, name, fsize, 0 );
   return SERVER_OK;
 }
 
-static int server_closedir( u8 *p )
+static int server_closedir( SERVER_CLIENT *pclient, u8 *p )
 {
   u32 d;
   int res;
@@ -201,10 +323,61 @@ static int server_closedir( u8 *p )
     log_msg( "server_closedir: unable to read request\n" );
     return SERVER_ERR;
   }
-  log_msg( "server_closedir: DIR = %08X\n", d );
-  res = os_closedir( d );
+  log_msg( "server_closedir: DIR = %08X\n", ( unsigned )d );
+  if( server_get_os_dir( pclient, d ) != 0 )
+  {
+    res = os_closedir( pclient->dirs[ d - 1 ] );
+    pclient->dirs[ d - 1 ] = 0;
+  }
+  else
+    res = -1;
   log_msg( "server_closedir: OS response is %d\n", res );
-  remotefs_closedir_write_response( p, d );
+  remotefs_closedir_write_response( p, res );
+  return SERVER_OK;
+}
+
+// The stamp is a FNV-1a hash of the names and sizes returned by readdir, so
+// it changes whenever a listing of the directory would change
+static int server_dirstamp( SERVER_CLIENT *pclient, u8 *p )
+{
+  const char *name, *fname;
+  u32 d, fsize, stamp = 0, i;
+  char fullname[ PLATFORM_MAX_FNAME_LEN + 1 ];
+  u8 sizebytes[ 4 ];
+
+  log_msg( "server_dirstamp: request handler starting\n" );
+  if( remotefs_dirstamp_read_request( p, &name ) == ELUARPC_ERR )
+  {
+    log_msg( "server_dirstamp: unable to read request\n" );
+    return SERVER_ERR;
+  }
+  server_get_fullname( fullname, name );
+  if( ( d = os_opendir( fullname ) ) != 0 )
+  {
+    stamp = 2166136261UL;
+    while( 1 )
+    {
+      os_readdir( d, &fname );
+      if( fname == NULL )
+        break;
+      if( server_get_file_size( fname, &fsize ) == -1 )
+        continue;
+      for( i = 0; i <= strlen( fname ); i ++ )
+        stamp = ( stamp ^ ( u8 )fname[ i ] ) * 16777619UL;
+      sizebytes[ 0 ] = fsize & 0xFF;
+      sizebytes[ 1 ] = ( fsize >> 8 ) & 0xFF;
+      sizebytes[ 2 ] = ( fsize >> 16 ) & 0xFF;
+      sizebytes[ 3 ] = fsize >> 24;
+      for( i = 0; i < 4; i ++ )
+        stamp = ( stamp ^ sizebytes[ i ] ) * 16777619UL;
+    }
+    os_closedir( d );
+    stamp &= 0xFFFFFFFFUL;
+    if( stamp == 0 )
+      stamp = 1;
+  }
+  log_msg( "server_dirstamp: stamp of %s is %08X\n", fullname, ( unsigned )stamp );
+  remotefs_dirstamp_write_response( p, stamp );
   return SERVER_OK;
 }
 
@@ -213,20 +386,52 @@ static int server_closedir( u8 *p )
 
 static const p_server_handler server_handlers[] = 
 { 
-  server_open, server_write, server_read, server_close, server_lseek, server_opendir, server_readdir, server_closedir
+  server_open, server_write, server_read, server_close, server_lseek, server_opendir, server_readdir, server_closedir,
+  server_readz, server_writez, server_dirstamp
 };
 
 void server_setup( const char* basedir )
 {
   server_basedir = strdup( basedir );
+  server_client_init( &server_default_client );
 }
 
 void server_cleanup()
 {
+  server_client_cleanup( &server_default_client );
   free( server_basedir );
   server_basedir = NULL;
 }
-int server_execute_request( u8 *pdata )
+
+void server_client_init( SERVER_CLIENT *pclient )
+{
+  unsigned i;
+
+  for( i = 0; i < SERVER_MAX_FDS; i ++ )
+    pclient->fds[ i ] = -1;
+  for( i = 0; i < SERVER_MAX_DIRS; i ++ )
+    pclient->dirs[ i ] = 0;
+}
+
+void server_client_cleanup( SERVER_CLIENT *pclient )
+{
+  unsigned i;
+
+  for( i = 0; i < SERVER_MAX_FDS; i ++ )
+    if( pclient->fds[ i ] != -1 )
+    {
+      os_close( pclient->fds[ i ] );
+      pclient->fds[ i ] = -1;
+    }
+  for( i = 0; i < SERVER_MAX_DIRS; i ++ )
+    if( pclient->dirs[ i ] != 0 )
+    {
+      os_closedir( pclient->dirs[ i ] );
+      pclient->dirs[ i ] = 0;
+    }
+}
+
+int server_execute_client_request( SERVER_CLIENT *pclient, u8 *pdata )
 {
   u8 req;
   
@@ -235,9 +440,13 @@ int server_execute_request( u8 *pdata )
     return SERVER_ERR;
   log_msg( "server_execute_request: got request with ID %d\n", req );
   if( req >= RFS_OP_FIRST && req <= RFS_OP_LAST ) 
-    return server_handlers[ req - RFS_OP_FIRST ]( pdata );
+    return server_handlers[ req - RFS_OP_FIRST ]( pclient, pdata );
   else
     return SERVER_ERR;
+}
 
+int server_execute_request( u8 *pdata )
+{
+  return server_execute_client_request( &server_default_client, pdata );
 }
 
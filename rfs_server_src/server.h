@@ -9,9 +9,28 @@
 #define SERVER_OK     0
 #define SERVER_ERR    1
 
+// Maximum number of open files and directories for each client
+#define SERVER_MAX_FDS      16
+#define SERVER_MAX_DIRS     4
+
+// Maximum size of a read request (the response must fit in the request buffer)
+#define SERVER_MAX_READ_SIZE  4096
+
+// Per-client server data
+// The file and directory handles sent to a client are indexes in these
+// tables, so a client can't access the files of another client
+typedef struct
+{
+  int fds[ SERVER_MAX_FDS ];
+  u32 dirs[ SERVER_MAX_DIRS ];
+} SERVER_CLIENT;
+
 // Server function                     
 void server_setup( const char *basedir );
 void server_cleanup();
+void server_client_init( SERVER_CLIENT *pclient );
+void server_client_cleanup( SERVER_CLIENT *pclient );
+int server_execute_client_request( SERVER_CLIENT *pclient, u8 *pdata );
 int server_execute_request( u8 *pdata );
 
 #endif
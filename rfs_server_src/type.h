@@ -7,8 +7,8 @@ typedef char s8;
 typedef unsigned char u8;
 typedef short s16;
 typedef unsigned short u16;
-typedef long s32;
-typedef unsigned long u32;
+typedef int s32;
+typedef unsigned int u32;
 typedef long long s64;
 typedef unsigned long long u64;
 
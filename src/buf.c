@@ -3,7 +3,7 @@
 #include "platform_conf.h"
 #include <stdio.h>
 
-#if defined( BUF_ENABLE_UART ) || defined( BUF_ENABLE_ADC )
+#if defined( BUF_ENABLE_UART ) || defined( BUF_ENABLE_ADC ) || defined( BUF_ENABLE_CAN )
 #define BUF_ENABLE
 #endif
 
@@ -36,12 +36,19 @@
   static buf_desc buf_desc_adc [ 0 ];
 #endif
 
+#ifdef BUF_ENABLE_CAN
+  static buf_desc buf_desc_can [ NUM_CAN ];
+#else
+  static buf_desc buf_desc_can [ 0 ];
+#endif
+
 // NOTE: the order of descriptors here MUST match the order of the BUF_ID_xx
 // enum in inc/buf.h
 static const buf_desc* buf_desc_array[ BUF_ID_TOTAL ] = 
 {
   buf_desc_uart,
-  buf_desc_adc
+  buf_desc_adc,
+  buf_desc_can
 };
 
 // Helper macros
@@ -82,8 +89,17 @@ int buf_set( unsigned resid, unsigned resnum, u8 logsize, u8 logdsize )
 {
   BUF_CHECK_RESNUM( resid, resnum );
   BUF_GETPTR( resid, resnum );
-  
+
   pbuf->logdsize = logdsize;
+  if( logsize == BUF_SIZE_NONE )
+  {
+    // Disable the buffer (logsize must stay BUF_SIZE_NONE for any data size)
+    free( pbuf->buf );
+    pbuf->buf = NULL;
+    pbuf->logsize = BUF_SIZE_NONE;
+    pbuf->rptr = pbuf->wptr = pbuf->count = 0;
+    return PLATFORM_OK;
+  }
   pbuf->logsize = logsize + logdsize;
   
   if( ( pbuf->buf = ( t_buf_data* )realloc( pbuf->buf, BUF_BYTESIZE( pbuf ) ) ) == NULL )
@@ -192,5 +208,43 @@ int buf_read( unsigned resid, unsigned resnum, t_buf_data *data )
   return PLATFORM_OK;
 }
 
+// Get up to 'count' elements from the buffer (in at most two copies)
+// resid - resource ID (BUF_ID_UART ...)
+// resnum - resource number (0, 1, 2...)
+// data - pointer for where data should go
+// count - maximum number of elements to get
+// Returns the number of elements copied to 'data'
+unsigned buf_read_block( unsigned resid, unsigned resnum, t_buf_data *data, unsigned count )
+{
+  BUF_CHECK_RESNUM( resid, resnum );
+  BUF_GETPTR( resid, resnum );
+
+  int old_status;
+  unsigned total = 0, n;
+  u8 *d = ( u8* )data;
+
+  if( pbuf->logsize == BUF_SIZE_NONE )
+    return 0;
+  if( count > READ16( pbuf->count ) )
+    count = READ16( pbuf->count );
+  while( total < count )
+  {
+    // Copy up to the end of the buffer memory, then from its start
+    n = ( BUF_BYTESIZE( pbuf ) - pbuf->rptr ) >> pbuf->logdsize;
+    if( n > count - total )
+      n = count - total;
+    memcpy( d, pbuf->buf + pbuf->rptr, n << pbuf->logdsize );
+    d += n << pbuf->logdsize;
+    pbuf->rptr = ( pbuf->rptr + ( n << pbuf->logdsize ) ) & ( BUF_BYTESIZE( pbuf ) - 1 );
+    total += n;
+  }
+
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  pbuf->count -= total;
+  platform_cpu_set_global_interrupts( old_status );
+  
+  return total;
+}
+
 #endif // #ifdef BUF_ENABLE
 
@@ -208,6 +208,16 @@ void cmn_platform_init()
   platform_uart_set_buffer( CON_UART_ID, CON_BUF_SIZE );
 #endif // #if defined( CON_UART_ID ) && CON_UART_ID < SERMUX_SERVICE_ID_FIRST
 
+#if defined( BUF_ENABLE_CAN ) && defined( CAN_BUF_SIZE )
+  // Setup the RX buffers of the CAN interfaces
+  {
+    unsigned id;
+
+    for( id = 0; id < NUM_CAN; id ++ )
+      platform_can_set_buffer( id, CAN_BUF_SIZE );
+  }
+#endif // #if defined( BUF_ENABLE_CAN ) && defined( CAN_BUF_SIZE )
+
   // Set the send/recv functions                          
   std_set_send_func( uart_send );
   std_set_get_func( uart_recv );  
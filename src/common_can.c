@@ -0,0 +1,110 @@
+// Common implementation: CAN functions
+
+#include "common.h"
+#include "platform.h"
+#include "platform_conf.h"
+#include "buf.h"
+#include "elua_int.h"
+#include <string.h>
+
+#if NUM_CAN > 0
+
+// ****************************************************************************
+// CAN functions
+
+// A received frame, as kept in the RX buffer (16 bytes, BUF_DSIZE_U128)
+typedef struct
+{
+  u32 canid;
+  u8 idtype;
+  u8 len;
+  u8 data[ PLATFORM_CAN_MAXLEN ];
+  u8 unused[ 2 ];
+} cmn_can_frame;
+
+// Number of received frames that were lost (RX buffer full or hardware overrun)
+static volatile u32 can_dropped[ NUM_CAN ];
+
+// Called by the platform code when it detects lost frames
+void cmn_can_rx_dropped( unsigned id, unsigned count )
+{
+  can_dropped[ id ] += count;
+}
+
+u32 platform_can_get_dropped( unsigned id )
+{
+  return can_dropped[ id ];
+}
+
+int platform_can_recv( unsigned id, u32 *canid, u8 *idtype, u8 *len, u8 *data )
+{
+#ifdef BUF_ENABLE_CAN
+  cmn_can_frame frame;
+
+  if( buf_is_enabled( BUF_ID_CAN, id ) )
+  {
+    if( buf_read( BUF_ID_CAN, id, ( t_buf_data* )&frame ) == PLATFORM_UNDERFLOW )
+      return PLATFORM_UNDERFLOW;
+    *canid = frame.canid;
+    *idtype = frame.idtype;
+    *len = frame.len;
+    memcpy( data, frame.data, frame.len );
+    return PLATFORM_OK;
+  }
+  else
+#endif // #ifdef BUF_ENABLE_CAN
+  return platform_s_can_recv( id, canid, idtype, len, data );
+}
+
+#ifdef BUF_ENABLE_CAN
+static elua_int_c_handler prev_can_rx_handler;
+
+// Move all the frames from the hardware to the RX buffer
+static void cmn_can_rx_inthandler( elua_int_resnum resnum )
+{
+  cmn_can_frame frame;
+
+  if( buf_is_enabled( BUF_ID_CAN, resnum ) )
+    while( platform_s_can_recv( resnum, &frame.canid, &frame.idtype, &frame.len, frame.data ) == PLATFORM_OK )
+    {
+      if( buf_get_count( BUF_ID_CAN, resnum ) == buf_get_size( BUF_ID_CAN, resnum ) )
+        can_dropped[ resnum ] ++;
+      else
+        buf_write( BUF_ID_CAN, resnum, ( t_buf_data* )&frame );
+    }
+
+  // Chain to previous handler
+  if( prev_can_rx_handler != NULL )
+    prev_can_rx_handler( resnum );
+}
+#endif // #ifdef BUF_ENABLE_CAN
+
+int platform_can_set_buffer( unsigned id, unsigned log2size )
+{
+#ifdef BUF_ENABLE_CAN
+  if( log2size == 0 )
+  {
+    // Disable buffering
+    platform_cpu_set_interrupt( INT_CAN_RX, id, PLATFORM_CPU_DISABLE );
+    buf_set( BUF_ID_CAN, id, BUF_SIZE_NONE, BUF_DSIZE_U128 );
+  }
+  else
+  {
+    // Enable buffering
+    if( buf_set( BUF_ID_CAN, id, log2size, BUF_DSIZE_U128 ) == PLATFORM_ERR )
+      return PLATFORM_ERR;
+    buf_flush( BUF_ID_CAN, id );
+    // Setup our C handler
+    if( elua_int_get_c_handler( INT_CAN_RX ) != cmn_can_rx_inthandler )
+      prev_can_rx_handler = elua_int_set_c_handler( INT_CAN_RX, cmn_can_rx_inthandler );
+    // Enable CAN RX interrupt
+    if( platform_cpu_set_interrupt( INT_CAN_RX, id, PLATFORM_CPU_ENABLE ) != PLATFORM_INT_OK )
+      return PLATFORM_ERR;
+  }
+  return PLATFORM_OK;
+#else // #ifdef BUF_ENABLE_CAN
+  return PLATFORM_ERR;
+#endif // #ifdef BUF_ENABLE_CAN
+}
+
+#endif // #if NUM_CAN > 0
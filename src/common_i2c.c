@@ -0,0 +1,57 @@
+// Common implementation: I2C functions
+
+#include "platform.h"
+#include "platform_conf.h"
+
+#if defined( NUM_I2C ) && NUM_I2C > 0 && !defined( I2C_PLATFORM_TRANSFER )
+
+// ****************************************************************************
+// I2C block transfers
+// This is the generic implementation, done with the byte level functions of
+// the platform. A platform that can do better (with interrupts or DMA) defines
+// I2C_PLATFORM_TRANSFER in platform_conf.h and implements its own
+// platform_i2c_transfer.
+
+// Each segment starts with a (repeated) START and the address, a STOP is sent
+// after the last segment or after an error
+int platform_i2c_transfer( unsigned id, u16 address, const platform_i2c_segment *segs, unsigned nsegs )
+{
+  const platform_i2c_segment *s;
+  int res = PLATFORM_OK, data;
+  u32 i;
+
+  for( s = segs; s < segs + nsegs && res == PLATFORM_OK; s ++ )
+  {
+    if( s->direction == PLATFORM_I2C_DIRECTION_RECEIVER && s->len == 0 )
+      continue;
+    platform_i2c_send_start( id );
+    if( platform_i2c_send_address( id, address, s->direction ) == 0 )
+    {
+      res = PLATFORM_ERR;
+      break;
+    }
+    for( i = 0; i < s->len; i ++ )
+      if( s->direction == PLATFORM_I2C_DIRECTION_TRANSMITTER )
+      {
+        if( platform_i2c_send_byte( id, s->data[ i ] ) == 0 )
+        {
+          res = PLATFORM_ERR;
+          break;
+        }
+      }
+      else
+      {
+        // The last byte of the segment is not acknowledged
+        if( ( data = platform_i2c_recv_byte( id, i < s->len - 1 ) ) == -1 )
+        {
+          res = PLATFORM_ERR;
+          break;
+        }
+        s->data[ i ] = ( u8 )data;
+      }
+  }
+  platform_i2c_send_stop( id );
+  return res;
+}
+
+#endif // #if defined( NUM_I2C ) && NUM_I2C > 0 && !defined( I2C_PLATFORM_TRANSFER )
@@ -0,0 +1,120 @@
+// Common implementation: PWM sequences
+
+#include "common.h"
+#include "platform.h"
+#include "platform_conf.h"
+#include "elua_int.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if NUM_PWM > 0 && defined( BUILD_PWM_SEQ )
+
+// ****************************************************************************
+// PWM sequence functions
+// The duty values are copied to a buffer that belongs to the sequence, so the
+// platform can convert them in place to its native format (for example the
+// compare values written by DMA) and the caller can reuse its array.
+
+typedef struct
+{
+  u16 *data;
+  volatile u32 passes;      // number of times the sequence was played until the end
+  // The flags are also written from the interrupt handler, so they don't
+  // share a byte (a read-modify-write could lose an update)
+  volatile u8 active;       // the sequence is playing
+  volatile u8 int_enabled;
+  volatile u8 int_flag;
+} pwm_seq_state;
+
+static pwm_seq_state pwm_seq[ NUM_PWM ];
+
+// Called by the platform code (usually from an interrupt handler) at the end of
+// each pass of the sequence. 'finished' is 1 if the sequence stopped.
+void cmn_pwm_seq_pass_done( unsigned id, int finished )
+{
+  pwm_seq_state *ps = pwm_seq + id;
+
+  ps->passes ++;
+  if( finished )
+    ps->active = 0;
+#ifdef INT_PWM_SEQ_DONE
+  ps->int_flag = 1;
+  if( ps->int_enabled )
+    cmn_int_handler( INT_PWM_SEQ_DONE, id );
+#endif
+}
+
+u32 platform_pwm_seq_start( unsigned id, const u16 *duty, u32 count, u32 rate, int mode )
+{
+  pwm_seq_state *ps = pwm_seq + id;
+  u32 res;
+
+  platform_pwm_seq_stop( id );
+  if( count == 0 || ( ps->data = ( u16* )malloc( count * sizeof( u16 ) ) ) == NULL )
+    return 0;
+  memcpy( ps->data, duty, count * sizeof( u16 ) );
+  ps->passes = 0;
+  ps->active = 1;
+  if( ( res = platform_s_pwm_seq_start( id, ps->data, count, rate, mode ) ) == 0 )
+    platform_pwm_seq_stop( id );
+  return res;
+}
+
+void platform_pwm_seq_stop( unsigned id )
+{
+  pwm_seq_state *ps = pwm_seq + id;
+
+  if( ps->data == NULL )
+    return;
+  platform_s_pwm_seq_stop( id );
+  ps->active = 0;
+  free( ps->data );
+  ps->data = NULL;
+}
+
+// Returns 1 if the sequence is playing, 0 otherwise
+int platform_pwm_seq_get_status( unsigned id, u32 *ppasses )
+{
+  pwm_seq_state *ps = pwm_seq + id;
+
+#ifdef PWM_SEQ_POLLED
+  if( ps->active )
+    platform_pwm_seq_poll( id );
+#endif
+  if( ppasses )
+    *ppasses = ps->passes;
+  return ps->active;
+}
+
+#ifdef INT_PWM_SEQ_DONE
+// INT_PWM_SEQ_DONE interrupt functions (the resource number is the PWM ID)
+int cmn_pwm_seq_int_set_status( elua_int_resnum resnum, int status )
+{
+  int prev, old_status;
+
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  prev = pwm_seq[ resnum ].int_enabled;
+  pwm_seq[ resnum ].int_enabled = status == PLATFORM_CPU_ENABLE;
+  platform_cpu_set_global_interrupts( old_status );
+  return prev;
+}
+
+int cmn_pwm_seq_int_get_status( elua_int_resnum resnum )
+{
+  return pwm_seq[ resnum ].int_enabled;
+}
+
+int cmn_pwm_seq_int_get_flag( elua_int_resnum resnum, int clear )
+{
+  int flag, old_status;
+
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  flag = pwm_seq[ resnum ].int_flag;
+  if( clear )
+    pwm_seq[ resnum ].int_flag = 0;
+  platform_cpu_set_global_interrupts( old_status );
+  return flag;
+}
+#endif // #ifdef INT_PWM_SEQ_DONE
+
+#endif // #if NUM_PWM > 0 && defined( BUILD_PWM_SEQ )
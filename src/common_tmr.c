@@ -32,126 +32,265 @@ extern const elua_int_descriptor elua_int_table[ INT_ELUA_LAST ];
 
 // ============================================================================
 // VTMR functions
-
-static volatile u32 vtmr_counters[ VTMR_NUM_TIMERS ];
-static volatile s8 vtmr_reset_idx = -1;
+// Each virtual timer counts from a start value of a common counter: the tick
+// count (incremented by cmn_virtual_timer_cb at VTMR_FREQ_HZ) or, if the
+// platform defines VTMR_TICKLESS, a free-running hardware counter that runs at
+// VTMR_FREQ_HZ (platform_vtmr_get_count). The armed timers are kept in a
+// min-heap ordered by deadline, so cmn_virtual_timer_cb only looks at the
+// first one. In tickless mode the platform is asked to call
+// cmn_virtual_timer_cb when the first deadline is reached
+// (platform_vtmr_set_alarm), so nothing runs while no timer expires. With
+// VTMR_POLLED the deadlines are checked by the timer functions instead.
+// All the counter values are compared modulo 2^32, so the periods are limited
+// to 2^31 counts.
 
 #if defined( BUILD_INT_HANDLERS ) && ( INT_TMR_MATCH != ELUA_INT_INVALID_INTERRUPT )
 #define CMN_TIMER_INT_SUPPORT
 #endif // #if defined( BUILD_INT_HANDLERS ) && ( INT_TMR_MATCH != ELUA_INT_INVALID_INTERRUPT )
 
-#ifdef CMN_TIMER_INT_SUPPORT
-static volatile u32 vtmr_period_limit[ VTMR_NUM_TIMERS ];  
-static volatile u8 vtmr_int_periodic_flag[ ( VTMR_NUM_TIMERS + 7 ) >> 3 ];
-static volatile u8 vtmr_int_enabled[ ( VTMR_NUM_TIMERS + 7 ) >> 3 ];
-static volatile u8 vtmr_int_flag[ ( VTMR_NUM_TIMERS + 7 ) >> 3 ];
-#endif // #ifdef CMN_TIMER_INT_SUPPORT
+#if defined( VTMR_POLLED ) && !defined( VTMR_TICKLESS )
+#error "VTMR_POLLED requires VTMR_TICKLESS"
+#endif
 
-// This should be called from the platform's timer interrupt at VTMR_FREQ_HZ
-void cmn_virtual_timer_cb()
+#define VTMR_MAX_PERIOD       0x7FFFFFFFUL
+
+typedef struct
 {
-  unsigned i;
-#ifdef CMN_TIMER_INT_SUPPORT
-  u8 msk;
+  u32 start;                  // counter value when the timer was (re)started
+  u32 deadline;               // counter value of the next match
+  u32 period;                 // match period in counts
+  elua_int_c_handler cb;      // match callback (NULL for the eLua interrupt)
+  u8 pos;                     // position in the heap
+  // These are written both from the timer interrupt and from the main code,
+  // so each one needs its own byte (no bitfields, no read-modify-write)
+  u8 armed;                   // the timer is in the heap
+  u8 periodic;
+  u8 int_enabled;
+  u8 int_flag;
+} vtmr_state;
+
+static volatile vtmr_state vtmr[ VTMR_NUM_TIMERS ];
+static volatile u8 vtmr_heap[ VTMR_NUM_TIMERS ];
+static volatile unsigned vtmr_heap_len;
+
+#ifdef VTMR_TICKLESS
+#define vtmr_now()            platform_vtmr_get_count()
+#else
+static volatile u32 vtmr_ticks;
+#define vtmr_now()            vtmr_ticks
 #endif
 
-  for( i = 0; i < VTMR_NUM_TIMERS; i ++ )
+// 'a' is before 'b' (modulo 2^32)
+#define vtmr_before( a, b )   ( ( s32 )( ( a ) - ( b ) ) < 0 )
+
+static void vtmr_heap_put( unsigned pos, unsigned id )
+{
+  vtmr_heap[ pos ] = id;
+  vtmr[ id ].pos = pos;
+}
+
+// Move the timer at 'pos' up or down until the heap is ordered again
+static void vtmr_heap_fix( unsigned pos )
+{
+  unsigned id = vtmr_heap[ pos ], child;
+  u32 deadline = vtmr[ id ].deadline;
+
+  while( pos > 0 && vtmr_before( deadline, vtmr[ vtmr_heap[ ( pos - 1 ) >> 1 ] ].deadline ) )
+  {
+    vtmr_heap_put( pos, vtmr_heap[ ( pos - 1 ) >> 1 ] );
+    pos = ( pos - 1 ) >> 1;
+  }
+  while( ( child = 2 * pos + 1 ) < vtmr_heap_len )
   {
-    vtmr_counters[ i ] ++;  
+    if( child + 1 < vtmr_heap_len && vtmr_before( vtmr[ vtmr_heap[ child + 1 ] ].deadline, vtmr[ vtmr_heap[ child ] ].deadline ) )
+      child ++;
+    if( !vtmr_before( vtmr[ vtmr_heap[ child ] ].deadline, deadline ) )
+      break;
+    vtmr_heap_put( pos, vtmr_heap[ child ] );
+    pos = child;
+  }
+  vtmr_heap_put( pos, id );
+}
+
+static void vtmr_heap_insert( unsigned id )
+{
+  vtmr[ id ].armed = 1;
+  vtmr_heap_put( vtmr_heap_len ++, id );
+  vtmr_heap_fix( vtmr[ id ].pos );
+}
+
+static void vtmr_heap_remove( unsigned id )
+{
+  unsigned pos = vtmr[ id ].pos;
+
+  vtmr[ id ].armed = 0;
+  if( pos != -- vtmr_heap_len )
+  {
+    vtmr_heap_put( pos, vtmr_heap[ vtmr_heap_len ] );
+    vtmr_heap_fix( pos );
+  }
+}
+
+#if defined( VTMR_TICKLESS ) && !defined( VTMR_POLLED )
+// Program the hardware for the first deadline
+static void vtmr_set_alarm()
+{
+  if( vtmr_heap_len > 0 )
+    platform_vtmr_set_alarm( vtmr[ vtmr_heap[ 0 ] ].deadline );
+  else
+    platform_vtmr_stop_alarm();
+}
+#else
+#define vtmr_set_alarm()
+#endif
+
+// Called (with interrupts disabled) when the first timer in the heap matches
+static void vtmr_match( u32 now )
+{
+  unsigned id = vtmr_heap[ 0 ];
+  volatile vtmr_state *pv = vtmr + id;
+
+  if( pv->periodic )
+  {
+    // Keep the phase of the timer even if some periods were missed
+    pv->deadline += ( ( now - pv->deadline ) / pv->period + 1 ) * pv->period;
+    vtmr_heap_fix( 0 );
+  }
+  else
+    vtmr_heap_remove( id );
+  if( pv->cb )
+    pv->cb( id + VTMR_FIRST_ID );
 #ifdef CMN_TIMER_INT_SUPPORT
-    msk = 1 << ( i & 0x07 );
-    if( vtmr_counters[ i ] >= vtmr_period_limit[ i ] )
+  else
+  {
+    pv->int_flag = 1;
+    if( pv->int_enabled )
     {
-      vtmr_int_flag[ i >> 3 ] |= msk;
-      if( vtmr_int_enabled[ i >> 3 ] & msk )      
-        elua_int_add( INT_TMR_MATCH, i + VTMR_FIRST_ID );
-      if( vtmr_int_periodic_flag[ i >> 3 ] & msk )
-        vtmr_counters[ i ] = 0;
-      else
-        vtmr_int_enabled[ i >> 3 ] &= ( u8 )~msk;    
+      if( !pv->periodic )
+        pv->int_enabled = 0;
+      cmn_int_handler( INT_TMR_MATCH, id + VTMR_FIRST_ID );
     }
+  }
 #endif // #ifdef CMN_TIMER_INT_SUPPORT
-  }    
-  if( vtmr_reset_idx != -1 )
+}
+
+// This should be called from the platform's timer interrupt at VTMR_FREQ_HZ
+// or, in tickless mode, when the alarm set by platform_vtmr_set_alarm fires
+void cmn_virtual_timer_cb()
+{
+  u32 now;
+
+#ifndef VTMR_TICKLESS
+  vtmr_ticks ++;
+#endif
+  now = vtmr_now();
+  while( vtmr_heap_len > 0 && !vtmr_before( now, vtmr[ vtmr_heap[ 0 ] ].deadline ) )
   {
-    vtmr_counters[ vtmr_reset_idx ] = 0;
-    vtmr_reset_idx = -1;
+    vtmr_match( now );
+    now = vtmr_now();
   }
+  vtmr_set_alarm();
 }
 
-static void vtmr_reset_timer( unsigned vid )
+#ifdef VTMR_POLLED
+static void vtmr_poll()
 {
-  unsigned id = VTMR_GET_ID( vid );
+  int old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
 
-  vtmr_reset_idx = ( s8 )id;
-  while( vtmr_reset_idx != -1 );  
+  if( vtmr_heap_len > 0 && !vtmr_before( vtmr_now(), vtmr[ vtmr_heap[ 0 ] ].deadline ) )
+    cmn_virtual_timer_cb();
+  platform_cpu_set_global_interrupts( old_status );
 }
+#else
+#define vtmr_poll()
+#endif
 
 static void vtmr_delay( unsigned vid, u32 delay_us )
 {
-  timer_data_type final;
-  unsigned id = VTMR_GET_ID( vid );
-  
-  final = ( ( u64 )delay_us * VTMR_FREQ_HZ ) / 1000000;
-  vtmr_reset_timer( vid );
-  while( vtmr_counters[ id ] < final );  
+  u32 start = vtmr_now();
+  u32 final = ( ( u64 )delay_us * VTMR_FREQ_HZ ) / 1000000;
+
+  while( vtmr_now() - start < final )
+    vtmr_poll();
 }
 
-#ifdef CMN_TIMER_INT_SUPPORT
-static int vtmr_set_match_int( unsigned vid, u32 period_us, int type )
+static u32 vtmr_read( unsigned vid )
+{
+  vtmr_poll();
+  return vtmr_now() - vtmr[ VTMR_GET_ID( vid ) ].start;
+}
+
+static void vtmr_start( unsigned vid )
+{
+  vtmr[ VTMR_GET_ID( vid ) ].start = vtmr_now();
+}
+
+// Arm (or disarm if 'period_us' is 0) the match of a virtual timer. The timer
+// is restarted and matches 'period_us' microseconds later.
+static int vtmr_set_match( unsigned vid, u32 period_us, int type, elua_int_c_handler cb )
 {
-  timer_data_type final;
   unsigned id = VTMR_GET_ID( vid );
-  u8 msk = 1 << ( id & 0x07 );
+  volatile vtmr_state *pv = vtmr + id;
+  u64 period = ( ( u64 )period_us * VTMR_FREQ_HZ ) / 1000000;
+  int old_status;
 
-  if( period_us == 0 )
+  if( period_us != 0 )
   {
-    vtmr_int_enabled[ id >> 3 ] &= ( u8 )~msk;
-    vtmr_int_flag[ id >> 3 ] &= ( u8 )~msk;
-    return PLATFORM_TIMER_INT_OK;
+    if( period == 0 )
+      return PLATFORM_TIMER_INT_TOO_SHORT;
+    if( period > VTMR_MAX_PERIOD )
+      return PLATFORM_TIMER_INT_TOO_LONG;
   }
-  if( ( final = ( ( u64 )period_us * VTMR_FREQ_HZ ) / 1000000 ) == 0 )
-    return PLATFORM_TIMER_INT_TOO_SHORT;
-  vtmr_period_limit[ id ] = final;
-  if( type == PLATFORM_TIMER_INT_ONESHOT )
-    vtmr_int_periodic_flag[ id >> 3 ] &= ( u8 )~msk;
-  else
-    vtmr_int_periodic_flag[ id >> 3 ] |= msk;
-  vtmr_int_flag[ id >> 3 ] &= ( u8 )~msk;
-  vtmr_reset_timer( vid ); 
-  vtmr_int_enabled[ id >> 3 ] |= msk;
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  if( pv->armed )
+    vtmr_heap_remove( id );
+  pv->int_flag = 0;
+  pv->int_enabled = 0;
+  if( period_us != 0 )
+  {
+    pv->start = vtmr_now();
+    pv->deadline = pv->start + ( u32 )period;
+    pv->period = ( u32 )period;
+    pv->periodic = type != PLATFORM_TIMER_INT_ONESHOT;
+    pv->cb = cb;
+    pv->int_enabled = cb == NULL;
+    vtmr_heap_insert( id );
+  }
+  vtmr_set_alarm();
+  platform_cpu_set_global_interrupts( old_status );
   return PLATFORM_TIMER_INT_OK;
 }
 
+#ifdef CMN_TIMER_INT_SUPPORT
 static int vtmr_int_get_flag( elua_int_resnum resnum, int clear )
 {
-  unsigned id = VTMR_GET_ID( resnum );
-  u8 msk = 1 << ( id & 0x07 );
-  int status = ( vtmr_int_flag[ id >> 3 ] & msk ) != 0;
+  volatile vtmr_state *pv = vtmr + VTMR_GET_ID( resnum );
+  int status, old_status;
 
+  vtmr_poll();
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  status = pv->int_flag;
   if( clear )
-    vtmr_int_flag[ id >> 3 ] &= ( u8 )~msk;
+    pv->int_flag = 0;
+  platform_cpu_set_global_interrupts( old_status );
   return status;
 }
 
 static int vtmr_int_set_status( elua_int_resnum resnum, int status )
 {
-  unsigned id = VTMR_GET_ID( resnum );
-  u8 msk = 1 << ( id & 0x07 );
-  int prev = ( vtmr_int_enabled[ id >> 3 ] & msk ) != 0;
+  volatile vtmr_state *pv = vtmr + VTMR_GET_ID( resnum );
+  int prev, old_status;
 
-  if( status == PLATFORM_CPU_ENABLE )
-    vtmr_int_enabled[ id >> 3 ] |= msk;
-  else
-    vtmr_int_enabled[ id >> 3 ] &= ( u8 )~msk;
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  prev = pv->int_enabled;
+  pv->int_enabled = status == PLATFORM_CPU_ENABLE;
+  platform_cpu_set_global_interrupts( old_status );
   return prev;
 }
 
 static int vtmr_int_get_status( elua_int_resnum resnum )
 {
-  unsigned id = VTMR_GET_ID( resnum );
-  u8 msk = 1 << ( id & 0x07 );
-  return ( vtmr_int_enabled[ id >> 3 ] & msk ) != 0;
+  return vtmr[ VTMR_GET_ID( resnum ) ].int_enabled;
 }
 #endif // #ifdef CMN_TIMER_INT_SUPPORT 
 
@@ -163,6 +302,25 @@ void cmn_virtual_timer_cb()
 
 #endif // #if VTMR_NUM_TIMERS > 0
 
+// ============================================================================
+// Timebase functions
+
+#ifdef TIMEBASE_CLOCK
+static u32 tmr_tb_high, tmr_tb_last;
+
+// Extend a 32-bit free-running counter to 64 bits. Must be called with the
+// interrupts disabled and with a counter value read with the interrupts
+// disabled, at least once per counter period (for example from a periodic
+// interrupt), so that no wrap is missed.
+u64 cmn_timebase_extend( u32 count )
+{
+  if( count < tmr_tb_last )
+    tmr_tb_high ++;
+  tmr_tb_last = count;
+  return ( ( u64 )tmr_tb_high << 32 ) | count;
+}
+#endif // #ifdef TIMEBASE_CLOCK
+
 // ============================================================================
 // Actual timer functions
 
@@ -196,12 +354,12 @@ u32 platform_timer_op( unsigned id, int op, u32 data )
   switch( op )
   {
     case PLATFORM_TIMER_OP_START:
-      vtmr_reset_timer( id );
+      vtmr_start( id );
       res = 0;
       break;
       
     case PLATFORM_TIMER_OP_READ:
-      res = vtmr_counters[ VTMR_GET_ID( id ) ];
+      res = vtmr_read( id );
       break;
       
     case PLATFORM_TIMER_OP_GET_MAX_DELAY:
@@ -236,12 +394,23 @@ u32 platform_timer_get_diff_us( unsigned id, timer_data_type end, timer_data_typ
   return ( ( u64 )( start - end ) * 1000000 ) / freq;
 }
 
+// Call 'cb' (from the timer interrupt) when the timer matches. Only virtual
+// timers support match callbacks.
+int platform_timer_set_match_cb( unsigned id, u32 period_us, int type, elua_int_c_handler cb )
+{
+#if VTMR_NUM_TIMERS > 0
+  if( TIMER_IS_VIRTUAL( id ) )
+    return vtmr_set_match( id, period_us, type, period_us ? cb : NULL );
+#endif
+  return PLATFORM_TIMER_INT_INVALID_ID;
+}
+
 #ifdef BUILD_INT_HANDLERS
 int platform_timer_set_match_int( unsigned id, u32 period_us, int type )
 {
 #if VTMR_NUM_TIMERS > 0 && defined( CMN_TIMER_INT_SUPPORT )
   if( TIMER_IS_VIRTUAL( id ) )
-    return vtmr_set_match_int( id, period_us, type );
+    return vtmr_set_match( id, period_us, type, NULL );
   else
 #endif
     return platform_s_timer_set_match_int( id, period_us, type );
@@ -6,7 +6,9 @@
 #include "elua_adc.h"
 #include "platform.h"
 #include <stdlib.h>
+#include <string.h>
 #include "utils.h"
+#include "common.h"
 
 #define SMOOTH_REALSIZE( s ) ( ( u16 )1 << ( s->logsmoothlen ) )
 
@@ -29,7 +31,7 @@ void adc_update_dev_sequence( unsigned dev_id  )
 {
   elua_adc_dev_state *d = adc_get_dev_state( dev_id );
   elua_adc_ch_state *s;
-  unsigned previd = d->ch_state[ d->seq_ctr ]->id;
+  unsigned previd = d->ch_state[ d->seq_ctr ] ? d->ch_state[ d->seq_ctr ]->id : 0;
   unsigned id;
   u8 tmp_seq_ctr = 0;
   int old_status;  
@@ -268,6 +270,39 @@ u16 adc_get_processed_sample( unsigned id )
   return sample;
 }
 
+// Get up to 'count' samples in 'dest', returns the number of samples
+// Without smoothing, the samples are copied directly from the buffer
+u16 adc_get_processed_samples( unsigned id, u16 *dest, u16 count )
+{
+  elua_adc_ch_state *s = adc_get_ch_state( id );
+  u16 i = 0, n;
+
+#if defined( BUF_ENABLE_ADC )
+  if( s->logsmoothlen == 0 )
+  {
+    while( i < count && adc_samples_available( id ) > 0 )
+    {
+      if( s->value_fresh == 1 )
+      {
+        dest[ i ++ ] = *( s->value_ptr );
+        s->value_fresh = 0;
+        n = 1;
+      }
+      else
+      {
+        n = buf_read_block( BUF_ID_ADC, id, ( t_buf_data* )( dest + i ), count - i );
+        i += n;
+      }
+      s->reqsamples = s->reqsamples > n ? s->reqsamples - n : 0;
+    }
+    return i;
+  }
+#endif
+  for( ; i < count && adc_samples_available( id ) > 0; i ++ )
+    dest[ i ] = adc_get_processed_sample( id );
+  return i;
+}
+
 // Zero out and reset smoothing buffer
 void adc_flush_smoothing( unsigned id )
 {
@@ -315,5 +350,198 @@ u16 adc_wait_samples( unsigned id, unsigned samples )
   return adc_samples_available( id );
 }
 
+// *****************************************************************************
+// Streaming
+// The platform code configures the converter to sample the channels of the
+// stream when the timer fires and writes the samples in the block that is
+// being filled, either directly (DMA) or with adc_stream_add_sample. When a
+// block is complete it calls adc_stream_block_done and continues with the
+// other block. A complete block must be read before the other block is
+// complete, otherwise it's overwritten and counted as an overrun.
+
+#ifdef BUILD_ADC_STREAM
+
+#if defined( INT_ADC_BLOCK ) && ( defined( BUILD_LUA_INT_HANDLERS ) || defined( BUILD_C_INT_HANDLERS ) )
+#define ADC_STREAM_INT_SUPPORT
 #endif
 
+static elua_adc_stream_state adc_stream_state;
+
+elua_adc_stream_state *adc_get_stream_state()
+{
+  return &adc_stream_state;
+}
+
+// Start streaming 'nchans' channels with blocks of 'blocksize' samples for each
+// channel. '*pfreq' is the sampling frequency (updated with the real value)
+int adc_stream_start( const u8 *chans, unsigned nchans, u16 blocksize, unsigned timer_id, u32 *pfreq )
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+  elua_adc_dev_state *d = adc_get_dev_state( 0 );
+  u32 freq;
+
+  adc_stream_stop();
+  // Can't stream while a sequence is running
+  if( d->running || nchans == 0 || nchans > NUM_ADC || blocksize == 0 )
+    return PLATFORM_ERR;
+  st->blocklen = ( u32 )blocksize * nchans;
+  if( ( st->data = ( u16* )malloc( ADC_STREAM_BLOCKS * st->blocklen * sizeof( u16 ) ) ) == NULL )
+    return PLATFORM_ERR;
+  memcpy( st->chans, chans, nchans );
+  st->nchans = nchans;
+  st->blocksize = blocksize;
+  st->fill = st->ready = 0;
+  st->idx = st->blocks = st->overruns = 0;
+  st->int_flag = 0;
+  st->active = 1;
+  if( ( freq = platform_adc_stream_start( timer_id, *pfreq ) ) == 0 )
+  {
+    st->active = 0;
+    free( st->data );
+    st->data = NULL;
+    return PLATFORM_ERR;
+  }
+  *pfreq = freq;
+  return PLATFORM_OK;
+}
+
+void adc_stream_stop()
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+
+  if( !st->active )
+    return;
+  platform_adc_stream_stop();
+  st->active = 0;
+  free( st->data );
+  st->data = NULL;
+}
+
+// Add a sample to the block that is being filled (for platforms that don't
+// write the samples directly in the blocks)
+void adc_stream_add_sample( u16 sample )
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+
+  st->data[ st->fill * st->blocklen + st->idx ] = sample;
+  if( ++ st->idx == st->blocklen )
+    adc_stream_block_done();
+}
+
+// Called by the platform code when the block that is being filled is complete
+void adc_stream_block_done()
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+  u8 next = ( st->fill + 1 ) % ADC_STREAM_BLOCKS;
+
+  st->blocks ++;
+  // The next block is overwritten from now on
+  if( st->ready & ( 1 << next ) )
+  {
+    st->ready &= ~( 1 << next );
+    st->overruns ++;
+  }
+  st->ready |= 1 << st->fill;
+  st->fill = next;
+  st->idx = 0;
+#ifdef ADC_STREAM_INT_SUPPORT
+  st->int_flag = 1;
+  if( st->int_enabled )
+    cmn_int_handler( INT_ADC_BLOCK, 0 );
+#endif
+}
+
+// Copy the complete block to 'dest' (an array with a buffer of 'blocksize'
+// samples for each channel). Returns 1 if a block was copied, 0 otherwise
+static int adc_stream_read_block( u16 *const *dest )
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+  const u16 *src;
+  unsigned c, i, blk;
+  int old_status, ok;
+
+  while( 1 )
+  {
+    if( st->ready == 0 )
+      return 0;
+    for( blk = 0; ( st->ready & ( 1 << blk ) ) == 0; blk ++ );
+    src = st->data + blk * st->blocklen;
+    if( st->nchans == 1 )
+      memcpy( dest[ 0 ], src, st->blocksize * sizeof( u16 ) );
+    else
+      for( c = 0; c < st->nchans; c ++ )
+        for( i = 0; i < st->blocksize; i ++ )
+          dest[ c ][ i ] = src[ i * st->nchans + c ];
+    // If the block was dropped while it was copied, the copy is not valid
+    old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+    ok = ( st->ready & ( 1 << blk ) ) != 0;
+    st->ready &= ~( 1 << blk );
+    platform_cpu_set_global_interrupts( old_status );
+    if( ok )
+      return 1;
+  }
+}
+
+// Wait for a complete block (with a timeout in microseconds, 0 for no wait or
+// ADC_STREAM_INF_TIMEOUT) and copy it to 'dest'. Returns 1 for OK, 0 if
+// there is no block.
+int adc_stream_get_block( u16 *const *dest, unsigned timer_id, s32 timeout )
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+  timer_data_type tmr_start = 0, tmr_crt;
+
+  if( timeout > 0 )
+    tmr_start = platform_timer_op( timer_id, PLATFORM_TIMER_OP_START, 0 );
+  while( st->active )
+  {
+#ifdef ADC_STREAM_POLLED
+    platform_adc_stream_poll();
+#endif
+    if( adc_stream_read_block( dest ) )
+      return 1;
+    if( timeout == 0 )
+      break;
+    if( timeout > 0 )
+    {
+      tmr_crt = platform_timer_op( timer_id, PLATFORM_TIMER_OP_READ, 0 );
+      if( platform_timer_get_diff_us( timer_id, tmr_crt, tmr_start ) >= timeout )
+        break;
+    }
+  }
+  return 0;
+}
+
+// INT_ADC_BLOCK interrupt functions (the resource number is not used)
+int adc_stream_int_set_status( elua_int_resnum resnum, int status )
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+  int prev, old_status;
+
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  prev = st->int_enabled;
+  st->int_enabled = status == PLATFORM_CPU_ENABLE;
+  platform_cpu_set_global_interrupts( old_status );
+  return prev;
+}
+
+int adc_stream_int_get_status( elua_int_resnum resnum )
+{
+  return adc_get_stream_state()->int_enabled;
+}
+
+int adc_stream_int_get_flag( elua_int_resnum resnum, int clear )
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+  int flag, old_status;
+
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  flag = st->int_flag;
+  if( clear )
+    st->int_flag = 0;
+  platform_cpu_set_global_interrupts( old_status );
+  return flag;
+}
+
+#endif // #ifdef BUILD_ADC_STREAM
+
+#endif
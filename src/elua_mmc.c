@@ -6,7 +6,7 @@
 // web site by Jesus Alvarez & James Snyder for eLua.
  
 #include "platform_conf.h"
-#ifdef BUILD_MMCFS
+#if defined( BUILD_MMCFS ) && !defined( MMCFS_SIM_IMAGE )
 #include "platform.h"
 #include "diskio.h"
 
@@ -309,7 +309,7 @@ BYTE send_cmd (
 /* Initialize Disk Drive                                                 */
 /*-----------------------------------------------------------------------*/
 
-DSTATUS disk_initialize (
+DSTATUS disk_raw_initialize (
     BYTE drv        /* Physical drive nmuber (0) */
 )
 {
@@ -390,7 +390,7 @@ DSTATUS disk_status (
 /* Read Sector(s)                                                        */
 /*-----------------------------------------------------------------------*/
 
-DRESULT disk_read (
+DRESULT disk_raw_read (
     BYTE drv,            /* Physical drive nmuber (0) */
     BYTE *buff,            /* Pointer to the data buffer to store read data */
     DWORD sector,        /* Start sector number (LBA) */
@@ -432,7 +432,7 @@ DRESULT disk_read (
 /*-----------------------------------------------------------------------*/
 
 #if _READONLY == 0
-DRESULT disk_write (
+DRESULT disk_raw_write (
     BYTE drv,            /* Physical drive nmuber (0) */
     const BYTE *buff,    /* Pointer to the data to be written */
     DWORD sector,        /* Start sector number (LBA) */
@@ -479,7 +479,7 @@ DRESULT disk_write (
 /* Miscellaneous Functions                                               */
 /*-----------------------------------------------------------------------*/
 
-DRESULT disk_ioctl (
+DRESULT disk_raw_ioctl (
     BYTE drv,        /* Physical drive nmuber (0) */
     BYTE ctrl,        /* Control code */
     void *buff        /* Buffer to send/receive control data */
@@ -153,7 +153,7 @@ static u8* eluarpc_end_packet( u8 *p )
   u16 len;
   
   *p ++ = TYPE_END;
-  p = eluarpc_write_u32( p, ~PACKET_SIG );
+  p = eluarpc_write_u32( p, ( u32 )~PACKET_SIG );
   len = p - eluarpc_packet_ptr;
   p = eluarpc_packet_ptr;
   *p ++ = TYPE_PKT_SIZE;
@@ -179,7 +179,7 @@ static const u8* eluarpc_match_packet_end( const u8 *p )
   
   p = eluarpc_read_expect( p, TYPE_END );
   p = eluarpc_read_u32( p, &fdata );
-  if( fdata != ~PACKET_SIG )
+  if( fdata != ( u32 )~PACKET_SIG )
     eluarpc_err_flag = ELUARPC_ERR;
   return p;
 }
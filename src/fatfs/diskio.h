@@ -36,6 +36,16 @@ DRESULT disk_write (BYTE, const BYTE*, DWORD, BYTE);
 DRESULT disk_ioctl (BYTE, BYTE, void*);
 void	disk_timerproc (void);
 
+/* Low level driver functions (elua_mmc.c), used by the sector cache (mmc_cache.c) */
+DSTATUS disk_raw_initialize (BYTE);
+DRESULT disk_raw_read (BYTE, BYTE*, DWORD, BYTE);
+#if	_READONLY == 0
+DRESULT disk_raw_write (BYTE, const BYTE*, DWORD, BYTE);
+#endif
+DRESULT disk_raw_ioctl (BYTE, BYTE, void*);
+struct _FATFS_;
+void mmc_cache_init (struct _FATFS_*);
+
 
 
 /* Disk Status Bits (DSTATUS) */
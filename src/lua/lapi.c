@@ -1013,6 +1013,17 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
       res = cast_int(g->memlimit >> 10);
       break;
     }
+    case LUA_GCPEAK: {
+      /* GC values are expressed in Kbytes: #bytes/2^10 */
+      res = cast_int(g->peakbytes >> 10);
+      break;
+    }
+    case LUA_GCPEAKB: {
+      res = cast_int(g->peakbytes & 0x3ff);
+      /* start a new measurement from the current usage */
+      g->peakbytes = g->totalbytes;
+      break;
+    }
     default: res = -1;  /* invalid option */
   }
   lua_unlock(L);
@@ -31,6 +31,10 @@
 #include "lstate.h"
 #include "legc.h"
 
+#ifdef LUA_BYTECODE_CACHE
+#include "devman.h"
+#endif
+
 #define FREELIST_REF	0	/* free list of references */
 
 
@@ -603,7 +607,7 @@ static int errfile (lua_State *L, const char *what, int fnameindex) {
 }
 
 
-LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
+static int loadfile (lua_State *L, const char *filename) {
   LoadF lf;
   int status, readstatus;
   int c;
@@ -644,6 +648,152 @@ LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
 }
 
 
+#ifdef LUA_BYTECODE_CACHE
+/*
+** Bytecode cache: 'name.lua' is compiled to 'name.lc'. The compiled file ends
+** with a trailer that has the size and the time of the source file (as
+** reported by its file system in 'struct dm_dirent') and a hash of its
+** contents; it is used only if they all still match. The hash is needed
+** because the file times are not reliable (without a RTC, FatFs stamps all
+** the files with the same time). lua_load ignores the trailer, so the .lc
+** files can also be loaded directly. Sources without a file time (ROM file
+** system) are not cached.
+*/
+
+#define LC_TRAILER_MAGIC    "eLC2"
+#define LC_TRAILER_SIZE     16
+#define LC_HASH_INIT        2166136261UL
+#define LC_HASH_PRIME       16777619UL
+#define LC_HASH_BUFSIZE     128  /* small, the C stack can be small */
+
+
+static int samename (const char *s1, const char *s2) {
+  while (*s1 && tolower((unsigned char)*s1) == tolower((unsigned char)*s2))
+    s1++, s2++;
+  return *s1 == *s2;
+}
+
+
+/* get the size and the time of a file from its directory */
+static int getfileinfo (lua_State *L, const char *filename, u32 *psize, u32 *ptime) {
+  const char *base = strrchr(filename, '/');
+  struct dm_dirent *ent;
+  DM_DIR *d;
+  int found = 0;
+  if (base == NULL || base == filename) return 0;
+  lua_pushlstring(L, filename, base - filename);
+  d = dm_opendir(lua_tostring(L, -1));
+  lua_pop(L, 1);
+  if (d == NULL) return 0;
+  while (!found && (ent = dm_readdir(d)) != NULL) {
+    if (samename(ent->fname, base + 1)) {
+      *psize = ent->fsize;
+      *ptime = ent->ftime;
+      found = 1;
+    }
+  }
+  dm_closedir(d);
+  return found && *ptime != 0;
+}
+
+
+/* FNV-1a hash of the contents of a file */
+static int gethash (const char *filename, u32 *phash) {
+  unsigned char buf[LC_HASH_BUFSIZE];
+  FILE *f = fopen(filename, "rb");
+  u32 h = LC_HASH_INIT;
+  size_t n, i;
+  int ok;
+  if (f == NULL) return 0;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    for (i = 0; i < n; i++)
+      h = (h ^ buf[i]) * LC_HASH_PRIME;
+  ok = !ferror(f);
+  fclose(f);
+  *phash = h;
+  return ok;
+}
+
+
+static void puttrailer (unsigned char *t, u32 size, u32 time, u32 hash) {
+  int i;
+  memcpy(t, LC_TRAILER_MAGIC, 4);
+  for (i = 0; i < 4; i++) {
+    t[4 + i] = (unsigned char)(size >> (8 * i));
+    t[8 + i] = (unsigned char)(time >> (8 * i));
+    t[12 + i] = (unsigned char)(hash >> (8 * i));
+  }
+}
+
+
+static int cachevalid (const char *lcname, u32 size, u32 time, u32 hash) {
+  unsigned char t[LC_TRAILER_SIZE], expected[LC_TRAILER_SIZE];
+  FILE *f = fopen(lcname, "rb");
+  int ok;
+  if (f == NULL) return 0;
+  puttrailer(expected, size, time, hash);
+  ok = fseek(f, -LC_TRAILER_SIZE, SEEK_END) == 0 &&
+       fread(t, 1, LC_TRAILER_SIZE, f) == LC_TRAILER_SIZE &&
+       memcmp(t, expected, LC_TRAILER_SIZE) == 0;
+  fclose(f);
+  return ok;
+}
+
+
+static int writer (lua_State *L, const void *p, size_t size, void *u) {
+  (void)L;
+  return fwrite(p, 1, size, (FILE *)u) != size;
+}
+
+
+/* write the function on the top of the stack to the cache file */
+static void writecache (lua_State *L, const char *lcname, u32 size, u32 time, u32 hash) {
+  unsigned char t[LC_TRAILER_SIZE];
+  FILE *f = fopen(lcname, "wb");
+  if (f == NULL) return;  /* read-only file system */
+  puttrailer(t, size, time, hash);
+  if (lua_dump(L, writer, f) == 0 && !ferror(f))
+    fwrite(t, 1, LC_TRAILER_SIZE, f);
+  fclose(f);
+}
+
+
+LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
+  const char *lcname;
+  size_t l;
+  u32 size, time, hash;
+  int status;
+  if (filename == NULL || (l = strlen(filename)) < 4 ||
+      !samename(filename + l - 4, ".lua") ||
+      !getfileinfo(L, filename, &size, &time) ||
+      !gethash(filename, &hash))
+    return loadfile(L, filename);
+  lua_pushlstring(L, filename, l - 2);  /* 'name.lua' -> 'name.lc' */
+  lua_pushliteral(L, "c");
+  lua_concat(L, 2);
+  lcname = lua_tostring(L, -1);
+  if (cachevalid(lcname, size, time, hash)) {
+    if ((status = loadfile(L, lcname)) == 0) {
+      lua_remove(L, -2);  /* remove cache file name */
+      return 0;
+    }
+    lua_pop(L, 1);  /* bad cache file, compile the source */
+  }
+  if ((status = loadfile(L, filename)) == 0)
+    writecache(L, lcname, size, time, hash);
+  lua_remove(L, -2);  /* remove cache file name */
+  return status;
+}
+
+#else
+
+LUALIB_API int luaL_loadfile (lua_State *L, const char *filename) {
+  return loadfile(L, filename);
+}
+
+#endif
+
+
 typedef struct LoadS {
   const char *s;
   size_t size;
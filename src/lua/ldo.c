@@ -330,10 +330,10 @@ int luaD_precall (lua_State *L, StkId func, int nresults) {
     if (L->hookmask & LUA_MASKCALL)
       luaD_callhook(L, LUA_HOOKCALL, -1);
     lua_unlock(L);
-    if (ttisfunction(func))
+    if (ttisfunction(ci->func))
       n = (*curr_func(L)->c.f)(L);  /* do the actual call */
     else
-      n = ((lua_CFunction)fvalue(func))(L);  /* do the actual call */    
+      n = ((lua_CFunction)fvalue(ci->func))(L);  /* do the actual call */    
     lua_lock(L);
     if (n < 0)  /* yielding? */
       return PCRYIELD;
@@ -333,6 +333,11 @@ static void read_string (LexState *ls, int del, SemInfo *seminfo) {
 
 static int llex (LexState *ls, SemInfo *seminfo) {
   luaZ_resetbuffer(ls->buff);
+#ifdef LUA_LOWMEM_PARSER
+  /* don't keep the memory used by a long string or name */
+  if (luaZ_sizebuffer(ls->buff) > LUA_MINBUFFER * 4)
+    luaZ_resizebuffer(ls->L, ls->buff, LUA_MINBUFFER);
+#endif
   for (;;) {
     switch (ls->current) {
       case '\n':
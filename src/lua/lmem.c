@@ -53,7 +53,12 @@ void *luaM_growaux_ (lua_State *L, void *block, int *size, size_t size_elems,
     newsize = limit;  /* still have at least one free place */
   }
   else {
+#ifdef LUA_LOWMEM_PARSER
+    /* only the parser grows vectors; grow them slower to waste less memory */
+    newsize = (*size) + (*size)/2;
+#else
     newsize = (*size)*2;
+#endif
     if (newsize < MINSIZEARRAY)
       newsize = MINSIZEARRAY;  /* minimum size */
   }
@@ -81,6 +86,8 @@ void *luaM_realloc_ (lua_State *L, void *block, size_t osize, size_t nsize) {
     luaD_throw(L, LUA_ERRMEM);
   lua_assert((nsize == 0) == (block == NULL));
   g->totalbytes = (g->totalbytes - osize) + nsize;
+  if (g->totalbytes > g->peakbytes)
+    g->peakbytes = g->totalbytes;
   return block;
 }
 
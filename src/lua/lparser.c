@@ -374,6 +374,10 @@ static void close_func (LexState *ls) {
   f->sizeupvalues = f->nups;
   lua_assert(luaG_checkcode(f));
   lua_assert(fs->bl == NULL);
+#ifdef LUA_LOWMEM_PARSER
+  /* the GC is stopped while parsing, so release the constants table now */
+  luaH_empty(L, fs->h);
+#endif
   ls->fs = fs->prev;
   L->top -= 2;  /* remove table and prototype from the stack */
   /* last token read was anchored in defunct function; must reanchor it */
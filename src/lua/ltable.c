@@ -516,6 +516,21 @@ void luaH_free (lua_State *L, Table *t) {
 }
 
 
+/*
+** releases the array and hash parts of a table (its contents are lost)
+*/
+void luaH_empty (lua_State *L, Table *t) {
+  if (t->node != dummynode)
+    luaM_freearray(L, t->node, sizenode(t), Node);
+  luaM_freearray(L, t->array, t->sizearray, TValue);
+  t->array = NULL;
+  t->sizearray = 0;
+  t->node = cast(Node *, dummynode);
+  t->lsizenode = 0;
+  t->lastfree = gnode(t, 0);
+}
+
+
 
 /*
 ** inserts a new key into a hash table; first, check whether key's main 
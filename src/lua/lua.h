@@ -230,6 +230,8 @@ LUA_API int  (lua_status) (lua_State *L);
 #define LUA_GCSETSTEPMUL	7
 #define LUA_GCSETMEMLIMIT	8
 #define LUA_GCGETMEMLIMIT	9
+#define LUA_GCPEAK		10
+#define LUA_GCPEAKB		11
 
 LUA_API int (lua_gc) (lua_State *L, int what, int data);
 
@@ -119,6 +119,16 @@
 
 #endif // #if defined(_WIN32)
 
+/*
+@@ LUA_BYTECODE_CACHE makes luaL_loadfile keep a compiled copy of the Lua
+@* files that it loads ('name.lua' is compiled to 'name.lc' in the same
+@* directory) and use it while the source file doesn't change (eLua only).
+** CHANGE it (undefine it) if you don't want eLua to write the .lc files.
+*/
+#if !defined(LUA_CROSS_COMPILER) && !defined(LUA_RPC)
+#define LUA_BYTECODE_CACHE
+#endif
+
 
 /*
 @@ LUA_DIRSEP is the directory separator (for submodules).
@@ -853,6 +863,16 @@ typedef long int32_t;
 #define LUA_META_ROTABLES 
 #endif
 
+/* If you define the next macro the parser will need less memory while it
+   compiles a chunk (but it will be a bit slower): the vectors of the functions
+   being compiled grow by 50% instead of doubling, the table of constants of a
+   function is released as soon as the function is closed and the lexer buffer
+   shrinks back after a long string or name
+*/
+#if (LUA_OPTIMIZE_MEMORY > 0) && !defined(LUA_CROSS_COMPILER)
+#define LUA_LOWMEM_PARSER
+#endif
+
 #if LUA_OPTIMIZE_MEMORY == 2 && LUA_USE_POPEN
 #error "Pipes not supported in aggresive optimization mode (LUA_OPTIMIZE_MEMORY=2)"
 #endif
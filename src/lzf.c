@@ -0,0 +1,192 @@
+// Small LZ77 codec (LZF compatible format) used to compress RFS and XMODEM data
+// The compressed data is a sequence of:
+//   000LLLLL <L+1 literal bytes>                   - literal run
+//   LLLOOOOO OOOOOOOO                              - back reference, length L+2 (L < 7)
+//   111OOOOO LLLLLLLL OOOOOOOO                     - back reference, length L+9
+// where the back reference copies bytes starting O+1 bytes before the current
+// output position. The decompressor needs no memory besides the output buffer
+// (and can get its input in chunks), the compressor needs a hash table of
+// 2^LZF_HLOG entries of 2 bytes.
+
+#include <string.h>
+#include "type.h"
+#include "lzf.h"
+
+// Size (log2) of the compressor's hash table
+#ifndef LZF_HLOG
+#define LZF_HLOG              8
+#endif
+
+#define LZF_MAX_LIT           32
+#define LZF_MAX_OFF           ( 1 << 13 )
+#define LZF_MAX_REF           ( ( 1 << 8 ) + ( 1 << 3 ) )
+
+// Decompressor states
+enum
+{
+  LZF_ST_CTRL,
+  LZF_ST_LIT,
+  LZF_ST_LEN,
+  LZF_ST_OFF
+};
+
+static u16 lzf_htab[ 1 << LZF_HLOG ];
+
+// *****************************************************************************
+// Compressor
+
+#define LZF_HASH( p ) ( ( ( ( ( u32 )( p )[ 0 ] << 16 ) | ( ( p )[ 1 ] << 8 ) | ( p )[ 2 ] ) * 2654435761U ) >> ( 32 - LZF_HLOG ) )
+
+// Compress 'srclen' bytes from 'src' (max 64k) to 'dest'
+// Returns the size of the compressed data or 0 if it doesn't fit in 'destlen'
+// bytes (in this case the data should be sent uncompressed)
+u32 lzf_compress( const u8 *src, u32 srclen, u8 *dest, u32 destlen )
+{
+  u32 ip = 0, op = 1, lit = 0, ref, off, len, maxlen, h;
+
+  if( srclen == 0 || srclen > 0xFFFF )
+    return 0;
+  memset( lzf_htab, 0, sizeof( lzf_htab ) );
+  while( ip < srclen )
+  {
+    // Worst case: a back reference (3 bytes) and the next control byte
+    if( op + 4 > destlen )
+      return 0;
+    if( ip + 2 < srclen )
+    {
+      h = LZF_HASH( src + ip );
+      ref = lzf_htab[ h ];
+      lzf_htab[ h ] = ( u16 )ip;
+      if( ref < ip && ( off = ip - ref - 1 ) < LZF_MAX_OFF && !memcmp( src + ref, src + ip, 3 ) )
+      {
+        maxlen = srclen - ip;
+        if( maxlen > LZF_MAX_REF )
+          maxlen = LZF_MAX_REF;
+        for( len = 3; len < maxlen && src[ ref + len ] == src[ ip + len ]; len ++ );
+        // Terminate the current literal run (or reuse its control byte)
+        if( lit )
+          dest[ op - lit - 1 ] = ( u8 )( lit - 1 );
+        else
+          op --;
+        ip += len;
+        len -= 2;
+        if( len < 7 )
+          dest[ op ++ ] = ( u8 )( ( off >> 8 ) + ( len << 5 ) );
+        else
+        {
+          dest[ op ++ ] = ( u8 )( ( off >> 8 ) + ( 7 << 5 ) );
+          dest[ op ++ ] = ( u8 )( len - 7 );
+        }
+        dest[ op ++ ] = ( u8 )off;
+        lit = 0;
+        op ++;
+        continue;
+      }
+    }
+    // No match, copy a literal byte
+    dest[ op ++ ] = src[ ip ++ ];
+    if( ++ lit == LZF_MAX_LIT )
+    {
+      dest[ op - lit - 1 ] = LZF_MAX_LIT - 1;
+      lit = 0;
+      op ++;
+    }
+  }
+  if( lit )
+    dest[ op - lit - 1 ] = ( u8 )( lit - 1 );
+  else
+    op --;
+  return op;
+}
+
+// *****************************************************************************
+// Decompressor
+
+void lzf_stream_init( LZF_STATE *ps )
+{
+  ps->state = LZF_ST_CTRL;
+  ps->len = ps->off = 0;
+}
+
+// Decompress 'srclen' bytes from 'src' to 'dest', starting at '*pdestpos' (which
+// is updated). Back references are resolved in 'dest', so all the previously
+// decompressed data must be kept there. Decompression stops when 'dest' is
+// full. Returns LZF_OK or LZF_ERR.
+int lzf_stream_decompress( LZF_STATE *ps, const u8 *src, u32 srclen, u8 *dest, u32 *pdestpos, u32 destlen )
+{
+  u32 pos = *pdestpos, len;
+  u8 c;
+  int res = LZF_OK;
+
+  while( srclen -- )
+  {
+    // Stop at the end of the destination buffer (ignore padding after the data)
+    if( ps->state == LZF_ST_CTRL && pos == destlen )
+      break;
+    c = *src ++;
+    switch( ps->state )
+    {
+      case LZF_ST_CTRL:
+        if( c < LZF_MAX_LIT )
+        {
+          ps->len = c + 1;
+          ps->state = LZF_ST_LIT;
+        }
+        else
+        {
+          ps->len = c >> 5;
+          ps->off = ( c & 0x1F ) << 8;
+          ps->state = ps->len == 7 ? LZF_ST_LEN : LZF_ST_OFF;
+        }
+        break;
+
+      case LZF_ST_LIT:
+        if( pos >= destlen )
+        {
+          res = LZF_ERR;
+          goto out;
+        }
+        dest[ pos ++ ] = c;
+        if( -- ps->len == 0 )
+          ps->state = LZF_ST_CTRL;
+        break;
+
+      case LZF_ST_LEN:
+        ps->len += c;
+        ps->state = LZF_ST_OFF;
+        break;
+
+      case LZF_ST_OFF:
+        ps->off |= c;
+        len = ps->len + 2;
+        if( ps->off >= pos || pos + len > destlen )
+        {
+          res = LZF_ERR;
+          goto out;
+        }
+        // The areas can overlap, so copy byte by byte
+        while( len -- )
+        {
+          dest[ pos ] = dest[ pos - ps->off - 1 ];
+          pos ++;
+        }
+        ps->state = LZF_ST_CTRL;
+        break;
+    }
+  }
+out:
+  *pdestpos = pos;
+  return res;
+}
+
+// Decompress a complete block, returns the size of the decompressed data (0 for error)
+u32 lzf_decompress( const u8 *src, u32 srclen, u8 *dest, u32 destlen )
+{
+  LZF_STATE state;
+  u32 pos = 0;
+
+  lzf_stream_init( &state );
+  if( lzf_stream_decompress( &state, src, srclen, dest, &pos, destlen ) == LZF_ERR || state.state != LZF_ST_CTRL )
+    return 0;
+  return pos;
+}
@@ -17,6 +17,9 @@
 #ifdef ELUA_SIMULATOR
 #include "hostif.h"
 #endif
+#ifdef BUILD_HOSTFS
+#include "hostfs.h"
+#endif
 
 // Validate eLua configuratin options
 #include "validate.h"
@@ -24,6 +27,7 @@
 #include "mmcfs.h"
 #include "romfs.h"
 #include "semifs.h"
+#include "wofs.h"
 
 // Define here your autorun/boot files, 
 // in the order you want eLua to search for them
@@ -96,12 +100,20 @@ int main( void )
   // Register the MMC filesystem
   dm_register( mmcfs_init() );
 
+  // Register the internal flash filesystem
+  dm_register( wofs_init() );
+
   // Register the Semihosting filesystem
   dm_register( semifs_init() );
 
   // Register the remote filesystem
   dm_register( remotefs_init() );
 
+#ifdef BUILD_HOSTFS
+  // Register the host filesystem (simulator only)
+  dm_register( hostfs_init() );
+#endif
+
   // Search for autorun files in the defined order and execute the 1st if found
   for( i = 0; i < sizeof( boot_order ) / sizeof( *boot_order ); i++ )
   {
@@ -0,0 +1,262 @@
+// Sector cache between FatFs and the low level disk driver (elua_mmc.c)
+// FatFs calls disk_read/disk_write/disk_ioctl/disk_initialize, which are
+// implemented here on top of the disk_raw_xxx functions of the driver.
+// The cache keeps two separate pools of sectors (FAT/root directory sectors
+// and data sectors), each one with LRU replacement. Written sectors are kept
+// in the cache (write-back) until they are evicted or until FatFs syncs the
+// file system (CTRL_SYNC, on f_sync/f_close). Transfers of at least
+// MMCFS_CACHE_BYPASS sectors (these are always sector aligned) go directly to
+// the driver, which uses multi-block commands for them.
+
+#include "platform_conf.h"
+#ifdef BUILD_MMCFS
+#include "type.h"
+#include "diskio.h"
+#include "ff.h"
+#include <string.h>
+
+// Number of sectors in the FAT/directory pool and in the data pool
+#ifndef MMCFS_CACHE_META_SECTORS
+#define MMCFS_CACHE_META_SECTORS    2
+#endif
+#ifndef MMCFS_CACHE_DATA_SECTORS
+#define MMCFS_CACHE_DATA_SECTORS    2
+#endif
+
+// Transfers of this many sectors (or more) bypass the cache
+#ifndef MMCFS_CACHE_BYPASS
+#define MMCFS_CACHE_BYPASS          2
+#endif
+
+#define MMC_CACHE_NUM_LINES         ( MMCFS_CACHE_META_SECTORS + MMCFS_CACHE_DATA_SECTORS )
+#define MMC_CACHE_SECTOR_SIZE       512
+
+#if MMC_CACHE_NUM_LINES > 0
+
+// Cache line
+typedef struct
+{
+  DWORD sector;
+  u32 age;
+  u8 drv;
+  u8 valid;
+  u8 dirty;
+  BYTE data[ MMC_CACHE_SECTOR_SIZE ];
+} MMC_CACHE_LINE;
+
+static MMC_CACHE_LINE mmc_cache_lines[ MMC_CACHE_NUM_LINES ];
+static u32 mmc_cache_clock;
+static FATFS *mmc_cache_fs;
+
+// Set the file system object, used to find the FAT and root directory sectors
+void mmc_cache_init( FATFS *fs )
+{
+  mmc_cache_fs = fs;
+}
+
+// Return true if the sector belongs to the FAT or to the (FAT12/16) root directory
+static int mmc_cache_is_meta( BYTE drv, DWORD sector )
+{
+  FATFS *fs = mmc_cache_fs;
+
+  return fs && fs->fs_type && fs->drive == drv && sector >= fs->fatbase && sector < fs->database;
+}
+
+static MMC_CACHE_LINE* mmc_cache_find( BYTE drv, DWORD sector )
+{
+  unsigned i;
+
+  for( i = 0; i < MMC_CACHE_NUM_LINES; i ++ )
+    if( mmc_cache_lines[ i ].valid && mmc_cache_lines[ i ].sector == sector && mmc_cache_lines[ i ].drv == drv )
+      return mmc_cache_lines + i;
+  return NULL;
+}
+
+static DRESULT mmc_cache_flush_line( MMC_CACHE_LINE *pline )
+{
+  DRESULT res = RES_OK;
+
+  if( pline->valid && pline->dirty )
+    if( ( res = disk_raw_write( pline->drv, pline->data, pline->sector, 1 ) ) == RES_OK )
+      pline->dirty = 0;
+  return res;
+}
+
+// Get a line for the given sector (from the pool of the sector). The least
+// recently used line is evicted (and written to the disk if needed).
+// Returns NULL if the evicted line can't be written.
+static MMC_CACHE_LINE* mmc_cache_alloc( BYTE drv, DWORD sector )
+{
+  MMC_CACHE_LINE *pline = NULL;
+  unsigned i, first, last;
+
+#if MMCFS_CACHE_META_SECTORS > 0 && MMCFS_CACHE_DATA_SECTORS > 0
+  if( mmc_cache_is_meta( drv, sector ) )
+    first = 0, last = MMCFS_CACHE_META_SECTORS;
+  else
+    first = MMCFS_CACHE_META_SECTORS, last = MMC_CACHE_NUM_LINES;
+#else
+  first = 0, last = MMC_CACHE_NUM_LINES;
+#endif
+  for( i = first; i < last; i ++ )
+  {
+    if( !mmc_cache_lines[ i ].valid )
+    {
+      pline = mmc_cache_lines + i;
+      break;
+    }
+    if( pline == NULL || mmc_cache_lines[ i ].age < pline->age )
+      pline = mmc_cache_lines + i;
+  }
+  if( mmc_cache_flush_line( pline ) != RES_OK )
+    return NULL;
+  pline->drv = drv;
+  pline->sector = sector;
+  pline->valid = 1;
+  pline->dirty = 0;
+  return pline;
+}
+
+// Mark a line as the most recently used one
+static void mmc_cache_touch( MMC_CACHE_LINE *pline )
+{
+  pline->age = ++ mmc_cache_clock;
+}
+
+// Drop all the lines of a drive (without writing them)
+static void mmc_cache_invalidate( BYTE drv )
+{
+  unsigned i;
+
+  for( i = 0; i < MMC_CACHE_NUM_LINES; i ++ )
+    if( mmc_cache_lines[ i ].drv == drv )
+      mmc_cache_lines[ i ].valid = 0;
+}
+
+// Write all the dirty lines of a drive
+static DRESULT mmc_cache_sync( BYTE drv )
+{
+  unsigned i;
+  DRESULT res = RES_OK;
+
+  for( i = 0; i < MMC_CACHE_NUM_LINES; i ++ )
+    if( mmc_cache_lines[ i ].drv == drv && mmc_cache_flush_line( mmc_cache_lines + i ) != RES_OK )
+      res = RES_ERROR;
+  return res;
+}
+
+// *****************************************************************************
+// FatFs disk interface
+
+DSTATUS disk_initialize( BYTE drv )
+{
+  mmc_cache_invalidate( drv );
+  return disk_raw_initialize( drv );
+}
+
+DRESULT disk_read( BYTE drv, BYTE *buff, DWORD sector, BYTE count )
+{
+  MMC_CACHE_LINE *pline;
+  DRESULT res;
+  unsigned i;
+
+  if( count >= MMCFS_CACHE_BYPASS )
+  {
+    // Read directly, then replace the sectors that were modified in the cache
+    if( ( res = disk_raw_read( drv, buff, sector, count ) ) != RES_OK )
+      return res;
+    for( i = 0; i < MMC_CACHE_NUM_LINES; i ++ )
+    {
+      pline = mmc_cache_lines + i;
+      if( pline->valid && pline->dirty && pline->drv == drv && pline->sector >= sector && pline->sector < sector + count )
+        memcpy( buff + ( pline->sector - sector ) * MMC_CACHE_SECTOR_SIZE, pline->data, MMC_CACHE_SECTOR_SIZE );
+    }
+    return RES_OK;
+  }
+  for( ; count > 0; count --, sector ++, buff += MMC_CACHE_SECTOR_SIZE )
+  {
+    if( ( pline = mmc_cache_find( drv, sector ) ) == NULL )
+    {
+      if( ( pline = mmc_cache_alloc( drv, sector ) ) == NULL )
+        return RES_ERROR;
+      if( ( res = disk_raw_read( drv, pline->data, sector, 1 ) ) != RES_OK )
+      {
+        pline->valid = 0;
+        return res;
+      }
+    }
+    memcpy( buff, pline->data, MMC_CACHE_SECTOR_SIZE );
+    mmc_cache_touch( pline );
+  }
+  return RES_OK;
+}
+
+#if _READONLY == 0
+DRESULT disk_write( BYTE drv, const BYTE *buff, DWORD sector, BYTE count )
+{
+  MMC_CACHE_LINE *pline;
+  unsigned i;
+
+  if( count >= MMCFS_CACHE_BYPASS )
+  {
+    // Write directly, the cached copies of these sectors are now obsolete
+    for( i = 0; i < MMC_CACHE_NUM_LINES; i ++ )
+    {
+      pline = mmc_cache_lines + i;
+      if( pline->drv == drv && pline->sector >= sector && pline->sector < sector + count )
+        pline->valid = 0;
+    }
+    return disk_raw_write( drv, buff, sector, count );
+  }
+  for( ; count > 0; count --, sector ++, buff += MMC_CACHE_SECTOR_SIZE )
+  {
+    if( ( pline = mmc_cache_find( drv, sector ) ) == NULL && ( pline = mmc_cache_alloc( drv, sector ) ) == NULL )
+      return RES_ERROR;
+    memcpy( pline->data, buff, MMC_CACHE_SECTOR_SIZE );
+    pline->dirty = 1;
+    mmc_cache_touch( pline );
+  }
+  return RES_OK;
+}
+#endif // #if _READONLY == 0
+
+DRESULT disk_ioctl( BYTE drv, BYTE ctrl, void *buff )
+{
+  if( ctrl == CTRL_SYNC && mmc_cache_sync( drv ) != RES_OK )
+    return RES_ERROR;
+  return disk_raw_ioctl( drv, ctrl, buff );
+}
+
+#else // #if MMC_CACHE_NUM_LINES > 0
+
+// No cache, call the driver directly
+
+void mmc_cache_init( FATFS *fs )
+{
+}
+
+DSTATUS disk_initialize( BYTE drv )
+{
+  return disk_raw_initialize( drv );
+}
+
+DRESULT disk_read( BYTE drv, BYTE *buff, DWORD sector, BYTE count )
+{
+  return disk_raw_read( drv, buff, sector, count );
+}
+
+#if _READONLY == 0
+DRESULT disk_write( BYTE drv, const BYTE *buff, DWORD sector, BYTE count )
+{
+  return disk_raw_write( drv, buff, sector, count );
+}
+#endif // #if _READONLY == 0
+
+DRESULT disk_ioctl( BYTE drv, BYTE ctrl, void *buff )
+{
+  return disk_raw_ioctl( drv, ctrl, buff );
+}
+
+#endif // #if MMC_CACHE_NUM_LINES > 0
+
+#endif // #ifdef BUILD_MMCFS
@@ -13,7 +13,11 @@
 #include "diskio.h"
 #include <fcntl.h>
 
+// Maximum number of files opened at the same time
+#ifndef MMCFS_MAX_FDS
 #define MMCFS_MAX_FDS   4
+#endif
+
 static FIL mmcfs_fd_table[ MMCFS_MAX_FDS ];
 static int mmcfs_num_fd;
 
@@ -225,7 +229,7 @@ static struct dm_dirent* mmcfs_readdir_r( struct _reent *r, void *d )
   strncpy( dm_shared_fname, fn, DM_MAX_FNAME_LENGTH );
   pent->fname = dm_shared_fname;
   pent->fsize = mmc_file_info.fsize;
-  pent->ftime = mmc_file_info.ftime; 
+  pent->ftime = ( ( u32 )mmc_file_info.fdate << 16 ) | mmc_file_info.ftime;
   return pent;
 }
 
@@ -254,6 +258,7 @@ const DM_DEVICE* mmcfs_init()
   // Mount the MMC file system using logical disk 0
   if ( f_mount( 0, &mmc_fs ) != FR_OK )
     return NULL;
+  mmc_cache_init( &mmc_fs );
 
   return &mmcfs_device;
 }
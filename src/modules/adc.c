@@ -9,6 +9,7 @@
 #include "lrotable.h"
 #include "platform_conf.h"
 #include "elua_adc.h"
+#include "sbuf.h"
 
 #ifdef BUILD_ADC
 
@@ -100,6 +101,10 @@ static int adc_sample( lua_State* L )
   count = luaL_checkinteger( L, 2 );
   if  ( ( count == 0 ) || count & ( count - 1 ) )
     return luaL_error( L, "count must be power of 2 and > 0" );
+#ifdef BUILD_ADC_STREAM
+  if( adc_get_stream_state()->active )
+    return luaL_error( L, "streaming in progress" );
+#endif
   
   // If first parameter is a table, extract channel list
   if ( lua_istable( L, 1 ) == 1 )
@@ -157,11 +162,13 @@ static int adc_getsample( lua_State* L )
 }
 
 #if defined( BUF_ENABLE_ADC )
-// Lua: table_of_vals = getsamples( id, [count] )
+// Lua: buf = getsamples( id, [count] )
+// Returns the samples in a sample buffer (see the sbuf module)
 static int adc_getsamples( lua_State* L )
 {
-  unsigned id, i;
+  unsigned id;
   u16 bcnt, count = 0;
+  sbuf_t *pbuf;
   
   id = luaL_checkinteger( L, 1 );
   MOD_CHECK_ID( adc, id );
@@ -179,26 +186,26 @@ static int adc_getsamples( lua_State* L )
   if ( count > bcnt )
     count = bcnt;
   
-  lua_createtable( L, count, 0 );
-  for( i = 1; i <= count; i ++ )
-  {
-    lua_pushinteger( L, adc_get_processed_sample( id ) );
-    lua_rawseti( L, -2, i );
-  }
-  return 0;
+  pbuf = sbuf_new( L, SBUF_TYPE_U16, count );
+  pbuf->count = adc_get_processed_samples( id, ( u16* )pbuf->data, count );
+  return 1;
 }
 
 
-// Lua: insertsamples(id, table, idx, count)
+// Lua: insertsamples( id, table_or_buf, idx, count )
+// With a sample buffer the samples are copied directly in the buffer, the
+// elements that can't be filled (not enough samples) are left unchanged
 static int adc_insertsamples( lua_State* L )
 {
   unsigned id, i, startidx;
   u16 bcnt, count;
+  sbuf_t *pbuf;
   
   id = luaL_checkinteger( L, 1 );
   MOD_CHECK_ID( adc, id );
   
-  luaL_checktype(L, 2, LUA_TTABLE);
+  if( ( pbuf = sbuf_test( L, 2 ) ) == NULL )
+    luaL_checktype(L, 2, LUA_TTABLE);
   
   startidx = luaL_checkinteger( L, 3 );
 	if  ( startidx <= 0 )
@@ -207,8 +214,19 @@ static int adc_insertsamples( lua_State* L )
   count = luaL_checkinteger(L, 4 );
 	if  ( count == 0 )
     return luaL_error( L, "count must be > 0" );
+
+  if( pbuf && pbuf->type != SBUF_TYPE_U16 )
+    return luaL_error( L, "the buffer must have u16 elements" );
+  if( pbuf && startidx + count - 1 > pbuf->count )
+    return luaL_error( L, "buffer too small" );
   
   bcnt = adc_wait_samples( id, count );
+
+  if( pbuf )
+  {
+    adc_get_processed_samples( id, ( u16* )pbuf->data + startidx - 1, count );
+    return 0;
+  }
   
   for( i = startidx; i < ( count + startidx ); i ++ )
   {
@@ -224,6 +242,98 @@ static int adc_insertsamples( lua_State* L )
 }
 #endif
 
+#ifdef BUILD_ADC_STREAM
+// Lua: realrate = stream( id_or_table_of_ids, blocksize, rate, timer_id )
+static int adc_stream( lua_State* L )
+{
+  u8 chans[ NUM_ADC ];
+  unsigned nchans = 1, id, timer_id, i;
+  u32 blocksize, rate;
+
+  if( lua_istable( L, 1 ) )
+  {
+    nchans = lua_objlen( L, 1 );
+    if( nchans == 0 || nchans > NUM_ADC )
+      return luaL_error( L, "invalid channel selection" );
+    for( i = 0; i < nchans; i ++ )
+    {
+      lua_rawgeti( L, 1, i + 1 );
+      id = luaL_checkinteger( L, -1 );
+      MOD_CHECK_ID( adc, id );
+      chans[ i ] = id;
+      lua_pop( L, 1 );
+    }
+  }
+  else
+  {
+    id = luaL_checkinteger( L, 1 );
+    MOD_CHECK_ID( adc, id );
+    chans[ 0 ] = id;
+  }
+  blocksize = luaL_checkinteger( L, 2 );
+  if( blocksize == 0 || blocksize > 0xFFFF )
+    return luaL_error( L, "invalid block size" );
+  rate = luaL_checkinteger( L, 3 );
+  if( rate == 0 )
+    return luaL_error( L, "invalid sampling rate" );
+  timer_id = luaL_checkinteger( L, 4 );
+  MOD_CHECK_ID( timer, timer_id );
+  for( i = 0; i < nchans; i ++ )
+    MOD_CHECK_RES_ID( adc, chans[ i ], timer, timer_id );
+  if( adc_stream_start( chans, nchans, blocksize, timer_id, &rate ) != PLATFORM_OK )
+    return luaL_error( L, "unable to start streaming" );
+  lua_pushinteger( L, rate );
+  return 1;
+}
+
+// Lua: streamstop()
+static int adc_streamstop( lua_State* L )
+{
+  adc_stream_stop();
+  return 0;
+}
+
+// Lua: buf1, [buf2], ..., [bufn] = getblock( [timeout], [timer_id] )
+// Returns a sample buffer for each channel of the stream (in the order given
+// to 'stream') or nothing if there's no complete block before the timeout
+static int adc_getblock( lua_State* L )
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+  s32 timeout = ADC_STREAM_INF_TIMEOUT;
+  unsigned timer_id = 0, i;
+  u16 *dest[ NUM_ADC ];
+
+  if( !st->active )
+    return luaL_error( L, "streaming not started" );
+  if( lua_gettop( L ) >= 1 )
+  {
+    timeout = luaL_checkinteger( L, 1 );
+    if( ( timeout < 0 ) && ( timeout != ADC_STREAM_INF_TIMEOUT ) )
+      return luaL_error( L, "invalid timeout value" );
+    if( ( timeout != ADC_STREAM_INF_TIMEOUT ) && ( timeout != 0 ) )
+    {
+      timer_id = luaL_checkinteger( L, 2 );
+      MOD_CHECK_ID( timer, timer_id );
+    }
+  }
+  for( i = 0; i < st->nchans; i ++ )
+    dest[ i ] = ( u16* )sbuf_new( L, SBUF_TYPE_U16, st->blocksize )->data;
+  if( adc_stream_get_block( dest, timer_id, timeout ) )
+    return st->nchans;
+  return 0;
+}
+
+// Lua: blocks, overruns = streamstats()
+static int adc_streamstats( lua_State* L )
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+
+  lua_pushinteger( L, st->blocks );
+  lua_pushinteger( L, st->overruns );
+  return 2;
+}
+#endif // #ifdef BUILD_ADC_STREAM
+
 // Module function map
 #define MIN_OPT_LEVEL 2
 #include "lrodefs.h"
@@ -239,13 +349,32 @@ const LUA_REG_TYPE adc_map[] =
 #if defined( BUF_ENABLE_ADC )
   { LSTRKEY( "getsamples" ), LFUNCVAL( adc_getsamples ) },
   { LSTRKEY( "insertsamples" ), LFUNCVAL( adc_insertsamples ) },
+#endif
+#ifdef BUILD_ADC_STREAM
+  { LSTRKEY( "stream" ), LFUNCVAL( adc_stream ) },
+  { LSTRKEY( "streamstop" ), LFUNCVAL( adc_streamstop ) },
+  { LSTRKEY( "getblock" ), LFUNCVAL( adc_getblock ) },
+  { LSTRKEY( "streamstats" ), LFUNCVAL( adc_streamstats ) },
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "NO_TIMEOUT" ), LNUMVAL( 0 ) },
+  { LSTRKEY( "INF_TIMEOUT" ), LNUMVAL( ADC_STREAM_INF_TIMEOUT ) },
+#endif
 #endif
   { LNILKEY, LNILVAL }
 };
 
 LUALIB_API int luaopen_adc( lua_State *L )
 {
-  LREGISTER( L, AUXLIB_ADC, adc_map );
+#if LUA_OPTIMIZE_MEMORY > 0
+  return 0;
+#else // #if LUA_OPTIMIZE_MEMORY > 0
+  luaL_register( L, AUXLIB_ADC, adc_map );
+#ifdef BUILD_ADC_STREAM
+  MOD_REG_NUMBER( L, "NO_TIMEOUT", 0 );
+  MOD_REG_NUMBER( L, "INF_TIMEOUT", ADC_STREAM_INF_TIMEOUT );
+#endif
+  return 1;
+#endif // #if LUA_OPTIMIZE_MEMORY > 0
 }
 
 #endif
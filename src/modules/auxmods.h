@@ -57,6 +57,12 @@ LUALIB_API int ( luaopen_elua )( lua_State *L );
 #define AUXLIB_I2C  "i2c"
 LUALIB_API int ( luaopen_i2c )( lua_State *L );
 
+#define AUXLIB_SBUF "sbuf"
+LUALIB_API int ( luaopen_sbuf )( lua_State *L );
+
+#define AUXLIB_DSP  "dsp"
+LUALIB_API int ( luaopen_dsp )( lua_State *L );
+
 // Helper macros
 #define MOD_CHECK_ID( mod, id )\
   if( !platform_ ## mod ## _exists( id ) )\
@@ -7,10 +7,41 @@
 #include "auxmods.h"
 #include "lrotable.h"
 #include <string.h>
+#include <stddef.h>
 
 #define META_NAME                 "eLua.bitarray"
 #define bitarray_check( L )      ( bitarray_t* )luaL_checkudata( L, 1, META_NAME )
+#define bitarray_check_arg( L, n )  ( bitarray_t* )luaL_checkudata( L, n, META_NAME )
 #define ROUND_SIZE(s)            ( ( ( s ) >> 3 ) + ( ( s ) & 7 ? 1 : 0 ) )
+#define ROUND_WORDS(s)           ( ( ( s ) >> 5 ) + ( ( s ) & 31 ? 1 : 0 ) )
+
+// Masks for the bits of a byte from bit 'b' to the end of the byte (HEAD) and
+// before bit 'b' (TAIL). The bits of a byte are used MSB first.
+#define BIT_HEAD_MASK( b )       ( ( u8 )( 0xFF >> ( ( b ) & 7 ) ) )
+#define BIT_TAIL_MASK( b )       ( ( u8 )( 0xFF << ( 8 - ( ( b ) & 7 ) ) ) )
+
+// Bit count and leading zeros count (of a non zero byte), using the compiler
+// builtins (CLZ/popcount instructions where the CPU has them)
+#ifdef __GNUC__
+#define bitarrayh_popcount32( w )  ( ( u32 )__builtin_popcount( w ) )
+#define bitarrayh_clz8( b )        ( ( u32 )__builtin_clz( ( u32 )( b ) << 24 ) )
+#else
+static u32 bitarrayh_popcount32( u32 w )
+{
+  w = w - ( ( w >> 1 ) & 0x55555555 );
+  w = ( w & 0x33333333 ) + ( ( w >> 2 ) & 0x33333333 );
+  return ( ( ( w + ( w >> 4 ) ) & 0x0F0F0F0F ) * 0x01010101 ) >> 24;
+}
+
+static u32 bitarrayh_clz8( u8 b )
+{
+  u32 n = 0;
+
+  for( ; !( b & 0x80 ); b <<= 1 )
+    n ++;
+  return n;
+}
+#endif
 
 // Unpack modes
 enum
@@ -20,11 +51,13 @@ enum
 };
  
 // Structure that describes our array
+// 'values' is word aligned and always has a whole number of words, so the
+// bulk operations can work on 32-bit words. The padding bits are kept at 0.
 typedef struct
 {
   u32 capacity;
-  u8 elsize;
-  u8 values[ 1 ];
+  u32 elsize;
+  u8 values[ 4 ];
 } bitarray_t;
 
 // Index shift values/masks
@@ -36,7 +69,7 @@ static const u8 bitarray_index_mask[] = { 0, 0x01, 0x03, 0, 0x0F };
 //      array = bitarray.new( lua_array, [element_size_bits] )
 static int bitarray_new( lua_State *L )
 {
-  u32 total, capacity;
+  u32 total, size, capacity;
   u8 elsize, fill = 0, fromarray = 0;
   const char *buf = NULL;
   bitarray_t *pa;
@@ -76,12 +109,15 @@ static int bitarray_new( lua_State *L )
     
   if( elsize <= 0 || ( elsize > 32 ) || ( elsize & ( elsize - 1 ) ) )
     return luaL_error( L, "invalid element size." );
-  total = ROUND_SIZE( capacity * elsize );
-  if( total <= 0 )
+  size = ROUND_SIZE( capacity * elsize );
+  if( size <= 0 )
     return luaL_error( L, "invalid arguments.");
-  pa = ( bitarray_t* )lua_newuserdata( L, sizeof( bitarray_t ) + total - 1 );
+  total = ROUND_WORDS( capacity * elsize ) << 2;
+  pa = ( bitarray_t* )lua_newuserdata( L, offsetof( bitarray_t, values ) + total );
   pa->capacity = capacity;
   pa->elsize = elsize;
+  // The padding is in the last word
+  *( ( u32* )pa->values + ( total >> 2 ) - 1 ) = 0;
   
   if( buf )
     memcpy( pa->values, buf, temp );
@@ -95,7 +131,7 @@ static int bitarray_new( lua_State *L )
     }
   }
   else
-    memset( pa->values, fill, total );
+    memset( pa->values, fill, size );
   luaL_getmetatable( L, META_NAME );
   lua_setmetatable( L, -2 );
   return 1;
@@ -253,7 +289,7 @@ static int bitarray_tostring( lua_State *L )
   if( ( mode == BITARRAY_UNPACK_SEQ ) && ( pa->elsize > 8 ) )
     return luaL_error( L, "element size too large." );
   luaL_buffinit( L, &b );
-  if( mode == BITARRAY_UNPACK_SEQ )
+  if( mode == BITARRAY_UNPACK_SEQ && pa->elsize < 8 )
     for( idx = 1; idx <= pa->capacity; idx  ++ )
       luaL_addchar( &b, bitarray_getval( pa, idx ) );
   else
@@ -299,6 +335,426 @@ static int bitarray_totable( lua_State *L )
   return 1;  
 }
 
+// ****************************************************************************
+// Bulk operations
+// The helpers below work on bit offsets from the start of 'values' (bits
+// are numbered MSB first in each byte, like the sub-byte elements). The
+// whole bytes in the middle of a range are handled a word at a time.
+
+// Helper: get the optional [first], [last] element range (1 based, defaults
+// to the whole array) at 'stackidx' as [*pfirst, *plast) (0 based)
+static void bitarrayh_get_range( lua_State *L, bitarray_t *pa, int stackidx, u32 *pfirst, u32 *plast )
+{
+  u32 first = luaL_optinteger( L, stackidx, 1 );
+  u32 last = luaL_optinteger( L, stackidx + 1, pa->capacity );
+
+  if( ( first == 0 ) || ( last > pa->capacity ) || ( first > last + 1 ) )
+    luaL_error( L, "invalid index." );
+  *pfirst = first - 1;
+  *plast = last;
+}
+
+// Helper: replicate an element value over a 32-bit word (in memory order)
+static u32 bitarrayh_pattern( bitarray_t *pa, u32 val )
+{
+  union
+  {
+    u32 w;
+    u16 h[ 2 ];
+  } p;
+  u32 i;
+
+  switch( pa->elsize )
+  {
+    case 32:
+      p.w = val;
+      break;
+
+    case 16:
+      p.h[ 0 ] = p.h[ 1 ] = ( u16 )val;
+      break;
+
+    default:
+      val &= ( 1 << pa->elsize ) - 1;
+      for( i = pa->elsize; i < 8; i <<= 1 )
+        val |= val << i;
+      p.w = val * 0x01010101;
+      break;
+  }
+  return p.w;
+}
+
+// Helper: set the bits [start, end) of 'p' to the ones of 'pattern' (a word
+// in memory order that repeats over the whole array)
+static void bitarrayh_fill_bits( u8 *p, u32 start, u32 end, u32 pattern )
+{
+  const u8 *pp = ( const u8* )&pattern;
+  u32 i = start >> 3, last = end >> 3;
+  u8 mask;
+
+  if( start >= end )
+    return;
+  if( start & 7 )
+  {
+    mask = BIT_HEAD_MASK( start );
+    if( i == last )
+      mask &= BIT_TAIL_MASK( end );
+    p[ i ] = ( p[ i ] & ~mask ) | ( pp[ i & 3 ] & mask );
+    if( i ++ == last )
+      return;
+  }
+  for( ; ( i < last ) && ( i & 3 ); i ++ )
+    p[ i ] = pp[ i & 3 ];
+  for( ; i + 4 <= last; i += 4 )
+    *( u32* )( p + i ) = pattern;
+  for( ; i < last; i ++ )
+    p[ i ] = pp[ i & 3 ];
+  if( end & 7 )
+  {
+    mask = BIT_TAIL_MASK( end );
+    p[ i ] = ( p[ i ] & ~mask ) | ( pp[ i & 3 ] & mask );
+  }
+}
+
+// Helper: count the bits set in [start, end)
+static u32 bitarrayh_count_bits( const u8 *p, u32 start, u32 end )
+{
+  u32 i = start >> 3, last = end >> 3, res = 0;
+  u8 mask;
+
+  if( start >= end )
+    return 0;
+  if( start & 7 )
+  {
+    mask = BIT_HEAD_MASK( start );
+    if( i == last )
+      return bitarrayh_popcount32( p[ i ] & mask & BIT_TAIL_MASK( end ) );
+    res = bitarrayh_popcount32( p[ i ++ ] & mask );
+  }
+  for( ; ( i < last ) && ( i & 3 ); i ++ )
+    res += bitarrayh_popcount32( p[ i ] );
+  for( ; i + 4 <= last; i += 4 )
+    res += bitarrayh_popcount32( *( const u32* )( p + i ) );
+  for( ; i < last; i ++ )
+    res += bitarrayh_popcount32( p[ i ] );
+  if( end & 7 )
+    res += bitarrayh_popcount32( p[ i ] & BIT_TAIL_MASK( end ) );
+  return res;
+}
+
+// Helper: copy 'n' bits (at most up to the end of the destination byte)
+static void bitarrayh_copy_chunk( u8 *dst, u32 dbit, const u8 *src, u32 sbit, u32 n )
+{
+  u32 ds = dbit & 7, ss = sbit & 7, v;
+  u8 mask = BIT_HEAD_MASK( ds ) & ( u8 )( 0xFF << ( 8 - ds - n ) );
+
+  v = src[ sbit >> 3 ] << 8;
+  if( ss + n > 8 )
+    v |= src[ ( sbit >> 3 ) + 1 ];
+  v >>= 8 - ss + ds;
+  dst[ dbit >> 3 ] = ( dst[ dbit >> 3 ] & ~mask ) | ( v & mask );
+}
+
+// Helper: copy 'n' bits from bit 'sbit' of 'src' to bit 'dbit' of 'dst'
+// The two areas can overlap (like memmove)
+static void bitarrayh_copy_bits( u8 *dst, u32 dbit, const u8 *src, u32 sbit, u32 n )
+{
+  int back = ( dst == src ) && ( dbit > sbit );
+  u32 head, mid, tail, i, k;
+
+  if( n == 0 )
+    return;
+  if( ( ( dbit ^ sbit ) & 7 ) == 0 )
+  {
+    // Same position in the byte: memmove (word copies) for the whole bytes
+    head = ( 8 - ( dbit & 7 ) ) & 7;
+    if( head > n )
+      head = n;
+    mid = ( n - head ) >> 3;
+    tail = n - head - ( mid << 3 );
+    if( head && !back )
+      bitarrayh_copy_chunk( dst, dbit, src, sbit, head );
+    if( tail && back )
+      bitarrayh_copy_chunk( dst, dbit + n - tail, src, sbit + n - tail, tail );
+    memmove( dst + ( ( dbit + head ) >> 3 ), src + ( ( sbit + head ) >> 3 ), mid );
+    if( head && back )
+      bitarrayh_copy_chunk( dst, dbit, src, sbit, head );
+    if( tail && !back )
+      bitarrayh_copy_chunk( dst, dbit + n - tail, src, sbit + n - tail, tail );
+  }
+  else if( back )
+  {
+    // Shifted copy, one destination byte at a time from the end
+    for( i = n; i > 0; i -= k )
+    {
+      k = ( dbit + i ) & 7 ? ( dbit + i ) & 7 : 8;
+      if( k > i )
+        k = i;
+      bitarrayh_copy_chunk( dst, dbit + i - k, src, sbit + i - k, k );
+    }
+  }
+  else
+  {
+    // Shifted copy, one destination byte at a time from the start
+    for( i = 0; i < n; i += k )
+    {
+      k = 8 - ( ( dbit + i ) & 7 );
+      if( k > n - i )
+        k = n - i;
+      bitarrayh_copy_chunk( dst, dbit + i, src, sbit + i, k );
+    }
+  }
+}
+
+// Helper: return the first non zero ('set' = 1) or zero ('set' = 0) element
+// at or after 'idx' (0 based), or the capacity of the array if there isn't one
+static u32 bitarrayh_find_elem( bitarray_t *pa, u32 idx, int set )
+{
+  u32 perword = 32 / pa->elsize, lo, hi, w, i;
+  const u32 *pw;
+  const u8 *pb;
+  u8 b;
+
+  // 'lo' has the lowest bit of each element set and 'hi' the highest one, so
+  // ( w - lo ) & ~w & hi is not zero only if the word has a zero element
+  lo = pa->elsize == 32 ? 1 : ( u32 )( 0xFFFFFFFFUL / ( ( 1UL << pa->elsize ) - 1 ) );
+  hi = lo << ( pa->elsize - 1 );
+  // Elements up to the first word boundary
+  for( ; ( idx < pa->capacity ) && ( idx % perword ); idx ++ )
+    if( ( bitarray_getval( pa, idx + 1 ) != 0 ) == set )
+      return idx;
+  // Skip the words that don't have a match
+  pw = ( const u32* )pa->values + idx / perword;
+  for( ; idx + perword <= pa->capacity; idx += perword )
+  {
+    w = *pw ++;
+    if( set ? w != 0 : ( ( w - lo ) & ~w & hi ) != 0 )
+      break;
+  }
+  // Single bits: find the first byte of the word with a match and use CLZ
+  if( ( pa->elsize == 1 ) && ( idx + perword <= pa->capacity ) )
+  {
+    pb = pa->values + ( idx >> 3 );
+    for( i = 0; i < 4; i ++, idx += 8 )
+      if( ( b = set ? pb[ i ] : ~pb[ i ] ) != 0 )
+        return idx + bitarrayh_clz8( b );
+  }
+  // The elements of the matching word (or the ones after the last word)
+  for( ; idx < pa->capacity; idx ++ )
+    if( ( bitarray_getval( pa, idx + 1 ) != 0 ) == set )
+      return idx;
+  return pa->capacity;
+}
+
+// Lua: bitarray.fill( array, value, [first], [last] )
+static int bitarray_fill( lua_State *L )
+{
+  bitarray_t *pa;
+  u32 val, first, last;
+
+  pa = bitarray_check( L );
+  val = luaL_checkinteger( L, 2 );
+  bitarrayh_get_range( L, pa, 3, &first, &last );
+  bitarrayh_fill_bits( pa->values, first * pa->elsize, last * pa->elsize, bitarrayh_pattern( pa, val ) );
+  return 0;
+}
+
+// Lua: bitarray.copy( dest, dest_first, src, [first], [last] )
+static int bitarray_copy( lua_State *L )
+{
+  bitarray_t *pd, *ps;
+  u32 dfirst, first, last;
+
+  pd = bitarray_check( L );
+  dfirst = luaL_checkinteger( L, 2 );
+  ps = bitarray_check_arg( L, 3 );
+  if( pd->elsize != ps->elsize )
+    return luaL_error( L, "element sizes don't match." );
+  bitarrayh_get_range( L, ps, 4, &first, &last );
+  if( ( dfirst == 0 ) || ( dfirst > pd->capacity + 1 ) || ( last - first > pd->capacity + 1 - dfirst ) )
+    return luaL_error( L, "invalid index." );
+  bitarrayh_copy_bits( pd->values, ( dfirst - 1 ) * pd->elsize, ps->values, first * ps->elsize, ( last - first ) * ps->elsize );
+  return 0;
+}
+
+// Bitwise operations
+enum
+{
+  BITARRAY_OP_AND,
+  BITARRAY_OP_OR,
+  BITARRAY_OP_XOR
+};
+
+// Helper: dest = dest <op> src
+static int bitarrayh_bitwise( lua_State *L, int op )
+{
+  bitarray_t *pd, *ps;
+  u32 *pdw, i, n;
+  const u32 *psw;
+
+  pd = bitarray_check( L );
+  ps = bitarray_check_arg( L, 2 );
+  if( ( pd->elsize != ps->elsize ) || ( pd->capacity != ps->capacity ) )
+    return luaL_error( L, "arrays don't match." );
+  pdw = ( u32* )pd->values;
+  psw = ( const u32* )ps->values;
+  n = ROUND_WORDS( pd->capacity * pd->elsize );
+  switch( op )
+  {
+    case BITARRAY_OP_AND:
+      for( i = 0; i < n; i ++ )
+        pdw[ i ] &= psw[ i ];
+      break;
+
+    case BITARRAY_OP_OR:
+      for( i = 0; i < n; i ++ )
+        pdw[ i ] |= psw[ i ];
+      break;
+
+    case BITARRAY_OP_XOR:
+      for( i = 0; i < n; i ++ )
+        pdw[ i ] ^= psw[ i ];
+      break;
+  }
+  return 0;
+}
+
+// Lua: bitarray.band( dest, src )
+static int bitarray_band( lua_State *L )
+{
+  return bitarrayh_bitwise( L, BITARRAY_OP_AND );
+}
+
+// Lua: bitarray.bor( dest, src )
+static int bitarray_bor( lua_State *L )
+{
+  return bitarrayh_bitwise( L, BITARRAY_OP_OR );
+}
+
+// Lua: bitarray.bxor( dest, src )
+static int bitarray_bxor( lua_State *L )
+{
+  return bitarrayh_bitwise( L, BITARRAY_OP_XOR );
+}
+
+// Lua: count = bitarray.popcount( array, [first], [last] )
+// Returns the number of bits set in the given elements
+static int bitarray_popcount( lua_State *L )
+{
+  bitarray_t *pa;
+  u32 first, last;
+
+  pa = bitarray_check( L );
+  bitarrayh_get_range( L, pa, 2, &first, &last );
+  lua_pushinteger( L, bitarrayh_count_bits( pa->values, first * pa->elsize, last * pa->elsize ) );
+  return 1;
+}
+
+// Helper: idx = bitarray.findset/findclear( array, [first] )
+static int bitarrayh_find( lua_State *L, int set )
+{
+  bitarray_t *pa;
+  u32 first, idx;
+
+  pa = bitarray_check( L );
+  first = luaL_optinteger( L, 2, 1 );
+  if( ( first == 0 ) || ( first > pa->capacity + 1 ) )
+    return luaL_error( L, "invalid index." );
+  if( ( idx = bitarrayh_find_elem( pa, first - 1, set ) ) == pa->capacity )
+    lua_pushnil( L );
+  else
+    lua_pushinteger( L, idx + 1 );
+  return 1;
+}
+
+// Lua: idx = bitarray.findset( array, [first] )
+// Returns the index of the first non zero element or nil
+static int bitarray_findset( lua_State *L )
+{
+  return bitarrayh_find( L, 1 );
+}
+
+// Lua: idx = bitarray.findclear( array, [first] )
+// Returns the index of the first zero element or nil
+static int bitarray_findclear( lua_State *L )
+{
+  return bitarrayh_find( L, 0 );
+}
+
+// Lua: bitarray.blit( dest, dest_width, x, y, src, src_width, [sx], [sy], [w], [h] )
+// The arrays are images with rows of 'dest_width'/'src_width' elements (pixels).
+// Copies the 'w' x 'h' rectangle at ('sx', 'sy') in 'src' (all of 'src' by
+// default) to ('x', 'y') in 'dest'. Coordinates start at 0 and the rectangle
+// is clipped to both images.
+static int bitarray_blit( lua_State *L )
+{
+  bitarray_t *pd, *ps;
+  s32 dw, x, y, sw, sx, sy, w, h, r, row;
+  u32 dbit, sbit, e;
+  int back;
+
+  pd = bitarray_check( L );
+  dw = luaL_checkinteger( L, 2 );
+  x = luaL_checkinteger( L, 3 );
+  y = luaL_checkinteger( L, 4 );
+  ps = bitarray_check_arg( L, 5 );
+  sw = luaL_checkinteger( L, 6 );
+  if( pd->elsize != ps->elsize )
+    return luaL_error( L, "element sizes don't match." );
+  if( ( dw <= 0 ) || ( sw <= 0 ) )
+    return luaL_error( L, "invalid width." );
+  sx = luaL_optinteger( L, 7, 0 );
+  sy = luaL_optinteger( L, 8, 0 );
+  w = luaL_optinteger( L, 9, sw - sx );
+  h = luaL_optinteger( L, 10, ( s32 )( ps->capacity / sw ) - sy );
+  // Clip to the source, then to the destination
+  if( sx < 0 )
+  {
+    w += sx;
+    x -= sx;
+    sx = 0;
+  }
+  if( sy < 0 )
+  {
+    h += sy;
+    y -= sy;
+    sy = 0;
+  }
+  if( x < 0 )
+  {
+    w += x;
+    sx -= x;
+    x = 0;
+  }
+  if( y < 0 )
+  {
+    h += y;
+    sy -= y;
+    y = 0;
+  }
+  if( w > sw - sx )
+    w = sw - sx;
+  if( h > ( s32 )( ps->capacity / sw ) - sy )
+    h = ps->capacity / sw - sy;
+  if( w > dw - x )
+    w = dw - x;
+  if( h > ( s32 )( pd->capacity / dw ) - y )
+    h = pd->capacity / dw - y;
+  if( ( w <= 0 ) || ( h <= 0 ) )
+    return 0;
+  // Go bottom up if the rectangles overlap and the destination is after the source
+  e = pd->elsize;
+  dbit = ( y * dw + x ) * e;
+  sbit = ( sy * sw + sx ) * e;
+  back = ( pd == ps ) && ( dbit > sbit );
+  for( r = 0; r < h; r ++ )
+  {
+    row = back ? h - 1 - r : r;
+    bitarrayh_copy_bits( pd->values, dbit + row * dw * e, ps->values, sbit + row * sw * e, w * e );
+  }
+  return 0;
+}
+
 // Module function map
 #define MIN_OPT_LEVEL 2
 #include "lrodefs.h"
@@ -308,6 +764,15 @@ const LUA_REG_TYPE bitarray_map[] =
   { LSTRKEY( "pairs" ), LFUNCVAL( bitarray_pairs ) },
   { LSTRKEY( "tostring" ), LFUNCVAL( bitarray_tostring ) },
   { LSTRKEY( "totable" ), LFUNCVAL( bitarray_totable ) },
+  { LSTRKEY( "fill" ), LFUNCVAL( bitarray_fill ) },
+  { LSTRKEY( "copy" ), LFUNCVAL( bitarray_copy ) },
+  { LSTRKEY( "band" ), LFUNCVAL( bitarray_band ) },
+  { LSTRKEY( "bor" ), LFUNCVAL( bitarray_bor ) },
+  { LSTRKEY( "bxor" ), LFUNCVAL( bitarray_bxor ) },
+  { LSTRKEY( "popcount" ), LFUNCVAL( bitarray_popcount ) },
+  { LSTRKEY( "findset" ), LFUNCVAL( bitarray_findset ) },
+  { LSTRKEY( "findclear" ), LFUNCVAL( bitarray_findclear ) },
+  { LSTRKEY( "blit" ), LFUNCVAL( bitarray_blit ) },
   { LNILKEY, LNILVAL } 
 };
 
@@ -6,6 +6,7 @@
 #include "platform.h"
 #include "auxmods.h"
 #include "lrotable.h"
+#include "common.h"
 
 // Lua: setup( id, clock )
 static int can_setup( lua_State* L )
@@ -64,6 +65,87 @@ static int can_recv( lua_State* L )
     return 0;
 }
 
+// Lua: frames = recvmany( id, [max] )
+// Each frame is a table { canid, canidtype, message }
+static int can_recvmany( lua_State* L )
+{
+  u8 len;
+  int id, max, n = 0;
+  u32 canid;
+  u8  idtype, data[ 8 ];
+
+  id = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( can, id );
+  max = luaL_optinteger( L, 2, 0 );
+  if( max < 0 )
+    return luaL_error( L, "invalid number of frames" );
+
+  lua_newtable( L );
+  while( ( max == 0 || n < max ) && platform_can_recv( id, &canid, &idtype, &len, data ) == PLATFORM_OK )
+  {
+    lua_createtable( L, 3, 0 );
+    lua_pushinteger( L, canid );
+    lua_rawseti( L, -2, 1 );
+    lua_pushinteger( L, idtype );
+    lua_rawseti( L, -2, 2 );
+    lua_pushlstring( L, ( const char * )data, ( size_t )len );
+    lua_rawseti( L, -2, 3 );
+    lua_rawseti( L, -2, ++ n );
+  }
+  return 1;
+}
+
+// Lua: setfilter( id, filter, [canid, mask, canidtype] )
+// Without 'canid', 'mask' and 'canidtype' the filter is disabled
+static int can_setfilter( lua_State* L )
+{
+  unsigned id, filter;
+  u32 canid = 0, mask = 0;
+  int idtype = PLATFORM_CAN_FILTER_OFF;
+
+  id = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( can, id );
+  filter = luaL_checkinteger( L, 2 );
+  if( lua_gettop( L ) > 2 )
+  {
+    canid = luaL_checkinteger( L, 3 );
+    mask = luaL_checkinteger( L, 4 );
+    idtype = luaL_checkinteger( L, 5 );
+    if( idtype != ELUA_CAN_ID_STD && idtype != ELUA_CAN_ID_EXT )
+      return luaL_error( L, "invalid CAN ID type" );
+  }
+  if( platform_can_set_filter( id, filter, canid, mask, idtype ) != PLATFORM_OK )
+    return luaL_error( L, "unable to set filter %d on interface %d", filter, id );
+  return 0;
+}
+
+// Lua: set_buffer( id, size )
+static int can_set_buffer( lua_State* L )
+{
+  unsigned id;
+  u32 size;
+
+  id = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( can, id );
+  size = ( u32 )luaL_checkinteger( L, 2 );
+  if( size && ( size & ( size - 1 ) ) )
+    return luaL_error( L, "the buffer size must be a power of 2 or 0" );
+  if( platform_can_set_buffer( id, intlog2( size ) ) == PLATFORM_ERR )
+    return luaL_error( L, "unable to set CAN buffer" );
+  return 0;
+}
+
+// Lua: count = dropped( id )
+static int can_dropped( lua_State* L )
+{
+  unsigned id;
+
+  id = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( can, id );
+  lua_pushnumber( L, platform_can_get_dropped( id ) );
+  return 1;
+}
+
 
 // Module function map
 #define MIN_OPT_LEVEL 2
@@ -73,6 +155,10 @@ const LUA_REG_TYPE can_map[] =
   { LSTRKEY( "setup" ),  LFUNCVAL( can_setup ) },
   { LSTRKEY( "send" ),  LFUNCVAL( can_send ) },  
   { LSTRKEY( "recv" ),  LFUNCVAL( can_recv ) },
+  { LSTRKEY( "recvmany" ),  LFUNCVAL( can_recvmany ) },
+  { LSTRKEY( "setfilter" ),  LFUNCVAL( can_setfilter ) },
+  { LSTRKEY( "set_buffer" ),  LFUNCVAL( can_set_buffer ) },
+  { LSTRKEY( "dropped" ),  LFUNCVAL( can_dropped ) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY( "ID_STD" ), LNUMVAL( ELUA_CAN_ID_STD ) },
   { LSTRKEY( "ID_EXT" ), LNUMVAL( ELUA_CAN_ID_EXT ) },
@@ -0,0 +1,563 @@
+// Module for signal processing over packed sample buffers (see sbuf.c)
+// The filters and the FFT work on buffers with 16-bit elements and use fixed
+// point arithmetic, the other functions work on all the buffer types.
+
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+#include "type.h"
+#include "auxmods.h"
+#include "lrotable.h"
+#include "sbuf.h"
+#include <math.h>
+
+// Number of fractional bits of the FIR (Q15) and IIR (Q14) coefficients
+#define DSP_FIR_QBITS         15
+#define DSP_IIR_QBITS         14
+
+// Maximum FFT size (the sine table below has DSP_FFT_MAX / 4 + 1 entries)
+#define DSP_FFT_MAX           1024
+#define DSP_FFT_QUARTER       ( DSP_FFT_MAX / 4 )
+
+// Threshold crossing directions
+#define DSP_RISING            1
+#define DSP_FALLING           2
+#define DSP_BOTH              3
+
+// *****************************************************************************
+// CPU specific operations
+
+#if defined( __GNUC__ ) && ( defined( __ARM_ARCH_7M__ ) || defined( __ARM_ARCH_7EM__ ) )
+// Cortex-M3/M4: single cycle saturation instructions
+static inline s32 dsp_sat_s16( s32 x )
+{
+  s32 res;
+
+  asm( "ssat %0, #16, %1" : "=r" ( res ) : "r" ( x ) );
+  return res;
+}
+
+static inline s32 dsp_sat_u16( s32 x )
+{
+  s32 res;
+
+  asm( "usat %0, #16, %1" : "=r" ( res ) : "r" ( x ) );
+  return res;
+}
+#else
+static inline s32 dsp_sat_s16( s32 x )
+{
+  return x > 32767 ? 32767 : x < -32768 ? -32768 : x;
+}
+
+static inline s32 dsp_sat_u16( s32 x )
+{
+  return x > 65535 ? 65535 : x < 0 ? 0 : x;
+}
+#endif
+
+#if defined( __GNUC__ ) && defined( __ARM_ARCH_7EM__ )
+// Cortex-M4: dual 16x16 multiply with 64-bit accumulation (SIMD)
+#define DSP_HAS_SIMD
+
+// Two packed s16 values (the unaligned word loads are handled by the CPU)
+typedef u32 __attribute__(( aligned( 2 ) )) dsp_pair_t;
+
+static inline s64 dsp_smlald( u32 x, u32 y, s64 acc )
+{
+  asm( "smlald %Q0, %R0, %1, %2" : "+r" ( acc ) : "r" ( x ), "r" ( y ) );
+  return acc;
+}
+#endif
+
+// Round a fixed point accumulator with 'qbits' fractional bits to an integer
+// (limited to the s32 range)
+static s32 dsp_round( s64 acc, unsigned qbits )
+{
+  acc = ( acc + ( 1 << ( qbits - 1 ) ) ) >> qbits;
+  if( acc > 0x7FFFFFFF )
+    return 0x7FFFFFFF;
+  if( acc < -0x7FFFFFFF )
+    return -0x7FFFFFFF;
+  return ( s32 )acc;
+}
+
+// *****************************************************************************
+// Helpers
+
+// Return the buffer at the given index (it must have 16-bit elements)
+static sbuf_t* dsp_check16( lua_State *L, int idx )
+{
+  sbuf_t *p = sbuf_check( L, idx );
+
+  if( p->type != SBUF_TYPE_U16 && p->type != SBUF_TYPE_S16 )
+    luaL_error( L, "the buffer must have 16-bit elements." );
+  return p;
+}
+
+// Get the coefficients at the given index as fixed point numbers with 'qbits'
+// fractional bits. They can be given as a table of numbers or as a S16 buffer
+// that already has fixed point values. The result is kept in a new userdata
+// (pushed on the stack), in reverse order if 'rev' is not 0.
+static s16* dsp_getcoefs( lua_State *L, int idx, unsigned qbits, int rev, u32 *pcount )
+{
+  sbuf_t *p;
+  s16 *pcoefs;
+  u32 i, n;
+
+  if( ( p = sbuf_test( L, idx ) ) != NULL )
+  {
+    if( p->type != SBUF_TYPE_S16 )
+      luaL_error( L, "the coefficients buffer must have S16 elements." );
+    n = p->count;
+  }
+  else
+  {
+    luaL_checktype( L, idx, LUA_TTABLE );
+    n = lua_objlen( L, idx );
+  }
+  pcoefs = ( s16* )lua_newuserdata( L, n * sizeof( s16 ) );
+  for( i = 0; i < n; i ++ )
+  {
+    if( p )
+      pcoefs[ rev ? n - 1 - i : i ] = ( ( const s16* )p->data )[ i ];
+    else
+    {
+      lua_rawgeti( L, idx, i + 1 );
+      pcoefs[ rev ? n - 1 - i : i ] = dsp_sat_s16( ( s32 )floor( lua_tonumber( L, -1 ) * ( 1 << qbits ) + 0.5 ) );
+      lua_pop( L, 1 );
+    }
+  }
+  *pcount = n;
+  return pcoefs;
+}
+
+// *****************************************************************************
+// Filters
+
+// FIR filter for 16-bit samples, 'h' has the coefficients in reverse order
+// Each output is y[ n ] = sum( h[ j ] * x[ n - ntaps + 1 + j ] ), the samples
+// before the start of the buffer are 0
+static void dsp_fir16( const sbuf_t *pin, sbuf_t *pout, const s16 *h, u32 ntaps, u32 decim )
+{
+  u32 n, j, first, cnt;
+  s64 acc;
+  s32 res;
+  const s16 *hp;
+
+  for( n = 0; n < pin->count; n += decim )
+  {
+    first = n + 1 < ntaps ? ntaps - 1 - n : 0;
+    hp = h + first;
+    cnt = ntaps - first;
+    acc = 0;
+    if( pin->type == SBUF_TYPE_S16 )
+    {
+      const s16 *xp = ( const s16* )pin->data + n + 1 + first - ntaps;
+
+      j = 0;
+#ifdef DSP_HAS_SIMD
+      for( ; j + 1 < cnt; j += 2 )
+        acc = dsp_smlald( *( const dsp_pair_t* )( xp + j ), *( const dsp_pair_t* )( hp + j ), acc );
+#endif
+      for( ; j < cnt; j ++ )
+        acc += ( s32 )hp[ j ] * xp[ j ];
+      res = dsp_round( acc, DSP_FIR_QBITS );
+      ( ( s16* )pout->data )[ n / decim ] = dsp_sat_s16( res );
+    }
+    else
+    {
+      const u16 *xp = ( const u16* )pin->data + n + 1 + first - ntaps;
+
+      for( j = 0; j < cnt; j ++ )
+        acc += ( s32 )hp[ j ] * xp[ j ];
+      res = dsp_round( acc, DSP_FIR_QBITS );
+      ( ( u16* )pout->data )[ n / decim ] = dsp_sat_u16( res );
+    }
+  }
+}
+
+// Lua: out = fir( buf, coefs, [decim] )
+static int dsp_fir( lua_State *L )
+{
+  sbuf_t *p = dsp_check16( L, 1 ), *pout;
+  u32 ntaps, decim = luaL_optinteger( L, 3, 1 );
+  const s16 *h;
+
+  if( decim == 0 )
+    return luaL_error( L, "invalid decimation factor." );
+  h = dsp_getcoefs( L, 2, DSP_FIR_QBITS, 1, &ntaps );
+  if( ntaps == 0 )
+    return luaL_error( L, "no coefficients." );
+  pout = sbuf_new( L, p->type, ( p->count + decim - 1 ) / decim );
+  dsp_fir16( p, pout, h, ntaps, decim );
+  return 1;
+}
+
+// Lua: out = iir( buf, coefs )
+// 'coefs' has 5 coefficients ( b0, b1, b2, a1, a2 ) for each second order
+// section; the sections are applied in order (direct form I, a0 = 1)
+static int dsp_iir( lua_State *L )
+{
+  sbuf_t *p = dsp_check16( L, 1 ), *pout;
+  u32 ncoefs, nsect, n, s;
+  const s16 *c;
+  s32 *state, v;
+  s64 acc;
+
+  c = dsp_getcoefs( L, 2, DSP_IIR_QBITS, 0, &ncoefs );
+  if( ncoefs == 0 || ncoefs % 5 )
+    return luaL_error( L, "the number of coefficients must be a multiple of 5." );
+  nsect = ncoefs / 5;
+  // x[ n - 1 ], x[ n - 2 ], y[ n - 1 ], y[ n - 2 ] for each section
+  state = ( s32* )lua_newuserdata( L, nsect * 4 * sizeof( s32 ) );
+  for( s = 0; s < nsect * 4; s ++ )
+    state[ s ] = 0;
+  pout = sbuf_new( L, p->type, p->count );
+  for( n = 0; n < p->count; n ++ )
+  {
+    if( p->type == SBUF_TYPE_S16 )
+      v = ( ( const s16* )p->data )[ n ];
+    else
+      v = ( ( const u16* )p->data )[ n ];
+    for( s = 0; s < nsect; s ++ )
+    {
+      const s16 *cs = c + s * 5;
+      s32 *st = state + s * 4;
+
+      acc = ( s64 )cs[ 0 ] * v + ( s64 )cs[ 1 ] * st[ 0 ] + ( s64 )cs[ 2 ] * st[ 1 ];
+      acc -= ( s64 )cs[ 3 ] * st[ 2 ] + ( s64 )cs[ 4 ] * st[ 3 ];
+      st[ 1 ] = st[ 0 ];
+      st[ 0 ] = v;
+      st[ 3 ] = st[ 2 ];
+      st[ 2 ] = v = dsp_round( acc, DSP_IIR_QBITS );
+    }
+    if( p->type == SBUF_TYPE_S16 )
+      ( ( s16* )pout->data )[ n ] = dsp_sat_s16( v );
+    else
+      ( ( u16* )pout->data )[ n ] = dsp_sat_u16( v );
+  }
+  return 1;
+}
+
+// Moving average of the last 'n' elements (the first n - 1 outputs are the
+// averages of the elements that are available)
+#define DSP_MOVAVG( type, sumtype )\
+  {\
+    const type *src = ( const type* )p->data;\
+    type *dst = ( type* )pout->data;\
+    sumtype sum = 0;\
+    for( i = 0; i < p->count; i ++ )\
+    {\
+      sum += src[ i ];\
+      if( i >= n )\
+        sum -= src[ i - n ];\
+      dst[ i ] = ( type )( sum / ( sumtype )( i < n ? i + 1 : n ) );\
+    }\
+  }
+
+// Lua: out = movavg( buf, n )
+static int dsp_movavg( lua_State *L )
+{
+  sbuf_t *p = sbuf_check( L, 1 ), *pout;
+  u32 n = luaL_checkinteger( L, 2 ), i;
+
+  if( n == 0 )
+    return luaL_error( L, "invalid window size." );
+  pout = sbuf_new( L, p->type, p->count );
+  switch( p->type )
+  {
+    case SBUF_TYPE_U16:
+      DSP_MOVAVG( u16, u32 );
+      break;
+
+    case SBUF_TYPE_S16:
+      DSP_MOVAVG( s16, s32 );
+      break;
+
+    case SBUF_TYPE_U32:
+      DSP_MOVAVG( u32, u64 );
+      break;
+
+    default:
+      DSP_MOVAVG( float, double );
+      break;
+  }
+  return 1;
+}
+
+// *****************************************************************************
+// FFT
+
+// Q15 sine table for the first quadrant (sin( 2 * pi * i / DSP_FFT_MAX ))
+static const s16 dsp_sintab[ DSP_FFT_QUARTER + 1 ] =
+{
+  0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809,
+  2009, 2210, 2411, 2611, 2811, 3012, 3212, 3412, 3612, 3812,
+  4011, 4211, 4410, 4609, 4808, 5007, 5205, 5404, 5602, 5800,
+  5998, 6195, 6393, 6590, 6787, 6983, 7180, 7376, 7571, 7767,
+  7962, 8157, 8351, 8546, 8740, 8933, 9127, 9319, 9512, 9704,
+  9896, 10088, 10279, 10469, 10660, 10850, 11039, 11228, 11417, 11605,
+  11793, 11980, 12167, 12354, 12540, 12725, 12910, 13095, 13279, 13463,
+  13646, 13828, 14010, 14192, 14373, 14553, 14733, 14912, 15091, 15269,
+  15447, 15624, 15800, 15976, 16151, 16326, 16500, 16673, 16846, 17018,
+  17190, 17361, 17531, 17700, 17869, 18037, 18205, 18372, 18538, 18703,
+  18868, 19032, 19195, 19358, 19520, 19681, 19841, 20001, 20160, 20318,
+  20475, 20632, 20788, 20943, 21097, 21251, 21403, 21555, 21706, 21856,
+  22006, 22154, 22302, 22449, 22595, 22740, 22884, 23028, 23170, 23312,
+  23453, 23593, 23732, 23870, 24008, 24144, 24279, 24414, 24548, 24680,
+  24812, 24943, 25073, 25202, 25330, 25457, 25583, 25708, 25833, 25956,
+  26078, 26199, 26320, 26439, 26557, 26674, 26791, 26906, 27020, 27133,
+  27246, 27357, 27467, 27576, 27684, 27791, 27897, 28002, 28106, 28209,
+  28311, 28411, 28511, 28610, 28707, 28803, 28899, 28993, 29086, 29178,
+  29269, 29359, 29448, 29535, 29622, 29707, 29792, 29875, 29957, 30038,
+  30118, 30196, 30274, 30350, 30425, 30499, 30572, 30644, 30715, 30784,
+  30853, 30920, 30986, 31050, 31114, 31177, 31238, 31298, 31357, 31415,
+  31471, 31527, 31581, 31634, 31686, 31737, 31786, 31834, 31881, 31927,
+  31972, 32015, 32058, 32099, 32138, 32177, 32214, 32251, 32286, 32319,
+  32352, 32383, 32413, 32442, 32470, 32496, 32522, 32546, 32568, 32590,
+  32610, 32629, 32647, 32664, 32679, 32693, 32706, 32718, 32729, 32738,
+  32746, 32753, 32758, 32762, 32766, 32767, 32767
+};
+
+// sin/cos( 2 * pi * t / DSP_FFT_MAX ) for 0 <= t < DSP_FFT_MAX / 2
+static s32 dsp_sin( u32 t )
+{
+  return t <= DSP_FFT_QUARTER ? dsp_sintab[ t ] : dsp_sintab[ 2 * DSP_FFT_QUARTER - t ];
+}
+
+static s32 dsp_cos( u32 t )
+{
+  return t <= DSP_FFT_QUARTER ? dsp_sintab[ DSP_FFT_QUARTER - t ] : -dsp_sintab[ t - DSP_FFT_QUARTER ];
+}
+
+// Lua: re, im = fft( buf )
+// Radix 2 decimation in time FFT; the results of each stage are divided by 2
+// (so the result is the DFT divided by the number of samples) to avoid
+// overflows. U16 samples are divided by 2 first to fit in a s16.
+static int dsp_fft( lua_State *L )
+{
+  sbuf_t *p = dsp_check16( L, 1 );
+  u32 n = p->count, i, j, k, a, b, len, half, tstep;
+  s16 *re, *im;
+  s32 wr, wi, tr, ti;
+
+  if( n < 2 || n > DSP_FFT_MAX || ( n & ( n - 1 ) ) )
+    return luaL_error( L, "the size must be a power of 2 between 2 and %d.", DSP_FFT_MAX );
+  re = ( s16* )sbuf_new( L, SBUF_TYPE_S16, n )->data;
+  im = ( s16* )sbuf_new( L, SBUF_TYPE_S16, n )->data;
+  // Copy the samples in bit reversed order
+  for( i = j = 0; i < n; i ++ )
+  {
+    if( p->type == SBUF_TYPE_S16 )
+      re[ j ] = ( ( const s16* )p->data )[ i ];
+    else
+      re[ j ] = ( ( const u16* )p->data )[ i ] >> 1;
+    im[ j ] = 0;
+    for( k = n >> 1; j & k; k >>= 1 )
+      j ^= k;
+    j |= k;
+  }
+  // Butterflies
+  for( len = 2, tstep = DSP_FFT_MAX / 2; len <= n; len <<= 1, tstep >>= 1 )
+  {
+    half = len >> 1;
+    for( k = 0; k < half; k ++ )
+    {
+      wr = dsp_cos( k * tstep );
+      wi = dsp_sin( k * tstep );
+      for( a = k; a < n; a += len )
+      {
+        b = a + half;
+        tr = ( re[ b ] * wr + im[ b ] * wi ) >> 15;
+        ti = ( im[ b ] * wr - re[ b ] * wi ) >> 15;
+        re[ b ] = dsp_sat_s16( ( re[ a ] - tr ) >> 1 );
+        im[ b ] = dsp_sat_s16( ( im[ a ] - ti ) >> 1 );
+        re[ a ] = dsp_sat_s16( ( re[ a ] + tr ) >> 1 );
+        im[ a ] = dsp_sat_s16( ( im[ a ] + ti ) >> 1 );
+      }
+    }
+  }
+  return 2;
+}
+
+// Lua: pwr = power( re, im ) (re[ i ] ^ 2 + im[ i ] ^ 2 in a U32 buffer)
+static int dsp_power( lua_State *L )
+{
+  sbuf_t *pre = sbuf_check( L, 1 ), *pim = sbuf_check( L, 2 ), *pout;
+  const s16 *re = ( const s16* )pre->data, *im = ( const s16* )pim->data;
+  u32 *dst, i;
+
+  if( pre->type != SBUF_TYPE_S16 || pim->type != SBUF_TYPE_S16 || pre->count != pim->count )
+    return luaL_error( L, "expected two S16 buffers with the same size." );
+  pout = sbuf_new( L, SBUF_TYPE_U32, pre->count );
+  dst = ( u32* )pout->data;
+  for( i = 0; i < pre->count; i ++ )
+    dst[ i ] = ( u32 )( re[ i ] * re[ i ] ) + ( u32 )( im[ i ] * im[ i ] );
+  return 1;
+}
+
+// *****************************************************************************
+// Analysis
+
+// Minimum, maximum, sum and sum of squares of the elements in the range
+#define DSP_STATS( type, sumtype, sqtype )\
+  {\
+    const type *src = ( const type* )p->data + start;\
+    type vmin = src[ 0 ], vmax = src[ 0 ];\
+    sumtype sum = 0;\
+    sqtype sumsq = 0;\
+    for( i = 0; i < count; i ++ )\
+    {\
+      if( src[ i ] < vmin )\
+        vmin = src[ i ];\
+      if( src[ i ] > vmax )\
+        vmax = src[ i ];\
+      sum += src[ i ];\
+      sumsq += ( sqtype )src[ i ] * src[ i ];\
+    }\
+    lua_pushnumber( L, ( lua_Number )vmin );\
+    lua_pushnumber( L, ( lua_Number )vmax );\
+    lua_pushnumber( L, ( lua_Number )( ( double )sum / count ) );\
+    lua_pushnumber( L, ( lua_Number )sqrt( ( double )sumsq / count ) );\
+  }
+
+// Lua: min, max, mean, rms = stats( buf, [i], [j] )
+static int dsp_stats( lua_State *L )
+{
+  sbuf_t *p = sbuf_check( L, 1 );
+  u32 start, i, count = sbuf_checkrange( L, p, 2, &start );
+
+  if( count == 0 )
+    return luaL_error( L, "empty range." );
+  switch( p->type )
+  {
+    case SBUF_TYPE_U16:
+      DSP_STATS( u16, u64, u64 );
+      break;
+
+    case SBUF_TYPE_S16:
+      DSP_STATS( s16, s64, u64 );
+      break;
+
+    case SBUF_TYPE_U32:
+      DSP_STATS( u32, u64, double );
+      break;
+
+    default:
+      DSP_STATS( float, double, double );
+      break;
+  }
+  return 4;
+}
+
+// Find the threshold crossings (with hysteresis, like a Schmitt trigger):
+// a rising crossing happens when the signal gets to 'level' after being
+// under 'level - hyst', a falling crossing when the signal goes under
+// 'level - hyst' after being over 'level'. Returns the number of crossings
+// and writes their indexes (1 based) in 'dst' if it's not NULL.
+#define DSP_CROSSINGS( type, valtype )\
+  {\
+    const type *src = ( const type* )p->data;\
+    valtype hi = ( valtype )level, lo = ( valtype )( level - hyst );\
+    for( i = 0; i < p->count; i ++ )\
+    {\
+      if( src[ i ] >= hi )\
+      {\
+        if( state < 0 && ( dir & DSP_RISING ) )\
+        {\
+          if( dst )\
+            dst[ found ] = i + 1;\
+          found ++;\
+        }\
+        state = 1;\
+      }\
+      else if( src[ i ] < lo )\
+      {\
+        if( state > 0 && ( dir & DSP_FALLING ) )\
+        {\
+          if( dst )\
+            dst[ found ] = i + 1;\
+          found ++;\
+        }\
+        state = -1;\
+      }\
+    }\
+  }
+
+static u32 dsp_find_crossings( const sbuf_t *p, lua_Number level, lua_Number hyst, int dir, u32 *dst )
+{
+  u32 i, found = 0;
+  int state = 0;
+
+  switch( p->type )
+  {
+    case SBUF_TYPE_U16:
+      DSP_CROSSINGS( u16, s32 );
+      break;
+
+    case SBUF_TYPE_S16:
+      DSP_CROSSINGS( s16, s32 );
+      break;
+
+    case SBUF_TYPE_U32:
+      DSP_CROSSINGS( u32, double );
+      break;
+
+    default:
+      DSP_CROSSINGS( float, double );
+      break;
+  }
+  return found;
+}
+
+// Lua: idx = crossings( buf, level, [dir], [hyst] )
+// Returns an U32 buffer with the indexes of the crossings
+static int dsp_crossings( lua_State *L )
+{
+  sbuf_t *p = sbuf_check( L, 1 ), *pout;
+  lua_Number level = luaL_checknumber( L, 2 );
+  int dir = luaL_optinteger( L, 3, DSP_BOTH );
+  lua_Number hyst = luaL_optnumber( L, 4, 0 );
+
+  if( dir < DSP_RISING || dir > DSP_BOTH )
+    return luaL_error( L, "invalid direction." );
+  if( hyst < 0 )
+    return luaL_error( L, "invalid hysteresis." );
+  pout = sbuf_new( L, SBUF_TYPE_U32, dsp_find_crossings( p, level, hyst, dir, NULL ) );
+  dsp_find_crossings( p, level, hyst, dir, ( u32* )pout->data );
+  return 1;
+}
+
+// Module function map
+#define MIN_OPT_LEVEL 2
+#include "lrodefs.h"
+const LUA_REG_TYPE dsp_map[] =
+{
+  { LSTRKEY( "fir" ), LFUNCVAL( dsp_fir ) },
+  { LSTRKEY( "iir" ), LFUNCVAL( dsp_iir ) },
+  { LSTRKEY( "movavg" ), LFUNCVAL( dsp_movavg ) },
+  { LSTRKEY( "fft" ), LFUNCVAL( dsp_fft ) },
+  { LSTRKEY( "power" ), LFUNCVAL( dsp_power ) },
+  { LSTRKEY( "stats" ), LFUNCVAL( dsp_stats ) },
+  { LSTRKEY( "crossings" ), LFUNCVAL( dsp_crossings ) },
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "RISING" ), LNUMVAL( DSP_RISING ) },
+  { LSTRKEY( "FALLING" ), LNUMVAL( DSP_FALLING ) },
+  { LSTRKEY( "BOTH" ), LNUMVAL( DSP_BOTH ) },
+#endif
+  { LNILKEY, LNILVAL }
+};
+
+LUALIB_API int luaopen_dsp( lua_State *L )
+{
+#if LUA_OPTIMIZE_MEMORY > 0
+  return 0;
+#else // #if LUA_OPTIMIZE_MEMORY > 0
+  luaL_register( L, AUXLIB_DSP, dsp_map );
+  MOD_REG_NUMBER( L, "RISING", DSP_RISING );
+  MOD_REG_NUMBER( L, "FALLING", DSP_FALLING );
+  MOD_REG_NUMBER( L, "BOTH", DSP_BOTH );
+  return 1;
+#endif // #if LUA_OPTIMIZE_MEMORY > 0
+}
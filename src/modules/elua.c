@@ -10,7 +10,20 @@
 #include "version.h"
 #include "platform_conf.h"
 #include "linenoise.h"
+#include "devman.h"
+#include "type.h"
 #include <string.h>
+#include <errno.h>
+
+#define MAP_META_NAME         "eLua.map"
+#define map_check( L )        ( elua_mapfile_t* )luaL_checkudata( L, 1, MAP_META_NAME )
+
+// A file mapped in memory (the data is not copied)
+typedef struct
+{
+  const u8 *data;
+  u32 size;
+} elua_mapfile_t;
 
 // Lua: elua.egc_setup( mode, [ memlimit ] )
 static int elua_egc_setup( lua_State *L )
@@ -54,14 +67,154 @@ static int elua_save_history( lua_State *L )
 #endif // #ifdef BUILD_LINENOISE
 }
 
+// Lua: map = elua.map( filename )
+// Returns a read-only view of the file data (or nil and an error message if
+// the file can't be mapped). Only the file systems that keep their data in
+// memory (ROMFS) can map files.
+static int elua_mapfile( lua_State *L )
+{
+  const char *fname = luaL_checkstring( L, 1 );
+  elua_mapfile_t *pm;
+  const void *pdata;
+  u32 size;
+
+  if( dm_map( fname, &pdata, &size ) != 0 )
+  {
+    lua_pushnil( L );
+    lua_pushfstring( L, "%s: %s", fname, errno == ENOSYS ? "file system doesn't support mapping" : "file not found" );
+    return 2;
+  }
+  pm = ( elua_mapfile_t* )lua_newuserdata( L, sizeof( elua_mapfile_t ) );
+  pm->data = ( const u8* )pdata;
+  pm->size = size;
+  luaL_getmetatable( L, MAP_META_NAME );
+  lua_setmetatable( L, -2 );
+  return 1;
+}
+
+// Helper: translate a string.sub style index (negative values count from the end)
+static long map_index( long idx, u32 size )
+{
+  return idx < 0 ? ( long )size + idx + 1 : idx;
+}
+
+// Helper: get the ( start, end ) range from the arguments at 'argn' and 'argn + 1'
+// Returns the range length (0 if the range is empty)
+static u32 map_range( lua_State *L, elua_mapfile_t *pm, int argn, long defend, u32 *pstart )
+{
+  long start = map_index( luaL_optlong( L, argn, 1 ), pm->size );
+  long end = map_index( luaL_optlong( L, argn + 1, defend ), pm->size );
+
+  if( start < 1 )
+    start = 1;
+  if( end > ( long )pm->size )
+    end = pm->size;
+  *pstart = start - 1;
+  return start <= end ? end - start + 1 : 0;
+}
+
+// Lua: str = map:sub( [i], [j] ) (copies only the given part of the data)
+static int map_sub( lua_State *L )
+{
+  elua_mapfile_t *pm = map_check( L );
+  u32 start, len = map_range( L, pm, 2, -1, &start );
+
+  lua_pushlstring( L, ( const char* )pm->data + start, len );
+  return 1;
+}
+
+// Lua: b1, b2, ... = map:byte( [i], [j] )
+static int map_byte( lua_State *L )
+{
+  elua_mapfile_t *pm = map_check( L );
+  u32 start, i, len = map_range( L, pm, 2, map_index( luaL_optlong( L, 2, 1 ), pm->size ), &start );
+
+  luaL_checkstack( L, len, "too many results" );
+  for( i = 0; i < len; i ++ )
+    lua_pushinteger( L, pm->data[ start + i ] );
+  return len;
+}
+
+// Lua: pos = map:find( str, [init] ) (plain search, no patterns)
+static int map_find( lua_State *L )
+{
+  elua_mapfile_t *pm = map_check( L );
+  size_t slen;
+  const char *s = luaL_checklstring( L, 2, &slen );
+  long init = map_index( luaL_optlong( L, 3, 1 ), pm->size );
+  u32 i;
+
+  if( init < 1 )
+    init = 1;
+  for( i = init - 1; i + slen <= pm->size; i ++ )
+    if( !memcmp( pm->data + i, s, slen ) )
+    {
+      lua_pushinteger( L, i + 1 );
+      lua_pushinteger( L, i + slen );
+      return 2;
+    }
+  lua_pushnil( L );
+  return 1;
+}
+
+// Lua: len = #map
+static int map_len( lua_State *L )
+{
+  elua_mapfile_t *pm = map_check( L );
+
+  lua_pushinteger( L, pm->size );
+  return 1;
+}
+
+#if LUA_OPTIMIZE_MEMORY > 0
+#define map_push_method( L, f )   lua_pushlightfunction( L, f )
+#else
+#define map_push_method( L, f )   lua_pushcfunction( L, f )
+#endif
+
+// Lua: byte = map[ idx ], or method = map.method
+static int map_index_func( lua_State *L )
+{
+  elua_mapfile_t *pm = map_check( L );
+  const char *key;
+  u32 idx;
+
+  if( lua_isnumber( L, 2 ) )
+  {
+    idx = luaL_checkinteger( L, 2 );
+    if( idx < 1 || idx > pm->size )
+      return 0;
+    lua_pushinteger( L, pm->data[ idx - 1 ] );
+    return 1;
+  }
+  key = luaL_checkstring( L, 2 );
+  if( !strcmp( key, "sub" ) )
+    map_push_method( L, map_sub );
+  else if( !strcmp( key, "byte" ) )
+    map_push_method( L, map_byte );
+  else if( !strcmp( key, "find" ) )
+    map_push_method( L, map_find );
+  else
+    return 0;
+  return 1;
+}
+
 // Module function map
 #define MIN_OPT_LEVEL 2
 #include "lrodefs.h"
+static const LUA_REG_TYPE elua_map_mt_map[] = 
+{
+  { LSTRKEY( "__index" ), LFUNCVAL( map_index_func ) },
+  { LSTRKEY( "__len" ), LFUNCVAL( map_len ) },
+  { LNILKEY, LNILVAL }
+};
+
 const LUA_REG_TYPE elua_map[] = 
 {
   { LSTRKEY( "egc_setup" ), LFUNCVAL( elua_egc_setup ) },
   { LSTRKEY( "version" ), LFUNCVAL( elua_version ) },  
   { LSTRKEY( "save_history" ), LFUNCVAL( elua_save_history ) },
+  { LSTRKEY( "map" ), LFUNCVAL( elua_mapfile ) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY( "EGC_NOT_ACTIVE" ), LNUMVAL( EGC_NOT_ACTIVE ) },
   { LSTRKEY( "EGC_ON_ALLOC_FAILURE" ), LNUMVAL( EGC_ON_ALLOC_FAILURE ) },
@@ -74,8 +227,12 @@ const LUA_REG_TYPE elua_map[] =
 LUALIB_API int luaopen_elua( lua_State *L )
 {
 #if LUA_OPTIMIZE_MEMORY > 0
+  luaL_rometatable( L, MAP_META_NAME, ( void* )elua_map_mt_map );
   return 0;
 #else
+  luaL_newmetatable( L, MAP_META_NAME );
+  luaL_register( L, NULL, elua_map_mt_map );
+  lua_pop( L, 1 );
   luaL_register( L, AUXLIB_ELUA, elua_map );
   MOD_REG_NUMBER( L, "EGC_NOT_ACTIVE", EGC_NOT_ACTIVE );
   MOD_REG_NUMBER( L, "EGC_ON_ALLOC_FAILURE", EGC_ON_ALLOC_FAILURE );
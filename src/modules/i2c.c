@@ -130,6 +130,75 @@ static int i2c_read( lua_State *L )
   return 1;
 }
 
+// Lua: read = i2c.transfer( id, address, [wdata], [rsize] )
+// Writes 'wdata' (a string, a table or an 8-bit number, for example a register
+// address), then reads 'rsize' bytes after a repeated START, all in a single
+// transaction. Returns the data read (an empty string if 'rsize' is 0) or nil
+// if the device doesn't acknowledge the transfer.
+static int i2c_transfer( lua_State *L )
+{
+  unsigned id = luaL_checkinteger( L, 1 );
+  u16 address = ( u16 )luaL_checkinteger( L, 2 );
+  u32 rsize = ( u32 )luaL_optinteger( L, 4, 0 );
+  platform_i2c_segment segs[ 2 ];
+  unsigned nsegs = 0;
+  const char *wdata = NULL;
+  size_t wsize = 0, i;
+  u8 numbuf, *rdata = NULL;
+  int numdata;
+  luaL_Buffer b;
+
+  MOD_CHECK_ID( i2c, id );
+  if( lua_isnumber( L, 3 ) )
+  {
+    numdata = ( int )luaL_checkinteger( L, 3 );
+    if( numdata < 0 || numdata > 255 )
+      return luaL_error( L, "numeric data can be between 0 and 255" );
+    numbuf = ( u8 )numdata;
+    wdata = ( const char* )&numbuf;
+    wsize = 1;
+  }
+  else if( lua_istable( L, 3 ) )
+  {
+    luaL_buffinit( L, &b );
+    for( i = 0; i < lua_objlen( L, 3 ); i ++ )
+    {
+      lua_rawgeti( L, 3, i + 1 );
+      numdata = luaL_checkinteger( L, -1 );
+      lua_pop( L, 1 );
+      if( numdata < 0 || numdata > 255 )
+        return luaL_error( L, "numeric data can be between 0 and 255" );
+      luaL_addchar( &b, ( char )numdata );
+    }
+    luaL_pushresult( &b );
+    wdata = lua_tolstring( L, -1, &wsize );
+  }
+  else if( !lua_isnoneornil( L, 3 ) )
+    wdata = luaL_checklstring( L, 3, &wsize );
+
+  // An empty write without a read only checks that the device is there
+  if( wdata && ( wsize > 0 || rsize == 0 ) )
+  {
+    segs[ nsegs ].data = ( u8* )wdata;
+    segs[ nsegs ].len = wsize;
+    segs[ nsegs ++ ].direction = PLATFORM_I2C_DIRECTION_TRANSMITTER;
+  }
+  if( rsize > 0 )
+  {
+    rdata = ( u8* )lua_newuserdata( L, rsize );
+    segs[ nsegs ].data = rdata;
+    segs[ nsegs ].len = rsize;
+    segs[ nsegs ++ ].direction = PLATFORM_I2C_DIRECTION_RECEIVER;
+  }
+  if( nsegs == 0 )
+    return luaL_error( L, "nothing to transfer" );
+  if( platform_i2c_transfer( id, address, segs, nsegs ) != PLATFORM_OK )
+    lua_pushnil( L );
+  else
+    lua_pushlstring( L, rsize > 0 ? ( const char* )rdata : "", rsize );
+  return 1;
+}
+
 // Module function map
 #define MIN_OPT_LEVEL   2
 #include "lrodefs.h"
@@ -141,6 +210,7 @@ const LUA_REG_TYPE i2c_map[] =
   { LSTRKEY( "address" ), LFUNCVAL( i2c_address ) },
   { LSTRKEY( "write" ), LFUNCVAL( i2c_write ) },
   { LSTRKEY( "read" ), LFUNCVAL( i2c_read ) },
+  { LSTRKEY( "transfer" ), LFUNCVAL( i2c_transfer ) },
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY( "FAST" ), LNUMVAL( PLATFORM_I2C_SPEED_FAST ) },
   { LSTRKEY( "SLOW" ), LNUMVAL( PLATFORM_I2C_SPEED_SLOW ) },
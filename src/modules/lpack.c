@@ -38,6 +38,7 @@
 #include "lauxlib.h"
 #include "auxmods.h"
 #include "lrotable.h"
+#include "sbuf.h"
 
 static void badcode(lua_State *L, int c)
 {
@@ -102,7 +103,7 @@ static void doswap(int swap, void *p, size_t n)
 static int l_unpack(lua_State *L) 		/** unpack(s,f,[init]) */
 {
  size_t len;
- const char *s=luaL_checklstring(L,1,&len);
+ const char *s=sbuf_checkdata(L,1,&len);
  const char *f=luaL_checkstring(L,2);
  int i=luaL_optnumber(L,3,1)-1;
  int n=0;
@@ -6,6 +6,7 @@
 #include "platform.h"
 #include "auxmods.h"
 #include "elua_net.h"
+#include "sbuf.h"
 #include <stdio.h>
 #include <string.h>
 #include <stddef.h>
@@ -52,15 +53,14 @@ static int net_close( lua_State* L )
   return 1;
 }
 
-// Lua: res, err = send( sock, str )
+// Lua: res, err = send( sock, str ) (str can also be a sample buffer)
 static int net_send( lua_State* L )
 {
   int sock = ( int )luaL_checkinteger( L, 1 );
   const char *buf;
   size_t len;
     
-  luaL_checktype( L, 2, LUA_TSTRING );
-  buf = lua_tolstring( L, 2, &len );
+  buf = sbuf_checkdata( L, 2, &len );
   lua_pushinteger( L, elua_net_send( sock, buf, len ) );
   lua_pushinteger( L, elua_net_get_last_err( sock ) );
   return 2;  
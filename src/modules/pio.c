@@ -363,6 +363,193 @@ static int pio_decode( lua_State *L )
   return 2;
 }
 
+// *****************************************************************************
+// Pin programs
+// A program is a sequence of port writes and delays, built once from Lua and
+// replayed by platform_pio_run with the interrupts disabled. Delays are given
+// in nanoseconds and stored in ticks of PIO_PROG_CLOCK.
+
+#ifdef BUILD_PIO_PROG
+
+#define PIO_PROG_META_NAME    "eLua.pio_prog"
+
+// Program entry types
+#define PIO_PROG_SETHIGH      0
+#define PIO_PROG_SETLOW       1
+#define PIO_PROG_SETPORT      2
+#define PIO_PROG_DELAY        3
+
+typedef struct
+{
+  u32 nsteps;
+  platform_pio_step steps[ 1 ];
+} pio_prog;
+
+static pio_prog* pioh_prog_check( lua_State *L, int idx )
+{
+  return ( pio_prog* )luaL_checkudata( L, idx, PIO_PROG_META_NAME );
+}
+
+// Helper function: translate the program entry at stack index 'idx' to steps
+// Returns the number of steps, 'psteps' is only written if not NULL
+static u32 pioh_prog_entry( lua_State *L, int idx, platform_pio_step *psteps )
+{
+  pio_prog *p;
+  int op, i, v, port, pin, n;
+  u32 nsteps = 0;
+  pio_type mask;
+  lua_Number ns;
+
+  if( lua_isuserdata( L, idx ) )
+  {
+    // Another program, copy its steps
+    p = pioh_prog_check( L, idx );
+    if( psteps )
+      memcpy( psteps, p->steps, p->nsteps * sizeof( platform_pio_step ) );
+    return p->nsteps;
+  }
+  luaL_checktype( L, idx, LUA_TTABLE );
+  n = lua_objlen( L, idx );
+  lua_rawgeti( L, idx, 1 );
+  op = luaL_checkinteger( L, -1 );
+  lua_pop( L, 1 );
+  switch( op )
+  {
+    case PIO_PROG_SETHIGH:
+    case PIO_PROG_SETLOW:
+      // One step for each port
+      pioh_clear_masks();
+      for( i = 2; i <= n; i ++ )
+      {
+        lua_rawgeti( L, idx, i );
+        v = luaL_checkinteger( L, -1 );
+        lua_pop( L, 1 );
+        port = PLATFORM_IO_GET_PORT( v );
+        pin = PLATFORM_IO_GET_PIN( v );
+        if( PLATFORM_IO_IS_PORT( v ) || !platform_pio_has_port( port ) || !platform_pio_has_pin( port, pin ) )
+          return luaL_error( L, "invalid pin" );
+        pio_masks[ port ] |= 1 << pin;
+      }
+      for( i = 0; i < PLATFORM_IO_PORTS; i ++ )
+        if( pio_masks[ i ] )
+        {
+          if( psteps )
+          {
+            psteps[ nsteps ].op = op == PIO_PROG_SETHIGH ? PLATFORM_PIO_STEP_SET : PLATFORM_PIO_STEP_CLEAR;
+            psteps[ nsteps ].port = i;
+            psteps[ nsteps ].mask = pio_masks[ i ];
+            psteps[ nsteps ].data = 0;
+          }
+          nsteps ++;
+        }
+      break;
+
+    case PIO_PROG_SETPORT:
+      // { SETPORT, port, value, [mask] }
+      lua_rawgeti( L, idx, 2 );
+      v = luaL_checkinteger( L, -1 );
+      lua_rawgeti( L, idx, 3 );
+      lua_rawgeti( L, idx, 4 );
+      port = PLATFORM_IO_GET_PORT( v );
+      if( !PLATFORM_IO_IS_PORT( v ) || !platform_pio_has_port( port ) )
+        return luaL_error( L, "invalid port" );
+      mask = lua_isnil( L, -1 ) ? PLATFORM_IO_ALL_PINS : ( pio_type )luaL_checknumber( L, -1 );
+      if( psteps )
+      {
+        psteps[ 0 ].op = PLATFORM_PIO_STEP_WRITE;
+        psteps[ 0 ].port = port;
+        psteps[ 0 ].mask = mask;
+        psteps[ 0 ].data = ( pio_type )luaL_checknumber( L, -2 );
+      }
+      lua_pop( L, 3 );
+      nsteps = 1;
+      break;
+
+    case PIO_PROG_DELAY:
+      // { DELAY, ns }
+      lua_rawgeti( L, idx, 2 );
+      ns = luaL_checknumber( L, -1 );
+      lua_pop( L, 1 );
+      if( ns < 0 )
+        return luaL_error( L, "invalid delay" );
+      if( psteps )
+      {
+        psteps[ 0 ].op = PLATFORM_PIO_STEP_DELAY;
+        psteps[ 0 ].port = 0;
+        psteps[ 0 ].mask = 0;
+        psteps[ 0 ].data = ( u32 )( ( ( u64 )ns * ( PIO_PROG_CLOCK ) + 500000000 ) / 1000000000 );
+      }
+      nsteps = 1;
+      break;
+
+    default:
+      return luaL_error( L, "invalid program entry" );
+  }
+  return nsteps;
+}
+
+// Lua: prog = pio.prog.new( entry1, [entry2], ..., [entryn] )
+// Each entry is a table ( { pio.prog.SETHIGH, pin1, ..., pinn },
+// { pio.prog.SETLOW, pin1, ..., pinn }, { pio.prog.SETPORT, port, value, [mask] }
+// or { pio.prog.DELAY, ns } ) or another program
+static int pio_prog_new( lua_State *L )
+{
+  int total = lua_gettop( L );
+  u32 nsteps = 0;
+  pio_prog *p;
+  int i;
+
+  for( i = 1; i <= total; i ++ )
+    nsteps += pioh_prog_entry( L, i, NULL );
+  p = ( pio_prog* )lua_newuserdata( L, sizeof( pio_prog ) + ( nsteps ? nsteps - 1 : 0 ) * sizeof( platform_pio_step ) );
+  p->nsteps = 0;
+  for( i = 1; i <= total; i ++ )
+    p->nsteps += pioh_prog_entry( L, i, p->steps + p->nsteps );
+  luaL_getmetatable( L, PIO_PROG_META_NAME );
+  lua_setmetatable( L, -2 );
+  return 1;
+}
+
+// Lua: pio.prog.run( prog, [count] )
+static int pio_prog_run( lua_State *L )
+{
+  pio_prog *p = pioh_prog_check( L, 1 );
+  u32 count = ( u32 )luaL_optinteger( L, 2, 1 );
+  int old_status;
+
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  while( count -- )
+    platform_pio_run( p->steps, p->nsteps );
+  platform_cpu_set_global_interrupts( old_status );
+  return 0;
+}
+
+// Lua: pio.prog.send( prog0, prog1, data, [nbits] )
+// Runs 'prog0' for each 0 bit and 'prog1' for each 1 bit of 'data' (MSB first)
+static int pio_prog_send( lua_State *L )
+{
+  pio_prog *p0 = pioh_prog_check( L, 1 );
+  pio_prog *p1 = pioh_prog_check( L, 2 );
+  size_t len;
+  const u8 *data = ( const u8* )luaL_checklstring( L, 3, &len );
+  u32 nbits = ( u32 )luaL_optinteger( L, 4, len * 8 ), i;
+  const pio_prog *p;
+  int old_status;
+
+  if( nbits > len * 8 )
+    return luaL_error( L, "not enough data" );
+  old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  for( i = 0; i < nbits; i ++ )
+  {
+    p = ( data[ i >> 3 ] & ( 0x80 >> ( i & 7 ) ) ) ? p1 : p0;
+    platform_pio_run( p->steps, p->nsteps );
+  }
+  platform_cpu_set_global_interrupts( old_status );
+  return 0;
+}
+
+#endif // #ifdef BUILD_PIO_PROG
+
 // *****************************************************************************
 // Pin function map
 
@@ -390,11 +577,39 @@ static const LUA_REG_TYPE pio_port_map[] =
   { LNILKEY, LNILVAL }
 };
 
+#ifdef BUILD_PIO_PROG
+static const LUA_REG_TYPE pio_prog_map[] =
+{
+  { LSTRKEY( "new" ), LFUNCVAL( pio_prog_new ) },
+  { LSTRKEY( "run" ), LFUNCVAL( pio_prog_run ) },
+  { LSTRKEY( "send" ), LFUNCVAL( pio_prog_send ) },
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "SETHIGH" ), LNUMVAL( PIO_PROG_SETHIGH ) },
+  { LSTRKEY( "SETLOW" ), LNUMVAL( PIO_PROG_SETLOW ) },
+  { LSTRKEY( "SETPORT" ), LNUMVAL( PIO_PROG_SETPORT ) },
+  { LSTRKEY( "DELAY" ), LNUMVAL( PIO_PROG_DELAY ) },
+#endif
+  { LNILKEY, LNILVAL }
+};
+
+#if LUA_OPTIMIZE_MEMORY > 0
+// Metatable of the programs ( prog:run() is the same as pio.prog.run( prog ) )
+static const LUA_REG_TYPE pio_prog_mt_map[] =
+{
+  { LSTRKEY( "__index" ), LROVAL( pio_prog_map ) },
+  { LNILKEY, LNILVAL }
+};
+#endif
+#endif // #ifdef BUILD_PIO_PROG
+
 const LUA_REG_TYPE pio_map[] =
 {
 #if LUA_OPTIMIZE_MEMORY > 0
   { LSTRKEY( "pin" ), LROVAL( pio_pin_map ) },
   { LSTRKEY( "port" ), LROVAL( pio_port_map ) },
+#ifdef BUILD_PIO_PROG
+  { LSTRKEY( "prog" ), LROVAL( pio_prog_map ) },
+#endif
   { LSTRKEY( "decode" ), LFUNCVAL( pio_decode ) },  
   { LSTRKEY( "INPUT" ), LNUMVAL( PIO_DIR_INPUT ) },
   { LSTRKEY( "OUTPUT" ), LNUMVAL( PIO_DIR_OUTPUT ) },
@@ -410,8 +625,14 @@ const LUA_REG_TYPE pio_map[] =
 LUALIB_API int luaopen_pio( lua_State *L )
 {
 #if LUA_OPTIMIZE_MEMORY > 0
+#ifdef BUILD_PIO_PROG
+  luaL_rometatable( L, PIO_PROG_META_NAME, ( void* )pio_prog_mt_map );
+#endif
   return 0;
 #else // #if LUA_OPTIMIZE_MEMORY > 0
+#ifdef BUILD_PIO_PROG
+  luaL_newmetatable( L, PIO_PROG_META_NAME );
+#endif
   luaL_register( L, AUXLIB_PIO, pio_map );
 
   // Set it as its own metatable
@@ -434,6 +655,19 @@ LUALIB_API int luaopen_pio( lua_State *L )
   luaL_register( L, NULL, pio_port_map );
   lua_setfield( L, -2, "port" );
 
+#ifdef BUILD_PIO_PROG
+  lua_newtable( L );
+  luaL_register( L, NULL, pio_prog_map );
+  MOD_REG_NUMBER( L, "SETHIGH", PIO_PROG_SETHIGH );
+  MOD_REG_NUMBER( L, "SETLOW", PIO_PROG_SETLOW );
+  MOD_REG_NUMBER( L, "SETPORT", PIO_PROG_SETPORT );
+  MOD_REG_NUMBER( L, "DELAY", PIO_PROG_DELAY );
+  // The program methods are the functions in pio.prog
+  lua_pushvalue( L, -1 );
+  lua_setfield( L, -4, "__index" );
+  lua_setfield( L, -2, "prog" );
+#endif
+
   return 1;
 #endif // #if LUA_OPTIMIZE_MEMORY > 0
 }
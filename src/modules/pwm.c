@@ -6,6 +6,8 @@
 #include "platform.h"
 #include "auxmods.h"
 #include "lrotable.h"
+#include "platform_conf.h"
+#include "sbuf.h"
 
 // Lua: realfrequency = setup( id, frequency, duty )
 static int pwm_setup( lua_State* L )
@@ -73,6 +75,83 @@ static int pwm_getclock( lua_State* L )
   return 1;
 }
 
+#ifdef BUILD_PWM_SEQ
+// Lua: realrate = seqstart( id, duties, rate, [mode] )
+// 'duties' is a U16 sample buffer or a table with the duty values (0 to
+// pwm.SEQ_MAX), 'mode' is pwm.ONESHOT (default) or pwm.LOOP
+static int pwm_seqstart( lua_State* L )
+{
+  unsigned id;
+  u32 count, rate, i;
+  int mode;
+  sbuf_t *pbuf;
+  u16 *duty;
+  lua_Number v;
+
+  id = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( pwm, id );
+  rate = luaL_checkinteger( L, 3 );
+  mode = luaL_optinteger( L, 4, PLATFORM_PWM_SEQ_ONESHOT );
+  if( mode != PLATFORM_PWM_SEQ_ONESHOT && mode != PLATFORM_PWM_SEQ_LOOP )
+    return luaL_error( L, "invalid mode" );
+  if( lua_istable( L, 2 ) )
+  {
+    count = lua_objlen( L, 2 );
+    duty = ( u16* )lua_newuserdata( L, count * sizeof( u16 ) );
+    for( i = 0; i < count; i ++ )
+    {
+      lua_rawgeti( L, 2, i + 1 );
+      v = luaL_checknumber( L, -1 );
+      lua_pop( L, 1 );
+      if( v < 0 || v > PLATFORM_PWM_SEQ_DUTY_MAX )
+        return luaL_error( L, "invalid duty value" );
+      duty[ i ] = ( u16 )v;
+    }
+  }
+  else
+  {
+    pbuf = sbuf_check( L, 2 );
+    if( pbuf->type != SBUF_TYPE_U16 )
+      return luaL_error( L, "U16 buffer expected" );
+    count = pbuf->count;
+    duty = ( u16* )pbuf->data;
+    for( i = 0; i < count; i ++ )
+      if( duty[ i ] > PLATFORM_PWM_SEQ_DUTY_MAX )
+        return luaL_error( L, "invalid duty value" );
+  }
+  if( count == 0 )
+    return luaL_error( L, "empty sequence" );
+  if( ( rate = platform_pwm_seq_start( id, duty, count, rate, mode ) ) == 0 )
+    return luaL_error( L, "unable to start the sequence" );
+  lua_pushinteger( L, rate );
+  return 1;
+}
+
+// Lua: seqstop( id )
+static int pwm_seqstop( lua_State* L )
+{
+  unsigned id;
+
+  id = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( pwm, id );
+  platform_pwm_seq_stop( id );
+  return 0;
+}
+
+// Lua: playing, passes = seqstatus( id )
+static int pwm_seqstatus( lua_State* L )
+{
+  unsigned id;
+  u32 passes;
+
+  id = luaL_checkinteger( L, 1 );
+  MOD_CHECK_ID( pwm, id );
+  lua_pushboolean( L, platform_pwm_seq_get_status( id, &passes ) );
+  lua_pushinteger( L, passes );
+  return 2;
+}
+#endif // #ifdef BUILD_PWM_SEQ
+
 // Module function map
 #define MIN_OPT_LEVEL 2
 #include "lrodefs.h"
@@ -83,10 +162,30 @@ const LUA_REG_TYPE pwm_map[] =
   { LSTRKEY( "stop" ), LFUNCVAL( pwm_stop ) },
   { LSTRKEY( "setclock" ), LFUNCVAL( pwm_setclock ) },
   { LSTRKEY( "getclock" ), LFUNCVAL( pwm_getclock ) },
+#ifdef BUILD_PWM_SEQ
+  { LSTRKEY( "seqstart" ), LFUNCVAL( pwm_seqstart ) },
+  { LSTRKEY( "seqstop" ), LFUNCVAL( pwm_seqstop ) },
+  { LSTRKEY( "seqstatus" ), LFUNCVAL( pwm_seqstatus ) },
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "ONESHOT" ), LNUMVAL( PLATFORM_PWM_SEQ_ONESHOT ) },
+  { LSTRKEY( "LOOP" ), LNUMVAL( PLATFORM_PWM_SEQ_LOOP ) },
+  { LSTRKEY( "SEQ_MAX" ), LNUMVAL( PLATFORM_PWM_SEQ_DUTY_MAX ) },
+#endif
+#endif
   { LNILKEY, LNILVAL }
 };
 
 LUALIB_API int luaopen_pwm( lua_State *L )
 {
-  LREGISTER( L, AUXLIB_PWM, pwm_map );
+#if LUA_OPTIMIZE_MEMORY > 0
+  return 0;
+#else // #if LUA_OPTIMIZE_MEMORY > 0
+  luaL_register( L, AUXLIB_PWM, pwm_map );
+#ifdef BUILD_PWM_SEQ
+  MOD_REG_NUMBER( L, "ONESHOT", PLATFORM_PWM_SEQ_ONESHOT );
+  MOD_REG_NUMBER( L, "LOOP", PLATFORM_PWM_SEQ_LOOP );
+  MOD_REG_NUMBER( L, "SEQ_MAX", PLATFORM_PWM_SEQ_DUTY_MAX );
+#endif
+  return 1;
+#endif // #if LUA_OPTIMIZE_MEMORY > 0
 }
@@ -0,0 +1,305 @@
+// Module that implements packed sample buffers (fixed size arrays of
+// u16/s16/u32/float elements)
+
+#include "lua.h"
+#include "lualib.h"
+#include "lauxlib.h"
+#include "type.h"
+#include "auxmods.h"
+#include "lrotable.h"
+#include "sbuf.h"
+#include <string.h>
+
+#define META_NAME                 "eLua.sbuf"
+#define sbuf_check_arg( L )       sbuf_check( L, 1 )
+
+// Size in bytes of each element type
+static const u8 sbuf_elsize[ SBUF_TYPE_TOTAL ] = { 2, 2, 4, 4 };
+
+// *****************************************************************************
+// C interface
+
+sbuf_t* sbuf_new( lua_State *L, int type, u32 count )
+{
+  sbuf_t *p;
+
+  if( type < 0 || type >= SBUF_TYPE_TOTAL )
+    luaL_error( L, "invalid element type." );
+  if( count > ( ( u32 )-1 - sizeof( sbuf_t ) ) / sbuf_elsize[ type ] )
+    luaL_error( L, "buffer too large." );
+  p = ( sbuf_t* )lua_newuserdata( L, sizeof( sbuf_t ) - sizeof( u32 ) + count * sbuf_elsize[ type ] );
+  p->count = count;
+  p->type = type;
+  p->elsize = sbuf_elsize[ type ];
+  luaL_getmetatable( L, META_NAME );
+  lua_setmetatable( L, -2 );
+  return p;
+}
+
+sbuf_t* sbuf_check( lua_State *L, int idx )
+{
+  return ( sbuf_t* )luaL_checkudata( L, idx, META_NAME );
+}
+
+sbuf_t* sbuf_test( lua_State *L, int idx )
+{
+  void *p = lua_touserdata( L, idx );
+  int res = 0;
+
+  if( p != NULL && lua_getmetatable( L, idx ) )
+  {
+    lua_getfield( L, LUA_REGISTRYINDEX, META_NAME );
+    res = lua_rawequal( L, -1, -2 );
+    lua_pop( L, 2 );
+  }
+  return res ? ( sbuf_t* )p : NULL;
+}
+
+const char* sbuf_checkdata( lua_State *L, int idx, size_t *plen )
+{
+  sbuf_t *p;
+
+  if( lua_type( L, idx ) == LUA_TSTRING )
+    return lua_tolstring( L, idx, plen );
+  if( ( p = sbuf_test( L, idx ) ) == NULL )
+    luaL_typerror( L, idx, "string or sbuf" );
+  *plen = SBUF_BYTES( p );
+  return ( const char* )p->data;
+}
+
+u32 sbuf_checkrange( lua_State *L, const sbuf_t *p, int argn, u32 *pstart )
+{
+  long start = luaL_optlong( L, argn, 1 );
+  long end = luaL_optlong( L, argn + 1, -1 );
+
+  if( start < 0 )
+    start += ( long )p->count + 1;
+  if( end < 0 )
+    end += ( long )p->count + 1;
+  if( start < 1 )
+    start = 1;
+  if( end > ( long )p->count )
+    end = p->count;
+  *pstart = start - 1;
+  return start <= end ? end - start + 1 : 0;
+}
+
+// *****************************************************************************
+// Helpers
+
+// Get the element at the given index (0 based) and push it on the stack
+static void sbuf_pushval( lua_State *L, const sbuf_t *p, u32 idx )
+{
+  switch( p->type )
+  {
+    case SBUF_TYPE_U16:
+      lua_pushinteger( L, ( ( const u16* )p->data )[ idx ] );
+      break;
+
+    case SBUF_TYPE_S16:
+      lua_pushinteger( L, ( ( const s16* )p->data )[ idx ] );
+      break;
+
+    case SBUF_TYPE_U32:
+      lua_pushnumber( L, ( lua_Number )( ( const u32* )p->data )[ idx ] );
+      break;
+
+    default:
+      lua_pushnumber( L, ( lua_Number )( ( const float* )p->data )[ idx ] );
+      break;
+  }
+}
+
+// Set the element at the given index (0 based)
+static void sbuf_setval( sbuf_t *p, u32 idx, lua_Number v )
+{
+  switch( p->type )
+  {
+    case SBUF_TYPE_U16:
+      ( ( u16* )p->data )[ idx ] = ( u16 )( s32 )v;
+      break;
+
+    case SBUF_TYPE_S16:
+      ( ( s16* )p->data )[ idx ] = ( s16 )( s32 )v;
+      break;
+
+    case SBUF_TYPE_U32:
+      ( ( u32* )p->data )[ idx ] = v < 0 ? ( u32 )( s32 )v : ( u32 )v;
+      break;
+
+    default:
+      ( ( float* )p->data )[ idx ] = ( float )v;
+      break;
+  }
+}
+
+// *****************************************************************************
+// Lua interface
+
+// Lua: buf = sbuf.new( count, [type], [fill] ), or
+//      buf = sbuf.new( "string", [type] ), or
+//      buf = sbuf.new( table, [type] )
+static int sbuf_lnew( lua_State *L )
+{
+  int type = luaL_optinteger( L, 2, SBUF_TYPE_U16 );
+  sbuf_t *p;
+  const char *s;
+  size_t len;
+  u32 i;
+
+  if( type < 0 || type >= SBUF_TYPE_TOTAL )
+    return luaL_error( L, "invalid element type." );
+  if( lua_type( L, 1 ) == LUA_TNUMBER )
+  {
+    p = sbuf_new( L, type, luaL_checkinteger( L, 1 ) );
+    if( lua_isnumber( L, 3 ) )
+      for( i = 0; i < p->count; i ++ )
+        sbuf_setval( p, i, lua_tonumber( L, 3 ) );
+    else
+      memset( p->data, 0, SBUF_BYTES( p ) );
+  }
+  else if( lua_type( L, 1 ) == LUA_TSTRING )
+  {
+    s = lua_tolstring( L, 1, &len );
+    if( len % sbuf_elsize[ type ] )
+      return luaL_error( L, "length is not a multiple of element size." );
+    p = sbuf_new( L, type, len / sbuf_elsize[ type ] );
+    memcpy( p->data, s, len );
+  }
+  else if( lua_istable( L, 1 ) )
+  {
+    p = sbuf_new( L, type, lua_objlen( L, 1 ) );
+    for( i = 0; i < p->count; i ++ )
+    {
+      lua_rawgeti( L, 1, i + 1 );
+      sbuf_setval( p, i, lua_tonumber( L, -1 ) );
+      lua_pop( L, 1 );
+    }
+  }
+  else
+    return luaL_error( L, "invalid arguments." );
+  return 1;
+}
+
+// Lua: value = buf[ idx ]
+static int sbuf_get( lua_State *L )
+{
+  sbuf_t *p = sbuf_check_arg( L );
+  u32 idx = luaL_checkinteger( L, 2 );
+
+  if( idx <= 0 || idx > p->count )
+    return luaL_error( L, "invalid index." );
+  sbuf_pushval( L, p, idx - 1 );
+  return 1;
+}
+
+// Lua: buf[ idx ] = value
+static int sbuf_set( lua_State *L )
+{
+  sbuf_t *p = sbuf_check_arg( L );
+  u32 idx = luaL_checkinteger( L, 2 );
+
+  if( idx <= 0 || idx > p->count )
+    return luaL_error( L, "invalid index." );
+  sbuf_setval( p, idx - 1, luaL_checknumber( L, 3 ) );
+  return 0;
+}
+
+// Lua: size = #buf
+static int sbuf_len( lua_State *L )
+{
+  sbuf_t *p = sbuf_check_arg( L );
+
+  lua_pushinteger( L, p->count );
+  return 1;
+}
+
+// Lua: newbuf = sbuf.sub( buf, [i], [j] ) (copy of the elements from i to j)
+static int sbuf_sub( lua_State *L )
+{
+  sbuf_t *p = sbuf_check_arg( L ), *pnew;
+  u32 start, count = sbuf_checkrange( L, p, 2, &start );
+
+  pnew = sbuf_new( L, p->type, count );
+  memcpy( pnew->data, ( const u8* )p->data + start * p->elsize, count * p->elsize );
+  return 1;
+}
+
+// Lua: string = sbuf.tostring( buf, [i], [j] ) (binary data in the native
+// byte order of the CPU)
+static int sbuf_tostring( lua_State *L )
+{
+  sbuf_t *p = sbuf_check_arg( L );
+  u32 start, count = sbuf_checkrange( L, p, 2, &start );
+
+  lua_pushlstring( L, ( const char* )p->data + start * p->elsize, count * p->elsize );
+  return 1;
+}
+
+// Lua: table = sbuf.totable( buf, [i], [j] )
+static int sbuf_totable( lua_State *L )
+{
+  sbuf_t *p = sbuf_check_arg( L );
+  u32 start, i, count = sbuf_checkrange( L, p, 2, &start );
+
+  lua_createtable( L, count, 0 );
+  for( i = 0; i < count; i ++ )
+  {
+    sbuf_pushval( L, p, start + i );
+    lua_rawseti( L, -2, i + 1 );
+  }
+  return 1;
+}
+
+// Lua: type = sbuf.type( buf )
+static int sbuf_type( lua_State *L )
+{
+  sbuf_t *p = sbuf_check_arg( L );
+
+  lua_pushinteger( L, p->type );
+  return 1;
+}
+
+// Module function map
+#define MIN_OPT_LEVEL 2
+#include "lrodefs.h"
+const LUA_REG_TYPE sbuf_map[] =
+{
+  { LSTRKEY( "new" ), LFUNCVAL( sbuf_lnew ) },
+  { LSTRKEY( "sub" ), LFUNCVAL( sbuf_sub ) },
+  { LSTRKEY( "tostring" ), LFUNCVAL( sbuf_tostring ) },
+  { LSTRKEY( "totable" ), LFUNCVAL( sbuf_totable ) },
+  { LSTRKEY( "type" ), LFUNCVAL( sbuf_type ) },
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "U16" ), LNUMVAL( SBUF_TYPE_U16 ) },
+  { LSTRKEY( "S16" ), LNUMVAL( SBUF_TYPE_S16 ) },
+  { LSTRKEY( "U32" ), LNUMVAL( SBUF_TYPE_U32 ) },
+  { LSTRKEY( "FLOAT" ), LNUMVAL( SBUF_TYPE_FLOAT ) },
+#endif
+  { LNILKEY, LNILVAL }
+};
+
+static const LUA_REG_TYPE sbuf_mt_map[] =
+{
+  { LSTRKEY( "__index" ), LFUNCVAL( sbuf_get ) },
+  { LSTRKEY( "__newindex" ), LFUNCVAL( sbuf_set ) },
+  { LSTRKEY( "__len" ), LFUNCVAL( sbuf_len ) },
+  { LNILKEY, LNILVAL }
+};
+
+LUALIB_API int luaopen_sbuf( lua_State* L )
+{
+#if LUA_OPTIMIZE_MEMORY > 0
+  luaL_rometatable( L, META_NAME, ( void* )sbuf_mt_map );
+  return 0;
+#else // #if LUA_OPTIMIZE_MEMORY > 0
+  luaL_newmetatable( L, META_NAME );
+  luaL_register( L, NULL, sbuf_mt_map );
+  luaL_register( L, AUXLIB_SBUF, sbuf_map );
+  MOD_REG_NUMBER( L, "U16", SBUF_TYPE_U16 );
+  MOD_REG_NUMBER( L, "S16", SBUF_TYPE_S16 );
+  MOD_REG_NUMBER( L, "U32", SBUF_TYPE_U32 );
+  MOD_REG_NUMBER( L, "FLOAT", SBUF_TYPE_FLOAT );
+  return 1;
+#endif // #if LUA_OPTIMIZE_MEMORY > 0
+}
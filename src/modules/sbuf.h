@@ -0,0 +1,47 @@
+// Packed sample buffers (the C interface of the 'sbuf' module)
+// A sample buffer is a fixed size userdata that keeps its elements in a C
+// array, so modules can fill it or send it without going through Lua values.
+
+#ifndef __SBUF_H__
+#define __SBUF_H__
+
+#include "lua.h"
+#include "type.h"
+#include <stddef.h>
+
+// Element types
+enum
+{
+  SBUF_TYPE_U16,
+  SBUF_TYPE_S16,
+  SBUF_TYPE_U32,
+  SBUF_TYPE_FLOAT,
+  SBUF_TYPE_TOTAL
+};
+
+typedef struct
+{
+  u32 count;                // number of elements
+  u8 type;                  // element type (SBUF_TYPE_xxx)
+  u8 elsize;                // size of an element in bytes
+  u32 data[ 1 ];            // the elements (declared as u32 for alignment)
+} sbuf_t;
+
+#define SBUF_BYTES( p )     ( ( p )->count * ( p )->elsize )
+
+// Push a new buffer on the stack (the elements are not initialized)
+sbuf_t* sbuf_new( lua_State *L, int type, u32 count );
+// Return the buffer at the given stack index (error if it's not a buffer)
+sbuf_t* sbuf_check( lua_State *L, int idx );
+// Return the buffer at the given stack index or NULL if it's not a buffer
+sbuf_t* sbuf_test( lua_State *L, int idx );
+// Return the data of a string or a buffer at the given stack index (for
+// functions that send raw data) and its length in bytes
+const char* sbuf_checkdata( lua_State *L, int idx, size_t *plen );
+// Get a ( start, end ) range of elements from the arguments at 'argn' and
+// 'argn + 1' (string.sub style indexes, negative values count from the end,
+// defaults to the whole buffer). Returns the number of elements in the range
+// and its first element (0 based) in 'pstart'
+u32 sbuf_checkrange( lua_State *L, const sbuf_t *p, int argn, u32 *pstart );
+
+#endif
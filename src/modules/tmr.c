@@ -121,6 +121,34 @@ static int tmr_getclock( lua_State* L )
   return 1;
 }
 
+#ifdef TIMEBASE_CLOCK
+// Lua: count = cycles()
+// Returns the value of the system timebase (usually the CPU cycle counter)
+static int tmr_cycles( lua_State* L )
+{
+  lua_pushnumber( L, ( lua_Number )platform_timebase_read() );
+  return 1;
+}
+
+// Lua: time_us = elapsed( start, [end] )
+// Returns the time between two values returned by cycles() ('end' is the
+// current value of the timebase if not specified)
+static int tmr_elapsed( lua_State* L )
+{
+  lua_Number start, end;
+
+  end = lua_isnoneornil( L, 2 ) ? ( lua_Number )platform_timebase_read() : luaL_checknumber( L, 2 );
+  start = luaL_checknumber( L, 1 );
+#ifdef LUA_NUMBER_INTEGRAL
+  // Only the low 32 bits of the timebase are kept in this case
+  lua_pushinteger( L, ( u32 )( ( u64 )( ( u32 )end - ( u32 )start ) * 1000000 / TIMEBASE_CLOCK ) );
+#else
+  lua_pushnumber( L, ( end - start ) * 1000000 / TIMEBASE_CLOCK );
+#endif
+  return 1;
+}
+#endif // #ifdef TIMEBASE_CLOCK
+
 #ifdef BUILD_LUA_INT_HANDLERS
 // Lua: set_match_int( id, timeout, type )
 static int tmr_set_match_int( lua_State *L )
@@ -175,6 +203,10 @@ const LUA_REG_TYPE tmr_map[] =
   { LSTRKEY( "getmaxdelay" ), LFUNCVAL( tmr_getmaxdelay ) },
   { LSTRKEY( "setclock" ), LFUNCVAL( tmr_setclock ) },
   { LSTRKEY( "getclock" ), LFUNCVAL( tmr_getclock ) },
+#ifdef TIMEBASE_CLOCK
+  { LSTRKEY( "cycles" ), LFUNCVAL( tmr_cycles ) },
+  { LSTRKEY( "elapsed" ), LFUNCVAL( tmr_elapsed ) },
+#endif
 #ifdef BUILD_LUA_INT_HANDLERS
   { LSTRKEY( "set_match_int" ), LFUNCVAL( tmr_set_match_int ) },
 #endif  
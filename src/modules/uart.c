@@ -8,6 +8,7 @@
 #include "lrotable.h"
 #include "common.h"
 #include "sermux.h"
+#include "sbuf.h"
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
@@ -41,7 +42,7 @@ static int uart_setup( lua_State* L )
   return 1;
 }
 
-// Lua: write( id, string1, [string2], ..., [stringn] )
+// Lua: write( id, string1, [string2], ..., [stringn] ) (strings can also be sample buffers)
 static int uart_write( lua_State* L )
 {
   int id;
@@ -62,8 +63,7 @@ static int uart_write( lua_State* L )
     }
     else
     {
-      luaL_checktype( L, s, LUA_TSTRING );
-      buf = lua_tolstring( L, s, &len );
+      buf = sbuf_checkdata( L, s, &len );
       for( i = 0; i < len; i ++ )
         platform_uart_send( id, buf[ i ] );
     }
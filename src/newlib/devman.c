@@ -1,6 +1,7 @@
 // Device manager interface for Newlib (stubs and additional IOCTL implementation)
 
 #include <string.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <fcntl.h>
 #include <reent.h>
@@ -14,24 +15,97 @@
 static const DM_DEVICE* dm_list[ DM_MAX_DEVICES ];           // list of devices
 static int dm_num_devs;                               // number of devices
 
+// Device name hash table (open addressing), each entry is a device index + 1 (0 for empty)
+#define DM_HASH_SIZE          ( DM_MAX_DEVICES * 2 )
+static u8 dm_hash[ DM_HASH_SIZE ];
+
+// File descriptor table
+// Entries 0, 1 and 2 are stdin, stdout and stderr (handled by the std device)
+#ifndef DM_MAX_FILES
+#define DM_MAX_FILES          8
+#endif
+
+// Size of the read buffer of each file (0 to disable buffering)
+#ifndef DM_FILE_BUFFER_SIZE
+#define DM_FILE_BUFFER_SIZE   512
+#endif
+
+typedef struct
+{
+  s8 devid;                   // device ID (-1 if the entry is not used)
+  u8 buffered;                // 1 if the file can be buffered
+  u16 pos, len;               // read position and amount of data in buffer
+  int fd;                     // descriptor returned by the device
+  u8 *buf;                    // read buffer (allocated on the first small read)
+} DM_FILE;
+
+#define fsmin( x , y ) ( ( x ) < ( y ) ? ( x ) : ( y ) )
+
+static DM_FILE *dm_files;
+static unsigned dm_max_files;
+
 // "Shared" variables: these can be used by any FS that implements 'ls' via opendir/readdir/closedir
 struct dm_dirent dm_shared_dirent;
 char dm_shared_fname[ DM_MAX_FNAME_LENGTH + 1 ];
 
+// Helper: hash the device part of a name ( '/<device>/...' ), returns the hash
+// and the length of the device part (including the first '/')
+static unsigned dm_hash_name( const char *name, unsigned *plen )
+{
+  const char *p = name + 1;
+  unsigned h = 0;
+
+  while( *p && *p != '/' )
+    h = h * 33 + tolower( ( unsigned char )*p ++ );
+  *plen = p - name;
+  return h;
+}
+
+// Helper: rebuild the device name hash table
+static void dm_hash_rebuild()
+{
+  unsigned i, h, len;
+
+  memset( dm_hash, 0, sizeof( dm_hash ) );
+  for( i = 0; i < dm_num_devs; i ++ )
+  {
+    h = dm_hash_name( dm_list[ i ]->name, &len ) % DM_HASH_SIZE;
+    while( dm_hash[ h ] )
+      h = ( h + 1 ) % DM_HASH_SIZE;
+    dm_hash[ h ] = i + 1;
+  }
+}
+
+// Helper: find a device given the first 'len' chars of a name
+static int dm_hash_find( const char *name, unsigned h, unsigned len )
+{
+  unsigned id;
+  const char *devname;
+
+  h %= DM_HASH_SIZE;
+  while( ( id = dm_hash[ h ] ) != 0 )
+  {
+    devname = dm_list[ id - 1 ]->name;
+    if( strlen( devname ) == len && !strncasecmp( devname, name, len ) )
+      return id - 1;
+    h = ( h + 1 ) % DM_HASH_SIZE;
+  }
+  return DM_ERR_NO_DEVICE;
+}
+
 // Register a device
 // Returns the index of the device in the device table
 int dm_register( const DM_DEVICE *pdev )
 {
-  int i;
-  
+  unsigned len;
+
   // First char of the name must be '/'
   if( pdev == NULL || pdev->name == NULL || *pdev->name != '/' || strlen( pdev->name ) > DM_MAX_DEV_NAME )
     return DM_ERR_INVALID_NAME;
   
   // Check if the device is not already registered
-  for( i = 0; i < dm_num_devs; i ++ )
-    if( !strcasecmp( pdev->name, dm_list[ i ]->name ) )
-      return DM_ERR_ALREADY_REGISTERED;
+  if( dm_hash_find( pdev->name, dm_hash_name( pdev->name, &len ), strlen( pdev->name ) ) != DM_ERR_NO_DEVICE )
+    return DM_ERR_ALREADY_REGISTERED;
   
   // Check for space
   if( dm_num_devs == DM_MAX_DEVICES )
@@ -39,29 +113,51 @@ int dm_register( const DM_DEVICE *pdev )
     
   // Register it now
   dm_list[ dm_num_devs ++ ] = pdev;
+  dm_hash_rebuild();
   return dm_num_devs - 1;
 }
 
-// Helper: get a device ID from its name
+// Helper: get a device ID from its name ('/<device>' or '/<device>/...')
 // Also return a pointer to the remaining part of the name as side effect
 static int dm_device_id_from_name( const char* name, const char **rest )
 {
-  unsigned i, pos;
-  unsigned matchlen = 0;
+  unsigned h, len;
+  int id;
 
   if( rest )
     *rest = NULL;
-  for( i = pos = 0; i < dm_num_devs; i ++ )
-    if( !strncasecmp( name, dm_list[ i ]->name, strlen( dm_list[ i ]->name ) ) && strlen( dm_list[ i ]->name ) > matchlen )
-    {
-      matchlen = strlen( dm_list[ i ]->name );
-      pos = i;
-    }
-  if( matchlen == 0 )
+  if( name == NULL || *name != '/' )
+    return DM_ERR_NO_DEVICE;
+  h = dm_hash_name( name, &len );
+  if( ( id = dm_hash_find( name, h, len ) ) == DM_ERR_NO_DEVICE )
     return DM_ERR_NO_DEVICE;
   if( rest )
-    *rest = name + strlen( dm_list[ pos ]->name );
-  return pos;
+    *rest = name + len;
+  return id;
+}
+
+// Get the device of a file name and the name of the file on the device
+// ('/<device>/<file>' or '/<file>' if a '/' device is registered)
+// Returns the device ID or DM_ERR_NO_DEVICE
+int dm_get_device_id( const char *name, const char **pactname )
+{
+  const char *rest;
+  int id;
+
+  if( name == NULL || *name != '/' )
+    return DM_ERR_NO_DEVICE;
+  if( strchr( name + 1, '/' ) == NULL )
+  {
+    // This shortcut allows to register the "/" filesystem and use it like "/file.ext"
+    id = dm_hash_find( "/", 0, 1 );
+    rest = name;
+  }
+  else
+    id = dm_device_id_from_name( name, &rest );
+  if( id == DM_ERR_NO_DEVICE || rest[ 1 ] == '\0' )
+    return DM_ERR_NO_DEVICE;
+  *pactname = rest + 1;
+  return id;
 }
 
 // Unregister a device
@@ -82,8 +178,9 @@ int dm_unregister( const char* name )
   
   // Remove it
   if( i != dm_num_devs - 1 )
-    memmove( dm_list + i, dm_list + i + 1, sizeof( DM_DEVICE* ) );
+    memmove( dm_list + i, dm_list + i + 1, ( dm_num_devs - i - 1 ) * sizeof( DM_DEVICE* ) );
   dm_num_devs --;
+  dm_hash_rebuild();
   return DM_OK;
 }
 
@@ -101,18 +198,245 @@ int dm_get_num_devices()
   return dm_num_devs;
 }
 
+// Set the size of the file descriptor table (including stdin/stdout/stderr). The
+// table can't be made smaller than the highest descriptor in use.
+// Returns DM_OK or DM_ERR_NO_SPACE.
+int dm_set_max_files( unsigned n )
+{
+  DM_FILE *pnew;
+  unsigned i;
+
+  if( n < DM_STDERR_NUM + 1 )
+    return DM_ERR_NO_SPACE;
+  for( i = n; i < dm_max_files; i ++ )
+    if( dm_files[ i ].devid != -1 )
+      return DM_ERR_NO_SPACE;
+  if( ( pnew = ( DM_FILE* )realloc( dm_files, n * sizeof( DM_FILE ) ) ) == NULL )
+    return DM_ERR_NO_SPACE;
+  for( i = dm_max_files; i < n; i ++ )
+  {
+    pnew[ i ].devid = -1;
+    pnew[ i ].buf = NULL;
+  }
+  dm_files = pnew;
+  dm_max_files = n;
+  return DM_OK;
+}
+
+// Returns the size of the file descriptor table
+unsigned dm_get_max_files()
+{
+  return dm_max_files;
+}
+
 // Initialize device manager
 // This initializes the standard descriptors (stdin, stdout, stderr)
 // At this point it is assumed that the std device (usually UART) is already initialized
 int dm_init() 
 {
-  dm_register( std_get_desc() );
+  int i, id = dm_register( std_get_desc() );
+
+  dm_set_max_files( DM_MAX_FILES );
+  for( i = DM_STDIN_NUM; i <= DM_STDERR_NUM; i ++ )
+    if( id >= 0 )
+    {
+      dm_files[ i ].devid = id;
+      dm_files[ i ].fd = i;
+      dm_files[ i ].buffered = 0;
+    }
 #ifndef BUILD_CON_TCP         // we need buffering on stdout for console over TCP
   setbuf( stdout, NULL );
 #endif
   return DM_OK;
 }
 
+// ****************************************************************************
+// File descriptor layer (called from the newlib stubs)
+
+// Helper: get the file structure for a descriptor (sets EBADF if invalid)
+static DM_FILE* dm_get_file( struct _reent *r, int file )
+{
+  if( file < 0 || file >= dm_max_files || dm_files[ file ].devid == -1 )
+  {
+    r->_errno = EBADF;
+    return NULL;
+  }
+  return dm_files + file;
+}
+
+// Helper: drop the read buffer, moving the device position back to the
+// position of the application. Returns 0 for OK, -1 for error.
+static int dm_drop_buffer( struct _reent *r, DM_FILE *pf )
+{
+  const DM_DEVICE *pdev = dm_list[ pf->devid ];
+  int res = 0;
+
+  if( pf->pos < pf->len )
+    res = pdev->p_lseek_r( r, pf->fd, -( off_t )( pf->len - pf->pos ), SEEK_CUR ) == -1 ? -1 : 0;
+  pf->pos = pf->len = 0;
+  return res;
+}
+
+int dm_fd_open( struct _reent *r, const char *name, int flags, int mode )
+{
+  const char *actname;
+  const DM_DEVICE *pdev;
+  int devid, fd;
+  unsigned i;
+
+  // Look for device, return error if not found or if function not implemented
+  if( ( devid = dm_get_device_id( name, &actname ) ) == DM_ERR_NO_DEVICE )
+  {
+    r->_errno = ENODEV;
+    return -1;
+  }
+  pdev = dm_list[ devid ];
+  if( pdev->p_open_r == NULL )
+  {
+    r->_errno = ENOSYS;
+    return -1;
+  }
+  // Look for a free descriptor
+  for( i = DM_STDERR_NUM + 1; i < dm_max_files; i ++ )
+    if( dm_files[ i ].devid == -1 )
+      break;
+  if( i == dm_max_files )
+  {
+    r->_errno = EMFILE;
+    return -1;
+  }
+  // Device found, call its function
+  if( ( fd = pdev->p_open_r( r, actname, flags, mode ) ) < 0 )
+    return fd;
+  dm_files[ i ].devid = devid;
+  dm_files[ i ].fd = fd;
+  dm_files[ i ].pos = dm_files[ i ].len = 0;
+  dm_files[ i ].buffered = DM_FILE_BUFFER_SIZE > 0 && pdev->p_lseek_r != NULL && ( flags & O_ACCMODE ) != O_WRONLY;
+  return i;
+}
+
+int dm_fd_close( struct _reent *r, int file )
+{
+  DM_FILE *pf = dm_get_file( r, file );
+  const DM_DEVICE *pdev;
+  int res;
+
+  if( pf == NULL )
+    return -1;
+  pdev = dm_list[ pf->devid ];
+  if( pdev->p_close_r == NULL )
+  {
+    r->_errno = ENOSYS;
+    return -1;
+  }
+  res = pdev->p_close_r( r, pf->fd );
+  free( pf->buf );
+  pf->buf = NULL;
+  pf->devid = -1;
+  return res;
+}
+
+_ssize_t dm_fd_read( struct _reent *r, int file, void *ptr, size_t len )
+{
+  DM_FILE *pf = dm_get_file( r, file );
+  const DM_DEVICE *pdev;
+  u8 *pdest = ( u8* )ptr;
+  _ssize_t res, total = 0;
+  size_t chunk;
+
+  if( pf == NULL )
+    return -1;
+  pdev = dm_list[ pf->devid ];
+  if( pdev->p_read_r == NULL )
+  {
+    r->_errno = ENOSYS;
+    return -1;
+  }
+  if( !pf->buffered )
+    return pdev->p_read_r( r, pf->fd, ptr, len );
+  while( len > 0 )
+  {
+    if( pf->pos == pf->len )
+    {
+      // Buffer empty: large reads go directly to the device, small reads fill the buffer
+      if( len >= DM_FILE_BUFFER_SIZE )
+        res = pdev->p_read_r( r, pf->fd, pdest, len );
+      else if( pf->buf == NULL && ( pf->buf = ( u8* )malloc( DM_FILE_BUFFER_SIZE ) ) == NULL )
+      {
+        pf->buffered = 0;
+        res = pdev->p_read_r( r, pf->fd, pdest, len );
+      }
+      else
+      {
+        if( ( res = pdev->p_read_r( r, pf->fd, pf->buf, DM_FILE_BUFFER_SIZE ) ) > 0 )
+        {
+          pf->pos = 0;
+          pf->len = res;
+          continue;
+        }
+      }
+      if( res <= 0 )
+        return total > 0 ? total : res;
+      return total + res;
+    }
+    chunk = fsmin( len, pf->len - pf->pos );
+    memcpy( pdest, pf->buf + pf->pos, chunk );
+    pf->pos += chunk;
+    pdest += chunk;
+    total += chunk;
+    len -= chunk;
+  }
+  return total;
+}
+
+_ssize_t dm_fd_write( struct _reent *r, int file, const void *ptr, size_t len )
+{
+  DM_FILE *pf = dm_get_file( r, file );
+  const DM_DEVICE *pdev;
+
+  if( pf == NULL )
+    return -1;
+  pdev = dm_list[ pf->devid ];
+  if( pdev->p_write_r == NULL )
+  {
+    r->_errno = ENOSYS;
+    return -1;
+  }
+  if( pf->buffered && dm_drop_buffer( r, pf ) == -1 )
+    return -1;
+  return pdev->p_write_r( r, pf->fd, ptr, len );
+}
+
+off_t dm_fd_lseek( struct _reent *r, int file, off_t off, int whence )
+{
+  DM_FILE *pf = dm_get_file( r, file );
+  const DM_DEVICE *pdev;
+  off_t res;
+
+  if( pf == NULL )
+    return -1;
+  pdev = dm_list[ pf->devid ];
+  if( pdev->p_lseek_r == NULL )
+  {
+    r->_errno = ENOSYS;
+    return -1;
+  }
+  if( pf->buffered && pf->pos < pf->len )
+  {
+    // Current position requests (ftell) keep the buffer
+    if( whence == SEEK_CUR && off == 0 )
+    {
+      if( ( res = pdev->p_lseek_r( r, pf->fd, 0, SEEK_CUR ) ) == -1 )
+        return -1;
+      return res - ( pf->len - pf->pos );
+    }
+    if( whence == SEEK_CUR )
+      off -= pf->len - pf->pos;
+  }
+  pf->pos = pf->len = 0;
+  return pdev->p_lseek_r( r, pf->fd, off, whence );
+}
+
 // Open a directory and return its descriptor
 DM_DIR* dm_opendir( const char* dirname )
 {
@@ -184,3 +508,26 @@ int dm_closedir( DM_DIR *d )
   return res;
 }
 
+// Get a pointer to the data of a file (only for the devices that keep their files in
+// memory, for example ROMFS). Returns 0 for OK, -1 for error
+int dm_map( const char* path, const void **pdata, u32 *psize )
+{
+  const char* rest;
+  const DM_DEVICE *pdev;
+  int pos;
+
+  if( ( pos = dm_device_id_from_name( path, &rest ) ) == DM_ERR_NO_DEVICE )
+  {
+    _REENT->_errno = ENODEV;
+    return -1;
+  }
+  pdev = dm_list[ pos ];
+  if( pdev->p_map_r == NULL )
+  {
+    _REENT->_errno = ENOSYS;
+    return -1;
+  }
+  if( *rest == '/' )
+    rest ++;
+  return pdev->p_map_r( _REENT, rest, pdata, psize );
+}
@@ -21,97 +21,17 @@
 #include <malloc.h>
 #endif
 
-// Utility function: look in the device manager table and find the index
-// for the given name. Returns an index into the device structure, -1 if error.
-// Also returns a pointer to the actual file name (without the device part)
-static int find_dm_entry( const char* name, char **pactname )
-{
-  int i;
-  const DM_DEVICE* pdev;
-  const char* preal;
-  char tempname[ DM_MAX_DEV_NAME + 1 ];
-  
-  // Sanity check for name
-  if( name == NULL || *name == '\0' || *name != '/' )
-    return -1;
-    
-  // Find device name
-  preal = strchr( name + 1, '/' );
-  if( preal == NULL )
-  {
-    // This shortcut allows to register the "/" filesystem and use it like "/file.ext"
-    strcpy( tempname, "/" );
-    preal = name;
-  }
-  else
-  {
-    if( ( preal - name > DM_MAX_DEV_NAME ) || ( preal - name == 1 ) ) // name too short/too long
-      return -1;
-    memcpy( tempname, name, preal - name );
-    tempname[ preal - name ] = '\0';
-  }
-    
-  // Find device
-  for( i = 0; i < dm_get_num_devices(); i ++ )
-  {
-    pdev = dm_get_device_at( i );
-    if( !strcasecmp( tempname, pdev->name ) )
-      break;
-  }
-  if( i == dm_get_num_devices() )
-    return -1;
-    
-  // Find the actual first char of the name
-  preal ++;
-  if( *preal == '\0' )
-    return -1;
-  *pactname = ( char * )preal;
-  return i;  
-}
-
 // *****************************************************************************
-// _open_r
+// File functions (implemented by the device manager file descriptor layer)
+
 int _open_r( struct _reent *r, const char *name, int flags, int mode )
 {
-  char* actname;
-  int res, devid;
-  const DM_DEVICE* pdev;
- 
-  // Look for device, return error if not found or if function not implemented
-  if( ( devid = find_dm_entry( name, &actname ) ) == -1 )
-  {
-    r->_errno = ENODEV;
-    return -1; 
-  }
-  pdev = dm_get_device_at( devid );
-  if( pdev->p_open_r == NULL )
-  {
-    r->_errno = ENOSYS;
-    return -1;   
-  }
-  
-  // Device found, call its function
-  if( ( res = pdev->p_open_r( r, actname, flags, mode ) ) < 0 )
-    return res;
-  return DM_MAKE_DESC( devid, res );
+  return dm_fd_open( r, name, flags, mode );
 }
 
-// *****************************************************************************
-// _close_r
 int _close_r( struct _reent *r, int file )
 {
-  const DM_DEVICE* pdev;
-  
-  // Find device, check close function
-  pdev = dm_get_device_at( DM_GET_DEVID( file ) );
-  if( pdev->p_close_r == NULL )
-  {
-    r->_errno = ENOSYS;
-    return -1; 
-  }
-  
-  // And call the close function
-  return pdev->p_close_r( r, DM_GET_FD( file ) );
+  return dm_fd_close( r, file );
 }
 
 // *****************************************************************************
@@ -127,58 +47,19 @@ int _fstat_r( struct _reent *r, int file, struct stat *st )
   return -1;
 }
 
-// *****************************************************************************
-// _lseek_r
 off_t _lseek_r( struct _reent *r, int file, off_t off, int whence )
 {
-  const DM_DEVICE* pdev;
-  
-  // Find device, check close function
-  pdev = dm_get_device_at( DM_GET_DEVID( file ) );
-  if( pdev->p_lseek_r == NULL )
-  {
-    r->_errno = ENOSYS;
-    return -1; 
-  }
-  
-  // And call the close function
-  return pdev->p_lseek_r( r, DM_GET_FD( file ), off, whence );
+  return dm_fd_lseek( r, file, off, whence );
 }
 
-// *****************************************************************************
-// _read_r 
 _ssize_t _read_r( struct _reent *r, int file, void *ptr, size_t len )
 {
-  const DM_DEVICE* pdev;
-  
-  // Find device, check read function
-  pdev = dm_get_device_at( DM_GET_DEVID( file ) );
-  if( pdev->p_read_r == NULL )
-  {
-    r->_errno = ENOSYS;
-    return -1; 
-  }
-  
-  // And call the read function
-  return pdev->p_read_r( r, DM_GET_FD( file ), ptr, len );  
+  return dm_fd_read( r, file, ptr, len );
 }
 
-// *****************************************************************************
-// _write_r 
 _ssize_t _write_r( struct _reent *r, int file, const void *ptr, size_t len )
 {
-  const DM_DEVICE* pdev;
-  
-  // Find device, check write function
-  pdev = dm_get_device_at( DM_GET_DEVID( file ) );
-  if( pdev->p_write_r == NULL )
-  {
-    r->_errno = ENOSYS;
-    return -1; 
-  }
-  
-  // And call the write function
-  return pdev->p_write_r( r, DM_GET_FD( file ), ptr, len );  
+  return dm_fd_write( r, file, ptr, len );
 }
 
 // ****************************************************************************
@@ -210,9 +91,19 @@ pid_t getpid()
 }
 
 #include <sys/times.h>
+#include <time.h>
+// The process time (clock()) is the time since the start of the timebase
 clock_t _times_r( struct _reent* r, struct tms *buf )
 {
+#ifdef TIMEBASE_CLOCK
+  clock_t t = ( clock_t )( platform_timebase_read() / ( TIMEBASE_CLOCK / CLOCKS_PER_SEC ) );
+
+  buf->tms_utime = t;
+  buf->tms_stime = buf->tms_cutime = buf->tms_cstime = 0;
+  return t;
+#else
   return 0;
+#endif
 }
 
 int _unlink_r( struct _reent *r, const char *name )
@@ -28,6 +28,7 @@
 #include "hw_types.h"
 #include "hw_pwm.h"
 #include "hw_nvic.h"
+#include "hw_gpio.h"
 #include "hw_can.h"
 #include "hw_ethernet.h"
 #include "debug.h"
@@ -73,11 +74,18 @@
 #define SYSTICKHZ               4
 #define SYSTICKMS               (1000 / SYSTICKHZ)
 
+// DWT cycle counter (timebase and pin programs)
+#define DWT_CTRL                0xE0001000
+#define DWT_CYCCNT              0xE0001004
+#define DWT_CTRL_CYCCNTENA      0x00000001
+#define NVIC_DBG_INT_TRCENA     0x01000000
+
 // ****************************************************************************
 // Platform initialization
 
 // forward
 static void timers_init();
+static void timebase_init();
 static void uarts_init();
 static void spis_init();
 static void pios_init();
@@ -107,6 +115,9 @@ int platform_init()
   // Setup timers
   timers_init();
 
+  // Setup the timebase
+  timebase_init();
+
   // Setup PWMs
   pwms_init();
 
@@ -126,9 +137,9 @@ int platform_init()
   // Common platform initialization code
   cmn_platform_init();
 
-  // Virtual timers
+  // Virtual timers and timebase
   // If the ethernet controller is used the timer is already initialized, so skip this sequence
-#if VTMR_NUM_TIMERS > 0 && !defined( BUILD_UIP )
+#if ( VTMR_NUM_TIMERS > 0 || defined( TIMEBASE_CLOCK ) ) && !defined( BUILD_UIP )
   // Configure SysTick for a periodic interrupt.
   MAP_SysTickPeriodSet( MAP_SysCtlClockGet() / SYSTICKHZ );
   MAP_SysTickEnable();
@@ -222,11 +233,50 @@ pio_type platform_pio_op( unsigned port, pio_type pinmask, int op )
   return retval;
 }
 
+#ifdef BUILD_PIO_PROG
+// Pin programs: the port writes use the masked data register (a single store
+// for any set of pins), the delays are absolute deadlines on the DWT cycle
+// counter, so the time spent on the port writes doesn't accumulate
+void platform_pio_run( const platform_pio_step *steps, unsigned nsteps )
+{
+  u32 t;
+
+  t = HWREG( DWT_CYCCNT );
+  for( ; nsteps; nsteps --, steps ++ )
+  {
+    switch( steps->op )
+    {
+      case PLATFORM_PIO_STEP_SET:
+        HWREG( pio_base[ steps->port ] + GPIO_O_DATA + ( steps->mask << 2 ) ) = 0xFF;
+        break;
+
+      case PLATFORM_PIO_STEP_CLEAR:
+        HWREG( pio_base[ steps->port ] + GPIO_O_DATA + ( steps->mask << 2 ) ) = 0;
+        break;
+
+      case PLATFORM_PIO_STEP_WRITE:
+        HWREG( pio_base[ steps->port ] + GPIO_O_DATA + ( ( steps->mask & 0xFF ) << 2 ) ) = steps->data;
+        break;
+
+      case PLATFORM_PIO_STEP_DELAY:
+        t += steps->data;
+        while( ( s32 )( HWREG( DWT_CYCCNT ) - t ) < 0 );
+        break;
+    }
+  }
+}
+#endif // #ifdef BUILD_PIO_PROG
+
 
 // ****************************************************************************
 // CAN
 
-volatile u32 can_rx_flag = 0;
+// Message objects 1 to CAN_NUM_FILTERS are used for receiving (one for each
+// filter), CAN_TX_OBJ is used for sending
+#define CAN_TX_OBJ      32
+
+volatile u32 can_rx_pending = 0;    // bit n set: message object n + 1 has a new frame
+volatile u32 can_rx_int_enabled = 0;
 volatile u32 can_tx_flag = 0;
 volatile u32 can_err_flag = 0;
 char can_tx_buf[8];
@@ -249,15 +299,17 @@ void CANIntHandler(void)
     can_err_flag = 1;
     can_tx_flag = 0;
   }
-  else if( status == 1 ) // Message receive
+  else if( status >= 1 && status <= CAN_NUM_FILTERS ) // Message receive
   {
-    CANIntClear(CAN0_BASE, 1);
-    can_rx_flag = 1;
+    CANIntClear(CAN0_BASE, status);
+    can_rx_pending |= 1 << ( status - 1 );
     can_err_flag = 0;
+    if( can_rx_int_enabled )
+      cmn_int_handler( INT_CAN_RX, 0 );
   }
-  else if( status == 2 ) // Message send
+  else if( status == CAN_TX_OBJ ) // Message send
   {
-    CANIntClear(CAN0_BASE, 2);
+    CANIntClear(CAN0_BASE, CAN_TX_OBJ);
     can_tx_flag = 0;
     can_err_flag = 0;
   }
@@ -287,6 +339,32 @@ void cans_init( void )
   MAP_CANMessageSet(CAN0_BASE, 1, &can_msg_rx, MSG_OBJ_TYPE_RX);
 }
 
+// Each filter is a receive message object. The IDE bit is always part of the
+// mask, so a filter matches only one type of identifiers.
+int platform_can_set_filter( unsigned id, unsigned filter, u32 canid, u32 mask, int idtype )
+{
+  tCANMsgObject msg_rx;
+
+  if( filter >= CAN_NUM_FILTERS )
+    return PLATFORM_ERR;
+  MAP_IntDisable( INT_CAN0 );
+  if( idtype == PLATFORM_CAN_FILTER_OFF )
+    MAP_CANMessageClear( CAN0_BASE, filter + 1 );
+  else
+  {
+    msg_rx.ulMsgID = canid;
+    msg_rx.ulMsgIDMask = mask;
+    msg_rx.ulFlags = MSG_OBJ_RX_INT_ENABLE | MSG_OBJ_USE_EXT_FILTER;
+    if( idtype == ELUA_CAN_ID_EXT )
+      msg_rx.ulFlags |= MSG_OBJ_EXTENDED_ID;
+    msg_rx.ulMsgLen = 8;
+    MAP_CANMessageSet( CAN0_BASE, filter + 1, &msg_rx, MSG_OBJ_TYPE_RX );
+  }
+  can_rx_pending &= ~( 1 << filter );
+  MAP_IntEnable( INT_CAN0 );
+  return PLATFORM_OK;
+}
+
 
 u32 platform_can_setup( unsigned id, u32 clock )
 {  
@@ -319,25 +397,31 @@ void platform_can_send( unsigned id, u32 canid, u8 idtype, u8 len, const u8 *dat
   DUFF_DEVICE_8( len,  *d++ = *s++ );
 
   can_tx_flag = 1;
-  CANMessageSet(CAN0_BASE, 2, &msg_tx, MSG_OBJ_TYPE_TX);
+  CANMessageSet(CAN0_BASE, CAN_TX_OBJ, &msg_tx, MSG_OBJ_TYPE_TX);
 }
 
-int platform_can_recv( unsigned id, u32 *canid, u8 *idtype, u8 *len, u8 *data )
+int platform_s_can_recv( unsigned id, u32 *canid, u8 *idtype, u8 *len, u8 *data )
 {
-  // wait for a message
-  if( can_rx_flag != 0 )
-  {
-    can_msg_rx.pucMsgData = data;
-    CANMessageGet(CAN0_BASE, 1, &can_msg_rx, 0);
-    can_rx_flag = 0;
-
-    *canid = ( u32 )can_msg_rx.ulMsgID;
-    *idtype = ( can_msg_rx.ulFlags & MSG_OBJ_EXTENDED_ID )? ELUA_CAN_ID_EXT : ELUA_CAN_ID_STD;
-    *len = can_msg_rx.ulMsgLen;
-    return PLATFORM_OK;
-  }
-  else
+  unsigned obj;
+
+  if( can_rx_pending == 0 )
     return PLATFORM_UNDERFLOW;
+
+  // Get the frame from the lowest numbered message object
+  MAP_IntDisable( INT_CAN0 );
+  for( obj = 0; ( can_rx_pending & ( 1 << obj ) ) == 0; obj ++ );
+  can_rx_pending &= ~( 1 << obj );
+  can_msg_rx.pucMsgData = data;
+  CANMessageGet(CAN0_BASE, obj + 1, &can_msg_rx, 0);
+  MAP_IntEnable( INT_CAN0 );
+
+  // The message object was overwritten before it was read
+  if( can_msg_rx.ulFlags & MSG_OBJ_DATA_LOST )
+    cmn_can_rx_dropped( id, 1 );
+  *canid = ( u32 )can_msg_rx.ulMsgID;
+  *idtype = ( can_msg_rx.ulFlags & MSG_OBJ_EXTENDED_ID )? ELUA_CAN_ID_EXT : ELUA_CAN_ID_STD;
+  *len = can_msg_rx.ulMsgLen;
+  return PLATFORM_OK;
 }
 
 // ****************************************************************************
@@ -469,6 +553,26 @@ int platform_s_uart_set_flow_control( unsigned id, int type )
   return PLATFORM_ERR;
 }
 
+// ****************************************************************************
+// Timebase: the DWT cycle counter, extended to 64 bits. The SysTick interrupt
+// reads it SYSTICKHZ times per second, much more often than it wraps (every
+// 85.9s at 50MHz).
+
+static void timebase_init()
+{
+  HWREG( NVIC_DBG_INT ) |= NVIC_DBG_INT_TRCENA;
+  HWREG( DWT_CTRL ) |= DWT_CTRL_CYCCNTENA;
+}
+
+u64 platform_timebase_read()
+{
+  int old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  u64 res = cmn_timebase_extend( HWREG( DWT_CYCCNT ) );
+
+  platform_cpu_set_global_interrupts( old_status );
+  return res;
+}
+
 // ****************************************************************************
 // Timers
 // Same on LM3S8962, LM3S6965, LM3S6918 and LM3S9B92 (4 timers)
@@ -647,6 +751,77 @@ u32 platform_pwm_op( unsigned id, int op, u32 data )
   return res;
 }
 
+#ifdef BUILD_PWM_SEQ
+// Sequences: the PWM unit has no DMA, so the "counter is zero" interrupt of the
+// generator (once per PWM period in up/down mode) writes the next duty value
+// every 'pwm_seq_rep' periods. One channel can play a sequence at a time.
+static const u8 pwm_gen_ints[] = { INT_PWM0, INT_PWM1, INT_PWM2 };
+static volatile int pwm_seq_id = -1;
+static u16 *pwm_seq_data;
+static u32 pwm_seq_count, pwm_seq_rep;
+static volatile u32 pwm_seq_idx, pwm_seq_ctr;
+static int pwm_seq_mode;
+
+u32 platform_s_pwm_seq_start( unsigned id, u16 *duty, u32 count, u32 rate, int mode )
+{
+  u32 gen = pwm_gens[ id >> 1 ], period, freq, i;
+
+  if( ( pwm_seq_id != -1 && pwm_seq_id != id ) || ( id >> 1 ) >= sizeof( pwm_gen_ints ) || rate == 0 )
+    return 0;
+  period = MAP_PWMGenPeriodGet( PWM_BASE, gen );
+  freq = platform_pwm_get_clock() / period;
+  if( rate > freq )
+    return 0;
+  for( i = 0; i < count; i ++ )
+    duty[ i ] = ( u16 )( ( u32 )duty[ i ] * period / PLATFORM_PWM_SEQ_DUTY_MAX );
+  pwm_seq_data = duty;
+  pwm_seq_count = count;
+  pwm_seq_rep = ( freq + rate / 2 ) / rate;
+  pwm_seq_mode = mode;
+  pwm_seq_idx = 0;
+  pwm_seq_ctr = pwm_seq_rep - 1;
+  pwm_seq_id = id;
+  MAP_PWMGenIntTrigEnable( PWM_BASE, gen, PWM_INT_CNT_ZERO );
+  MAP_PWMIntEnable( PWM_BASE, PWM_INT_GEN_0 << ( id >> 1 ) );
+  MAP_IntEnable( pwm_gen_ints[ id >> 1 ] );
+  return freq / pwm_seq_rep;
+}
+
+void platform_s_pwm_seq_stop( unsigned id )
+{
+  if( pwm_seq_id != id )
+    return;
+  MAP_PWMIntDisable( PWM_BASE, PWM_INT_GEN_0 << ( id >> 1 ) );
+  MAP_PWMGenIntTrigDisable( PWM_BASE, pwm_gens[ id >> 1 ], PWM_INT_CNT_ZERO );
+  pwm_seq_id = -1;
+}
+
+void PWMGenIntHandler()
+{
+  unsigned id = pwm_seq_id;
+
+  if( pwm_seq_id == -1 )
+    return;
+  MAP_PWMGenIntClear( PWM_BASE, pwm_gens[ id >> 1 ], PWM_INT_CNT_ZERO );
+  if( ++ pwm_seq_ctr < pwm_seq_rep )
+    return;
+  pwm_seq_ctr = 0;
+  MAP_PWMPulseWidthSet( PWM_BASE, pwm_outs[ id ], pwm_seq_data[ pwm_seq_idx ] );
+  if( ++ pwm_seq_idx == pwm_seq_count )
+  {
+    pwm_seq_idx = 0;
+    if( pwm_seq_mode == PLATFORM_PWM_SEQ_ONESHOT )
+    {
+      // The last duty value stays in the generator
+      platform_s_pwm_seq_stop( id );
+      cmn_pwm_seq_pass_done( id, 1 );
+    }
+    else
+      cmn_pwm_seq_pass_done( id, 0 );
+  }
+}
+#endif // #ifdef BUILD_PWM_SEQ
+
 // *****************************************************************************
 // ADC specific functions and variables
 
@@ -699,6 +874,18 @@ void ADCIntHandler( void )
   elua_adc_ch_state *s;
 
   MAP_ADCIntClear( ADC_BASE, d->seq_id );
+#ifdef BUILD_ADC_STREAM
+  // Streaming: there's no DMA for the ADC on these parts, so the samples of
+  // each scan are copied in the stream blocks here
+  if( adc_get_stream_state()->active )
+  {
+    long i, count = MAP_ADCSequenceDataGet( ADC_BASE, d->seq_id, tmpbuff );
+
+    for( i = 0; i < count; i ++ )
+      adc_stream_add_sample( ( u16 )tmpbuff[ i ] );
+    return;
+  }
+#endif
   MAP_ADCSequenceDataGet( ADC_BASE, d->seq_id, tmpbuff );
   
   d->seq_ctr = 0;
@@ -844,6 +1031,45 @@ int platform_adc_start_sequence()
   return PLATFORM_OK;
 }
 
+#ifdef BUILD_ADC_STREAM
+
+// The timer triggers a scan of all the channels of the stream, the interrupt
+// handler copies the samples in the stream blocks
+u32 platform_adc_stream_start( unsigned timer_id, u32 frequency )
+{
+  elua_adc_dev_state *d = adc_get_dev_state( 0 );
+  elua_adc_stream_state *st = adc_get_stream_state();
+  unsigned i, id;
+
+  d->timer_id = timer_id;
+  frequency = platform_adc_setclock( 0, frequency );
+  for( i = 0; i < st->nchans; i ++ )
+  {
+    id = st->chans[ i ];
+    MAP_ADCSequenceStepConfigure( ADC_BASE, d->seq_id, i, adc_ctls[ id ] | ( i == st->nchans - 1 ? ADC_CTL_IE | ADC_CTL_END : 0 ) );
+#ifdef ADC_PIN_CONFIG
+    MAP_GPIOPinTypeADC( adc_ports[ id ], adc_pins[ id ] );
+#endif
+  }
+  MAP_ADCSequenceEnable( ADC_BASE, d->seq_id );
+  MAP_TimerControlTrigger( timer_base[ d->timer_id ], TIMER_A, true );
+  MAP_TimerEnable( timer_base[ d->timer_id ], TIMER_A );
+  return frequency;
+}
+
+void platform_adc_stream_stop()
+{
+  elua_adc_dev_state *d = adc_get_dev_state( 0 );
+
+  MAP_ADCSequenceDisable( ADC_BASE, d->seq_id );
+  // Back to processor triggers, the sequence is reprogrammed by the next
+  // 'sample' request
+  platform_adc_setclock( 0, 0 );
+  d->force_reseq = 1;
+}
+
+#endif // #ifdef BUILD_ADC_STREAM
+
 #endif // ifdef BUILD_ADC
 
 // ****************************************************************************
@@ -1008,6 +1234,9 @@ u32 platform_eth_get_elapsed_time()
 
 void SysTickIntHandler()
 {
+  // Keep the 64-bit timebase up to date
+  platform_timebase_read();
+
   // Handle virtual timers
   cmn_virtual_timer_cb();
 
@@ -1039,6 +1268,7 @@ void EthernetIntHandler()
 
 void SysTickIntHandler()
 {
+  platform_timebase_read();
   cmn_virtual_timer_cb();
 
 #ifdef BUILD_MMCFS
@@ -1051,6 +1281,47 @@ void EthernetIntHandler()
 }
 #endif // #ifdef ELUA_UIP
 
+// ****************************************************************************
+// Internal flash functions
+
+#ifdef BUILD_WOFS
+
+#define LM3S_FLASH_SECTOR_SIZE    1024
+
+extern unsigned long _etext, _data, _edata;
+
+u32 platform_flash_get_num_sectors()
+{
+  return SysCtlFlashSizeGet() / LM3S_FLASH_SECTOR_SIZE;
+}
+
+u32 platform_flash_get_sector_start( u32 sectid )
+{
+  return sectid * LM3S_FLASH_SECTOR_SIZE;
+}
+
+// The firmware image ends with the initial values of the .data section (stored after _etext)
+u32 platform_flash_get_first_free_sector()
+{
+  u32 end = ( u32 )&_etext + ( ( u32 )&_edata - ( u32 )&_data );
+
+  return ( end + LM3S_FLASH_SECTOR_SIZE - 1 ) / LM3S_FLASH_SECTOR_SIZE;
+}
+
+int platform_flash_erase( u32 sectid )
+{
+  MAP_FlashUsecSet( MAP_SysCtlClockGet() / 1000000 );
+  return MAP_FlashErase( sectid * LM3S_FLASH_SECTOR_SIZE ) == 0 ? PLATFORM_OK : PLATFORM_ERR;
+}
+
+int platform_flash_write( const void *from, u32 toaddr, u32 size )
+{
+  MAP_FlashUsecSet( MAP_SysCtlClockGet() / 1000000 );
+  return MAP_FlashProgram( ( unsigned long* )from, toaddr, size ) == 0 ? PLATFORM_OK : PLATFORM_ERR;
+}
+
+#endif // #ifdef BUILD_WOFS
+
 // ****************************************************************************
 // Platform specific modules go here
 
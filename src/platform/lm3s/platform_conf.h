@@ -17,6 +17,7 @@
 #define BUILD_SHELL
 #define BUILD_ROMFS
 #define BUILD_MMCFS
+//#define BUILD_WOFS
 #define BUILD_TERM
 #ifndef FORLM3S1968
   #define BUILD_UIP
@@ -25,9 +26,14 @@
 #endif  
 #define BUILD_CON_GENERIC
 #define BUILD_ADC
+#define BUILD_ADC_STREAM
 #define BUILD_RPC
 //#define BUILD_CON_TCP
 #define BUILD_C_INT_HANDLERS
+#define BUILD_PIO_PROG
+#ifndef FORLM3S6918
+#define BUILD_PWM_SEQ
+#endif
 
 // *****************************************************************************
 // UART/Timer IDs configuration data (used in main.c)
@@ -101,6 +107,8 @@
   _ROM( AUXLIB_PACK, luaopen_pack, pack_map )\
   _ROM( AUXLIB_BIT, luaopen_bit, bit_map )\
   _ROM( AUXLIB_BITARRAY, luaopen_bitarray, bitarray_map )\
+  _ROM( AUXLIB_SBUF, luaopen_sbuf, sbuf_map )\
+  _ROM( AUXLIB_DSP, luaopen_dsp, dsp_map )\
   NETLINE\
   _ROM( AUXLIB_CPU, luaopen_cpu, cpu_map )\
   _ROM( AUXLIB_ELUA, luaopen_elua, elua_map )\
@@ -179,6 +187,11 @@
 #define ADC_TIMER_FIRST_ID    0
 #define ADC_NUM_TIMERS        NUM_TIMER  
 
+// CAN configuration (RX buffering and number of hardware filters)
+#define BUF_ENABLE_CAN
+#define CAN_BUF_SIZE          BUF_SIZE_32
+#define CAN_NUM_FILTERS       8
+
 // RPC boot options
 #define RPC_UART_ID           CON_UART_ID
 #define RPC_TIMER_ID          CON_TIMER_ID
@@ -212,6 +225,12 @@
 // CPU frequency (needed by the CPU module, 0 if not used)
 #define CPU_FREQUENCY         SysCtlClockGet()
 
+// Clock of the pin program delays (DWT cycle counter)
+#define PIO_PROG_CLOCK        CPU_FREQUENCY
+
+// Timebase (the DWT cycle counter, needs the SysTick interrupt)
+#define TIMEBASE_CLOCK        CPU_FREQUENCY
+
 // PIO prefix ('0' for P0, P1, ... or 'A' for PA, PB, ...)
 #define PIO_PREFIX            'A'
 // Pins per port configuration:
@@ -240,7 +259,10 @@
 
 // Interrupt list
 #define INT_UART_RX           ELUA_INT_FIRST_ID
-#define INT_ELUA_LAST         INT_UART_RX
+#define INT_ADC_BLOCK         ( ELUA_INT_FIRST_ID + 1 )
+#define INT_CAN_RX            ( ELUA_INT_FIRST_ID + 2 )
+#define INT_PWM_SEQ_DONE      ( ELUA_INT_FIRST_ID + 3 )
+#define INT_ELUA_LAST         INT_PWM_SEQ_DONE
 
 // *****************************************************************************
 // CPU constants that should be exposed to the eLua "cpu" module
@@ -296,6 +318,9 @@
   _C( INT_PWM3 ),\
   _C( INT_UDMA ),\
   _C( INT_UDMAERR ),\
-  _C( INT_UART_RX )
+  _C( INT_UART_RX ),\
+  _C( INT_ADC_BLOCK ),\
+  _C( INT_CAN_RX ),\
+  _C( INT_PWM_SEQ_DONE )
 
 #endif // #ifndef __PLATFORM_CONF_H__
@@ -7,6 +7,7 @@
 #include "platform.h"
 #include "elua_int.h"
 #include "common.h"
+#include "elua_adc.h"
 
 // Platform includes
 #ifdef FORLM3S9B92
@@ -87,6 +88,32 @@ static int int_uart_rx_get_flag( elua_int_resnum resnum, int clear )
   return flag;  
 }
 
+// ****************************************************************************
+// Interrupt: INT_CAN_RX
+// The CAN interrupt is always enabled (it is also used for sending), so the
+// RX interrupt is a software flag checked by the CAN interrupt handler
+
+extern volatile u32 can_rx_int_enabled, can_rx_pending;
+
+static int int_can_rx_get_status( elua_int_resnum resnum )
+{
+  return can_rx_int_enabled ? 1 : 0;
+}
+
+static int int_can_rx_set_status( elua_int_resnum resnum, int status )
+{
+  int prev = int_can_rx_get_status( resnum );
+
+  can_rx_int_enabled = status == PLATFORM_CPU_ENABLE;
+  return prev;
+}
+
+// The flag is cleared by reading the frames
+static int int_can_rx_get_flag( elua_int_resnum resnum, int clear )
+{
+  return can_rx_pending != 0 ? 1 : 0;
+}
+
 // ****************************************************************************
 // Interrupt initialization
 
@@ -103,7 +130,18 @@ void platform_int_init()
 
 const elua_int_descriptor elua_int_table[ INT_ELUA_LAST ] = 
 {
-  { int_uart_rx_set_status, int_uart_rx_get_status, int_uart_rx_get_flag }
+  { int_uart_rx_set_status, int_uart_rx_get_status, int_uart_rx_get_flag },
+#ifdef BUILD_ADC_STREAM
+  { adc_stream_int_set_status, adc_stream_int_get_status, adc_stream_int_get_flag },
+#else
+  { NULL, NULL, NULL },
+#endif
+  { int_can_rx_set_status, int_can_rx_get_status, int_can_rx_get_flag },
+#ifdef BUILD_PWM_SEQ
+  { cmn_pwm_seq_int_set_status, cmn_pwm_seq_int_get_status, cmn_pwm_seq_int_get_flag }
+#else
+  { NULL, NULL, NULL }
+#endif
 };
 
 #endif // #if defined( BUILD_C_INT_HANDLERS ) || defined( BUILD_LUA_INT_HANDLERS )
@@ -42,6 +42,7 @@ extern void SysTickIntHandler();
 extern void ADCIntHandler();
 extern void UARTIntHandler();
 extern void CANIntHandler();
+extern void PWMGenIntHandler();
 
 #include "hw_memmap.h"
 #include "platform_conf.h"
@@ -102,9 +103,15 @@ void (* const g_pfnVectors[])(void) =
     IntDefaultHandler,                      // SSI0 Rx and Tx
     IntDefaultHandler,                      // I2C0 Master and Slave
     IntDefaultHandler,                      // PWM Fault
+#ifdef BUILD_PWM_SEQ
+    PWMGenIntHandler,                       // PWM Generator 0
+    PWMGenIntHandler,                       // PWM Generator 1
+    PWMGenIntHandler,                       // PWM Generator 2
+#else
     IntDefaultHandler,                      // PWM Generator 0
     IntDefaultHandler,                      // PWM Generator 1
     IntDefaultHandler,                      // PWM Generator 2
+#endif
     IntDefaultHandler,                      // Quadrature Encoder 0
 #ifdef BUILD_ADC
     ADCIntHandler,	                        // ADC Sequence 0
@@ -0,0 +1,184 @@
+// ADC emulation for the simulator
+// Each channel is a synthetic waveform: channel 'n' is a sine wave of
+// 50 * ( n + 1 ) Hz with a small amount of noise, in the range of a
+// ADC_BIT_RESOLUTION bits converter. The time base of the waveforms is the
+// host time, so the samples of a timer triggered stream are generated when the
+// stream is polled (ADC_STREAM_POLLED), for all the conversions that should
+// have happened since the last poll.
+
+#include "platform_conf.h"
+#ifdef BUILD_ADC
+#include "type.h"
+#include "platform.h"
+#include "elua_adc.h"
+#include "buf.h"
+#include "hostif.h"
+#include <math.h>
+
+#define ADC_SIM_MAX_VALUE         ( ( 1 << ADC_BIT_RESOLUTION ) - 1 )
+#define ADC_SIM_BASE_FREQ         50
+#define ADC_SIM_MAX_RATE          100000
+
+#ifndef M_PI
+#define M_PI                      3.14159265358979323846
+#endif
+
+static u32 adc_sim_seed = 1;
+
+// Value of channel 'id' at time 't' (in microseconds)
+static u16 adc_sim_value( unsigned id, u32 t )
+{
+  double phase = 2 * M_PI * ADC_SIM_BASE_FREQ * ( id + 1 ) * ( t % 1000000 ) / 1000000.0;
+  s32 v;
+
+  adc_sim_seed = adc_sim_seed * 1103515245 + 12345;
+  v = ( s32 )( ( ADC_SIM_MAX_VALUE / 2 ) * ( 1 + 0.9 * sin( phase ) ) );
+  v += ( s32 )( ( adc_sim_seed >> 16 ) % 32 ) - 16;
+  return v < 0 ? 0 : v > ADC_SIM_MAX_VALUE ? ADC_SIM_MAX_VALUE : v;
+}
+
+// *****************************************************************************
+// Classic interface
+// Conversions are done synchronously when the sequence is started. A
+// freerunning channel stops when it has the requested number of samples, like
+// the other channels.
+
+static void adc_sim_convert()
+{
+  elua_adc_dev_state *d = adc_get_dev_state( 0 );
+  elua_adc_ch_state *s;
+  u32 now = hostif_gettime_us();
+
+  d->seq_ctr = 0;
+  while( d->seq_ctr < d->seq_len )
+  {
+    s = d->ch_state[ d->seq_ctr ];
+    d->sample_buf[ d->seq_ctr ] = adc_sim_value( s->id, now );
+    s->value_fresh = 1;
+
+    if ( s->logsmoothlen > 0 && s->smooth_ready == 0)
+      adc_smooth_data( s->id );
+#if defined( BUF_ENABLE_ADC )
+    else if ( s->reqsamples > 1 )
+    {
+      buf_write( BUF_ID_ADC, s->id, ( t_buf_data* )s->value_ptr );
+      s->value_fresh = 0;
+    }
+#endif
+
+    if ( adc_samples_available( s->id ) >= s->reqsamples )
+      platform_adc_stop( s->id );
+    d->seq_ctr++;
+  }
+  d->seq_ctr = 0;
+  if ( d->running == 1 )
+    adc_update_dev_sequence( 0 );
+}
+
+int platform_adc_check_timer_id( unsigned id, unsigned timer_id )
+{
+  return ( ( timer_id >= ADC_TIMER_FIRST_ID ) && ( timer_id < ( ADC_TIMER_FIRST_ID + ADC_NUM_TIMERS ) ) );
+}
+
+void platform_adc_stop( unsigned id )
+{
+  elua_adc_ch_state *s = adc_get_ch_state( id );
+  elua_adc_dev_state *d = adc_get_dev_state( 0 );
+
+  s->op_pending = 0;
+  INACTIVATE_CHANNEL( d, id );
+  if( d->ch_active == 0 )
+    d->running = 0;
+}
+
+u32 platform_adc_setclock( unsigned id, u32 frequency )
+{
+  elua_adc_dev_state *d = adc_get_dev_state( 0 );
+
+  d->clocked = frequency > 0;
+  return frequency;
+}
+
+int platform_adc_update_sequence()
+{
+  return PLATFORM_OK;
+}
+
+int platform_adc_start_sequence()
+{
+  elua_adc_dev_state *d = adc_get_dev_state( 0 );
+
+  if( d->running != 1 )
+  {
+    adc_update_dev_sequence( 0 );
+    d->running = 1;
+    while( d->running )
+      adc_sim_convert();
+  }
+  return PLATFORM_OK;
+}
+
+void adc_sim_init()
+{
+  unsigned id;
+
+  for( id = 0; id < NUM_ADC; id ++ )
+    adc_init_ch_state( id );
+}
+
+// *****************************************************************************
+// Streaming
+
+#ifdef BUILD_ADC_STREAM
+
+static u32 adc_sim_period;        // time between two scans (microseconds)
+static u32 adc_sim_scan_time;     // time of the next scan
+static u32 adc_sim_last_poll;     // host time of the last poll
+static u32 adc_sim_pending;       // time since the last poll not used for scans yet
+
+u32 platform_adc_stream_start( unsigned timer_id, u32 frequency )
+{
+  if( frequency == 0 || frequency > ADC_SIM_MAX_RATE )
+    return 0;
+  adc_sim_period = 1000000 / frequency;
+  adc_sim_scan_time = adc_sim_last_poll = hostif_gettime_us();
+  adc_sim_pending = 0;
+  return 1000000 / adc_sim_period;
+}
+
+void platform_adc_stream_stop()
+{
+}
+
+// Generate the samples of all the scans since the last poll. If the reader
+// is late by more than the two blocks, the blocks in between are dropped
+// directly (and counted as overruns).
+void platform_adc_stream_poll()
+{
+  elua_adc_stream_state *st = adc_get_stream_state();
+  u32 now = hostif_gettime_us(), scans, skip;
+  unsigned i;
+
+  adc_sim_pending += now - adc_sim_last_poll;
+  adc_sim_last_poll = now;
+  scans = adc_sim_pending / adc_sim_period;
+  adc_sim_pending %= adc_sim_period;
+  if( scans > ADC_STREAM_BLOCKS * st->blocksize )
+  {
+    skip = ( scans - ADC_STREAM_BLOCKS * st->blocksize ) / st->blocksize;
+    st->blocks += skip;
+    st->overruns += skip;
+    scans -= skip * st->blocksize;
+    adc_sim_scan_time += skip * st->blocksize * adc_sim_period;
+  }
+  while( scans -- )
+  {
+    for( i = 0; i < st->nchans; i ++ )
+      adc_stream_add_sample( adc_sim_value( st->chans[ i ], adc_sim_scan_time ) );
+    adc_sim_scan_time += adc_sim_period;
+  }
+}
+
+#endif // #ifdef BUILD_ADC_STREAM
+
+#endif // #ifdef BUILD_ADC
@@ -0,0 +1,119 @@
+// CAN emulation for the simulator
+// The CAN interface is in loopback mode: the frames sent with
+// platform_can_send are checked against the acceptance filters and, if they
+// pass, they are put in the receive FIFO. The FIFO has CAN_SIM_FIFO_SIZE
+// frames, the frames sent when the FIFO is full are counted as dropped. There
+// are no interrupts in the simulator, so RX buffering is not available
+// (the FIFO is the RX queue).
+
+#include "platform_conf.h"
+#if NUM_CAN > 0
+#include "type.h"
+#include "platform.h"
+#include "common.h"
+#include <string.h>
+
+typedef struct
+{
+  u32 canid;
+  u8 idtype;
+  u8 len;
+  u8 data[ PLATFORM_CAN_MAXLEN ];
+} can_sim_frame;
+
+typedef struct
+{
+  u32 canid;
+  u32 mask;
+  int idtype;
+} can_sim_filter;
+
+static can_sim_frame can_sim_fifo[ CAN_SIM_FIFO_SIZE ];
+static unsigned can_sim_rptr, can_sim_count;
+
+// Filter 0 accepts all the frames (both identifier types), like the default
+// configuration of the real CAN controllers
+#define CAN_SIM_FILTER_ANY    ( -2 )
+static can_sim_filter can_sim_filters[ CAN_NUM_FILTERS ];
+
+// Empty the FIFO and set the filters to their default configuration
+void can_sim_init()
+{
+  unsigned i;
+
+  can_sim_rptr = can_sim_count = 0;
+  can_sim_filters[ 0 ].canid = can_sim_filters[ 0 ].mask = 0;
+  can_sim_filters[ 0 ].idtype = CAN_SIM_FILTER_ANY;
+  for( i = 1; i < CAN_NUM_FILTERS; i ++ )
+    can_sim_filters[ i ].idtype = PLATFORM_CAN_FILTER_OFF;
+}
+
+// Return 1 if the frame passes at least one of the active filters
+static int can_sim_accept( u32 canid, u8 idtype )
+{
+  const can_sim_filter *f;
+  unsigned i;
+
+  for( i = 0, f = can_sim_filters; i < CAN_NUM_FILTERS; i ++, f ++ )
+  {
+    if( f->idtype == PLATFORM_CAN_FILTER_OFF )
+      continue;
+    if( f->idtype != CAN_SIM_FILTER_ANY && f->idtype != idtype )
+      continue;
+    if( ( ( canid ^ f->canid ) & f->mask ) == 0 )
+      return 1;
+  }
+  return 0;
+}
+
+u32 platform_can_setup( unsigned id, u32 clock )
+{
+  can_sim_init();
+  return clock;
+}
+
+int platform_can_set_filter( unsigned id, unsigned filter, u32 canid, u32 mask, int idtype )
+{
+  if( filter >= CAN_NUM_FILTERS )
+    return PLATFORM_ERR;
+  can_sim_filters[ filter ].canid = canid;
+  can_sim_filters[ filter ].mask = mask;
+  can_sim_filters[ filter ].idtype = idtype;
+  return PLATFORM_OK;
+}
+
+void platform_can_send( unsigned id, u32 canid, u8 idtype, u8 len, const u8 *data )
+{
+  can_sim_frame *f;
+
+  if( !can_sim_accept( canid, idtype ) )
+    return;
+  if( can_sim_count == CAN_SIM_FIFO_SIZE )
+  {
+    cmn_can_rx_dropped( id, 1 );
+    return;
+  }
+  f = can_sim_fifo + ( can_sim_rptr + can_sim_count ) % CAN_SIM_FIFO_SIZE;
+  f->canid = canid;
+  f->idtype = idtype;
+  f->len = len;
+  memcpy( f->data, data, len );
+  can_sim_count ++;
+}
+
+int platform_s_can_recv( unsigned id, u32 *canid, u8 *idtype, u8 *len, u8 *data )
+{
+  const can_sim_frame *f = can_sim_fifo + can_sim_rptr;
+
+  if( can_sim_count == 0 )
+    return PLATFORM_UNDERFLOW;
+  *canid = f->canid;
+  *idtype = f->idtype;
+  *len = f->len;
+  memcpy( data, f->data, f->len );
+  can_sim_rptr = ( can_sim_rptr + 1 ) % CAN_SIM_FIFO_SIZE;
+  can_sim_count --;
+  return PLATFORM_OK;
+}
+
+#endif // #if NUM_CAN > 0
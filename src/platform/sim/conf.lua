@@ -1,6 +1,6 @@
 -- Configuration file for the linux (sim) backend
 
-specific_files = sf( "boot.s utils.s hostif_%s.c platform.c host.c", comp.cpu:lower() )
+specific_files = sf( "boot.s utils.s hostif_%s.c platform.c host.c mmc_sim.c hostfs.c flash_sim.c adc_sim.c can_sim.c i2c_sim.c pio_sim.c pwm_sim.c", comp.cpu:lower() )
 local ldscript = "i386.ld"
   
 -- Override default optimize settings
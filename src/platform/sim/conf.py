@@ -1,6 +1,6 @@
 # Configuration file for the linux backend
 
-specific_files = "boot.s utils.s hostif_%s.c platform.c host.c" % comp[ 'cpu' ].lower()
+specific_files = "boot.s utils.s hostif_%s.c platform.c host.c mmc_sim.c hostfs.c flash_sim.c adc_sim.c can_sim.c i2c_sim.c pio_sim.c pwm_sim.c" % comp[ 'cpu' ].lower()
 ldscript = "i386.ld"
   
 # override default optimize settings (-Os is broken right now)
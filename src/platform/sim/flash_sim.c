@@ -0,0 +1,84 @@
+// Internal flash emulation for the simulator
+// The flash is a host file (SIM_FLASH_IMAGE) mapped in memory, so it can be
+// read directly like the memory mapped flash of a MCU. Erase sets all the bytes
+// of a sector to 0xFF and write can only clear bits, as in a real NOR flash.
+// The whole flash is free (there's no firmware image in it).
+
+#include "platform_conf.h"
+#ifdef SIM_FLASH_IMAGE
+#include "type.h"
+#include "platform.h"
+#include "hostif.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FLASH_SIM_NUM_SECTORS     ( SIM_FLASH_SIZE / SIM_FLASH_SECTOR_SIZE )
+
+static u8 *flash_sim_data;
+
+// Open the image file (a new or short image is filled with erased bytes) and
+// map it in memory. Returns 1 for OK, 0 for error.
+static int flash_sim_init()
+{
+  u8 buf[ 256 ];
+  long size;
+  unsigned n;
+  int fd;
+
+  if( flash_sim_data )
+    return 1;
+  if( ( fd = hostif_open( SIM_FLASH_IMAGE, HOSTIF_O_RDWR | HOSTIF_O_CREAT, 0644 ) ) == -1 )
+    return 0;
+  if( ( size = hostif_lseek( fd, 0, SEEK_END ) ) == -1 )
+    goto done;
+  memset( buf, 0xFF, sizeof( buf ) );
+  while( size < SIM_FLASH_SIZE )
+  {
+    n = SIM_FLASH_SIZE - size > sizeof( buf ) ? sizeof( buf ) : SIM_FLASH_SIZE - size;
+    if( hostif_write( fd, buf, n ) != n )
+      goto done;
+    size += n;
+  }
+  flash_sim_data = hostif_mapfile( fd, SIM_FLASH_SIZE );
+done:
+  // The mapping stays valid after the file is closed
+  hostif_close( fd );
+  return flash_sim_data != NULL;
+}
+
+u32 platform_flash_get_num_sectors()
+{
+  return flash_sim_init() ? FLASH_SIM_NUM_SECTORS : 0;
+}
+
+u32 platform_flash_get_sector_start( u32 sectid )
+{
+  return ( u32 )( flash_sim_data + sectid * SIM_FLASH_SECTOR_SIZE );
+}
+
+u32 platform_flash_get_first_free_sector()
+{
+  return 0;
+}
+
+int platform_flash_erase( u32 sectid )
+{
+  if( !flash_sim_init() || sectid >= FLASH_SIM_NUM_SECTORS )
+    return PLATFORM_ERR;
+  memset( flash_sim_data + sectid * SIM_FLASH_SECTOR_SIZE, 0xFF, SIM_FLASH_SECTOR_SIZE );
+  return PLATFORM_OK;
+}
+
+int platform_flash_write( const void *from, u32 toaddr, u32 size )
+{
+  u8 *pdest = ( u8* )toaddr;
+  const u8 *psrc = ( const u8* )from;
+
+  if( !flash_sim_init() || pdest < flash_sim_data || pdest + size > flash_sim_data + SIM_FLASH_SIZE )
+    return PLATFORM_ERR;
+  while( size -- )
+    *pdest ++ &= *psrc ++;
+  return PLATFORM_OK;
+}
+
+#endif // #ifdef SIM_FLASH_IMAGE
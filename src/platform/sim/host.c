@@ -6,6 +6,12 @@
 #define __NR_exit     1
 #define __NR_open     5 
 #define __NR_close    6
+#define __NR_lseek    19
+#define __NR_gettimeofday 78
+#define __NR_nanosleep 162
+#define __NR_clock_gettime 265
+#define __NR_stat     106
+#define __NR_getdents 141
 
 int host_errno = 0;
 
@@ -27,6 +33,15 @@ __asm__ volatile ("int $0x80" \
 __syscall_return(type,__res); \
 }
 
+#define _syscall2(type,name,type1,arg1,type2,arg2) \
+type host_##name(type1 arg1,type2 arg2) \
+{ \
+long __res; \
+__asm__ volatile ("int $0x80" \
+        : "=a" (__res) \
+        : "0" (__NR_##name),"b" ((long)(arg1)),"c" ((long)(arg2))); \
+__syscall_return(type,__res); \
+}
 
 #define _syscall3(type,name,type1,arg1,type2,arg2,type3,arg3) \
 type host_##name(type1 arg1,type2 arg2,type3 arg3) \
@@ -58,4 +73,10 @@ _syscall3(int, open, const char*, pathname, int, flags, mode_t, mode);
 _syscall6(void *,mmap2, void *,addr, size_t, length, int, prot, int, flags, int, fd, off_t, offset);
 _syscall1(void, exit, int, status);
 _syscall1(int, close, int, status);
+_syscall3(off_t, lseek, int, fd, off_t, offset, int, whence);
+_syscall2(int, gettimeofday, struct host_timeval *, tv, void *, tz);
+_syscall2(int, stat, const char *, name, struct host_stat *, buf);
+_syscall3(int, getdents, int, fd, void *, dirp, unsigned, count);
+_syscall2(int, nanosleep, const struct host_timespec *, req, struct host_timespec *, rem);
+_syscall2(int, clock_gettime, int, clk_id, struct host_timespec *, tp);
 
@@ -12,6 +12,52 @@ ssize_t host_read( int fd, void * buf, size_t count );
 ssize_t host_write( int fd, const void * buf, size_t count );
 int host_open( const char *name, int flags, mode_t mode );
 int host_close( int fd );
+off_t host_lseek( int fd, off_t offset, int whence );
+
+// Time structures (as seen by the i386 kernel)
+struct host_timeval
+{
+  long tv_sec;
+  long tv_usec;
+};
+
+struct host_timespec
+{
+  long tv_sec;
+  long tv_nsec;
+};
+
+// File information (as returned by the i386 'stat' system call)
+struct host_stat
+{
+  unsigned long st_dev;
+  unsigned long st_ino;
+  unsigned short st_mode;
+  unsigned short st_nlink;
+  unsigned short st_uid;
+  unsigned short st_gid;
+  unsigned long st_rdev;
+  unsigned long st_size;
+  unsigned long st_blksize;
+  unsigned long st_blocks;
+  unsigned long st_atime;
+  unsigned long st_atime_nsec;
+  unsigned long st_mtime;
+  unsigned long st_mtime_nsec;
+  unsigned long st_ctime;
+  unsigned long st_ctime_nsec;
+  unsigned long unused4;
+  unsigned long unused5;
+};
+
+int host_stat( const char *name, struct host_stat *buf );
+int host_getdents( int fd, void *dirp, unsigned count );
+int host_gettimeofday( struct host_timeval *tv, void *tz );
+int host_nanosleep( const struct host_timespec *req, struct host_timespec *rem );
+int host_clock_gettime( int clk_id, struct host_timespec *tp );
+
+// Clocks for "clock_gettime"
+#define HOST_CLOCK_MONOTONIC 1
 
 #define PROT_READ 0x1   /* Page can be read.  */
 #define PROT_WRITE  0x2   /* Page can be written.  */
@@ -27,6 +73,11 @@ int host_close( int fd );
 #define O_RDONLY	     00
 #define O_WRONLY	     01
 
+// Flags for "lseek"
+#define SEEK_SET        0
+#define SEEK_CUR        1
+#define SEEK_END        2
+
 #define MAP_FAILED (void *)(-1)
 
 void *host_mmap2(void *addr, size_t length, int prot, int flags, int fd, off_t pgoffset);
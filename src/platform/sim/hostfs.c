@@ -0,0 +1,230 @@
+// Host file system for the simulator
+// Maps '/host/<path>' to '<path>' in a directory of the host (HOSTFS_ROOT),
+// using the host system calls directly (no protocol and no copying besides
+// the one done by the host kernel). The descriptors returned to the device
+// manager are the host file descriptors.
+
+#include "platform_conf.h"
+#ifdef BUILD_HOSTFS
+#include "type.h"
+#include "devman.h"
+#include "hostif.h"
+#include "hostfs.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+
+// Host directory shared with eLua (relative to the current directory of the simulator)
+#ifndef HOSTFS_ROOT
+#define HOSTFS_ROOT           "."
+#endif
+
+// Maximum number of directories opened at the same time
+#ifndef HOSTFS_MAX_DIRS
+#define HOSTFS_MAX_DIRS       2
+#endif
+
+#define HOSTFS_MAX_PATH       256
+#define HOSTFS_DIRBUF_SIZE    512
+
+// Directory data
+typedef struct
+{
+  int fd;
+  unsigned pos, len;
+  char path[ HOSTFS_MAX_PATH ];
+  char buf[ HOSTFS_DIRBUF_SIZE ];
+} HOSTFS_DIR;
+
+static HOSTFS_DIR hostfs_dirs[ HOSTFS_MAX_DIRS ];
+
+// Build the host name of a file (returns 0 if the name is too long)
+static int hostfs_make_path( char *dest, const char *path )
+{
+  while( *path == '/' )
+    path ++;
+  if( strlen( HOSTFS_ROOT ) + strlen( path ) + 2 > HOSTFS_MAX_PATH )
+    return 0;
+  strcpy( dest, HOSTFS_ROOT );
+  if( *path )
+  {
+    strcat( dest, "/" );
+    strcat( dest, path );
+  }
+  return 1;
+}
+
+static int hostfs_open_r( struct _reent *r, const char *path, int flags, int mode )
+{
+  char hpath[ HOSTFS_MAX_PATH ];
+  int hflags, fd;
+
+  if( !hostfs_make_path( hpath, path ) )
+  {
+    r->_errno = ENAMETOOLONG;
+    return -1;
+  }
+  // Translate the newlib flags to host flags
+  switch( flags & O_ACCMODE )
+  {
+    case O_WRONLY:
+      hflags = HOSTIF_O_WRONLY;
+      break;
+
+    case O_RDWR:
+      hflags = HOSTIF_O_RDWR;
+      break;
+
+    default:
+      hflags = HOSTIF_O_RDONLY;
+      break;
+  }
+  if( flags & O_CREAT )
+    hflags |= HOSTIF_O_CREAT;
+  if( flags & O_EXCL )
+    hflags |= HOSTIF_O_EXCL;
+  if( flags & O_TRUNC )
+    hflags |= HOSTIF_O_TRUNC;
+  if( flags & O_APPEND )
+    hflags |= HOSTIF_O_APPEND;
+  if( ( fd = hostif_open( hpath, hflags, 0644 ) ) == -1 )
+    r->_errno = hostif_errno();
+  return fd;
+}
+
+static int hostfs_close_r( struct _reent *r, int fd )
+{
+  return hostif_close( fd );
+}
+
+static _ssize_t hostfs_write_r( struct _reent *r, int fd, const void* ptr, size_t len )
+{
+  int res;
+
+  if( ( res = hostif_write( fd, ptr, len ) ) == -1 )
+    r->_errno = hostif_errno();
+  return res;
+}
+
+static _ssize_t hostfs_read_r( struct _reent *r, int fd, void* ptr, size_t len )
+{
+  int res;
+
+  if( ( res = hostif_read( fd, ptr, len ) ) == -1 )
+    r->_errno = hostif_errno();
+  return res;
+}
+
+static off_t hostfs_lseek_r( struct _reent *r, int fd, off_t off, int whence )
+{
+  long res;
+
+  if( ( res = hostif_lseek( fd, off, whence ) ) == -1 )
+    r->_errno = hostif_errno();
+  return res;
+}
+
+// opendir
+static void* hostfs_opendir_r( struct _reent *r, const char* dname )
+{
+  HOSTFS_DIR *d;
+  unsigned i;
+
+  for( i = 0; i < HOSTFS_MAX_DIRS; i ++ )
+    if( hostfs_dirs[ i ].fd == -1 )
+      break;
+  if( i == HOSTFS_MAX_DIRS )
+  {
+    r->_errno = ENFILE;
+    return NULL;
+  }
+  d = hostfs_dirs + i;
+  if( !hostfs_make_path( d->path, dname ) )
+  {
+    r->_errno = ENAMETOOLONG;
+    return NULL;
+  }
+  if( ( d->fd = hostif_open( d->path, HOSTIF_O_RDONLY | HOSTIF_O_DIRECTORY, 0 ) ) == -1 )
+  {
+    r->_errno = hostif_errno();
+    return NULL;
+  }
+  d->pos = d->len = 0;
+  return d;
+}
+
+// readdir
+extern struct dm_dirent dm_shared_dirent;
+extern char dm_shared_fname[ DM_MAX_FNAME_LENGTH + 1 ];
+static struct dm_dirent* hostfs_readdir_r( struct _reent *r, void *dir )
+{
+  HOSTFS_DIR *d = ( HOSTFS_DIR* )dir;
+  struct dm_dirent *pent = &dm_shared_dirent;
+  struct hostif_dirent *pd;
+  char hpath[ HOSTFS_MAX_PATH ];
+  unsigned size, mtime;
+  int res, isdir;
+
+  while( 1 )
+  {
+    if( d->pos >= d->len )
+    {
+      if( ( res = hostif_getdents( d->fd, d->buf, HOSTFS_DIRBUF_SIZE ) ) <= 0 )
+        return NULL;
+      d->len = res;
+      d->pos = 0;
+    }
+    pd = ( struct hostif_dirent* )( d->buf + d->pos );
+    d->pos += pd->d_reclen;
+    // Only regular files with names that eLua can handle are listed
+    if( pd->d_name[ 0 ] == '.' || strlen( pd->d_name ) > DM_MAX_FNAME_LENGTH )
+      continue;
+    if( strlen( d->path ) + strlen( pd->d_name ) + 2 > HOSTFS_MAX_PATH )
+      continue;
+    strcpy( hpath, d->path );
+    strcat( hpath, "/" );
+    strcat( hpath, pd->d_name );
+    if( hostif_stat( hpath, &size, &mtime, &isdir ) == -1 || isdir )
+      continue;
+    strcpy( dm_shared_fname, pd->d_name );
+    pent->fname = dm_shared_fname;
+    pent->fsize = size;
+    pent->ftime = mtime;
+    return pent;
+  }
+}
+
+// closedir
+static int hostfs_closedir_r( struct _reent *r, void *dir )
+{
+  HOSTFS_DIR *d = ( HOSTFS_DIR* )dir;
+  int res = hostif_close( d->fd );
+
+  d->fd = -1;
+  return res;
+}
+
+// Host file system device descriptor structure
+static const DM_DEVICE hostfs_device =
+{
+  "/host",
+  hostfs_open_r,         // open
+  hostfs_close_r,        // close
+  hostfs_write_r,        // write
+  hostfs_read_r,         // read
+  hostfs_lseek_r,        // lseek
+  hostfs_opendir_r,      // opendir
+  hostfs_readdir_r,      // readdir
+  hostfs_closedir_r      // closedir
+};
+
+const DM_DEVICE* hostfs_init()
+{
+  unsigned i;
+
+  for( i = 0; i < HOSTFS_MAX_DIRS; i ++ )
+    hostfs_dirs[ i ].fd = -1;
+  return &hostfs_device;
+}
+
+#endif // #ifdef BUILD_HOSTFS
@@ -0,0 +1,12 @@
+// Host file system for the simulator
+
+#ifndef __HOSTFS_H__
+#define __HOSTFS_H__
+
+#include "type.h"
+#include "devman.h"
+
+// FS functions
+const DM_DEVICE* hostfs_init();
+
+#endif
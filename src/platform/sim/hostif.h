@@ -15,9 +15,22 @@ int hostif_getch();
 // Get memory
 void *hostif_getmem( unsigned size );
 
+// Map 'size' bytes of an open file in memory (changes are written to the file)
+void *hostif_mapfile( int fd, unsigned size );
+
 // Terminate the simulator (exit program)
 void hostif_exit();
 
+// Flags for hostif_open (Linux values, they are different from the newlib ones)
+#define HOSTIF_O_RDONLY       00
+#define HOSTIF_O_WRONLY       01
+#define HOSTIF_O_RDWR         02
+#define HOSTIF_O_CREAT        0100
+#define HOSTIF_O_EXCL         0200
+#define HOSTIF_O_TRUNC        01000
+#define HOSTIF_O_APPEND       02000
+#define HOSTIF_O_DIRECTORY    0200000
+
 // Open
 int hostif_open( const char* name, int flags, unsigned mode );
 
@@ -30,5 +43,39 @@ int hostif_write( int fd, const void *buf, unsigned count );
 // Close
 int hostif_close( int fd );
 
+// Directory entry (as returned by hostif_getdents)
+struct hostif_dirent
+{
+  unsigned long d_ino;
+  unsigned long d_off;
+  unsigned short d_reclen;
+  char d_name[ 1 ];
+};
+
+// Read directory entries from a directory opened with HOSTIF_O_DIRECTORY
+// Returns the number of bytes read, 0 at the end of the directory or -1 for error
+int hostif_getdents( int fd, void *buf, unsigned count );
+
+// Get the size and modification time of a file (returns 0 for OK, -1 for error)
+int hostif_stat( const char *name, unsigned *psize, unsigned *pmtime, int *pisdir );
+
+// Get the error code of the last failed operation (errno on the host)
+int hostif_errno();
+
+// Seek (returns the new offset or -1 for error)
+long hostif_lseek( int fd, long offset, int whence );
+
+// Get the host time in seconds since the epoch (UTC)
+long hostif_time();
+
+// Get the host time in microseconds (wraps around every ~71 minutes)
+unsigned hostif_gettime_us();
+
+// Get the time of the host monotonic clock in nanoseconds
+unsigned long long hostif_gettime_ns();
+
+// Sleep for the given number of microseconds
+void hostif_sleep_us( unsigned us );
+
 #endif // __HOSTIO_H__
 
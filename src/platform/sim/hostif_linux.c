@@ -39,6 +39,12 @@ void* hostif_getmem( unsigned size )
   return pmem == MAP_FAILED ? NULL : pmem;
 }
 
+void* hostif_mapfile( int fd, unsigned size )
+{
+  void *pmem = host_mmap2( 0, size, (PROT_READ|PROT_WRITE), MAP_SHARED, fd, 0 );
+  return pmem == MAP_FAILED ? NULL : pmem;
+}
+
 void hostif_exit()
 {
   host_exit( 0 );
@@ -64,3 +70,62 @@ int hostif_close( int fd )
   return host_close( fd );
 }
 
+long hostif_lseek( int fd, long offset, int whence )
+{
+  return ( long )host_lseek( fd, ( off_t )offset, whence );
+}
+
+int hostif_getdents( int fd, void *buf, unsigned count )
+{
+  return host_getdents( fd, buf, count );
+}
+
+int hostif_stat( const char *name, unsigned *psize, unsigned *pmtime, int *pisdir )
+{
+  struct host_stat st;
+
+  if( host_stat( name, &st ) == -1 )
+    return -1;
+  *psize = st.st_size;
+  *pmtime = st.st_mtime;
+  *pisdir = ( st.st_mode & 0170000 ) == 0040000;
+  return 0;
+}
+
+int hostif_errno()
+{
+  return host_errno;
+}
+
+long hostif_time()
+{
+  struct host_timeval tv;
+
+  host_gettimeofday( &tv, NULL );
+  return tv.tv_sec;
+}
+
+unsigned hostif_gettime_us()
+{
+  struct host_timeval tv;
+
+  host_gettimeofday( &tv, NULL );
+  return ( unsigned )tv.tv_sec * 1000000 + ( unsigned )tv.tv_usec;
+}
+
+unsigned long long hostif_gettime_ns()
+{
+  struct host_timespec ts;
+
+  host_clock_gettime( HOST_CLOCK_MONOTONIC, &ts );
+  return ( unsigned long long )ts.tv_sec * 1000000000ULL + ( unsigned long )ts.tv_nsec;
+}
+
+void hostif_sleep_us( unsigned us )
+{
+  struct host_timespec ts;
+
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = ( us % 1000000 ) * 1000;
+  host_nanosleep( &ts, NULL );
+}
@@ -0,0 +1,90 @@
+// I2C emulation for the simulator
+// There is a single device on the bus, at address I2C_SIM_ADDRESS, that works
+// like most I2C sensors and EEPROMs: it has 256 8-bit registers and a register
+// pointer. The first byte written after the address sets the pointer, the next
+// bytes are written to the registers. Reads start at the pointer. The pointer
+// is incremented after each register access. Register 'n' is initialized with
+// 'n'. If I2C_SIM_BYTE_TIME_US is defined, each byte on the bus (including the
+// address) takes that many microseconds.
+
+#include "platform_conf.h"
+#if defined( NUM_I2C ) && NUM_I2C > 0
+#include "type.h"
+#include "platform.h"
+#include "hostif.h"
+
+static u8 i2c_sim_regs[ 256 ];
+static u8 i2c_sim_ptr;
+static int i2c_sim_selected;      // the device was addressed
+static int i2c_sim_direction;     // direction of the current transfer
+static int i2c_sim_first;         // the next byte written is the register pointer
+
+// Wait for the transfer of a byte
+static void i2c_sim_byte_time()
+{
+#ifdef I2C_SIM_BYTE_TIME_US
+  u32 start = hostif_gettime_us();
+
+  while( hostif_gettime_us() - start < I2C_SIM_BYTE_TIME_US );
+#endif
+}
+
+void i2c_sim_init()
+{
+  unsigned i;
+
+  for( i = 0; i < 256; i ++ )
+    i2c_sim_regs[ i ] = i;
+}
+
+u32 platform_i2c_setup( unsigned id, u32 speed )
+{
+  i2c_sim_selected = 0;
+  return speed;
+}
+
+void platform_i2c_send_start( unsigned id )
+{
+  i2c_sim_selected = 0;
+}
+
+void platform_i2c_send_stop( unsigned id )
+{
+  i2c_sim_selected = 0;
+}
+
+int platform_i2c_send_address( unsigned id, u16 address, int direction )
+{
+  i2c_sim_byte_time();
+  if( address != I2C_SIM_ADDRESS )
+    return 0;
+  i2c_sim_selected = 1;
+  i2c_sim_direction = direction;
+  i2c_sim_first = 1;
+  return 1;
+}
+
+int platform_i2c_send_byte( unsigned id, u8 data )
+{
+  if( !i2c_sim_selected || i2c_sim_direction != PLATFORM_I2C_DIRECTION_TRANSMITTER )
+    return 0;
+  i2c_sim_byte_time();
+  if( i2c_sim_first )
+  {
+    i2c_sim_ptr = data;
+    i2c_sim_first = 0;
+  }
+  else
+    i2c_sim_regs[ i2c_sim_ptr ++ ] = data;
+  return 1;
+}
+
+int platform_i2c_recv_byte( unsigned id, int ack )
+{
+  if( !i2c_sim_selected || i2c_sim_direction != PLATFORM_I2C_DIRECTION_RECEIVER )
+    return -1;
+  i2c_sim_byte_time();
+  return i2c_sim_regs[ i2c_sim_ptr ++ ];
+}
+
+#endif // #if defined( NUM_I2C ) && NUM_I2C > 0
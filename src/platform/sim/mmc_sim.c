@@ -0,0 +1,160 @@
+// File backed SD/MMC card for the simulator
+// Implements the low level disk functions used by FatFs (through the sector
+// cache in src/mmc_cache.c) on top of a host image file (MMCFS_SIM_IMAGE).
+// The image must contain a FAT file system without a partition table, it can
+// be created with 'mkfs.vfat -C <image> <size in KB>' for example.
+// The timing of a SPI SD card can be modeled with a fixed latency for each
+// command (MMCFS_SIM_READ_LATENCY_US, MMCFS_SIM_WRITE_LATENCY_US) and a
+// maximum transfer speed (MMCFS_SIM_KBPS, in kilobytes per second).
+
+#include "platform_conf.h"
+#if defined( BUILD_MMCFS ) && defined( MMCFS_SIM_IMAGE )
+#include "type.h"
+#include "diskio.h"
+#include "hostif.h"
+#include <stdio.h>
+
+#ifndef MMCFS_SIM_READ_LATENCY_US
+#define MMCFS_SIM_READ_LATENCY_US     0
+#endif
+
+#ifndef MMCFS_SIM_WRITE_LATENCY_US
+#define MMCFS_SIM_WRITE_LATENCY_US    0
+#endif
+
+// Transfer speed (0 for no limit)
+#ifndef MMCFS_SIM_KBPS
+#define MMCFS_SIM_KBPS                0
+#endif
+
+#define MMC_SIM_SECTOR_SIZE           512
+
+static int mmc_sim_fd = -1;
+static DWORD mmc_sim_sectors;
+
+// Wait for the time needed by a command that transfers 'count' sectors
+static void mmc_sim_delay( u32 latency, BYTE count )
+{
+  u32 us = latency;
+
+#if MMCFS_SIM_KBPS > 0
+  us += ( u32 )count * MMC_SIM_SECTOR_SIZE * 1000 / MMCFS_SIM_KBPS;
+#endif
+  if( us > 0 )
+    hostif_sleep_us( us );
+}
+
+// Move to the given sector in the image
+static int mmc_sim_seek( DWORD sector, BYTE count )
+{
+  if( mmc_sim_fd == -1 )
+    return 0;
+  if( sector + count > mmc_sim_sectors )
+    return 0;
+  return hostif_lseek( mmc_sim_fd, ( long )sector * MMC_SIM_SECTOR_SIZE, SEEK_SET ) != -1;
+}
+
+DSTATUS disk_raw_initialize( BYTE drv )
+{
+  long size;
+
+  if( drv )
+    return STA_NOINIT;
+  if( mmc_sim_fd == -1 )
+  {
+    if( ( mmc_sim_fd = hostif_open( MMCFS_SIM_IMAGE, HOSTIF_O_RDWR, 0 ) ) == -1 )
+      return STA_NOINIT | STA_NODISK;
+    if( ( size = hostif_lseek( mmc_sim_fd, 0, SEEK_END ) ) == -1 )
+    {
+      hostif_close( mmc_sim_fd );
+      mmc_sim_fd = -1;
+      return STA_NOINIT | STA_NODISK;
+    }
+    mmc_sim_sectors = size / MMC_SIM_SECTOR_SIZE;
+  }
+  return 0;
+}
+
+DSTATUS disk_status( BYTE drv )
+{
+  if( drv )
+    return STA_NOINIT;
+  return mmc_sim_fd == -1 ? STA_NOINIT : 0;
+}
+
+DRESULT disk_raw_read( BYTE drv, BYTE *buff, DWORD sector, BYTE count )
+{
+  unsigned size = ( unsigned )count * MMC_SIM_SECTOR_SIZE;
+
+  if( drv || !count )
+    return RES_PARERR;
+  if( !mmc_sim_seek( sector, count ) )
+    return RES_NOTRDY;
+  mmc_sim_delay( MMCFS_SIM_READ_LATENCY_US, count );
+  return hostif_read( mmc_sim_fd, buff, size ) == size ? RES_OK : RES_ERROR;
+}
+
+#if _READONLY == 0
+DRESULT disk_raw_write( BYTE drv, const BYTE *buff, DWORD sector, BYTE count )
+{
+  unsigned size = ( unsigned )count * MMC_SIM_SECTOR_SIZE;
+
+  if( drv || !count )
+    return RES_PARERR;
+  if( !mmc_sim_seek( sector, count ) )
+    return RES_NOTRDY;
+  mmc_sim_delay( MMCFS_SIM_WRITE_LATENCY_US, count );
+  return hostif_write( mmc_sim_fd, buff, size ) == size ? RES_OK : RES_ERROR;
+}
+#endif // #if _READONLY == 0
+
+DRESULT disk_raw_ioctl( BYTE drv, BYTE ctrl, void *buff )
+{
+  if( drv )
+    return RES_PARERR;
+  if( mmc_sim_fd == -1 )
+    return RES_NOTRDY;
+  switch( ctrl )
+  {
+    case CTRL_SYNC:
+      return RES_OK;
+
+    case GET_SECTOR_COUNT:
+      *( DWORD* )buff = mmc_sim_sectors;
+      return RES_OK;
+
+    case GET_SECTOR_SIZE:
+      *( WORD* )buff = MMC_SIM_SECTOR_SIZE;
+      return RES_OK;
+
+    case GET_BLOCK_SIZE:
+      *( DWORD* )buff = 1;
+      return RES_OK;
+  }
+  return RES_PARERR;
+}
+
+// FatFs time stamp, uses the time of the host
+DWORD get_fattime()
+{
+  long t = hostif_time();
+  u32 days = t / 86400, secs = t % 86400;
+  u32 era, doe, yoe, doy, mp, year, month, day;
+
+  // Convert the number of days since 1970-01-01 to a date
+  days += 719468;
+  era = days / 146097;
+  doe = days - era * 146097;
+  yoe = ( doe - doe / 1460 + doe / 36524 - doe / 146096 ) / 365;
+  doy = doe - ( 365 * yoe + yoe / 4 - yoe / 100 );
+  mp = ( 5 * doy + 2 ) / 153;
+  day = doy - ( 153 * mp + 2 ) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = yoe + era * 400 + ( month <= 2 );
+  if( year < 1980 )
+    year = 1980;
+  return ( ( year - 1980 ) << 25 ) | ( month << 21 ) | ( day << 16 ) |
+         ( ( secs / 3600 ) << 11 ) | ( ( secs / 60 % 60 ) << 5 ) | ( secs % 60 / 2 );
+}
+
+#endif // #if defined( BUILD_MMCFS ) && defined( MMCFS_SIM_IMAGE )
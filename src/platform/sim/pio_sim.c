@@ -0,0 +1,165 @@
+// PIO emulation for the simulator
+// The ports are simple output latches (what is written can be read back, the
+// pins have no other state). The pin programs (platform_pio_run) run in
+// virtual time: the port writes take no time and the delays advance a virtual
+// clock (in ns, PIO_PROG_CLOCK is 1GHz). Each output change made by a program
+// is recorded with its virtual time, so the generated waveforms can be checked
+// from Lua with sim.pio.record().
+
+#include "platform_conf.h"
+#if NUM_PIO > 0
+#include "type.h"
+#include "platform.h"
+#include "lua.h"
+#include "lauxlib.h"
+#include "lrotable.h"
+
+typedef struct
+{
+  u32 time;
+  u8 port;
+  pio_type value;
+} pio_sim_event;
+
+static pio_type pio_sim_latch[ NUM_PIO ];
+static pio_type pio_sim_dir[ NUM_PIO ];
+static pio_sim_event pio_sim_events[ PIO_SIM_REC_SIZE ];
+static unsigned pio_sim_nevents;
+static u32 pio_sim_lost;
+static u32 pio_sim_time;
+
+void pio_sim_init()
+{
+  unsigned i;
+
+  for( i = 0; i < NUM_PIO; i ++ )
+    pio_sim_latch[ i ] = pio_sim_dir[ i ] = 0;
+  pio_sim_nevents = pio_sim_lost = pio_sim_time = 0;
+}
+
+pio_type platform_pio_op( unsigned port, pio_type pinmask, int op )
+{
+  pio_type retval = 1;
+
+  switch( op )
+  {
+    case PLATFORM_IO_PORT_SET_VALUE:
+      pio_sim_latch[ port ] = pinmask;
+      break;
+
+    case PLATFORM_IO_PIN_SET:
+      pio_sim_latch[ port ] |= pinmask;
+      break;
+
+    case PLATFORM_IO_PIN_CLEAR:
+      pio_sim_latch[ port ] &= ~pinmask;
+      break;
+
+    case PLATFORM_IO_PORT_DIR_OUTPUT:
+      pinmask = PLATFORM_IO_ALL_PINS;
+    case PLATFORM_IO_PIN_DIR_OUTPUT:
+      pio_sim_dir[ port ] |= pinmask;
+      break;
+
+    case PLATFORM_IO_PORT_DIR_INPUT:
+      pinmask = PLATFORM_IO_ALL_PINS;
+    case PLATFORM_IO_PIN_DIR_INPUT:
+      pio_sim_dir[ port ] &= ~pinmask;
+      break;
+
+    case PLATFORM_IO_PORT_GET_VALUE:
+      retval = pio_sim_latch[ port ] & pinmask;
+      break;
+
+    case PLATFORM_IO_PIN_GET:
+      retval = ( pio_sim_latch[ port ] & pinmask ) ? 1 : 0;
+      break;
+
+    default:
+      retval = 0;
+      break;
+  }
+  return retval;
+}
+
+// Write a port latch and record the change
+static void pio_sim_write( unsigned port, pio_type value )
+{
+  if( value == pio_sim_latch[ port ] )
+    return;
+  pio_sim_latch[ port ] = value;
+  if( pio_sim_nevents == PIO_SIM_REC_SIZE )
+  {
+    pio_sim_lost ++;
+    return;
+  }
+  pio_sim_events[ pio_sim_nevents ].time = pio_sim_time;
+  pio_sim_events[ pio_sim_nevents ].port = port;
+  pio_sim_events[ pio_sim_nevents ++ ].value = value;
+}
+
+void platform_pio_run( const platform_pio_step *steps, unsigned nsteps )
+{
+  pio_type v;
+
+  for( ; nsteps; nsteps --, steps ++ )
+  {
+    v = pio_sim_latch[ steps->port ];
+    switch( steps->op )
+    {
+      case PLATFORM_PIO_STEP_SET:
+        pio_sim_write( steps->port, v | steps->mask );
+        break;
+
+      case PLATFORM_PIO_STEP_CLEAR:
+        pio_sim_write( steps->port, v & ~steps->mask );
+        break;
+
+      case PLATFORM_PIO_STEP_WRITE:
+        pio_sim_write( steps->port, ( v & ~steps->mask ) | ( steps->data & steps->mask ) );
+        break;
+
+      case PLATFORM_PIO_STEP_DELAY:
+        pio_sim_time += steps->data;
+        break;
+    }
+  }
+}
+
+// ****************************************************************************
+// Recorder access from Lua (sim.pio)
+
+// Lua: events, lost = sim.pio.record()
+// Returns the output changes made by the pin programs since the last call as
+// an array of { time, port, value } tables (time is in ns, starting at 0 after
+// each call) and the number of changes that didn't fit in the buffer
+static int sim_pio_record( lua_State *L )
+{
+  unsigned i;
+
+  lua_createtable( L, pio_sim_nevents, 0 );
+  for( i = 0; i < pio_sim_nevents; i ++ )
+  {
+    lua_createtable( L, 3, 0 );
+    lua_pushnumber( L, pio_sim_events[ i ].time );
+    lua_rawseti( L, -2, 1 );
+    lua_pushinteger( L, PLATFORM_IO_ENCODE( pio_sim_events[ i ].port, 0, PLATFORM_IO_ENC_PORT ) );
+    lua_rawseti( L, -2, 2 );
+    lua_pushnumber( L, pio_sim_events[ i ].value );
+    lua_rawseti( L, -2, 3 );
+    lua_rawseti( L, -2, i + 1 );
+  }
+  lua_pushinteger( L, pio_sim_lost );
+  pio_sim_nevents = pio_sim_lost = pio_sim_time = 0;
+  return 2;
+}
+
+#define MIN_OPT_LEVEL 2
+#include "lrodefs.h"
+const LUA_REG_TYPE sim_pio_map[] =
+{
+  { LSTRKEY( "record" ), LFUNCVAL( sim_pio_record ) },
+  { LNILKEY, LNILVAL }
+};
+
+#endif // #if NUM_PIO > 0
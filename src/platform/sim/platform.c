@@ -10,6 +10,9 @@
 #include <string.h>
 #include <ctype.h>
 #include "term.h"
+#include "lua.h"
+#include "lauxlib.h"
+#include "lrotable.h"
 
 // Platform specific includes
 #include "hostif.h"
@@ -85,6 +88,26 @@ static int kb_read( s32 to )
 // ****************************************************************************
 // Platform initialization (low-level and full)
 
+#ifdef BUILD_ADC
+// ADC emulation (adc_sim.c)
+void adc_sim_init();
+#endif
+
+#if NUM_CAN > 0
+// CAN emulation (can_sim.c)
+void can_sim_init();
+#endif
+
+#if NUM_I2C > 0
+// I2C emulation (i2c_sim.c)
+void i2c_sim_init();
+#endif
+
+#if NUM_PIO > 0
+// PIO emulation (pio_sim.c)
+void pio_sim_init();
+#endif
+
 void *memory_start_address = 0;
 void *memory_end_address = 0;
 
@@ -115,6 +138,22 @@ int platform_init()
 
   term_clrscr();
   term_gotoxy( 1, 1 );
+
+#ifdef BUILD_ADC
+  adc_sim_init();
+#endif
+
+#if NUM_CAN > 0
+  can_sim_init();
+#endif
+
+#if NUM_I2C > 0
+  i2c_sim_init();
+#endif
+
+#if NUM_PIO > 0
+  pio_sim_init();
+#endif
  
   // All done
   return PLATFORM_OK;
@@ -143,15 +182,51 @@ int platform_s_uart_set_flow_control( unsigned id, int type )
 }
 
 // ****************************************************************************
-// "Dummy" timer functions
+// Timer functions
+// There is a single timer that counts microseconds using the host time
 
 void platform_s_timer_delay( unsigned id, u32 delay_us )
 {
+  hostif_sleep_us( delay_us );
 }
 
 u32 platform_s_timer_op( unsigned id, int op, u32 data )
 {
-  return 0;
+  u32 res = 0;
+
+  switch( op )
+  {
+    case PLATFORM_TIMER_OP_START:
+    case PLATFORM_TIMER_OP_READ:
+      res = hostif_gettime_us();
+      break;
+
+    case PLATFORM_TIMER_OP_GET_MAX_DELAY:
+      res = platform_timer_get_diff_us( id, 0, 0xFFFFFFFF );
+      break;
+
+    case PLATFORM_TIMER_OP_GET_MIN_DELAY:
+      res = platform_timer_get_diff_us( id, 0, 1 );
+      break;
+
+    case PLATFORM_TIMER_OP_SET_CLOCK:
+    case PLATFORM_TIMER_OP_GET_CLOCK:
+      res = 1000000;
+      break;
+  }
+  return res;
+}
+
+// The timebase is the monotonic clock of the host (in nanoseconds)
+u64 platform_timebase_read()
+{
+  return hostif_gettime_ns();
+}
+
+// The virtual timers use the same host time (VTMR_TICKLESS and VTMR_POLLED)
+u32 platform_vtmr_get_count()
+{
+  return hostif_gettime_us();
 }
 
 // ****************************************************************************
@@ -168,3 +243,39 @@ int platform_cpu_get_global_interrupts()
   return 0;
 }
 
+// ****************************************************************************
+// Platform specific modules go here
+
+#define MIN_OPT_LEVEL 2
+#include "lrodefs.h"
+extern const LUA_REG_TYPE sim_pio_map[];
+extern const LUA_REG_TYPE sim_pwm_map[];
+
+const LUA_REG_TYPE platform_map[] =
+{
+#if LUA_OPTIMIZE_MEMORY > 0
+  { LSTRKEY( "pio" ), LROVAL( sim_pio_map ) },
+  { LSTRKEY( "pwm" ), LROVAL( sim_pwm_map ) },
+#endif
+  { LNILKEY, LNILVAL }
+};
+
+LUALIB_API int luaopen_platform( lua_State *L )
+{
+#if LUA_OPTIMIZE_MEMORY > 0
+  return 0;
+#else // #if LUA_OPTIMIZE_MEMORY > 0
+  luaL_register( L, PS_LIB_TABLE_NAME, platform_map );
+
+  // Setup the new tables inside platform table
+  lua_newtable( L );
+  luaL_register( L, NULL, sim_pio_map );
+  lua_setfield( L, -2, "pio" );
+
+  lua_newtable( L );
+  luaL_register( L, NULL, sim_pwm_map );
+  lua_setfield( L, -2, "pwm" );
+
+  return 1;
+#endif // #if LUA_OPTIMIZE_MEMORY > 0
+}
@@ -15,6 +15,13 @@
 #define BUILD_ROMFS
 #define BUILD_CON_GENERIC
 #define BUILD_TERM
+#define BUILD_MMCFS
+#define BUILD_HOSTFS
+#define BUILD_WOFS
+#define BUILD_ADC
+#define BUILD_ADC_STREAM
+#define BUILD_PIO_PROG
+#define BUILD_PWM_SEQ
 //#define BUILD_RFS
 
 #define TERM_LINES    25
@@ -23,11 +30,23 @@
 // *****************************************************************************
 // Auxiliary libraries that will be compiled for this platform
 
+// The name of the platform specific libs table
+#define PS_LIB_TABLE_NAME   "sim"
+
 #define LUA_PLATFORM_LIBS_ROM\
+  _ROM( AUXLIB_PIO, luaopen_pio, pio_map )\
+  _ROM( AUXLIB_PWM, luaopen_pwm, pwm_map )\
   _ROM( AUXLIB_PD, luaopen_pd, pd_map )\
   _ROM( LUA_MATHLIBNAME, luaopen_math, math_map )\
   _ROM( AUXLIB_TERM, luaopen_term, term_map )\
-  _ROM( AUXLIB_ELUA, luaopen_elua, elua_map )
+  _ROM( AUXLIB_TMR, luaopen_tmr, tmr_map )\
+  _ROM( AUXLIB_ADC, luaopen_adc, adc_map )\
+  _ROM( AUXLIB_SBUF, luaopen_sbuf, sbuf_map )\
+  _ROM( AUXLIB_DSP, luaopen_dsp, dsp_map )\
+  _ROM( AUXLIB_CAN, luaopen_can, can_map )\
+  _ROM( AUXLIB_I2C, luaopen_i2c, i2c_map )\
+  _ROM( AUXLIB_ELUA, luaopen_elua, elua_map )\
+  _ROM( PS_LIB_TABLE_NAME, luaopen_platform, platform_map )
 
 // Bogus defines for common.c
 #define CON_UART_ID           0
@@ -37,17 +56,54 @@
 // *****************************************************************************
 // Configuration data
 
-// Virtual timers (0 if not used)
-#define VTMR_NUM_TIMERS       0
+// Virtual timers (0 if not used). They count microseconds of host time and
+// their matches are polled by the timer functions.
+#define VTMR_NUM_TIMERS       4
+#define VTMR_FREQ_HZ          1000000
+#define VTMR_TICKLESS
+#define VTMR_POLLED
 
 // Number of resources (0 if not available/not implemented)
-#define NUM_PIO               0
+#define NUM_PIO               2
 #define NUM_SPI               0
 #define NUM_UART              0
-#define NUM_TIMER             0
-#define NUM_PWM               0
-#define NUM_ADC               0
-#define NUM_CAN               0
+#define NUM_TIMER             1
+#define NUM_PWM               2
+#define NUM_ADC               4
+#define NUM_CAN               1
+#define NUM_I2C               1
+
+// ADC configuration (synthetic waveforms, see adc_sim.c). There are no
+// interrupts in the simulator, the stream is polled by adc.getblock.
+#define ADC_BIT_RESOLUTION    12
+#define BUF_ENABLE_ADC
+#define ADC_BUF_SIZE          BUF_SIZE_2
+#define ADC_TIMER_FIRST_ID    0
+#define ADC_NUM_TIMERS        1
+#define ADC_STREAM_POLLED
+
+// CAN configuration (loopback interface, see can_sim.c)
+#define CAN_NUM_FILTERS       4
+#define CAN_SIM_FIFO_SIZE     16
+
+// I2C configuration (one emulated device, see i2c_sim.c). A byte takes 22.5us
+// on a 400kHz bus.
+#define I2C_SIM_ADDRESS       0xD0
+#define I2C_SIM_BYTE_TIME_US  23
+
+// PIO configuration (output latches, see pio_sim.c). The pin programs run in
+// virtual time (1 tick = 1ns) and their output changes are recorded.
+#define PIO_PROG_CLOCK        1000000000
+#define PIO_SIM_REC_SIZE      1024
+
+// PWM configuration (no outputs, see pwm_sim.c). The sequences are polled and
+// their duty changes are recorded.
+#define PWM_SIM_CLOCK         1000000
+#define PWM_SEQ_POLLED
+#define PWM_SIM_REC_SIZE      1024
+
+// Timebase (the monotonic clock of the host, in nanoseconds)
+#define TIMEBASE_CLOCK        1000000000
 
 // CPU frequency (needed by the CPU module, 0 if not used)
 #define CPU_FREQUENCY         0
@@ -58,7 +114,7 @@
 // #define PIO_PINS_PER_PORT (n) if each port has the same number of pins, or
 // #define PIO_PIN_ARRAY { n1, n2, ... } to define pins per port in an array
 // Use #define PIO_PINS_PER_PORT 0 if this isn't needed
-#define PIO_PINS_PER_PORT     0
+#define PIO_PINS_PER_PORT     32
 
 // Allocator data: define your free memory zones here in two arrays
 // (start address and end address)
@@ -68,6 +124,22 @@ extern void *memory_end_address;
 #define MEM_START_ADDRESS     { ( void* )memory_start_address }
 #define MEM_END_ADDRESS       { ( void* )memory_end_address }
 
+// SD/MMC card emulation: FAT image file on the host (opened from the current
+// directory of the simulator) and optional timing of a SPI SD card
+#define MMCFS_SIM_IMAGE       "elua_mmc.img"
+//#define MMCFS_SIM_READ_LATENCY_US   300
+//#define MMCFS_SIM_WRITE_LATENCY_US  1000
+//#define MMCFS_SIM_KBPS              1000
+
+// Host file system: '/host/<path>' is '<path>' in this directory of the host
+#define HOSTFS_ROOT           "."
+
+// Internal flash emulation (used by WOFS): host image file (created if it
+// doesn't exist), flash size and sector size
+#define SIM_FLASH_IMAGE       "elua_flash.img"
+#define SIM_FLASH_SIZE        ( 256 * 1024 )
+#define SIM_FLASH_SECTOR_SIZE 4096
+
 // RFS configuration
 #define RFS_TIMEOUT           0 // dummy, always blocking by implementation
 #define RFS_BUFFER_SIZE       BUF_SIZE_512
@@ -0,0 +1,181 @@
+// PWM emulation for the simulator
+// The channels only keep their configuration (there is no output). The duty
+// values of a sequence are applied at the PWM period boundaries, like on the
+// real hardware: each value is held for 'freq / rate' periods. The sequences
+// are polled (PWM_SEQ_POLLED), their position comes from the host clock. Each
+// duty change made by a sequence is recorded with the host time at which it
+// was applied (from the start of the sequence), so the timeline can be checked
+// from Lua with sim.pwm.record().
+
+#include "platform_conf.h"
+#if NUM_PWM > 0
+#include "type.h"
+#include "platform.h"
+#include "common.h"
+#include "hostif.h"
+#include "auxmods.h"
+#include "lua.h"
+#include "lauxlib.h"
+#include "lrotable.h"
+
+typedef struct
+{
+  u32 time;                 // microseconds from the start of the sequence
+  u16 duty;
+} pwm_sim_event;
+
+typedef struct
+{
+  u32 freq;
+  u16 duty;                 // in 1/PLATFORM_PWM_SEQ_DUTY_MAX units
+  u8 running;
+  // Sequence
+  const u16 *seq;
+  u32 seq_count, seq_rate, seq_step, seq_start;
+  u8 seq_mode, seq_active;
+  // Recorder
+  pwm_sim_event events[ PWM_SIM_REC_SIZE ];
+  unsigned nevents;
+  u32 lost;
+} pwm_sim_channel;
+
+static pwm_sim_channel pwm_sim[ NUM_PWM ];
+static u32 pwm_sim_clock = PWM_SIM_CLOCK;
+
+u32 platform_pwm_setup( unsigned id, u32 frequency, unsigned duty )
+{
+  pwm_sim_channel *pc = pwm_sim + id;
+  u32 period = pwm_sim_clock / frequency;
+
+  if( period == 0 )
+    period = 1;
+  pc->freq = pwm_sim_clock / period;
+  pc->duty = duty * ( PLATFORM_PWM_SEQ_DUTY_MAX / 100 );
+  return pc->freq;
+}
+
+u32 platform_pwm_op( unsigned id, int op, u32 data )
+{
+  u32 res = 0;
+
+  switch( op )
+  {
+    case PLATFORM_PWM_OP_SET_CLOCK:
+      if( data > 0 )
+        pwm_sim_clock = data;
+      res = pwm_sim_clock;
+      break;
+
+    case PLATFORM_PWM_OP_GET_CLOCK:
+      res = pwm_sim_clock;
+      break;
+
+    case PLATFORM_PWM_OP_START:
+      pwm_sim[ id ].running = 1;
+      break;
+
+    case PLATFORM_PWM_OP_STOP:
+      pwm_sim[ id ].running = 0;
+      break;
+  }
+  return res;
+}
+
+// ****************************************************************************
+// Sequences
+
+u32 platform_s_pwm_seq_start( unsigned id, u16 *duty, u32 count, u32 rate, int mode )
+{
+  pwm_sim_channel *pc = pwm_sim + id;
+  u32 rep;
+
+  if( pc->freq == 0 || rate == 0 || rate > pc->freq )
+    return 0;
+  rep = ( pc->freq + rate / 2 ) / rate;
+  pc->seq = duty;
+  pc->seq_count = count;
+  pc->seq_rate = pc->freq / rep;
+  pc->seq_mode = mode;
+  pc->seq_step = 0;
+  pc->seq_start = hostif_gettime_us();
+  pc->nevents = pc->lost = 0;
+  pc->seq_active = 1;
+  return pc->seq_rate;
+}
+
+void platform_s_pwm_seq_stop( unsigned id )
+{
+  pwm_sim[ id ].seq_active = 0;
+}
+
+// Apply all the steps of the sequence that are due
+void platform_pwm_seq_poll( unsigned id )
+{
+  pwm_sim_channel *pc = pwm_sim + id;
+  u32 due, now;
+  int finished;
+
+  if( !pc->seq_active )
+    return;
+  now = hostif_gettime_us() - pc->seq_start;
+  due = ( u32 )( ( u64 )now * pc->seq_rate / 1000000 ) + 1;
+  while( pc->seq_active && pc->seq_step < due )
+  {
+    pc->duty = pc->seq[ pc->seq_step % pc->seq_count ];
+    if( pc->nevents < PWM_SIM_REC_SIZE )
+    {
+      pc->events[ pc->nevents ].time = now;
+      pc->events[ pc->nevents ++ ].duty = pc->duty;
+    }
+    else
+      pc->lost ++;
+    if( ++ pc->seq_step % pc->seq_count == 0 )
+    {
+      finished = pc->seq_mode == PLATFORM_PWM_SEQ_ONESHOT;
+      if( finished )
+        pc->seq_active = 0;
+      cmn_pwm_seq_pass_done( id, finished );
+    }
+  }
+}
+
+// ****************************************************************************
+// Recorder access from Lua (sim.pwm)
+
+// Lua: events, lost = sim.pwm.record( id )
+// Returns the duty changes made by the last sequence on channel 'id' since the
+// last call as an array of { time, duty } tables (time is in microseconds
+// from the start of the sequence, duty is in 1/pwm.SEQ_MAX units) and the
+// number of changes that didn't fit in the buffer
+static int sim_pwm_record( lua_State *L )
+{
+  unsigned id = luaL_checkinteger( L, 1 ), i;
+  pwm_sim_channel *pc;
+
+  MOD_CHECK_ID( pwm, id );
+  pc = pwm_sim + id;
+  platform_pwm_seq_get_status( id, NULL );
+  lua_createtable( L, pc->nevents, 0 );
+  for( i = 0; i < pc->nevents; i ++ )
+  {
+    lua_createtable( L, 2, 0 );
+    lua_pushinteger( L, pc->events[ i ].time );
+    lua_rawseti( L, -2, 1 );
+    lua_pushinteger( L, pc->events[ i ].duty );
+    lua_rawseti( L, -2, 2 );
+    lua_rawseti( L, -2, i + 1 );
+  }
+  lua_pushinteger( L, pc->lost );
+  pc->nevents = pc->lost = 0;
+  return 2;
+}
+
+#define MIN_OPT_LEVEL 2
+#include "lrodefs.h"
+const LUA_REG_TYPE sim_pwm_map[] =
+{
+  { LSTRKEY( "record" ), LFUNCVAL( sim_pwm_record ) },
+  { LNILKEY, LNILVAL }
+};
+
+#endif // #if NUM_PWM > 0
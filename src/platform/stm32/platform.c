@@ -35,8 +35,20 @@
 // NOTE: when using virtual timers, SYSTICKHZ and VTMR_FREQ_HZ should have the
 // same value, as they're served by the same timer (the systick)
 // Max SysTick preload value is 16777215, for STM32F103RET6 @ 72 MHz, lowest acceptable rate would be about 5 Hz
+// With tickless virtual timers the SysTick runs from HCLK / 8 and is only the
+// time base of the virtual timers, so it can wrap once per second.
+#if defined( VTMR_TICKLESS ) && !defined( BUILD_MMCFS )
+#define SYSTICKHZ               1
+#else
 #define SYSTICKHZ               10  
+#endif
 #define SYSTICKMS               (1000 / SYSTICKHZ)
+
+// DWT cycle counter (timebase and pin programs)
+#define DWT_CTRL                ( *( volatile u32* )0xE0001000 )
+#define DWT_CYCCNT              ( *( volatile u32* )0xE0001004 )
+#define DWT_CTRL_CYCCNTENA      1
+
 // ****************************************************************************
 // Platform initialization
 
@@ -45,6 +57,10 @@ static void RCC_Configuration(void);
 static void NVIC_Configuration(void);
 
 static void timers_init();
+static void timebase_init();
+#ifdef VTMR_TICKLESS
+static void vtmr_systick_init();
+#endif
 static void pwms_init();
 static void uarts_init();
 static void spis_init();
@@ -71,6 +87,9 @@ int platform_init()
   
   // Setup timers
   timers_init();
+
+  // Setup the timebase
+  timebase_init();
   
   // Setup PWMs
   pwms_init();
@@ -84,11 +103,15 @@ int platform_init()
   cans_init();
   
   // Enable SysTick
+#ifdef VTMR_TICKLESS
+  vtmr_systick_init();
+#else
   if ( SysTick_Config( HCLK / SYSTICKHZ ) )
   { 
     /* Capture error */ 
     while (1);
   }
+#endif
   
   cmn_platform_init();
 
@@ -263,6 +286,41 @@ pio_type platform_pio_op( unsigned port, pio_type pinmask, int op )
   return retval;
 }
 
+#ifdef BUILD_PIO_PROG
+// Pin programs: the delays are absolute deadlines on the DWT cycle counter, so
+// the time spent on the port writes doesn't accumulate
+void platform_pio_run( const platform_pio_step *steps, unsigned nsteps )
+{
+  GPIO_TypeDef *base;
+  u32 t;
+
+  t = DWT_CYCCNT;
+  for( ; nsteps; nsteps --, steps ++ )
+  {
+    base = pio_port[ steps->port ];
+    switch( steps->op )
+    {
+      case PLATFORM_PIO_STEP_SET:
+        base->BSRR = steps->mask;
+        break;
+
+      case PLATFORM_PIO_STEP_CLEAR:
+        base->BRR = steps->mask;
+        break;
+
+      case PLATFORM_PIO_STEP_WRITE:
+        base->BSRR = ( steps->data & steps->mask ) | ( ( ~steps->data & steps->mask ) << 16 );
+        break;
+
+      case PLATFORM_PIO_STEP_DELAY:
+        t += steps->data;
+        while( ( s32 )( DWT_CYCCNT - t ) < 0 );
+        break;
+    }
+  }
+}
+#endif // #ifdef BUILD_PIO_PROG
+
 // ****************************************************************************
 // CAN
 // TODO: Many things
@@ -296,6 +354,8 @@ u32 platform_can_setup( unsigned id, u32 clock )
   CAN_FilterInitTypeDef  CAN_FilterInitStructure;
   GPIO_InitTypeDef GPIO_InitStructure;
   int cbaudidx = -1;
+  unsigned i;
+  u32 rx_int = CAN1->IER & CAN_IER_FMPIE0;
 
   // Configure IO Pins -- This is for STM32F103RE
   GPIO_InitStructure.GPIO_Pin = GPIO_Pin_8;
@@ -337,7 +397,7 @@ u32 platform_can_setup( unsigned id, u32 clock )
   CAN_InitStructure.CAN_Prescaler=can_baud_pre[ cbaudidx ];
   CAN_Init( CAN1, &CAN_InitStructure );
 
-  /* CAN filter init */
+  /* CAN filter init: filter 0 accepts all the frames, the others are off */
   CAN_FilterInitStructure.CAN_FilterNumber=0;
   CAN_FilterInitStructure.CAN_FilterMode=CAN_FilterMode_IdMask;
   CAN_FilterInitStructure.CAN_FilterScale=CAN_FilterScale_32bit;
@@ -348,9 +408,48 @@ u32 platform_can_setup( unsigned id, u32 clock )
   CAN_FilterInitStructure.CAN_FilterFIFOAssignment=CAN_FIFO0;
   CAN_FilterInitStructure.CAN_FilterActivation=ENABLE;
   CAN_FilterInit(&CAN_FilterInitStructure);
+  for( i = 1; i < CAN_NUM_FILTERS; i ++ )
+    platform_can_set_filter( id, i, 0, 0, PLATFORM_CAN_FILTER_OFF );
+
+  // CAN_DeInit also disabled the RX interrupt
+  if( rx_int )
+    CAN_ITConfig( CAN1, CAN_IT_FMP0, ENABLE );
   
   return can_baud_rate[ cbaudidx ];
 }
+
+// Each filter is a filter bank in 32-bit identifier mask mode. A frame is
+// accepted if it matches any of the active filters. The IDE bit is always
+// part of the mask, so a filter matches only one type of identifiers.
+int platform_can_set_filter( unsigned id, unsigned filter, u32 canid, u32 mask, int idtype )
+{
+  CAN_FilterInitTypeDef  CAN_FilterInitStructure;
+  u32 fid, fmask;
+
+  if( filter >= CAN_NUM_FILTERS )
+    return PLATFORM_ERR;
+  if( idtype == ELUA_CAN_ID_EXT )
+  {
+    fid = ( canid << 3 ) | CAN_ID_EXT;
+    fmask = ( mask << 3 ) | CAN_ID_EXT;
+  }
+  else
+  {
+    fid = canid << 21;
+    fmask = ( mask << 21 ) | CAN_ID_EXT;
+  }
+  CAN_FilterInitStructure.CAN_FilterNumber=filter;
+  CAN_FilterInitStructure.CAN_FilterMode=CAN_FilterMode_IdMask;
+  CAN_FilterInitStructure.CAN_FilterScale=CAN_FilterScale_32bit;
+  CAN_FilterInitStructure.CAN_FilterIdHigh=fid >> 16;
+  CAN_FilterInitStructure.CAN_FilterIdLow=fid & 0xFFFF;
+  CAN_FilterInitStructure.CAN_FilterMaskIdHigh=fmask >> 16;
+  CAN_FilterInitStructure.CAN_FilterMaskIdLow=fmask & 0xFFFF;
+  CAN_FilterInitStructure.CAN_FilterFIFOAssignment=CAN_FIFO0;
+  CAN_FilterInitStructure.CAN_FilterActivation=idtype == PLATFORM_CAN_FILTER_OFF ? DISABLE : ENABLE;
+  CAN_FilterInit(&CAN_FilterInitStructure);
+  return PLATFORM_OK;
+}
 /*
 u32 platform_can_op( unsigned id, int op, u32 data )
 {
@@ -396,38 +495,18 @@ void platform_can_send( unsigned id, u32 canid, u8 idtype, u8 len, const u8 *dat
   CAN_Transmit( CAN1, &TxMessage );
 }
 
-void USB_LP_CAN_RX0_IRQHandler(void)
-{
-/*
-  CanRxMsg RxMessage;
-
-  RxMessage.StdId=0x00;
-  RxMessage.ExtId=0x00;
-  RxMessage.IDE=0;
-  RxMessage.DLC=0;
-  RxMessage.FMI=0;
-  RxMessage.Data[0]=0x00;
-  RxMessage.Data[1]=0x00;
-
-  CAN_Receive(CAN_FIFO0, &RxMessage);
-
-  if((RxMessage.ExtId==0x1234) && (RxMessage.IDE==CAN_ID_EXT)
-     && (RxMessage.DLC==2) && ((RxMessage.Data[1]|RxMessage.Data[0]<<8)==0xDECA))
-  {
-    ret = 1; 
-  }
-  else
-  {
-    ret = 0; 
-  }*/
-}
-
-int platform_can_recv( unsigned id, u32 *canid, u8 *idtype, u8 *len, u8 *data )
+int platform_s_can_recv( unsigned id, u32 *canid, u8 *idtype, u8 *len, u8 *data )
 {
   CanRxMsg RxMessage;
   const char *s;
   char *d;
 
+  // Frames lost because the hardware FIFO was full
+  if( CAN1->RF0R & CAN_RF0R_FOVR0 )
+  {
+    CAN1->RF0R = CAN_RF0R_FOVR0;
+    cmn_can_rx_dropped( id, 1 );
+  }
   if( CAN_MessagePending( CAN1, CAN_FIFO0 ) > 0 )
   {
     CAN_Receive(CAN1, CAN_FIFO0, &RxMessage);
@@ -689,6 +768,26 @@ int platform_s_uart_set_flow_control( unsigned id, int type )
 }
 
 
+// ****************************************************************************
+// Timebase: the DWT cycle counter, extended to 64 bits. The SysTick interrupt
+// reads it at least once per second, much more often than it wraps (every
+// 59.6s at 72MHz).
+
+static void timebase_init()
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+u64 platform_timebase_read()
+{
+  int old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+  u64 res = cmn_timebase_extend( DWT_CYCCNT );
+
+  platform_cpu_set_global_interrupts( old_status );
+  return res;
+}
+
 // ****************************************************************************
 // Timers
 
@@ -700,10 +799,96 @@ static TIM_TypeDef * const timer[] = { TIM1, TIM2, TIM3, TIM4, TIM5 };
 
 static u32 timer_set_clock( unsigned id, u32 clock );
 
+#ifdef VTMR_TICKLESS
+// Tickless virtual timers: the SysTick counts at HCLK / 8 and is the time base
+// (a microsecond counter extended in software at each SysTick wrap), TIM7 runs
+// at 1MHz in one pulse mode and is the alarm. The alarm can fire up to 1us
+// early, cmn_virtual_timer_cb rearms it in that case.
+#define VTMR_SYSTICK_CLK        ( HCLK / 8 )
+#define VTMR_SYSTICK_LOAD       ( VTMR_SYSTICK_CLK / SYSTICKHZ )
+#define VTMR_SYSTICK_US         ( 1000000 / SYSTICKHZ )
+#define VTMR_ALARM_BASE_CLK     ( PCLK1_DIV == 1 ? HCLK : HCLK / ( PCLK1_DIV / 2 ) )
+#define VTMR_ALARM_MAX          0x10000
+
+static volatile u32 vtmr_systick_base;
+
+static void vtmr_systick_init()
+{
+  NVIC_InitTypeDef nvic_init_structure;
+
+  SysTick->LOAD = VTMR_SYSTICK_LOAD - 1;
+  NVIC_SetPriority( SysTick_IRQn, ( 1 << __NVIC_PRIO_BITS ) - 1 );
+  SysTick->VAL = 0;
+  SysTick->CTRL = ( 1 << SYSTICK_ENABLE ) | ( 1 << SYSTICK_TICKINT );
+
+  RCC_APB1PeriphClockCmd( RCC_APB1Periph_TIM7, ENABLE );
+  TIM7->CR1 = TIM_CR1_OPM | TIM_CR1_URS;
+  TIM7->PSC = VTMR_ALARM_BASE_CLK / 1000000 - 1;
+  TIM7->EGR = TIM_EGR_UG;
+  TIM7->SR = 0;
+  TIM7->DIER = TIM_DIER_UIE;
+  nvic_init_structure.NVIC_IRQChannel = TIM7_IRQn;
+  nvic_init_structure.NVIC_IRQChannelPreemptionPriority = 0;
+  nvic_init_structure.NVIC_IRQChannelSubPriority = 1;
+  nvic_init_structure.NVIC_IRQChannelCmd = ENABLE;
+  NVIC_Init( &nvic_init_structure );
+}
+
+u32 platform_vtmr_get_count()
+{
+  u32 base, val;
+  int old_status = platform_cpu_set_global_interrupts( PLATFORM_CPU_DISABLE );
+
+  base = vtmr_systick_base;
+  val = SysTick->VAL;
+  if( SCB->ICSR & SCB_ICSR_PENDSTSET )
+  {
+    // The SysTick wrapped, but its interrupt wasn't served yet
+    base += VTMR_SYSTICK_US;
+    val = SysTick->VAL;
+  }
+  platform_cpu_set_global_interrupts( old_status );
+  return base + ( VTMR_SYSTICK_LOAD - 1 - val ) / ( VTMR_SYSTICK_CLK / 1000000 );
+}
+
+void platform_vtmr_set_alarm( u32 count )
+{
+  s32 delta = ( s32 )( count - platform_vtmr_get_count() );
+
+  if( delta < 2 )
+    delta = 2;
+  else if( delta > VTMR_ALARM_MAX )
+    delta = VTMR_ALARM_MAX;
+  TIM7->CR1 &= ( u16 )~TIM_CR1_CEN;
+  TIM7->CNT = 0;
+  TIM7->ARR = delta - 1;
+  TIM7->SR = 0;
+  TIM7->CR1 |= TIM_CR1_CEN;
+}
+
+void platform_vtmr_stop_alarm()
+{
+  TIM7->CR1 &= ( u16 )~TIM_CR1_CEN;
+}
+
+void TIM7_IRQHandler()
+{
+  TIM7->SR = ( u16 )~TIM_SR_UIF;
+  cmn_virtual_timer_cb();
+}
+#endif // #ifdef VTMR_TICKLESS
+
 void SysTick_Handler( void )
 {
+  // Keep the 64-bit timebase up to date
+  platform_timebase_read();
+
+#ifdef VTMR_TICKLESS
+  vtmr_systick_base += VTMR_SYSTICK_US;
+#else
   // Handle virtual timers
   cmn_virtual_timer_cb();
+#endif
 
 #ifdef BUILD_MMCFS
   disk_timerproc();
@@ -840,8 +1025,20 @@ static const u16 pwm_gpio_pins[] = { GPIO_Pin_6, GPIO_Pin_7, GPIO_Pin_8, GPIO_Pi
 
 static void pwms_init()
 {
+#ifdef BUILD_PWM_SEQ
+  NVIC_InitTypeDef nvic_init_structure;
+#endif
+
   RCC_APB2PeriphClockCmd( RCC_APB2Periph_TIM8, ENABLE );  
-  // 
+#ifdef BUILD_PWM_SEQ
+  // The sequences use DMA2 channel 1 (TIM8 update request)
+  RCC_AHBPeriphClockCmd( RCC_AHBPeriph_DMA2, ENABLE );
+  nvic_init_structure.NVIC_IRQChannel = DMA2_Channel1_IRQn;
+  nvic_init_structure.NVIC_IRQChannelPreemptionPriority = 0;
+  nvic_init_structure.NVIC_IRQChannelSubPriority = 2;
+  nvic_init_structure.NVIC_IRQChannelCmd = ENABLE;
+  NVIC_Init( &nvic_init_structure );
+#endif
 }
 
 // Helper function: return the PWM clock
@@ -957,6 +1154,81 @@ u32 platform_pwm_op( unsigned id, int op, u32 data )
   return res;
 }
 
+#ifdef BUILD_PWM_SEQ
+// Sequences: the update event of the timer (generated every RCR + 1 PWM
+// periods by the repetition counter) triggers DMA2 channel 1, which writes the
+// next duty value to the compare register of the channel. The new value is
+// loaded at the following update event (the compare registers are preloaded).
+// There is a single update DMA request, so only one channel can play a
+// sequence at a time.
+static int pwm_seq_id = -1;
+
+u32 platform_s_pwm_seq_start( unsigned id, u16 *duty, u32 count, u32 rate, int mode )
+{
+  DMA_InitTypeDef dma_init_struct;
+  u32 freq = platform_pwm_get_clock(), period = PWM_TIMER_NAME->ARR + 1, rep, i;
+
+  if( ( pwm_seq_id != -1 && pwm_seq_id != id ) || rate == 0 || rate > freq )
+    return 0;
+  // The repetition counter has 8 bits
+  if( ( rep = ( freq + rate / 2 ) / rate ) > 256 )
+    return 0;
+  for( i = 0; i < count; i ++ )
+    duty[ i ] = ( u16 )( ( u32 )duty[ i ] * period / PLATFORM_PWM_SEQ_DUTY_MAX );
+
+  DMA_DeInit( DMA2_Channel1 );
+  dma_init_struct.DMA_PeripheralBaseAddr = ( u32 )&PWM_TIMER_NAME->CCR1 + 4 * id;
+  dma_init_struct.DMA_MemoryBaseAddr = ( u32 )duty;
+  dma_init_struct.DMA_DIR = DMA_DIR_PeripheralDST;
+  dma_init_struct.DMA_BufferSize = count;
+  dma_init_struct.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  dma_init_struct.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  dma_init_struct.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+  dma_init_struct.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+  dma_init_struct.DMA_Mode = mode == PLATFORM_PWM_SEQ_LOOP ? DMA_Mode_Circular : DMA_Mode_Normal;
+  dma_init_struct.DMA_Priority = DMA_Priority_High;
+  dma_init_struct.DMA_M2M = DMA_M2M_Disable;
+  DMA_Init( DMA2_Channel1, &dma_init_struct );
+  DMA_ITConfig( DMA2_Channel1, DMA_IT_TC, ENABLE );
+  DMA_Cmd( DMA2_Channel1, ENABLE );
+
+  PWM_TIMER_NAME->RCR = rep - 1;
+  pwm_seq_id = id;
+  TIM_DMACmd( PWM_TIMER_NAME, TIM_DMA_Update, ENABLE );
+  return freq / rep;
+}
+
+void platform_s_pwm_seq_stop( unsigned id )
+{
+  if( pwm_seq_id != id )
+    return;
+  TIM_DMACmd( PWM_TIMER_NAME, TIM_DMA_Update, DISABLE );
+  DMA_Cmd( DMA2_Channel1, DISABLE );
+  PWM_TIMER_NAME->RCR = 0;
+  pwm_seq_id = -1;
+}
+
+void DMA2_Channel1_IRQHandler( void )
+{
+  unsigned id = pwm_seq_id;
+
+  if( DMA_GetITStatus( DMA2_IT_TC1 ) != RESET )
+  {
+    DMA_ClearITPendingBit( DMA2_IT_TC1 );
+    if( pwm_seq_id == -1 )
+      return;
+    if( DMA2_Channel1->CCR & DMA_Mode_Circular )
+      cmn_pwm_seq_pass_done( id, 0 );
+    else
+    {
+      // One shot sequence: the last duty value stays in the compare register
+      platform_s_pwm_seq_stop( id );
+      cmn_pwm_seq_pass_done( id, 1 );
+    }
+  }
+}
+#endif // #ifdef BUILD_PWM_SEQ
+
 // *****************************************************************************
 // CPU specific functions
  
@@ -1057,6 +1329,25 @@ void DMA1_Channel1_IRQHandler(void)
   elua_adc_dev_state *d = adc_get_dev_state( 0 );
   elua_adc_ch_state *s;
   
+#ifdef BUILD_ADC_STREAM
+  // Streaming: the first half of the DMA buffer is block 0, the second half
+  // is block 1
+  if( adc_get_stream_state()->active )
+  {
+    if( DMA_GetITStatus( DMA1_IT_HT1 ) != RESET )
+    {
+      DMA_ClearITPendingBit( DMA1_IT_HT1 );
+      adc_stream_block_done();
+    }
+    if( DMA_GetITStatus( DMA1_IT_TC1 ) != RESET )
+    {
+      DMA_ClearITPendingBit( DMA1_IT_TC1 );
+      adc_stream_block_done();
+    }
+    return;
+  }
+#endif
+
   DMA_ClearITPendingBit( DMA1_IT_TC1 );
   
   d->seq_ctr = 0;
@@ -1223,6 +1514,63 @@ int platform_adc_start_sequence( )
   return PLATFORM_OK;
 }
 
+#ifdef BUILD_ADC_STREAM
+
+// The timer triggers a scan of all the channels of the stream and the DMA
+// writes the results in the two blocks (circular mode, with interrupts at
+// half transfer and at transfer complete)
+u32 platform_adc_stream_start( unsigned timer_id, u32 frequency )
+{
+  elua_adc_dev_state *d = adc_get_dev_state( 0 );
+  elua_adc_stream_state *st = adc_get_stream_state();
+  unsigned i;
+
+  if( ADC_STREAM_BLOCKS * st->blocklen > 0xFFFF )
+    return 0;
+  ADC_ExternalTrigConvCmd( adc[ d->seq_id ], DISABLE );
+  ADC_DMACmd( adc[ d->seq_id ], DISABLE );
+  ADC_Cmd( adc[ d->seq_id ], DISABLE );
+  ADC_DeInit( adc[ d->seq_id ] );
+  for( i = 0; i < st->nchans; i ++ )
+    ADC_RegularChannelConfig( adc[ d->seq_id ], st->chans[ i ], i + 1, ADC_SampleTime_1Cycles5 );
+  adc_init_struct.ADC_NbrOfChannel = st->nchans;
+  d->timer_id = timer_id;
+  frequency = platform_adc_setclock( 0, frequency );
+  ADC_Cmd( adc[ d->seq_id ], ENABLE );
+
+  DMA_Cmd( DMA1_Channel1, DISABLE );
+  DMA_DeInit( DMA1_Channel1 );
+  dma_init_struct.DMA_BufferSize = ADC_STREAM_BLOCKS * st->blocklen;
+  dma_init_struct.DMA_MemoryBaseAddr = ( u32 )st->data;
+  DMA_Init( DMA1_Channel1, &dma_init_struct );
+  DMA_ClearITPendingBit( DMA1_IT_GL1 );
+  DMA_ITConfig( DMA1_Channel1, DMA_IT_HT | DMA_IT_TC, ENABLE );
+  DMA_Cmd( DMA1_Channel1, ENABLE );
+  ADC_DMACmd( adc[ d->seq_id ], ENABLE );
+
+  nvic_init_structure_adc.NVIC_IRQChannelCmd = ENABLE; 
+  NVIC_Init( &nvic_init_structure_adc );
+  ADC_ExternalTrigConvCmd( adc[ d->seq_id ], ENABLE );
+  return frequency;
+}
+
+void platform_adc_stream_stop()
+{
+  elua_adc_dev_state *d = adc_get_dev_state( 0 );
+
+  ADC_ExternalTrigConvCmd( adc[ d->seq_id ], DISABLE );
+  nvic_init_structure_adc.NVIC_IRQChannelCmd = DISABLE; 
+  NVIC_Init( &nvic_init_structure_adc );
+  DMA_ITConfig( DMA1_Channel1, DMA_IT_HT, DISABLE );
+  DMA_Cmd( DMA1_Channel1, DISABLE );
+  // Back to software triggers, the sequence is reprogrammed by the next
+  // 'sample' request
+  platform_adc_setclock( 0, 0 );
+  d->force_reseq = 1;
+}
+
+#endif // #ifdef BUILD_ADC_STREAM
+
 #endif // ifdef BUILD_ADC
 
 // ****************************************************************************
@@ -23,12 +23,15 @@
 //#define BUILD_DNS
 #define BUILD_CON_GENERIC
 #define BUILD_ADC
+#define BUILD_ADC_STREAM
 #define BUILD_RPC
 //#define BUILD_RFS
 //#define BUILD_CON_TCP
 #define BUILD_LINENOISE
 #define BUILD_C_INT_HANDLERS
 #define BUILD_LUA_INT_HANDLERS
+#define BUILD_PIO_PROG
+#define BUILD_PWM_SEQ
 #define ENABLE_ENC
 
 // *****************************************************************************
@@ -86,6 +89,8 @@
   _ROM( AUXLIB_TERM, luaopen_term, term_map )\
   _ROM( AUXLIB_PACK, luaopen_pack, pack_map )\
   _ROM( AUXLIB_BIT, luaopen_bit, bit_map )\
+  _ROM( AUXLIB_SBUF, luaopen_sbuf, sbuf_map )\
+  _ROM( AUXLIB_DSP, luaopen_dsp, dsp_map )\
   _ROM( AUXLIB_CPU, luaopen_cpu, cpu_map )\
   _ROM( AUXLIB_ELUA, luaopen_elua, elua_map )\
   _ROM( AUXLIB_TMR, luaopen_tmr, tmr_map )\
@@ -104,8 +109,15 @@
 #define EGC_INITIAL_MODE      1
 
 // Virtual timers (0 if not used)
+// With VTMR_TICKLESS the virtual timers count microseconds (SysTick time base)
+// and TIM7 interrupts only at their deadlines, instead of a VTMR_FREQ_HZ tick
 #define VTMR_NUM_TIMERS       4
+#define VTMR_TICKLESS
+#ifdef VTMR_TICKLESS
+#define VTMR_FREQ_HZ          1000000
+#else
 #define VTMR_FREQ_HZ          10
+#endif
 
 // Number of resources (0 if not available/not implemented)
 #define NUM_PIO               7
@@ -129,6 +141,11 @@
 #define ADC_TIMER_FIRST_ID    0
 #define ADC_NUM_TIMERS        4
 
+// CAN configuration (RX buffering and number of hardware filters)
+#define BUF_ENABLE_CAN
+#define CAN_BUF_SIZE          BUF_SIZE_32
+#define CAN_NUM_FILTERS       14
+
 // RPC boot options
 #define RPC_UART_ID           CON_UART_ID
 #define RPC_TIMER_ID          CON_TIMER_ID
@@ -149,6 +166,12 @@
 u32 platform_s_cpu_get_frequency();
 #define CPU_FREQUENCY         platform_s_cpu_get_frequency()
 
+// Clock of the pin program delays (DWT cycle counter)
+#define PIO_PROG_CLOCK        CPU_FREQUENCY
+
+// Timebase (the DWT cycle counter)
+#define TIMEBASE_CLOCK        CPU_FREQUENCY
+
 // PIO prefix ('0' for P0, P1, ... or 'A' for PA, PB, ...)
 #define PIO_PREFIX            'A'
 // Pins per port configuration:
@@ -182,13 +205,19 @@ u32 platform_s_cpu_get_frequency();
 #define INT_GPIO_NEGEDGE      ( ELUA_INT_FIRST_ID + 1 )
 #define INT_TMR_MATCH         ( ELUA_INT_FIRST_ID + 2 )
 #define INT_UART_RX           ( ELUA_INT_FIRST_ID + 3 )
-#define INT_ELUA_LAST         INT_UART_RX
+#define INT_ADC_BLOCK         ( ELUA_INT_FIRST_ID + 4 )
+#define INT_CAN_RX            ( ELUA_INT_FIRST_ID + 5 )
+#define INT_PWM_SEQ_DONE      ( ELUA_INT_FIRST_ID + 6 )
+#define INT_ELUA_LAST         INT_PWM_SEQ_DONE
 
 #define PLATFORM_CPU_CONSTANTS\
   _C( INT_GPIO_POSEDGE ),     \
   _C( INT_GPIO_NEGEDGE ),     \
   _C( INT_TMR_MATCH ),        \
-  _C( INT_UART_RX )
+  _C( INT_UART_RX ),         \
+  _C( INT_ADC_BLOCK ),        \
+  _C( INT_CAN_RX ),           \
+  _C( INT_PWM_SEQ_DONE )
 
 #endif // #ifndef __PLATFORM_CONF_H__
 
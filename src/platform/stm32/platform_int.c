@@ -5,6 +5,7 @@
 #include "platform_conf.h"
 #include "elua_int.h"
 #include "common.h"
+#include "elua_adc.h"
 
 // Platform-specific headers
 #include "stm32f10x.h"
@@ -50,6 +51,11 @@ void UART5_IRQHandler()
   all_usart_irqhandler( 4 );
 }
 
+void USB_LP_CAN1_RX0_IRQHandler()
+{
+  cmn_int_handler( INT_CAN_RX, 0 );
+}
+
 // ****************************************************************************
 // External interrupt handlers
 
@@ -272,6 +278,27 @@ static int int_uart_rx_get_flag( elua_int_resnum resnum, int clear )
   return status;
 }
 
+// ****************************************************************************
+// Interrupt: INT_CAN_RX
+
+static int int_can_rx_get_status( elua_int_resnum resnum )
+{
+  return ( CAN1->IER & CAN_IER_FMPIE0 ) ? 1 : 0;
+}
+
+static int int_can_rx_set_status( elua_int_resnum resnum, int status )
+{
+  int prev = int_can_rx_get_status( resnum );
+  CAN_ITConfig( CAN1, CAN_IT_FMP0, status == PLATFORM_CPU_ENABLE ? ENABLE : DISABLE );
+  return prev;
+}
+
+// The flag is cleared by reading the frames from the FIFO
+static int int_can_rx_get_flag( elua_int_resnum resnum, int clear )
+{
+  return CAN_MessagePending( CAN1, CAN_FIFO0 ) > 0 ? 1 : 0;
+}
+
 // ****************************************************************************
 // Initialize interrupt subsystem
 
@@ -309,6 +336,9 @@ void platform_int_init()
     NVIC_Init( &nvic_init_structure );
   }
 
+  // Enable the CAN RX interrupt in the NVIC
+  nvic_init_structure.NVIC_IRQChannel = USB_LP_CAN1_RX0_IRQn;
+  NVIC_Init( &nvic_init_structure );
 }
 
 // ****************************************************************************
@@ -320,5 +350,16 @@ const elua_int_descriptor elua_int_table[ INT_ELUA_LAST ] =
   { int_gpio_posedge_set_status, int_gpio_posedge_get_status, int_gpio_posedge_get_flag },
   { int_gpio_negedge_set_status, int_gpio_negedge_get_status, int_gpio_negedge_get_flag },
   { int_tmr_match_set_status, int_tmr_match_get_status, int_tmr_match_get_flag },
-  { int_uart_rx_set_status, int_uart_rx_get_status, int_uart_rx_get_flag }  
+  { int_uart_rx_set_status, int_uart_rx_get_status, int_uart_rx_get_flag },
+#ifdef BUILD_ADC_STREAM
+  { adc_stream_int_set_status, adc_stream_int_get_status, adc_stream_int_get_flag },
+#else
+  { NULL, NULL, NULL },
+#endif
+  { int_can_rx_set_status, int_can_rx_get_status, int_can_rx_get_flag },
+#ifdef BUILD_PWM_SEQ
+  { cmn_pwm_seq_int_set_status, cmn_pwm_seq_int_get_status, cmn_pwm_seq_int_get_flag }
+#else
+  { NULL, NULL, NULL }
+#endif
 };
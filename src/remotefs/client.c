@@ -5,6 +5,7 @@
 #include "client.h"
 #include "os_io.h"
 #include "eluarpc.h"
+#include "lzf.h"
 
 #include <stdio.h>
 #include "platform_conf.h"
@@ -27,6 +28,9 @@ static u8 *rfsc_buffer;
 static p_rfsc_send rfsc_send;
 static p_rfsc_recv rfsc_recv;
 static u32 rfsc_timeout;
+#ifdef RFS_COMPRESS
+static u32 rfsc_zfds;                 // bit n set if fd n was opened with compression
+#endif
 
 // ****************************************************************************
 // Client helpers
@@ -73,6 +77,58 @@ static int rfsch_send_request_read_response()
   return CLIENT_OK;
 }
 
+#ifdef RFS_COMPRESS
+static int rfsch_is_compressed( int fd )
+{
+  return fd >= 0 && fd < 32 && ( rfsc_zfds & ( 1UL << fd ) ) != 0;
+}
+
+static s32 rfsch_writez( int fd, const void *buf, u32 count )
+{
+  u32 datalen = 0;
+  int res;
+
+  // Compress directly in the request buffer, the packet can't be larger than
+  // the one for a regular write request. Data that doesn't compress is sent
+  // with a regular write request, since a WRITEZ request with uncompressed
+  // data is larger than that (it has an extra u32) and might not fit in the
+  // buffer.
+  if( count > ELUARPC_U32_SIZE )
+    datalen = lzf_compress( buf, count, rfsc_buffer + ELUARPC_WRITE_BUF_OFFSET, count - ELUARPC_U32_SIZE );
+  if( datalen != 0 )
+    remotefs_writez_write_request( rfsc_buffer, fd, NULL, datalen, count );
+  else
+    remotefs_write_write_request( rfsc_buffer, fd, buf, count );
+  if( rfsch_send_request_read_response() == CLIENT_ERR )
+    return -1;
+  if( datalen != 0 )
+    res = remotefs_writez_read_response( rfsc_buffer, &count );
+  else
+    res = remotefs_write_read_response( rfsc_buffer, &count );
+  if( res == ELUARPC_ERR )
+    return -1;
+  return ( s32 )count;
+}
+
+static s32 rfsch_readz( int fd, void *buf, u32 count )
+{
+  const u8 *resbuf;
+  u32 datalen;
+
+  remotefs_readz_write_request( rfsc_buffer, fd, count );
+  if( rfsch_send_request_read_response() == CLIENT_ERR )
+    return -1;
+  if( remotefs_readz_read_response( rfsc_buffer, &resbuf, &datalen, &count ) == ELUARPC_ERR )
+    return -1;
+  // Decompress directly in the destination buffer
+  if( datalen == count )
+    memcpy( buf, resbuf, count );
+  else if( lzf_decompress( resbuf, datalen, buf, count ) != count )
+    return -1;
+  return ( s32 )count;
+}
+#endif // #ifdef RFS_COMPRESS
+
 // ****************************************************************************
 // Client public interface
 
@@ -92,22 +148,45 @@ void rfsc_set_timeout( u32 timeout )
 int rfsc_open( const char* pathname, int flags, int mode )
 {
   int fd;
+#ifdef RFS_COMPRESS
+  int method;
 
+  // Make the request (ask for compression)
+  remotefs_open_write_request( rfsc_buffer, pathname, os_open_sys_flags_to_rfs_flags( flags ) | RFS_OPEN_FLAG_COMPRESS, mode );
+#else
   // Make the request
   remotefs_open_write_request( rfsc_buffer, pathname, os_open_sys_flags_to_rfs_flags( flags ), mode );
+#endif
 
   // Send the request / get the respone
   if( rfsch_send_request_read_response() == CLIENT_ERR )
     return -1;
 
   // Interpret the response
+#ifdef RFS_COMPRESS
+  if( remotefs_open_read_response_method( rfsc_buffer, &fd, &method ) == ELUARPC_ERR )
+    return -1;
+  if( fd >= 0 && fd < 32 )
+  {
+    if( method == LZF_METHOD_LZF )
+      rfsc_zfds |= 1UL << fd;
+    else
+      rfsc_zfds &= ~( 1UL << fd );
+  }
+#else
   if( remotefs_open_read_response( rfsc_buffer, &fd ) == ELUARPC_ERR )
     return -1;
+#endif
   return fd;
 }
 
 s32 rfsc_write( int fd, const void *buf, u32 count )
 {
+#ifdef RFS_COMPRESS
+  if( rfsch_is_compressed( fd ) )
+    return rfsch_writez( fd, buf, count );
+#endif
+
   // Make the request
   remotefs_write_write_request( rfsc_buffer, fd, buf, count );
 
@@ -125,6 +204,11 @@ s32 rfsc_read( int fd, void *buf, u32 count )
 {
   const u8 *resbuf;
 
+#ifdef RFS_COMPRESS
+  if( rfsch_is_compressed( fd ) )
+    return rfsch_readz( fd, buf, count );
+#endif
+
   // Make the request
   remotefs_read_write_request( rfsc_buffer, fd, count );
 
@@ -218,4 +302,19 @@ int rfsc_closedir( u32 d )
   return res;
 }  
 
+u32 rfsc_dirstamp( const char *name )
+{
+  u32 res;
+
+  // Make the request
+  remotefs_dirstamp_write_request( rfsc_buffer, name );
+  if( rfsch_send_request_read_response() == CLIENT_ERR )
+    return 0;
+
+  // Interpret the response
+  if( remotefs_dirstamp_read_response( rfsc_buffer, &res ) == ELUARPC_ERR )
+    return 0;
+  return res;
+}
+
 #endif // #ifdef BUILD_RFS
@@ -14,6 +14,7 @@
 #include "hostif.h"
 #endif
 #include <stdio.h>
+#include <string.h>
 
 #ifdef BUILD_RFS
 
@@ -33,23 +34,263 @@ static u8 rfs_buffer[ 1 << RFS_BUFFER_SIZE ];
 static int rfs_read_fd, rfs_write_fd;
 #endif
 
+// RFS client cache configuration
+// RFS_CACHE_FDS is the number of files that can be cached at the same time
+// (files opened after all the cache entries are in use are not cached), 
+// RFS_CACHE_BLOCKS is the number of RFS_REAL_BUFFER_SIZE blocks in each
+// cache entry. Define RFS_CACHE_WRITE_BACK to keep small sequential writes
+// in the cache until the block is full or the file is read, seeked or closed
+// (the default is write-through). RFS_DIRCACHE_SIZE is the size (in bytes)
+// of the directory listing cache. Any of RFS_CACHE_BLOCKS or RFS_DIRCACHE_SIZE 
+// can be defined as 0 to disable the corresponding cache.
+#ifndef RFS_CACHE_FDS
+#define RFS_CACHE_FDS         2
+#endif
+
+#ifndef RFS_CACHE_BLOCKS
+#define RFS_CACHE_BLOCKS      2
+#endif
+
+#ifndef RFS_DIRCACHE_SIZE
+#define RFS_DIRCACHE_SIZE     512
+#endif
+
+#if RFS_CACHE_BLOCKS > 0
+
+// Block flags
+#define RFS_CACHE_BLOCK_VALID 1
+#define RFS_CACHE_BLOCK_DIRTY 2
+
+// A cached block of file data
+typedef struct
+{
+  u32 offset;                           // file offset of the first byte in the block
+  u16 len;                              // number of valid bytes in the block
+  u8 flags;                             // RFS_CACHE_BLOCK_xxx
+  u8 age;                               // for LRU replacement
+  u8 data[ RFS_REAL_BUFFER_SIZE ];
+} rfs_cache_block;
+
+// Cache data for an open file
+typedef struct
+{
+  int fd;                               // server side file descriptor (-1 if the entry is not used)
+  u32 pos;                              // file position as seen by the eLua side
+  u32 srvpos;                           // file position on the server
+  u8 tick;
+  rfs_cache_block blocks[ RFS_CACHE_BLOCKS ];
+} rfs_cache_entry;
+
+static rfs_cache_entry rfs_cache[ RFS_CACHE_FDS ];
+
+// Return the cache entry of the given file descriptor (NULL if the file is not cached)
+static rfs_cache_entry* rfsh_cache_get( int fd )
+{
+  unsigned i;
+
+  for( i = 0; i < RFS_CACHE_FDS; i ++ )
+    if( rfs_cache[ i ].fd == fd )
+      return rfs_cache + i;
+  return NULL;
+}
+
+// Return the block that contains the given file position (NULL if not found)
+static rfs_cache_block* rfsh_cache_find( rfs_cache_entry *pe, u32 pos )
+{
+  unsigned i;
+  rfs_cache_block *pb;
+
+  for( i = 0, pb = pe->blocks; i < RFS_CACHE_BLOCKS; i ++, pb ++ )
+    if( ( pb->flags & RFS_CACHE_BLOCK_VALID ) && pos >= pb->offset && pos < pb->offset + pb->len )
+    {
+      pb->age = ++ pe->tick;
+      return pb;
+    }
+  return NULL;
+}
+
+// Return the least recently used block in the entry
+static rfs_cache_block* rfsh_cache_victim( rfs_cache_entry *pe )
+{
+  unsigned i;
+  rfs_cache_block *pb, *pvictim = pe->blocks;
+
+  for( i = 0, pb = pe->blocks; i < RFS_CACHE_BLOCKS; i ++, pb ++ )
+  {
+    if( !( pb->flags & RFS_CACHE_BLOCK_VALID ) )
+      return pb;
+    if( ( u8 )( pe->tick - pb->age ) > ( u8 )( pe->tick - pvictim->age ) )
+      pvictim = pb;
+  }
+  return pvictim;
+}
+
+// Move the server file pointer to 'pos' (if needed)
+static int rfsh_cache_sync_pos( rfs_cache_entry *pe, u32 pos )
+{
+  s32 res;
+
+  if( pe->srvpos == pos )
+    return 0;
+  if( ( res = rfsc_lseek( pe->fd, ( s32 )pos, SEEK_SET ) ) == -1 )
+    return -1;
+  pe->srvpos = ( u32 )res;
+  return 0;
+}
+
+// Write the (single) dirty block of the entry to the server
+static int rfsh_cache_flush( rfs_cache_entry *pe )
+{
+  unsigned i;
+  rfs_cache_block *pb;
+  s32 res;
+
+  for( i = 0, pb = pe->blocks; i < RFS_CACHE_BLOCKS; i ++, pb ++ )
+    if( pb->flags & RFS_CACHE_BLOCK_DIRTY )
+    {
+      pb->flags = 0;
+      if( rfsh_cache_sync_pos( pe, pb->offset ) == -1 )
+        return -1;
+      if( ( res = rfsc_write( pe->fd, pb->data, pb->len ) ) == -1 )
+        return -1;
+      pe->srvpos += res;
+      return res == pb->len ? 0 : -1;
+    }
+  return 0;
+}
+
+// Invalidate all the (clean) blocks that intersect [pos, pos + len]
+static void rfsh_cache_invalidate( rfs_cache_entry *pe, u32 pos, u32 len )
+{
+  unsigned i;
+  rfs_cache_block *pb;
+
+  for( i = 0, pb = pe->blocks; i < RFS_CACHE_BLOCKS; i ++, pb ++ )
+    if( !( pb->flags & RFS_CACHE_BLOCK_DIRTY ) && pb->offset <= pos + len && pos <= pb->offset + pb->len )
+      pb->flags = 0;
+}
+
+#endif // #if RFS_CACHE_BLOCKS > 0
+
+#if RFS_DIRCACHE_SIZE > 0
+
+// Directory listing cache
+// Entries are stored as ( u32 fsize, u32 ftime, name ) in 'data'. The listing
+// can also change on the PC side, so the cache is revalidated on each opendir
+// with the listing stamp from the server (RFS_OP_DIRSTAMP).
+static struct
+{
+  char name[ DM_MAX_FNAME_LENGTH + 1 ];
+  u8 data[ RFS_DIRCACHE_SIZE ];
+  u32 stamp;
+  u16 used, rdptr;
+  u8 valid, busy;
+  struct dm_dirent ent;
+} rfs_dircache;
+
+#define RFS_DIRCACHE_HANDLE   ( ( void* )&rfs_dircache )
+
+// Invalidate the directory cache (called whenever the content of the remote
+// filesystem might change)
+static void rfsh_dircache_invalidate()
+{
+  rfs_dircache.valid = 0;
+}
+
+// Read the full listing of 'name' (with stamp 'stamp') into the directory cache
+static int rfsh_dircache_fill( const char *name, u32 stamp )
+{
+  u32 d, fsize, ftime;
+  const char *fname;
+  u16 used = 0, entlen;
+  int res = 0;
+
+  rfs_dircache.valid = 0;
+  if( stamp == 0 )
+    return -1;
+  if( ( d = rfsc_opendir( name ) ) == 0 )
+    return -1;
+  while( 1 )
+  {
+    rfsc_readdir( d, &fname, &fsize, &ftime );
+    if( fname == NULL )
+      break;
+    entlen = 2 * sizeof( u32 ) + strlen( fname ) + 1;
+    if( used + entlen > RFS_DIRCACHE_SIZE )
+    {
+      res = -1;
+      break;
+    }
+    memcpy( rfs_dircache.data + used, &fsize, sizeof( u32 ) );
+    memcpy( rfs_dircache.data + used + sizeof( u32 ), &ftime, sizeof( u32 ) );
+    strcpy( ( char* )rfs_dircache.data + used + 2 * sizeof( u32 ), fname );
+    used += entlen;
+  }
+  rfsc_closedir( d );
+  if( res == 0 )
+  {
+    strcpy( rfs_dircache.name, name );
+    rfs_dircache.stamp = stamp;
+    rfs_dircache.used = used;
+    rfs_dircache.valid = 1;
+  }
+  return res;
+}
+
+#else // #if RFS_DIRCACHE_SIZE > 0
+
+#define rfsh_dircache_invalidate()
+
+#endif // #if RFS_DIRCACHE_SIZE > 0
+
 static int rfs_open_r( struct _reent *r, const char *path, int flags, int mode )
 {
-  return rfsc_open( path, flags, mode );
+  int fd;
+#if RFS_CACHE_BLOCKS > 0
+  rfs_cache_entry *pe;
+#endif
+
+  if( ( flags & O_ACCMODE ) != O_RDONLY )
+    rfsh_dircache_invalidate();
+  if( ( fd = rfsc_open( path, flags, mode ) ) == -1 )
+    return -1;
+#if RFS_CACHE_BLOCKS > 0
+  // The position of files open in append mode is decided by the server, so
+  // they are never cached
+  if( !( flags & O_APPEND ) && ( pe = rfsh_cache_get( -1 ) ) != NULL )
+  {
+    memset( pe, 0, sizeof( rfs_cache_entry ) );
+    pe->fd = fd;
+  }
+#endif
+  return fd;
 }
 
 static int rfs_close_r( struct _reent *r, int fd )
 {
+#if RFS_CACHE_BLOCKS > 0
+  rfs_cache_entry *pe;
+  int res = 0;
+
+  if( ( pe = rfsh_cache_get( fd ) ) != NULL )
+  {
+    res = rfsh_cache_flush( pe );
+    pe->fd = -1;
+  }
+  if( rfsc_close( fd ) == -1 )
+    return -1;
+  return res;
+#else
   return rfsc_close( fd );
+#endif
 }
 
-static _ssize_t rfs_write_r( struct _reent *r, int fd, const void* ptr, size_t len )
+// Write directly to the server (in RFS_REAL_BUFFER_SIZE increments)
+static s32 rfsh_write( int fd, const u8 *p, size_t len )
 { 
   s32 total = 0, res;
   u32 towrite;
-  const u8 *p = ( const u8* )ptr;
 
-  // Write in RFS_REAL_BUFFER_SIZE increments
 //  printf( "Got WRITE request for %d bytes\n", len );
   while( len )
   {
@@ -63,16 +304,15 @@ static _ssize_t rfs_write_r( struct _reent *r, int fd, const void* ptr, size_t l
     len -= towrite;
     p += towrite; 
   }
-  return ( _ssize_t )total;
+  return total;
 }
 
-static _ssize_t rfs_read_r( struct _reent *r, int fd, void* ptr, size_t len )
+// Read directly from the server (in RFS_REAL_BUFFER_SIZE increments)
+static s32 rfsh_read( int fd, u8 *p, size_t len )
 {
   s32 total = 0, res;
   u32 toread;
-  u8 *p = ( u8* )ptr;
 
-  // Read in RFS_REAL_BUFFER_SIZE increments
 //  printf( "Got READ request for %d bytes\n", len );
   while( len )
   {
@@ -86,18 +326,181 @@ static _ssize_t rfs_read_r( struct _reent *r, int fd, void* ptr, size_t len )
     len -= toread;
     p += toread;
   }
-  return ( _ssize_t )total;
+  return total;
+}
+
+static _ssize_t rfs_write_r( struct _reent *r, int fd, const void* ptr, size_t len )
+{ 
+#if RFS_CACHE_BLOCKS > 0
+  rfs_cache_entry *pe;
+  s32 total;
+#ifdef RFS_CACHE_WRITE_BACK
+  rfs_cache_block *pb;
+  unsigned i;
+#endif
+#endif
+
+  rfsh_dircache_invalidate();
+#if RFS_CACHE_BLOCKS > 0
+  if( ( pe = rfsh_cache_get( fd ) ) != NULL )
+  {
+#ifdef RFS_CACHE_WRITE_BACK
+    if( len < RFS_REAL_BUFFER_SIZE )
+    {
+      // Append to the dirty block if this write continues it, otherwise
+      // start a new dirty block
+      for( i = 0, pb = pe->blocks; i < RFS_CACHE_BLOCKS; i ++, pb ++ )
+        if( pb->flags & RFS_CACHE_BLOCK_DIRTY )
+          break;
+      if( i == RFS_CACHE_BLOCKS || pb->offset + pb->len != pe->pos || pb->len + len > RFS_REAL_BUFFER_SIZE )
+      {
+        if( rfsh_cache_flush( pe ) == -1 )
+          return -1;
+        pb = rfsh_cache_victim( pe );
+        pb->offset = pe->pos;
+        pb->len = 0;
+        pb->flags = RFS_CACHE_BLOCK_VALID | RFS_CACHE_BLOCK_DIRTY;
+      }
+      rfsh_cache_invalidate( pe, pe->pos, len );
+      memcpy( pb->data + pb->len, ptr, len );
+      pb->len += len;
+      pb->age = ++ pe->tick;
+      pe->pos += len;
+      return ( _ssize_t )len;
+    }
+    if( rfsh_cache_flush( pe ) == -1 )
+      return -1;
+#endif // #ifdef RFS_CACHE_WRITE_BACK
+    // Write-through: send the data and drop the blocks that overlap it
+    rfsh_cache_invalidate( pe, pe->pos, len );
+    if( rfsh_cache_sync_pos( pe, pe->pos ) == -1 )
+      return -1;
+    total = rfsh_write( fd, ptr, len );
+    pe->pos = pe->srvpos = pe->srvpos + total;
+    return ( _ssize_t )total;
+  }
+#endif // #if RFS_CACHE_BLOCKS > 0
+  return ( _ssize_t )rfsh_write( fd, ptr, len );
+}
+
+static _ssize_t rfs_read_r( struct _reent *r, int fd, void* ptr, size_t len )
+{
+#if RFS_CACHE_BLOCKS > 0
+  rfs_cache_entry *pe;
+  rfs_cache_block *pb;
+  s32 total = 0, res;
+  u32 tocopy;
+  u8 *p = ( u8* )ptr;
+
+  if( ( pe = rfsh_cache_get( fd ) ) != NULL )
+  {
+    // Make sure the server has all our data before reading it back
+    if( rfsh_cache_flush( pe ) == -1 )
+      return -1;
+    while( len )
+    {
+      if( ( pb = rfsh_cache_find( pe, pe->pos ) ) != NULL )
+      {
+        // Cache hit
+        tocopy = pb->offset + pb->len - pe->pos;
+        tocopy = tocopy > len ? len : tocopy;
+        memcpy( p, pb->data + pe->pos - pb->offset, tocopy );
+      }
+      else
+      {
+        if( rfsh_cache_sync_pos( pe, pe->pos ) == -1 )
+          break;
+        if( len >= RFS_REAL_BUFFER_SIZE )
+        {
+          // Large reads go directly to the destination buffer
+          tocopy = len - len % RFS_REAL_BUFFER_SIZE;
+          res = rfsh_read( fd, p, tocopy );
+          pe->srvpos += res;
+          // Stop at the end of the file
+          if( ( u32 )res < tocopy )
+            len = tocopy = res;
+        }
+        else
+        {
+          // Read ahead a full block
+          pb = rfsh_cache_victim( pe );
+          pb->flags = 0;
+          if( ( res = rfsc_read( fd, pb->data, RFS_REAL_BUFFER_SIZE ) ) <= 0 )
+            break;
+          pe->srvpos += res;
+          pb->offset = pe->pos;
+          pb->len = ( u16 )res;
+          pb->flags = RFS_CACHE_BLOCK_VALID;
+          pb->age = ++ pe->tick;
+          tocopy = ( u32 )res > len ? len : ( u32 )res;
+          memcpy( p, pb->data, tocopy );
+        }
+        if( tocopy == 0 )
+          break;
+      }
+      pe->pos += tocopy;
+      total += tocopy;
+      p += tocopy;
+      len -= tocopy;
+    }
+    return ( _ssize_t )total;
+  }
+#endif // #if RFS_CACHE_BLOCKS > 0
+  return ( _ssize_t )rfsh_read( fd, ptr, len );
 }
 
 // lseek
 static off_t rfs_lseek_r( struct _reent *r, int fd, off_t off, int whence )
 {
+#if RFS_CACHE_BLOCKS > 0
+  rfs_cache_entry *pe;
+  s32 res;
+  unsigned i;
+
+  if( ( pe = rfsh_cache_get( fd ) ) != NULL )
+  {
+    // Position queries don't need to go to the server
+    if( whence == SEEK_CUR && off == 0 )
+      return ( off_t )pe->pos;
+    if( rfsh_cache_flush( pe ) == -1 )
+      return -1;
+    for( i = 0; i < RFS_CACHE_BLOCKS; i ++ )
+      pe->blocks[ i ].flags = 0;
+    // The server position might differ from ours, so make SEEK_CUR absolute
+    if( whence == SEEK_CUR )
+    {
+      off += pe->pos;
+      whence = SEEK_SET;
+    }
+    if( ( res = rfsc_lseek( fd, ( s32 )off, whence ) ) == -1 )
+      return -1;
+    pe->pos = pe->srvpos = ( u32 )res;
+    return ( off_t )res;
+  }
+#endif // #if RFS_CACHE_BLOCKS > 0
   return ( off_t )rfsc_lseek( fd, ( s32 )off, whence );
 }
 
 // opendir
 static void* rfs_opendir_r( struct _reent *r, const char* name )
 {
+#if RFS_DIRCACHE_SIZE > 0
+  u32 stamp;
+
+  // The stamp is taken before the listing is read, so a change made on the PC
+  // while the listing is read is caught by the next opendir
+  if( !rfs_dircache.busy && strlen( name ) <= DM_MAX_FNAME_LENGTH )
+  {
+    stamp = rfsc_dirstamp( name );
+    if( ( rfs_dircache.valid && !strcmp( name, rfs_dircache.name ) && stamp != 0 && stamp == rfs_dircache.stamp ) ||
+        rfsh_dircache_fill( name, stamp ) == 0 )
+    {
+      rfs_dircache.busy = 1;
+      rfs_dircache.rdptr = 0;
+      return RFS_DIRCACHE_HANDLE;
+    }
+  }
+#endif
   return ( void* )rfsc_opendir( name );
 }
 
@@ -106,6 +509,20 @@ static struct dm_dirent* rfs_readdir_r( struct _reent *r, void *d )
 {
   static struct dm_dirent ent;
 
+#if RFS_DIRCACHE_SIZE > 0
+  if( d == RFS_DIRCACHE_HANDLE )
+  {
+    const u8 *p = rfs_dircache.data + rfs_dircache.rdptr;
+
+    if( rfs_dircache.rdptr >= rfs_dircache.used )
+      return NULL;
+    memcpy( &ent.fsize, p, sizeof( u32 ) );
+    memcpy( &ent.ftime, p + sizeof( u32 ), sizeof( u32 ) );
+    ent.fname = ( const char* )p + 2 * sizeof( u32 );
+    rfs_dircache.rdptr += 2 * sizeof( u32 ) + strlen( ent.fname ) + 1;
+    return &ent;
+  }
+#endif
   rfsc_readdir( ( u32 )d, &ent.fname, &ent.fsize, &ent.ftime );
   if( ent.fname == NULL )
     return NULL;
@@ -115,6 +532,13 @@ static struct dm_dirent* rfs_readdir_r( struct _reent *r, void *d )
 // closedir
 static int rfs_closedir_r( struct _reent *r, void *d )
 {
+#if RFS_DIRCACHE_SIZE > 0
+  if( d == RFS_DIRCACHE_HANDLE )
+  {
+    rfs_dircache.busy = 0;
+    return 0;
+  }
+#endif
   return rfsc_closedir( ( u32 )d );
 }
 
@@ -200,6 +624,14 @@ const DM_DEVICE *remotefs_init()
   } 
 #endif
   rfsc_setup( rfs_buffer, rfs_send, rfs_recv, RFS_TIMEOUT );
+#if RFS_CACHE_BLOCKS > 0
+  {
+    unsigned i;
+
+    for( i = 0; i < RFS_CACHE_FDS; i ++ )
+      rfs_cache[ i ].fd = -1;
+  }
+#endif
   return &rfs_device;
 }
 
@@ -31,6 +31,20 @@ int remotefs_open_read_request( const u8 *p, const char **ppathname, int *pflags
   return eluarpc_gen_read( p, "opii", RFS_OP_OPEN, ppathname, NULL, pflags, pmode );  
 }  
 
+void remotefs_open_write_response_method( u8 *p, int result, int method )
+{
+  eluarpc_gen_write( p, "rii", RFS_OP_OPEN, result, method );
+}
+
+int remotefs_open_read_response_method( const u8 *p, int *presult, int *pmethod )
+{
+  // Fall back to the regular response if the server ignored the compression request
+  if( eluarpc_gen_read( p, "rii", RFS_OP_OPEN, presult, pmethod ) == ELUARPC_OK )
+    return ELUARPC_OK;
+  *pmethod = 0;
+  return eluarpc_gen_read( p, "ri", RFS_OP_OPEN, presult );
+}
+
 // *****************************************************************************
 // Operation: write
 // write: ssize_t write( int fd, const void *buf, size_t count )
@@ -79,6 +93,53 @@ int remotefs_read_read_request( const u8 *p, int *pfd, u32 *pcount )
   return eluarpc_gen_read( p, "oil", RFS_OP_READ, pfd, pcount );    
 }
   
+// *****************************************************************************
+// Operation: readz (read with compressed data)
+
+void remotefs_readz_write_response( u8 *p, u32 datalen, u32 readbytes )
+{
+  eluarpc_gen_write( p, "rpl", RFS_OP_READZ, NULL, datalen, readbytes );
+}
+
+int remotefs_readz_read_response( const u8 *p, const u8 **ppdata, u32 *pdatalen, u32 *preadbytes )
+{
+  return eluarpc_gen_read( p, "rpl", RFS_OP_READZ, ppdata, pdatalen, preadbytes );
+}
+
+void remotefs_readz_write_request( u8 *p, int fd, u32 count )
+{
+  eluarpc_gen_write( p, "oil", RFS_OP_READZ, fd, count );
+}
+
+int remotefs_readz_read_request( const u8 *p, int *pfd, u32 *pcount )
+{
+  return eluarpc_gen_read( p, "oil", RFS_OP_READZ, pfd, pcount );
+}
+
+// *****************************************************************************
+// Operation: writez (write with compressed data)
+
+void remotefs_writez_write_response( u8 *p, u32 result )
+{
+  eluarpc_gen_write( p, "rl", RFS_OP_WRITEZ, result );
+}
+
+int remotefs_writez_read_response( const u8 *p, u32 *presult )
+{
+  return eluarpc_gen_read( p, "rl", RFS_OP_WRITEZ, presult );
+}
+
+// If 'buf' is NULL the data must already be in the packet at ELUARPC_WRITE_BUF_OFFSET
+void remotefs_writez_write_request( u8 *p, int fd, const void *buf, u32 datalen, u32 count )
+{
+  eluarpc_gen_write( p, "oipl", RFS_OP_WRITEZ, fd, buf, datalen, count );
+}
+
+int remotefs_writez_read_request( const u8 *p, int *pfd, const void **pbuf, u32 *pdatalen, u32 *pcount )
+{
+  return eluarpc_gen_read( p, "oipl", RFS_OP_WRITEZ, pfd, pbuf, pdatalen, pcount );
+}
+
 // *****************************************************************************
 // Operation: close  
 // close: int close( int fd )
@@ -201,3 +262,27 @@ int remotefs_closedir_read_request( const u8 *p, u32 *pd )
 }
 
 
+
+// ****************************************************************************
+// Operation: dirstamp
+// dirstamp: u32 dirstamp( const char *name )
+
+void remotefs_dirstamp_write_response( u8 *p, u32 stamp )
+{
+  eluarpc_gen_write( p, "rl", RFS_OP_DIRSTAMP, stamp );
+}
+
+int remotefs_dirstamp_read_response( const u8 *p, u32 *pstamp )
+{
+  return eluarpc_gen_read( p, "rl", RFS_OP_DIRSTAMP, pstamp );
+}
+
+void remotefs_dirstamp_write_request( u8 *p, const char *name )
+{
+  eluarpc_gen_write( p, "op", RFS_OP_DIRSTAMP, name, strlen( name ) + 1 );
+}
+
+int remotefs_dirstamp_read_request( const u8 *p, const char **pname )
+{
+  return eluarpc_gen_read( p, "op", RFS_OP_DIRSTAMP, pname, NULL );
+}
@@ -2,6 +2,7 @@
 #include "romfs.h"
 #include "type.h"
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
 #include "devman.h"
 #include "romfiles.h"
@@ -11,7 +12,11 @@
 #include "platform_conf.h"
 #ifdef BUILD_ROMFS
 
+// Maximum number of files opened at the same time
+#ifndef ROMFS_MAX_FDS
 #define ROMFS_MAX_FDS   4
+#endif
+
 #define fsmin( x , y ) ( ( x ) < ( y ) ? ( x ) : ( y ) )
 
 static FS romfs_fd_table[ ROMFS_MAX_FDS ];
@@ -37,45 +42,63 @@ static void romfs_close_fd( int fd )
   memset( romfs_fd_table + fd, 0, sizeof( FS ) );
 }
 
+// Read a 16-bit or a 32-bit little endian number from the file system
+static u16 romfs_read_u16( p_read_fs_byte p_read_func, u32 addr )
+{
+  return p_read_func( addr ) | ( p_read_func( addr + 1 ) << 8 );
+}
+
+static u32 romfs_read_u32( p_read_fs_byte p_read_func, u32 addr )
+{
+  return romfs_read_u16( p_read_func, addr ) | ( ( u32 )romfs_read_u16( p_read_func, addr + 2 ) << 16 );
+}
+
+// Return the address of the directory (the first entry)
+static u32 romfs_dir_addr( p_read_fs_byte p_read_func )
+{
+  u32 addr = ROMFS_HEADER_SIZE + ( romfs_read_u16( p_read_func, ROMFS_MAGIC_SIZE + 2 ) + 1 ) * 2;
+
+  return ( addr + ROMFS_ALIGN - 1 ) & ~( ROMFS_ALIGN - 1 );
+}
+
 // Open the given file, returning one of FS_FILE_NOT_FOUND, FS_FILE_ALREADY_OPENED
 // or FS_FILE_OK
 u8 romfs_open_file( const char* fname, p_read_fs_byte p_read_func, FS* pfs )
 {
-  u32 i, j;
-  char fsname[ DM_MAX_FNAME_LENGTH + 1 ];
-  u16 fsize;
+  u32 h = 0, addr, nameaddr, i, last;
+  const char *p;
+  u16 nbuckets;
+  int c;
   
-  // Look for the file
-  i = 0;
-  while( 1 )
+  for( i = 0; i < ROMFS_MAGIC_SIZE; i ++ )
+    if( p_read_func( i ) != ROMFS_MAGIC[ i ] )
+      return FS_FILE_NOT_FOUND;
+  // Find the hash bucket of the file
+  for( p = fname; *p; p ++ )
+    h = ROMFS_HASH_STEP( h, tolower( ( unsigned char )*p ) );
+  nbuckets = romfs_read_u16( p_read_func, ROMFS_MAGIC_SIZE + 2 );
+  addr = ROMFS_HEADER_SIZE + ( h & ( nbuckets - 1 ) ) * 2;
+  i = romfs_read_u16( p_read_func, addr );
+  last = romfs_read_u16( p_read_func, addr + 2 );
+  // Look for the file in its bucket
+  for( addr = romfs_dir_addr( p_read_func ) + i * ROMFS_DIRENT_SIZE; i < last; i ++, addr += ROMFS_DIRENT_SIZE )
   {
-    // Read file name
-    for( j = 0; j < DM_MAX_FNAME_LENGTH; j ++ )
+    nameaddr = romfs_read_u32( p_read_func, addr );
+    for( p = fname; ; p ++, nameaddr ++ )
     {
-      fsname[ j ] = p_read_func( i + j );
-      if( fsname[ j ] == 0 )
-      {
-        if( j == 0 )
-          return FS_FILE_NOT_FOUND;
-        else
-          break;
-      }
+      c = p_read_func( nameaddr );
+      if( tolower( c ) != tolower( ( unsigned char )*p ) || c == 0 )
+        break;
     }
-    // ' i + j' now points at the '0' byte
-    j = i + j + 1;
-    // And read the size   
-    fsize = p_read_func( j ) + ( p_read_func( j + 1 ) << 8 );
-    if( !strncasecmp( fname, fsname, DM_MAX_FNAME_LENGTH ) )
+    if( c == 0 && *p == '\0' )
     {
       // Found the file
-      pfs->baseaddr = j + 2;
+      pfs->baseaddr = romfs_read_u32( p_read_func, addr + 4 );
       pfs->offset = 0;
-      pfs->size = fsize;
+      pfs->size = romfs_read_u32( p_read_func, addr + 8 );
       pfs->p_read_func = p_read_func;   
       return FS_FILE_OK;
     }
-    // Move to next file
-    i = j + 2 + fsize;
   }
   return FS_FILE_NOT_FOUND;
 }
@@ -153,17 +176,75 @@ static off_t romfs_lseek_r( struct _reent *r, int fd, off_t off, int whence )
   return newpos;
 }
 
+// map
+static int romfs_map_r( struct _reent *r, const char *path, const void **pdata, u32 *psize )
+{
+  FS tempfs;
+
+  if( romfs_open_file( path, romfs_read, &tempfs ) != FS_FILE_OK )
+  {
+    r->_errno = ENOENT;
+    return -1;
+  }
+  *pdata = romfiles_fs + tempfs.baseaddr;
+  *psize = tempfs.size;
+  return 0;
+}
+
 // Directory operations
-static u32 romfs_dir_data = 0;
+// The directories are not stored in the image, the files of directory 'a/b'
+// are the ones with names that start with 'a/b/' and have no other '/'.
+typedef struct
+{
+  u32 idx;          // next directory entry
+  u32 prefaddr;     // address of a file name that starts with the directory name
+  u16 preflen;      // length of the directory name including the final '/' (0 for the root)
+} ROMFS_DIR;
+
+static ROMFS_DIR romfs_dir_data;
+
+// Return the part of the name at 'nameaddr' after the prefix of the open
+// directory, or 0 if the file is not in the directory
+static u32 romfs_dir_match( u32 nameaddr )
+{
+  u32 prefaddr = romfs_dir_data.prefaddr;
+  u16 i;
+
+  for( i = 0; i < romfs_dir_data.preflen; i ++ )
+    if( tolower( romfs_read( nameaddr + i ) ) != tolower( romfs_read( prefaddr + i ) ) )
+      return 0;
+  return nameaddr + i;
+}
 
 // opendir
 static void* romfs_opendir_r( struct _reent *r, const char* dname )
 {
-  if( !dname || strlen( dname ) == 0 || ( strlen( dname ) == 1 && !strcmp( dname, "/" ) ) )
-  {
-    romfs_dir_data = 0;
+  u32 i, nfiles, addr, nameaddr;
+  unsigned len, j;
+
+  romfs_dir_data.idx = romfs_dir_data.prefaddr = romfs_dir_data.preflen = 0;
+  while( dname && *dname == '/' )
+    dname ++;
+  if( !dname || ( len = strlen( dname ) ) == 0 )
     return &romfs_dir_data;
+  while( len > 0 && dname[ len - 1 ] == '/' )
+    len --;
+  // The directory exists if at least one file name starts with 'dname/'
+  nfiles = romfs_read_u16( romfs_read, ROMFS_MAGIC_SIZE );
+  for( i = 0, addr = romfs_dir_addr( romfs_read ); i < nfiles; i ++, addr += ROMFS_DIRENT_SIZE )
+  {
+    nameaddr = romfs_read_u32( romfs_read, addr );
+    for( j = 0; j < len; j ++ )
+      if( tolower( romfs_read( nameaddr + j ) ) != tolower( ( unsigned char )dname[ j ] ) )
+        break;
+    if( j == len && romfs_read( nameaddr + len ) == '/' )
+    {
+      romfs_dir_data.prefaddr = nameaddr;
+      romfs_dir_data.preflen = len + 1;
+      return &romfs_dir_data;
+    }
   }
+  r->_errno = ENOENT;
   return NULL;
 }
 
@@ -172,24 +253,35 @@ extern struct dm_dirent dm_shared_dirent;
 extern char dm_shared_fname[ DM_MAX_FNAME_LENGTH + 1 ];
 static struct dm_dirent* romfs_readdir_r( struct _reent *r, void *d )
 {
-  u32 off = *( u32* )d;
+  ROMFS_DIR *pdir = ( ROMFS_DIR* )d;
+  u32 addr, nameaddr;
   struct dm_dirent *pent = &dm_shared_dirent;
-  unsigned j = 0;
-  
-  if( romfs_read( off ) == 0 )
-    return NULL;
-  while( ( dm_shared_fname[ j ++ ] = romfs_read( off ++ ) ) != '\0' );
-  pent->fname = dm_shared_fname;
-  pent->fsize = romfs_read( off ) + ( romfs_read( off + 1 ) << 8 );
-  pent->ftime = 0;
-  *( u32* )d = off + 2 + pent->fsize;
-  return pent;
+  unsigned j;
+  int c;
+
+  while( pdir->idx < romfs_read_u16( romfs_read, ROMFS_MAGIC_SIZE ) )
+  {
+    addr = romfs_dir_addr( romfs_read ) + pdir->idx ++ * ROMFS_DIRENT_SIZE;
+    if( ( nameaddr = romfs_dir_match( romfs_read_u32( romfs_read, addr ) ) ) == 0 )
+      continue;
+    // Files in subdirectories are not listed
+    for( j = 0; ( c = romfs_read( nameaddr + j ) ) != '\0' && c != '/' && j < DM_MAX_FNAME_LENGTH; j ++ )
+      dm_shared_fname[ j ] = c;
+    if( c != '\0' )
+      continue;
+    dm_shared_fname[ j ] = '\0';
+    pent->fname = dm_shared_fname;
+    pent->fsize = romfs_read_u32( romfs_read, addr + 8 );
+    pent->ftime = 0;
+    return pent;
+  }
+  return NULL;
 }
 
 // closedir
 static int romfs_closedir_r( struct _reent *r, void *d )
 {
-  *( u32* )d = 0;
+  ( ( ROMFS_DIR* )d )->idx = 0;
   return 0;
 }
 
@@ -204,7 +296,8 @@ static const DM_DEVICE romfs_device =
   romfs_lseek_r,        // lseek
   romfs_opendir_r,      // opendir
   romfs_readdir_r,      // readdir
-  romfs_closedir_r      // closedir
+  romfs_closedir_r,     // closedir
+  romfs_map_r           // map
 };
 
 const DM_DEVICE* romfs_init()
@@ -15,6 +15,9 @@
 
 #define SEMIFS_MAX_FDS   4
 
+// Maximum length of the search pattern used to list a directory
+#define SEMIFS_MAX_PATTERN  128
+
 // Custom Functions for mbed getting listings of files
 #define RESERVED_FOR_USER_APPLICATIONS (0x100) /* 0x100 - 0x1ff */
 #define USR_XFFIND (RESERVED_FOR_USER_APPLICATIONS + 0)    
@@ -210,12 +213,30 @@ static int xffind(const char *pattern, XFINFO *info)
 }
 
 // opendir
-char testpattern[] = "*";
-SEARCHINFO semifs_dir;
+// The search pattern is '<dir>/*' for a subdirectory and '*' for the root directory
+static char semifs_pattern[ SEMIFS_MAX_PATTERN + 1 ];
+static SEARCHINFO semifs_dir;
 static void* semifs_opendir_r( struct _reent *r, const char* dname )
 {
+  unsigned len = 0;
+
+  while( dname && *dname == '/' )
+    dname ++;
+  if( dname )
+    len = strlen( dname );
+  while( len > 0 && dname[ len - 1 ] == '/' )
+    len --;
+  if( len + 2 > SEMIFS_MAX_PATTERN )
+  {
+    r->_errno = ENAMETOOLONG;
+    return NULL;
+  }
+  memcpy( semifs_pattern, dname, len );
+  if( len > 0 )
+    semifs_pattern[ len ++ ] = '/';
+  strcpy( semifs_pattern + len, "*" );
   semifs_dir.file_info.fileID = 0;
-  semifs_dir.pattern = testpattern;
+  semifs_dir.pattern = semifs_pattern;
   return ( void * )&semifs_dir;
 }
 
@@ -236,7 +257,10 @@ static struct dm_dirent* semifs_readdir_r( struct _reent *r, void *d )
   strncpy( dm_shared_fname, semifs_file_info->name, DM_MAX_FNAME_LENGTH );
   pent->fname = dm_shared_fname;
   pent->fsize = semifs_file_info->size;
-  pent->ftime = 0; // need to convert from struct to UNIX time?!
+  // Date and time in the FAT format (as in mmcfs)
+  pent->ftime = ( ( u32 )( semifs_file_info->write_time.year - 1980 ) << 25 ) | ( ( u32 )semifs_file_info->write_time.mon << 21 ) |
+                ( ( u32 )semifs_file_info->write_time.day << 16 ) | ( semifs_file_info->write_time.hr << 11 ) |
+                ( semifs_file_info->write_time.min << 5 ) | ( semifs_file_info->write_time.sec >> 1 );
   return pent;
 }
 
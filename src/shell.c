@@ -16,6 +16,7 @@
 #include "remotefs.h"
 #include "eluarpc.h"
 #include "linenoise.h"
+#include "lzf.h"
 
 #include "platform_conf.h"
 #ifdef BUILD_SHELL
@@ -56,7 +57,7 @@ static void shell_help( char* args )
   printf( "  ls or dir   - lists filesystems files and sizes\n" );
   printf( "  cat or type - lists file contents\n" );
   printf( "  lua [args]  - run Lua with the given arguments\n" );
-  printf( "  recv        - receive a file via XMODEM and execute it\n" );
+  printf( "  recv [file] - receive a file via XMODEM and execute it (or save it)\n" );
   printf( "  cp <src> <dst> - copy source file 'src' to 'dst'\n" );
   printf( "  ver         - print eLua version\n" );
 }
@@ -108,6 +109,21 @@ static void shell_lua( char* args )
 }
 
 // 'recv' handler
+#ifdef BUILD_XMODEM
+// Data function for 'recv <file>': write the data to the file as it arrives
+static int shell_recv_write( void *pdata, const u8 *p, u32 size )
+{
+  FILE *fp = ( FILE* )pdata;
+
+#ifdef XMODEM_COMPRESS
+  // Compressed files are decompressed in RAM, they can't be saved
+  if( ftell( fp ) == 0 && size >= LZF_FILE_MAGIC_SIZE && !memcmp( p, LZF_FILE_MAGIC, LZF_FILE_MAGIC_SIZE ) )
+    return XMODEM_ERROR_DECOMPRESS;
+#endif
+  return fwrite( p, 1, size, fp ) == size ? 0 : XMODEM_ERROR_WRITE;
+}
+#endif // #ifdef BUILD_XMODEM
+
 static void shell_recv( char* args )
 {
   args = args;
@@ -117,32 +133,52 @@ static void shell_recv( char* args )
   return;
 #else // #ifndef BUILD_XMODEM
 
-  char *p;
   long actsize;
   lua_State* L;
+  FILE *fp = NULL;
+  char *p;
 
-  if( ( shell_prog = malloc( XMODEM_INITIAL_BUFFER_SIZE ) ) == NULL )
+  if( *args )
   {
-    printf( "Unable to allocate memory\n" );
-    return;
+    // 'recv <file>': save the file instead of executing it
+    if( ( p = strchr( args, ' ' ) ) != NULL )
+      *p = 0;
+    if( ( fp = fopen( args, "wb" ) ) == NULL )
+    {
+      printf( "Unable to open %s for writing\n", args );
+      return;
+    }
+    printf( "Waiting for file ... " );
+    actsize = xmodem_receive_stream( shell_recv_write, fp );
+    fclose( fp );
   }
-  printf( "Waiting for file ... " );
-  if( ( actsize = xmodem_receive( &shell_prog ) ) < 0 )
+  else
+  {
+    if( ( shell_prog = malloc( XMODEM_INITIAL_BUFFER_SIZE ) ) == NULL )
+    {
+      printf( "Unable to allocate memory\n" );
+      return;
+    }
+    printf( "Waiting for file ... " );
+    actsize = xmodem_receive( &shell_prog );
+  }
+  if( actsize < 0 )
   {
     free( shell_prog );
     shell_prog = NULL;
     if( actsize == XMODEM_ERROR_OUTOFMEM )
       printf( "file too big\n" );
+    else if( actsize == XMODEM_ERROR_DECOMPRESS )
+      printf( fp ? "compressed files can't be saved\n" : "invalid compressed data\n" );
+    else if( actsize == XMODEM_ERROR_WRITE )
+      printf( "unable to write to %s\n", args );
     else
       printf( "XMODEM error\n" );
     return;
   }
-  // Eliminate the XMODEM padding bytes
-  p = shell_prog + actsize - 1;
-  while( *p == '\x1A' )
-    p --;
-  p ++;
-  printf( "done, got %u bytes\n", ( unsigned )( p - shell_prog ) );          
+  printf( "done, got %u bytes\n", ( unsigned )actsize );
+  if( fp )
+    return;
   
   // Execute
   if( ( L = lua_open() ) == NULL )
@@ -153,7 +189,7 @@ static void shell_recv( char* args )
     return;
   }
   luaL_openlibs( L );
-  if( luaL_loadbuffer( L, shell_prog, p - shell_prog, "xmodem" ) != 0 )
+  if( luaL_loadbuffer( L, shell_prog, actsize, "xmodem" ) != 0 )
     printf( "Error: %s\n", lua_tostring( L, -1 ) );
   else
     if( lua_pcall( L, 0, LUA_MULTRET, 0 ) != 0 )
@@ -0,0 +1,794 @@
+// WOFS: write once file system in the internal flash of the MCU
+// The flash after the firmware image is used as a circular log of records.
+// Each sector in use starts with a header that has a sequence number, followed
+// by records (file creation, data appended to a file, file removal) that are
+// never modified after they are written. Writing to a file appends a data
+// record to the log, so files can only grow (opening an existing file with
+// O_TRUNC removes it and creates a new one). When the last free sector is
+// needed, the oldest sector is reclaimed: its live records are copied to the
+// free sector, then it is erased. The sectors are always used in the same
+// order, so all of them get the same number of erase cycles.
+// Records that were not completely written (power loss) are detected with
+// checksums and ignored. Mounting reads the sector headers and the records in
+// the used part of the area once, there's no journal to replay.
+
+#include "wofs.h"
+#include "type.h"
+#include "devman.h"
+#include "platform.h"
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "platform_conf.h"
+#ifdef BUILD_WOFS
+
+// Maximum number of files in the file system
+#ifndef WOFS_MAX_FILES
+#define WOFS_MAX_FILES        16
+#endif
+
+// Maximum number of files opened at the same time
+#ifndef WOFS_MAX_FDS
+#define WOFS_MAX_FDS          4
+#endif
+
+// Minimum number of sectors (one of them is always kept free)
+#define WOFS_MIN_SECTORS      3
+
+// Sector header
+#define WOFS_SECT_MAGIC       0x53464F57UL
+#define WOFS_SECT_HDR_SIZE    16
+typedef struct
+{
+  u32 magic;
+  u32 seq;
+  u32 nseq;             // ~seq
+  u32 reserved;
+} WOFS_SECT_HDR;
+
+// Record header, followed by the data of the record (padded to 4 bytes)
+#define WOFS_REC_MAGIC        0x5752
+#define WOFS_REC_HDR_SIZE     16
+enum
+{
+  WOFS_REC_CREATE = 1,  // data is the file name
+  WOFS_REC_DATA,        // data is part of the file
+  WOFS_REC_DELETE       // no data
+};
+typedef struct
+{
+  u16 magic;
+  u8 type;
+  u8 hcheck;            // checksum of the header
+  u16 id;               // file ID
+  u16 len;              // data length
+  u32 offset;           // offset of the data in the file (WOFS_REC_DATA)
+  u32 dcheck;           // checksum of the data
+} WOFS_REC_HDR;
+
+#define WOFS_ALIGN( x )       ( ( ( x ) + 3 ) & ~3UL )
+#define WOFS_REC_SIZE( p )    ( WOFS_REC_HDR_SIZE + WOFS_ALIGN( ( p )->len ) )
+#define WOFS_MAX_REC_DATA     0xFFFC
+#define WOFS_HASH_INIT        2166136261UL
+
+// File data
+typedef struct
+{
+  u16 id;               // 0 for an unused entry
+  u16 nopen;            // number of descriptors of this file
+  u32 size;
+  const WOFS_REC_HDR *pcreate;  // creation record (has the file name)
+} WOFS_FILE;
+
+// Position in the log
+typedef struct
+{
+  u32 sect;             // sector (index in the WOFS area)
+  u32 addr;             // address of a record in the sector
+} WOFS_POS;
+
+// Descriptor data
+typedef struct
+{
+  WOFS_FILE *pfile;     // NULL for an unused descriptor
+  u32 offset;
+  WOFS_POS cursor;      // where to start looking for data records
+  u8 canwrite;
+} WOFS_FD;
+
+static WOFS_FILE wofs_files[ WOFS_MAX_FILES ];
+static WOFS_FD wofs_fds[ WOFS_MAX_FDS ];
+static u32 wofs_first_sect, wofs_num_sects, wofs_max_data;
+static u32 wofs_head, wofs_tail, wofs_used;   // newest sector, oldest sector, number of used sectors
+static u32 wofs_wptr, wofs_seq;               // write address and sequence number of the head
+static u16 wofs_next_id;
+static u8 wofs_id_wrapped;                    // the IDs wrapped around, wofs_next_id may be used
+
+// *****************************************************************************
+// Flash access helpers
+
+static u32 wofs_sect_start( u32 sect )
+{
+  return platform_flash_get_sector_start( wofs_first_sect + sect );
+}
+
+static u32 wofs_sect_end( u32 sect )
+{
+  return platform_flash_get_sector_start( wofs_first_sect + sect + 1 );
+}
+
+static u32 wofs_next_sect( u32 sect )
+{
+  return sect + 1 == wofs_num_sects ? 0 : sect + 1;
+}
+
+static u32 wofs_prev_sect( u32 sect )
+{
+  return sect == 0 ? wofs_num_sects - 1 : sect - 1;
+}
+
+// Return true if the given flash area is erased
+static int wofs_is_blank( u32 addr, u32 end )
+{
+  for( ; addr < end; addr += 4 )
+    if( *( const u32* )addr != 0xFFFFFFFF )
+      return 0;
+  return 1;
+}
+
+// Write data to the flash through an aligned buffer (the last word is padded with 0xFF)
+// The data can be in the flash too, it's not read while the flash is written.
+static int wofs_write( u32 addr, const void *data, u32 len )
+{
+  u32 buf[ 16 ];
+  u32 n;
+
+  while( len > 0 )
+  {
+    n = len > sizeof( buf ) ? sizeof( buf ) : len;
+    buf[ ( n - 1 ) / 4 ] = 0xFFFFFFFF;
+    memcpy( buf, data, n );
+    if( platform_flash_write( buf, addr, WOFS_ALIGN( n ) ) != PLATFORM_OK )
+      return 0;
+    addr += n;
+    data = ( const u8* )data + n;
+    len -= n;
+  }
+  return 1;
+}
+
+// FNV-1a hash
+static u32 wofs_hash( u32 h, const void *data, unsigned len )
+{
+  const u8 *p = ( const u8* )data;
+
+  while( len -- )
+  {
+    h ^= *p ++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+// Checksum of a record header (all the fields except 'hcheck')
+static u8 wofs_hdr_check( const WOFS_REC_HDR *p )
+{
+  u32 h = wofs_hash( WOFS_HASH_INIT, p, 3 );
+
+  h = wofs_hash( h, ( const u8* )p + 4, WOFS_REC_HDR_SIZE - 4 );
+  return ( u8 )( h ^ ( h >> 8 ) ^ ( h >> 16 ) ^ ( h >> 24 ) );
+}
+
+static int wofs_data_ok( const WOFS_REC_HDR *p )
+{
+  return p->dcheck == wofs_hash( WOFS_HASH_INIT, p + 1, p->len );
+}
+
+// Return the sequence number of a sector in *pseq, or 0 if the sector isn't used
+static int wofs_sect_valid( u32 sect, u32 *pseq )
+{
+  const WOFS_SECT_HDR *p = ( const WOFS_SECT_HDR* )wofs_sect_start( sect );
+
+  if( p->magic != WOFS_SECT_MAGIC || p->nseq != ~p->seq )
+    return 0;
+  *pseq = p->seq;
+  return 1;
+}
+
+// *****************************************************************************
+// Log functions
+
+static void wofs_pos_init( WOFS_POS *ppos, u32 sect )
+{
+  ppos->sect = sect;
+  ppos->addr = wofs_sect_start( sect ) + WOFS_SECT_HDR_SIZE;
+}
+
+// Return the record at the given position and move the position to the next
+// record. Returns NULL at the end of the sector (the position isn't changed).
+static const WOFS_REC_HDR* wofs_rec_at( WOFS_POS *ppos )
+{
+  const WOFS_REC_HDR *p = ( const WOFS_REC_HDR* )ppos->addr;
+  u32 limit = ppos->sect == wofs_head ? wofs_wptr : wofs_sect_end( ppos->sect );
+
+  if( ppos->addr + WOFS_REC_HDR_SIZE > limit || p->magic != WOFS_REC_MAGIC || p->hcheck != wofs_hdr_check( p ) )
+    return NULL;
+  if( ppos->addr + WOFS_REC_SIZE( p ) > limit )
+    return NULL;
+  ppos->addr += WOFS_REC_SIZE( p );
+  return p;
+}
+
+// Return the next record in the log (NULL at the end of the log)
+static const WOFS_REC_HDR* wofs_rec_next( WOFS_POS *ppos )
+{
+  const WOFS_REC_HDR *p;
+
+  while( ( p = wofs_rec_at( ppos ) ) == NULL )
+  {
+    if( ppos->sect == wofs_head )
+      return NULL;
+    wofs_pos_init( ppos, wofs_next_sect( ppos->sect ) );
+  }
+  return p;
+}
+
+// Start a new sector after the head (erasing it if needed)
+static int wofs_new_sector()
+{
+  u32 sect = wofs_used ? wofs_next_sect( wofs_head ) : wofs_head;
+  u32 start = wofs_sect_start( sect );
+  WOFS_SECT_HDR h;
+
+  if( wofs_used == wofs_num_sects )
+    return 0;
+  if( !wofs_is_blank( start, wofs_sect_end( sect ) ) && platform_flash_erase( wofs_first_sect + sect ) != PLATFORM_OK )
+    return 0;
+  h.magic = WOFS_SECT_MAGIC;
+  h.seq = wofs_seq + 1;
+  h.nseq = ~h.seq;
+  h.reserved = 0xFFFFFFFF;
+  if( !wofs_write( start, &h, WOFS_SECT_HDR_SIZE ) )
+    return 0;
+  wofs_seq = h.seq;
+  wofs_head = sect;
+  wofs_used ++;
+  wofs_wptr = start + WOFS_SECT_HDR_SIZE;
+  return 1;
+}
+
+static WOFS_FILE* wofs_find_id( u16 id )
+{
+  unsigned i;
+
+  for( i = 0; i < WOFS_MAX_FILES; i ++ )
+    if( wofs_files[ i ].id == id )
+      return wofs_files + i;
+  return NULL;
+}
+
+// Return true if a record in the log has the given file ID
+static int wofs_id_in_log( u16 id )
+{
+  const WOFS_REC_HDR *p;
+  WOFS_POS pos;
+
+  wofs_pos_init( &pos, wofs_tail );
+  while( ( p = wofs_rec_next( &pos ) ) != NULL )
+    if( p->id == id )
+      return 1;
+  return 0;
+}
+
+// Get the ID of a new file (0 if there's no free ID). The IDs from
+// wofs_next_id up are not used by any record until the IDs wrap around. After
+// that the IDs still used by a record in the log (of an existing file or of a
+// removed file that was not reclaimed yet) are skipped, so the records of two
+// files never have the same ID.
+static u16 wofs_new_id()
+{
+  u32 i;
+  u16 id;
+  int ok;
+
+  for( i = 0; i < 0xFFFF; i ++ )
+  {
+    id = wofs_next_id;
+    ok = !wofs_id_wrapped || !wofs_id_in_log( id );
+    if( ++ wofs_next_id == 0 )
+    {
+      wofs_next_id = 1;
+      wofs_id_wrapped = 1;
+    }
+    if( ok )
+      return id;
+  }
+  return 0;
+}
+
+// Reclaim the oldest sector: copy its live records to a new sector, then erase it
+static int wofs_reclaim()
+{
+  u32 sect = wofs_tail, addr, zero = 0;
+  const WOFS_REC_HDR *p;
+  WOFS_FILE *pf;
+  WOFS_POS pos;
+  unsigned i;
+
+  if( !wofs_new_sector() )
+    return 0;
+  wofs_pos_init( &pos, sect );
+  while( ( p = wofs_rec_at( &pos ) ) != NULL )
+  {
+    // Only the records of the existing files are kept
+    if( ( pf = wofs_find_id( p->id ) ) == NULL )
+      continue;
+    if( ( p->type == WOFS_REC_CREATE && p == pf->pcreate ) ||
+        ( p->type == WOFS_REC_DATA && p->offset < pf->size && wofs_data_ok( p ) ) )
+    {
+      addr = wofs_wptr;
+      if( addr + WOFS_REC_SIZE( p ) > wofs_sect_end( wofs_head ) )
+        return 0;
+      wofs_wptr += WOFS_REC_SIZE( p );
+      if( !wofs_write( addr, p, WOFS_REC_SIZE( p ) ) )
+        return 0;
+      if( p->type == WOFS_REC_CREATE )
+        pf->pcreate = ( const WOFS_REC_HDR* )addr;
+    }
+  }
+  // Clear the sector header first, so a partially erased sector is not used after a reset
+  if( !wofs_write( wofs_sect_start( sect ), &zero, 4 ) || platform_flash_erase( wofs_first_sect + sect ) != PLATFORM_OK )
+    return 0;
+  wofs_tail = wofs_next_sect( sect );
+  wofs_used --;
+  // The descriptors that were using the sector start again from the oldest one
+  for( i = 0; i < WOFS_MAX_FDS; i ++ )
+    if( wofs_fds[ i ].pfile && wofs_fds[ i ].cursor.sect == sect )
+      wofs_pos_init( &wofs_fds[ i ].cursor, wofs_tail );
+  return 1;
+}
+
+// Make room for a record of the given size at the end of the log
+static int wofs_make_room( u32 size )
+{
+  u32 reclaimed = 0;
+
+  while( wofs_wptr + size > wofs_sect_end( wofs_head ) )
+  {
+    if( wofs_used + 1 < wofs_num_sects )
+    {
+      if( !wofs_new_sector() )
+        return 0;
+    }
+    else
+    {
+      // Only the sector needed by wofs_reclaim is free. If all the sectors were
+      // reclaimed and there's still no room, the file system is full.
+      if( reclaimed ++ == wofs_num_sects - 1 || !wofs_reclaim() )
+        return 0;
+    }
+  }
+  return 1;
+}
+
+// Append a record to the log, returns its address or NULL for error
+static const WOFS_REC_HDR* wofs_append( u8 type, u16 id, u32 offset, const void *data, u16 len )
+{
+  WOFS_REC_HDR h;
+  u32 addr;
+
+  h.magic = WOFS_REC_MAGIC;
+  h.type = type;
+  h.id = id;
+  h.len = len;
+  h.offset = offset;
+  h.dcheck = wofs_hash( WOFS_HASH_INIT, data, len );
+  h.hcheck = wofs_hdr_check( &h );
+  if( !wofs_make_room( WOFS_REC_SIZE( &h ) ) )
+    return NULL;
+  // The header is written first, so a partially written record has a wrong data checksum
+  addr = wofs_wptr;
+  wofs_wptr += WOFS_REC_SIZE( &h );
+  if( !wofs_write( addr, &h, WOFS_REC_HDR_SIZE ) || !wofs_write( addr + WOFS_REC_HDR_SIZE, data, len ) )
+    return NULL;
+  return ( const WOFS_REC_HDR* )addr;
+}
+
+// Mount the file system (format it if there are no used sectors)
+static int wofs_mount()
+{
+  u32 i, seq, hseq = 0, end, maxid = 0;
+  const WOFS_REC_HDR *p;
+  WOFS_FILE *pf;
+  WOFS_POS pos;
+  int found = 0;
+
+  memset( wofs_files, 0, sizeof( wofs_files ) );
+  memset( wofs_fds, 0, sizeof( wofs_fds ) );
+  wofs_next_id = 1;
+  wofs_id_wrapped = 0;
+  // Find the newest sector
+  for( i = 0; i < wofs_num_sects; i ++ )
+    if( wofs_sect_valid( i, &seq ) && ( !found || seq > hseq ) )
+    {
+      hseq = seq;
+      wofs_head = i;
+      found = 1;
+    }
+  if( !found )
+  {
+    wofs_head = wofs_tail = 0;
+    wofs_used = wofs_seq = 0;
+    return wofs_new_sector();
+  }
+  // The used sectors are the ones before the head with consecutive sequence numbers
+  wofs_seq = hseq;
+  wofs_tail = wofs_head;
+  for( wofs_used = 1; wofs_used < wofs_num_sects; wofs_used ++ )
+  {
+    i = wofs_prev_sect( wofs_tail );
+    if( !wofs_sect_valid( i, &seq ) || seq != hseq - wofs_used )
+      break;
+    wofs_tail = i;
+  }
+  // If all the sectors are used the system was reset while reclaiming the
+  // oldest sector. The head has only copies of records from the oldest sector, drop it.
+  if( wofs_used == wofs_num_sects )
+  {
+    if( platform_flash_erase( wofs_first_sect + wofs_head ) != PLATFORM_OK )
+      return 0;
+    wofs_head = wofs_prev_sect( wofs_head );
+    wofs_used --;
+    wofs_seq --;
+  }
+  // Find the end of the head. If the rest of the sector isn't erased (a record
+  // header was partially written) the sector is not used anymore.
+  end = wofs_wptr = wofs_sect_end( wofs_head );
+  wofs_pos_init( &pos, wofs_head );
+  while( wofs_rec_at( &pos ) != NULL );
+  if( wofs_is_blank( pos.addr, end ) )
+    wofs_wptr = pos.addr;
+  // Find the files
+  wofs_pos_init( &pos, wofs_tail );
+  while( ( p = wofs_rec_next( &pos ) ) != NULL )
+  {
+    if( p->id > maxid )
+      maxid = p->id;
+    if( p->type == WOFS_REC_CREATE )
+    {
+      if( wofs_find_id( p->id ) == NULL && p->len <= DM_MAX_FNAME_LENGTH && wofs_data_ok( p ) && ( pf = wofs_find_id( 0 ) ) != NULL )
+      {
+        pf->id = p->id;
+        pf->pcreate = p;
+      }
+    }
+    else if( p->type == WOFS_REC_DELETE && ( pf = wofs_find_id( p->id ) ) != NULL )
+      pf->id = 0;
+  }
+  // The IDs above the highest one in the log are free. If the highest one is
+  // the last possible ID, the free IDs are looked for by wofs_new_id.
+  wofs_id_wrapped = maxid == 0xFFFF;
+  wofs_next_id = wofs_id_wrapped ? 1 : maxid + 1;
+  // Find the file sizes
+  wofs_pos_init( &pos, wofs_tail );
+  while( ( p = wofs_rec_next( &pos ) ) != NULL )
+    if( p->type == WOFS_REC_DATA && ( pf = wofs_find_id( p->id ) ) != NULL && p->offset + p->len > pf->size && wofs_data_ok( p ) )
+      pf->size = p->offset + p->len;
+  return 1;
+}
+
+// Find a file by name
+static WOFS_FILE* wofs_find_name( const char *name )
+{
+  const char *pname;
+  unsigned i, j, len = strlen( name );
+
+  for( i = 0; i < WOFS_MAX_FILES; i ++ )
+  {
+    if( wofs_files[ i ].id == 0 || wofs_files[ i ].pcreate->len != len )
+      continue;
+    pname = ( const char* )( wofs_files[ i ].pcreate + 1 );
+    for( j = 0; j < len; j ++ )
+      if( tolower( ( unsigned char )pname[ j ] ) != tolower( ( unsigned char )name[ j ] ) )
+        break;
+    if( j == len )
+      return wofs_files + i;
+  }
+  return NULL;
+}
+
+// Find the data record that has the given offset of the file, starting from
+// the cursor of the descriptor (files are usually read in the same order as
+// they were written)
+static const WOFS_REC_HDR* wofs_find_data( WOFS_FD *pfd, u32 offset )
+{
+  WOFS_POS pos = pfd->cursor, prev;
+  const WOFS_REC_HDR *p;
+  u16 id = pfd->pfile->id;
+  int wrapped = 0;
+
+  while( 1 )
+  {
+    prev = pos;
+    if( wrapped && prev.sect == pfd->cursor.sect && prev.addr >= pfd->cursor.addr )
+      return NULL;
+    if( ( p = wofs_rec_next( &pos ) ) == NULL )
+    {
+      // End of the log, continue with the oldest sector
+      if( wrapped )
+        return NULL;
+      wofs_pos_init( &pos, wofs_tail );
+      wrapped = 1;
+      continue;
+    }
+    if( p->type == WOFS_REC_DATA && p->id == id && offset >= p->offset && offset < p->offset + p->len && wofs_data_ok( p ) )
+    {
+      pfd->cursor = prev;
+      return p;
+    }
+  }
+}
+
+// *****************************************************************************
+// Device functions
+
+static int wofs_open_r( struct _reent *r, const char *path, int flags, int mode )
+{
+  const WOFS_REC_HDR *p;
+  WOFS_FILE *pf;
+  WOFS_FD *pfd;
+  u16 id;
+  int fd, canwrite = ( flags & O_ACCMODE ) != O_RDONLY;
+
+  for( fd = 0; fd < WOFS_MAX_FDS; fd ++ )
+    if( wofs_fds[ fd ].pfile == NULL )
+      break;
+  if( fd == WOFS_MAX_FDS )
+  {
+    r->_errno = ENFILE;
+    return -1;
+  }
+  pf = wofs_find_name( path );
+  if( pf && ( flags & O_CREAT ) && ( flags & O_EXCL ) )
+  {
+    r->_errno = EEXIST;
+    return -1;
+  }
+  if( pf && canwrite && ( flags & O_TRUNC ) )
+  {
+    // Remove the file, it will be created again below
+    if( pf->nopen > 0 )
+    {
+      r->_errno = EBUSY;
+      return -1;
+    }
+    if( wofs_append( WOFS_REC_DELETE, pf->id, 0, NULL, 0 ) == NULL )
+    {
+      r->_errno = ENOSPC;
+      return -1;
+    }
+    pf->id = 0;
+    pf = NULL;
+  }
+  if( pf == NULL )
+  {
+    if( ( flags & O_CREAT ) == 0 )
+    {
+      r->_errno = ENOENT;
+      return -1;
+    }
+    if( strlen( path ) > DM_MAX_FNAME_LENGTH )
+    {
+      r->_errno = ENAMETOOLONG;
+      return -1;
+    }
+    if( *path == '\0' || strchr( path, '/' ) )
+    {
+      r->_errno = EINVAL;
+      return -1;
+    }
+    if( ( pf = wofs_find_id( 0 ) ) == NULL || ( id = wofs_new_id() ) == 0 ||
+        ( p = wofs_append( WOFS_REC_CREATE, id, 0, path, strlen( path ) ) ) == NULL )
+    {
+      r->_errno = ENOSPC;
+      return -1;
+    }
+    pf->id = id;
+    pf->nopen = 0;
+    pf->size = 0;
+    pf->pcreate = p;
+  }
+  pfd = wofs_fds + fd;
+  pfd->pfile = pf;
+  pfd->offset = ( flags & O_APPEND ) ? pf->size : 0;
+  pfd->canwrite = canwrite;
+  wofs_pos_init( &pfd->cursor, wofs_tail );
+  pf->nopen ++;
+  return fd;
+}
+
+static int wofs_close_r( struct _reent *r, int fd )
+{
+  wofs_fds[ fd ].pfile->nopen --;
+  wofs_fds[ fd ].pfile = NULL;
+  return 0;
+}
+
+// Data is always appended at the end of the file
+static _ssize_t wofs_write_r( struct _reent *r, int fd, const void* ptr, size_t len )
+{
+  WOFS_FD *pfd = wofs_fds + fd;
+  WOFS_FILE *pf = pfd->pfile;
+  size_t total = 0;
+  u32 n;
+
+  if( !pfd->canwrite )
+  {
+    r->_errno = EBADF;
+    return -1;
+  }
+  while( total < len )
+  {
+    n = len - total > wofs_max_data ? wofs_max_data : len - total;
+    if( wofs_append( WOFS_REC_DATA, pf->id, pf->size, ( const u8* )ptr + total, n ) == NULL )
+    {
+      r->_errno = ENOSPC;
+      if( total == 0 )
+        return -1;
+      break;
+    }
+    pf->size += n;
+    total += n;
+  }
+  pfd->offset = pf->size;
+  return total;
+}
+
+static _ssize_t wofs_read_r( struct _reent *r, int fd, void* ptr, size_t len )
+{
+  WOFS_FD *pfd = wofs_fds + fd;
+  const WOFS_REC_HDR *p;
+  size_t total = 0;
+  u32 n, skip;
+
+  if( len > pfd->pfile->size - pfd->offset )
+    len = pfd->pfile->size - pfd->offset;
+  while( total < len )
+  {
+    if( ( p = wofs_find_data( pfd, pfd->offset ) ) == NULL )
+    {
+      r->_errno = EIO;
+      return total > 0 ? total : -1;
+    }
+    skip = pfd->offset - p->offset;
+    n = p->len - skip;
+    if( n > len - total )
+      n = len - total;
+    memcpy( ( u8* )ptr + total, ( const u8* )( p + 1 ) + skip, n );
+    total += n;
+    pfd->offset += n;
+  }
+  return total;
+}
+
+// lseek
+static off_t wofs_lseek_r( struct _reent *r, int fd, off_t off, int whence )
+{
+  WOFS_FD *pfd = wofs_fds + fd;
+  u32 newpos = 0;
+
+  switch( whence )
+  {
+    case SEEK_SET:
+      newpos = off;
+      break;
+
+    case SEEK_CUR:
+      newpos = pfd->offset + off;
+      break;
+
+    case SEEK_END:
+      newpos = pfd->pfile->size + off;
+      break;
+
+    default:
+      return -1;
+  }
+  if( newpos > pfd->pfile->size )
+    return -1;
+  // Look for the data from the start of the log when moving backwards
+  if( newpos < pfd->offset )
+    wofs_pos_init( &pfd->cursor, wofs_tail );
+  pfd->offset = newpos;
+  return newpos;
+}
+
+// Directory operations
+static u32 wofs_dir_data = 0;
+
+// opendir
+static void* wofs_opendir_r( struct _reent *r, const char* dname )
+{
+  if( !dname || strlen( dname ) == 0 || ( strlen( dname ) == 1 && !strcmp( dname, "/" ) ) )
+  {
+    wofs_dir_data = 0;
+    return &wofs_dir_data;
+  }
+  return NULL;
+}
+
+// readdir
+extern struct dm_dirent dm_shared_dirent;
+extern char dm_shared_fname[ DM_MAX_FNAME_LENGTH + 1 ];
+static struct dm_dirent* wofs_readdir_r( struct _reent *r, void *d )
+{
+  u32 idx = *( u32* )d;
+  struct dm_dirent *pent = &dm_shared_dirent;
+  WOFS_FILE *pf;
+
+  while( idx < WOFS_MAX_FILES && wofs_files[ idx ].id == 0 )
+    idx ++;
+  if( idx == WOFS_MAX_FILES )
+    return NULL;
+  pf = wofs_files + idx;
+  memcpy( dm_shared_fname, pf->pcreate + 1, pf->pcreate->len );
+  dm_shared_fname[ pf->pcreate->len ] = '\0';
+  pent->fname = dm_shared_fname;
+  pent->fsize = pf->size;
+  pent->ftime = 0;
+  *( u32* )d = idx + 1;
+  return pent;
+}
+
+// closedir
+static int wofs_closedir_r( struct _reent *r, void *d )
+{
+  *( u32* )d = 0;
+  return 0;
+}
+
+// WOFS device descriptor structure
+static const DM_DEVICE wofs_device =
+{
+  "/wofs",
+  wofs_open_r,          // open
+  wofs_close_r,         // close
+  wofs_write_r,         // write
+  wofs_read_r,          // read
+  wofs_lseek_r,         // lseek
+  wofs_opendir_r,       // opendir
+  wofs_readdir_r,       // readdir
+  wofs_closedir_r       // closedir
+};
+
+const DM_DEVICE* wofs_init()
+{
+  u32 i, size, n = platform_flash_get_num_sectors();
+
+  wofs_first_sect = platform_flash_get_first_free_sector();
+  if( n < wofs_first_sect + WOFS_MIN_SECTORS )
+    return NULL;
+  wofs_num_sects = n - wofs_first_sect;
+  // A record must fit in the smallest sector
+  wofs_max_data = WOFS_MAX_REC_DATA;
+  for( i = 0; i < wofs_num_sects; i ++ )
+  {
+    size = wofs_sect_end( i ) - wofs_sect_start( i ) - WOFS_SECT_HDR_SIZE - WOFS_REC_HDR_SIZE;
+    if( size < wofs_max_data )
+      wofs_max_data = size & ~3UL;
+  }
+  if( !wofs_mount() )
+    return NULL;
+  return &wofs_device;
+}
+
+#else // #ifdef BUILD_WOFS
+
+const DM_DEVICE* wofs_init()
+{
+  return NULL;
+}
+
+#endif // #ifdef BUILD_WOFS
@@ -38,16 +38,23 @@
 #include "platform_conf.h"
 #ifdef BUILD_XMODEM
 
+#ifdef XMODEM_COMPRESS
+#include "lzf.h"
+#endif
+
 #define PXM_ACKET_SIZE    128
+#define PXM_ACKET_1K_SIZE 1024
 static p_xm_send_func xmodem_out_func;
 static p_xm_recv_func xmodem_in_func;
 
 // Line control codes
 #define XM_SOH  0x01
+#define XM_STX  0x02
 #define XM_ACK  0x06
 #define XM_NAK  0x15
 #define XM_CAN  0x18
 #define XM_EOT  0x04
+#define XM_PAD  0x1A
 
 // Arguments to xmodem_flush
 #define XMODEM_FLUSH_ONLY       0
@@ -56,6 +63,11 @@ static p_xm_recv_func xmodem_in_func;
 // Delay in "flush packet" mode
 #define XMODEM_PXM_ACKET_DELAY     10000UL
 
+// Return codes of xmodem_get_record
+#define XMODEM_RECORD_ERR       0
+#define XMODEM_RECORD_OK        1
+#define XMODEM_RECORD_DUP       2
+
 void xmodem_init( p_xm_send_func send_func, p_xm_recv_func recv_func )
 {
   xmodem_out_func = send_func;
@@ -74,15 +86,17 @@ static void xmodem_flush( int how )
   }
 }
 
-// This private function receives a x-modem record to the pointer and
-// returns 1 on success and 0 on error
-static int xmodem_get_record( unsigned char blocknum, unsigned char *pbuf )
+// This private function receives a x-modem record of 'size' bytes to the
+// pointer. Returns XMODEM_RECORD_OK on success, XMODEM_RECORD_DUP if the
+// previous record was received again (our ACK was lost) or XMODEM_RECORD_ERR
+// on error (in this case the record is NAKed)
+static int xmodem_get_record( unsigned char blocknum, unsigned char *pbuf, unsigned size )
 {
-  unsigned chk, j, size;
+  unsigned chk, i, j;
   int ch;
   
   // Read packet
-  for( j = 0; j < PXM_ACKET_SIZE + 4; j ++ )
+  for( j = 0; j < size + 4; j ++ )
   {
     if( ( ch = xmodem_in_func( XMODEM_TIMEOUT ) ) == -1 )
       goto err;
@@ -90,12 +104,17 @@ static int xmodem_get_record( unsigned char blocknum, unsigned char *pbuf )
   }
 
   // Check block number
-  if( *pbuf ++ != blocknum )
+  if( pbuf[ 0 ] != ( unsigned char )~pbuf[ 1 ] )
     goto err;
-  if( *pbuf ++ != ( unsigned char )~blocknum )
+  if( pbuf[ 0 ] != blocknum )
+  {
+    if( pbuf[ 0 ] == ( unsigned char )( blocknum - 1 ) )
+      return XMODEM_RECORD_DUP;
     goto err;
+  }
   // Check CRC
-  for( size = chk = 0; size < PXM_ACKET_SIZE; size++, pbuf ++ ) 
+  pbuf += 2;
+  for( i = chk = 0; i < size; i++, pbuf ++ ) 
   {
     chk = chk ^ *pbuf << 8;
     for( j = 0; j < 8; j ++ ) 
@@ -111,74 +130,191 @@ static int xmodem_get_record( unsigned char blocknum, unsigned char *pbuf )
     goto err;
   if( *pbuf ++ != ( chk & 0xFF ) )
     goto err;
-  return 1;
+  return XMODEM_RECORD_OK;
   
 err:
+  // Wait for the line to become idle before asking for a retransmission
+  xmodem_flush( XMODEM_FLUSH_ONLY );
   xmodem_out_func( XM_NAK );
+  return XMODEM_RECORD_ERR;
+}
+
+// Give 'size' padding chars to the data function
+static int xmodem_send_padding( p_xm_data_func func, void *pdata, unsigned size )
+{
+  u8 pad[ 16 ];
+  unsigned len;
+  int res;
+
+  memset( pad, XM_PAD, sizeof( pad ) );
+  for( ; size > 0; size -= len )
+  {
+    len = size > sizeof( pad ) ? sizeof( pad ) : size;
+    if( ( res = func( pdata, pad, len ) ) < 0 )
+      return res;
+  }
   return 0;
 }
 
 // This global function receives a x-modem transmission consisting of
-// (potentially) several blocks.  Returns the number of bytes received or
-// an error code an error
-long xmodem_receive( char **dest )
+// (potentially) several blocks of 128 bytes (SOH) or 1024 bytes (STX, 
+// XMODEM-1K), all with CRC-16. The data of each valid block is given to 'func'
+// before the block is acknowledged, so it can go directly to a file. The
+// padding chars at the end of a block are kept until the next block arrives,
+// this way the padding after the last block is never written. Compressed data
+// (XMODEM_COMPRESS) is given as it is, padding included: the LZF header has
+// the size of the data, so the decompressor ignores the padding, and the
+// compressed data itself can end with XM_PAD chars.
+// Returns the number of bytes received or an error code on error ('func' 
+// can also return an error code to abort the transfer)
+long xmodem_receive_stream( p_xm_data_func func, void *pdata )
 {
   int starting = 1, ch;
-  unsigned char packnum = 1, buf[ PXM_ACKET_SIZE + 4 ];
-  unsigned retries = XMODEM_RETRY_LIMIT;
-  u32 limit = XMODEM_INITIAL_BUFFER_SIZE, size = 0;
-  void *p;
+  unsigned char packnum = 1, *buf;
+  unsigned retries = XMODEM_RETRY_LIMIT, pktsize, len, padding = 0;
+  u32 size = 0;
+  long res;
+  int strip = 1;
   
+  if( ( buf = malloc( PXM_ACKET_1K_SIZE + 4 ) ) == NULL )
+    return XMODEM_ERROR_OUTOFMEM;
   while( retries-- ) 
   {
     if( starting )
       xmodem_out_func( 'C' );
-    if( ( ( ch = xmodem_in_func( XMODEM_TIMEOUT ) ) == -1 ) || ( ch != XM_SOH && ch != XM_EOT && ch != XM_CAN ) )
+    if( ( ( ch = xmodem_in_func( XMODEM_TIMEOUT ) ) == -1 ) || ( ch != XM_SOH && ch != XM_STX && ch != XM_EOT && ch != XM_CAN ) )
       continue;
     if( ch == XM_EOT ) 
     {
       // End of transmission
       xmodem_out_func( XM_ACK );
       xmodem_flush( XMODEM_FLUSH_ONLY );
-      return size;
+      res = size;
+      goto out;
     }
     else if( ch == XM_CAN )
     {
       // The remote part ended the transmission
       xmodem_out_func( XM_ACK );
       xmodem_flush( XMODEM_FLUSH_ONLY );
-      return XMODEM_ERROR_REMOTECANCEL;      
+      res = XMODEM_ERROR_REMOTECANCEL;
+      goto out;
     }
     starting = 0;
     
     // Get XMODEM packet
-    if( !xmodem_get_record( packnum, buf ) )
+    pktsize = ch == XM_STX ? PXM_ACKET_1K_SIZE : PXM_ACKET_SIZE;
+    if( ( ch = xmodem_get_record( packnum, buf, pktsize ) ) == XMODEM_RECORD_ERR )
       continue; // allow for retransmission
-    xmodem_flush( XMODEM_FLUSH_ONLY );      
     retries = XMODEM_RETRY_LIMIT;
-    packnum ++;
+    if( ch == XMODEM_RECORD_DUP )
+    {
+      xmodem_out_func( XM_ACK );
+      continue;
+    }
       
-    // Got a valid packet
-    if( size + PXM_ACKET_SIZE > limit )
+    // Got a valid packet, give the data to 'func' (with the padding of the previous packet)
+#ifdef XMODEM_COMPRESS
+    if( size == 0 && padding == 0 && !memcmp( buf + 2, LZF_FILE_MAGIC, LZF_FILE_MAGIC_SIZE ) )
+      strip = 0;
+#endif
+    for( len = pktsize; strip && len > 0 && buf[ len + 1 ] == XM_PAD; len -- );
+    if( len > 0 )
     {
-      limit += XMODEM_INCREMENT_AMMOUNT;
-      if( ( p = realloc( *dest, limit ) ) == NULL )
+      if( ( res = xmodem_send_padding( func, pdata, padding ) ) < 0 || ( res = func( pdata, buf + 2, len ) ) < 0 )
       {
-        // Not enough memory, force cancel and return
         xmodem_flush( XMODEM_FLUSH_AND_XM_CAN );
-        return XMODEM_ERROR_OUTOFMEM;
+        goto out;
       }
-      *dest = ( char* )p;
-    }    
-    // Acknowledge and consume packet
+      size += padding + len;
+      padding = 0;
+    }
+    padding += pktsize - len;
+    // Acknowledge packet
     xmodem_out_func( XM_ACK );
-    memcpy( *dest + size, buf + 2, PXM_ACKET_SIZE );
-    size += PXM_ACKET_SIZE;
+    packnum ++;
   }
   
   // Exceeded retry count
   xmodem_flush( XMODEM_FLUSH_AND_XM_CAN );
-  return XMODEM_ERROR_RETRYEXCEED;
+  res = XMODEM_ERROR_RETRYEXCEED;
+out:
+  free( buf );
+  return res;
+}
+
+// Data of an in-memory transfer
+typedef struct
+{
+  char **dest;
+  u32 size;
+  u32 limit;
+#ifdef XMODEM_COMPRESS
+  u32 zsize;
+  LZF_STATE zstate;
+#endif
+} XMODEM_MEM_DATA;
+
+// Data function of xmodem_receive: append the data to the destination buffer
+static int xmodem_mem_write( void *pdata, const u8 *p, u32 size )
+{
+  XMODEM_MEM_DATA *pm = ( XMODEM_MEM_DATA* )pdata;
+  void *pnew;
+
+#ifdef XMODEM_COMPRESS
+  if( pm->size == 0 && pm->zsize == 0 && size >= LZF_FILE_HEADER_SIZE && !memcmp( p, LZF_FILE_MAGIC, LZF_FILE_MAGIC_SIZE ) )
+  {
+    // Compressed data: allocate the buffer for the decompressed data only once
+    pm->zsize = p[ 4 ] | ( ( u32 )p[ 5 ] << 8 ) | ( ( u32 )p[ 6 ] << 16 ) | ( ( u32 )p[ 7 ] << 24 );
+    if( pm->zsize == 0 || ( pnew = realloc( *pm->dest, pm->zsize ) ) == NULL )
+      return XMODEM_ERROR_OUTOFMEM;
+    *pm->dest = ( char* )pnew;
+    lzf_stream_init( &pm->zstate );
+    p += LZF_FILE_HEADER_SIZE;
+    size -= LZF_FILE_HEADER_SIZE;
+  }
+  if( pm->zsize )
+  {
+    // Decompress the data directly in the destination buffer
+    if( lzf_stream_decompress( &pm->zstate, p, size, ( u8* )*pm->dest, &pm->size, pm->zsize ) == LZF_ERR )
+      return XMODEM_ERROR_DECOMPRESS;
+    return 0;
+  }
+#endif
+  if( pm->size + size > pm->limit )
+  {
+    while( pm->size + size > pm->limit )
+      pm->limit += XMODEM_INCREMENT_AMMOUNT;
+    if( ( pnew = realloc( *pm->dest, pm->limit ) ) == NULL )
+      return XMODEM_ERROR_OUTOFMEM;
+    *pm->dest = ( char* )pnew;
+  }
+  memcpy( *pm->dest + pm->size, p, size );
+  pm->size += size;
+  return 0;
+}
+
+// Receive a x-modem transmission in memory. '*dest' must be allocated with
+// XMODEM_INITIAL_BUFFER_SIZE bytes, it is reallocated as needed.
+// Returns the number of bytes received or an error code on error
+// If XMODEM_COMPRESS is defined and the data starts with LZF_FILE_MAGIC, the
+// data is decompressed as it's received (the returned size is the size of
+// the decompressed data)
+long xmodem_receive( char **dest )
+{
+  XMODEM_MEM_DATA mdata;
+  long res;
+
+  memset( &mdata, 0, sizeof( mdata ) );
+  mdata.dest = dest;
+  mdata.limit = XMODEM_INITIAL_BUFFER_SIZE;
+  if( ( res = xmodem_receive_stream( xmodem_mem_write, &mdata ) ) < 0 )
+    return res;
+#ifdef XMODEM_COMPRESS
+  if( mdata.zsize )
+    return mdata.size == mdata.zsize ? ( long )mdata.size : XMODEM_ERROR_DECOMPRESS;
+#endif
+  return mdata.size;
 }
 
 #else // #ifdef BUILD_XMODEM
@@ -0,0 +1,45 @@
+-- ADC streaming test
+-- Streams two channels and checks the blocks, then stalls on purpose to
+-- produce overruns. On the simulator the channels are synthetic sine waves
+-- (channel n has a frequency of 50 * ( n + 1 ) Hz), so the script also checks
+-- the number of crossings of the middle level in each block against the
+-- number of periods of each wave in a block (the first crossing of a block
+-- can be missed, as the detector needs a low sample before it).
+-- Run it with 'lua /host/test/adc_stream.lua [<rate>] [<blocksize>]'.
+
+local args = { ... }
+local sf = string.format
+local timer = 0
+local rate = tonumber( args[ 1 ] ) or 10000
+local blocksize = tonumber( args[ 2 ] ) or 512
+local chans = { 0, 1 }
+local mid = adc.maxval( 0 ) / 2
+local sim = pd.platform() == "SIM"
+
+local realrate = adc.stream( chans, blocksize, rate, timer )
+print( sf( "Streaming channels %s at %d Hz, %d samples per block", table.concat( chans, "," ), realrate, blocksize ) )
+
+for n = 1, 8 do
+  local bufs = { adc.getblock( 1000000, timer ) }
+  assert( #bufs == #chans, "timeout waiting for a block" )
+  local line = sf( "block %d:", n )
+  for i, buf in ipairs( bufs ) do
+    assert( #buf == blocksize and sbuf.type( buf ) == sbuf.U16 )
+    local mn, mx, mean = dsp.stats( buf )
+    local cross = #dsp.crossings( buf, mid, dsp.RISING, mid / 10 )
+    line = line .. sf( "  ch%d min %4d max %4d mean %6.1f crossings %d", chans[ i ], mn, mx, mean, cross )
+    if sim then
+      local expected = 50 * ( chans[ i ] + 1 ) * blocksize / realrate
+      assert( cross >= math.floor( expected ) - 1 and cross <= math.ceil( expected ), sf( "block %d, ch%d: %d crossings, expected %.1f", n, chans[ i ], cross, expected ) )
+    end
+  end
+  print( line )
+end
+
+-- Don't read anything for a while, the blocks in between are lost
+tmr.delay( timer, 4 * blocksize * 1000000 / realrate )
+adc.getblock()
+local blocks, overruns = adc.streamstats()
+adc.streamstop()
+print( sf( "%d blocks, %d overruns", blocks, overruns ) )
+assert( overruns > 0, "expected overruns after the stall" )
@@ -0,0 +1,144 @@
+-- bitarray bulk operations test
+-- Checks fill, copy, band/bor/bxor, popcount, findset/findclear and blit
+-- against the same operations done one element at a time, for all the
+-- element sizes and for random (unaligned) ranges.
+-- Run it with 'lua /host/test/bitarray_bulk.lua [<iterations>]'.
+
+local args = { ... }
+local sf = string.format
+local iters = tonumber( args[ 1 ] ) or 200
+
+math.randomseed( 1 )
+
+local function maxval( bits )
+  return bits == 32 and 0x3FFFFFFF or 2 ^ bits - 1
+end
+
+local function randarray( n, bits )
+  local a = bitarray.new( n, bits )
+  for i = 1, n do a[ i ] = math.random( 0, maxval( bits ) ) end
+  return a
+end
+
+local function dup( a, bits )
+  local b = bitarray.new( #a, bits )
+  for i = 1, #a do b[ i ] = a[ i ] end
+  return b
+end
+
+local function check( a, ref, what )
+  assert( #a == #ref )
+  for i = 1, #a do
+    assert( a[ i ] == ref[ i ], sf( "%s: wrong value at %d (%d instead of %d)", what, i, a[ i ], ref[ i ] ) )
+  end
+end
+
+local function bits( v )
+  local n = 0
+  while v > 0 do
+    n = n + v % 2
+    v = math.floor( v / 2 )
+  end
+  return n
+end
+
+for _, size in ipairs{ 1, 2, 4, 8, 16, 32 } do
+  for it = 1, iters do
+    local n = math.random( 1, 300 )
+    local a = randarray( n, size )
+    local ref = dup( a, size )
+    local first = math.random( 1, n )
+    local last = math.random( first - 1, n )
+
+    -- fill
+    local v = math.random( 0, maxval( size ) )
+    bitarray.fill( a, v, first, last )
+    for i = first, last do ref[ i ] = v end
+    check( a, ref, "fill" )
+
+    -- popcount
+    do
+      local count = 0
+      for i = first, last do count = count + bits( a[ i ] ) end
+      assert( bitarray.popcount( a, first, last ) == count, "popcount" )
+    end
+
+    -- copy from another array and within the same array (both directions)
+    do
+      local src = randarray( math.random( 1, 300 ), size )
+      local sfirst = math.random( 1, #src )
+      local slast = math.random( sfirst - 1, math.min( #src, sfirst + n - first ) )
+      bitarray.copy( a, first, src, sfirst, slast )
+      for i = sfirst, slast do ref[ first + i - sfirst ] = src[ i ] end
+      check( a, ref, "copy" )
+      local dfirst = math.random( 1, n )
+      slast = math.random( first - 1, math.min( n, first + n - dfirst ) )
+      bitarray.copy( a, dfirst, a, first, slast )
+      local tmp = {}
+      for i = first, slast do tmp[ i ] = ref[ i ] end
+      for i = first, slast do ref[ dfirst + i - first ] = tmp[ i ] end
+      check( a, ref, "overlapping copy" )
+    end
+
+    -- findset/findclear
+    do
+      local z = bitarray.new( n, size )
+      for i = 1, n do if math.random( 1, 8 ) == 1 then z[ i ] = math.random( 0, maxval( size ) ) end end
+      local from = math.random( 1, n + 1 )
+      local fs, fc
+      for i = from, n do if not fs and z[ i ] ~= 0 then fs = i end end
+      bitarray.fill( a, maxval( size ) )
+      for i = 1, n do if math.random( 1, 8 ) == 1 then a[ i ] = 0 end end
+      for i = from, n do if not fc and a[ i ] == 0 then fc = i end end
+      assert( bitarray.findset( z, from ) == fs, "findset" )
+      assert( bitarray.findclear( a, from ) == fc, "findclear" )
+    end
+
+    -- band/bor/bxor
+    local b, c = randarray( n, size ), randarray( n, size )
+    ref = dup( b, size )
+    local op = ( { "band", "bor", "bxor" } )[ it % 3 + 1 ]
+    bitarray[ op ]( b, c )
+    for i = 1, n do
+      local x, y, r, p = ref[ i ], c[ i ], 0, 1
+      for j = 1, size do
+        local bx, by = x % 2, y % 2
+        local br = op == "band" and bx * by or op == "bor" and math.max( bx, by ) or ( bx + by ) % 2
+        r, p, x, y = r + br * p, p * 2, math.floor( x / 2 ), math.floor( y / 2 )
+      end
+      ref[ i ] = r
+    end
+    check( b, ref, op )
+  end
+  print( sf( "%2d bit elements: ok", size ) )
+end
+
+-- blit on 1-bpp images, with clipping and overlapping rectangles
+for it = 1, iters do
+  local dw, dh, sw, sh = math.random( 1, 70 ), math.random( 1, 20 ), math.random( 1, 70 ), math.random( 1, 20 )
+  local dst, src = randarray( dw * dh, 1 ), randarray( sw * sh, 1 )
+  local x, y = math.random( -10, dw ), math.random( -5, dh )
+  local sx, sy = math.random( -10, sw ), math.random( -5, sh )
+  local w, h = math.random( 0, 80 ), math.random( 0, 25 )
+  local same = it % 2 == 0
+  if same then src, sw, sh = dst, dw, dh end
+  local ref, sref = dup( dst, 1 ), dup( src, 1 )
+  bitarray.blit( dst, dw, x, y, src, sw, sx, sy, w, h )
+  for r = 0, h - 1 do
+    for c = 0, w - 1 do
+      local px, py, qx, qy = x + c, y + r, sx + c, sy + r
+      if px >= 0 and px < dw and py >= 0 and py < dh and qx >= 0 and qx < sw and qy >= 0 and qy < sh then
+        ref[ py * dw + px + 1 ] = sref[ qy * sw + qx + 1 ]
+      end
+    end
+  end
+  check( dst, ref, "blit" )
+end
+print( "blit: ok" )
+
+-- The whole source is copied by default
+local fb = bitarray.new( 64 * 8, 1 )
+local glyph = bitarray.new( { 0x3C, 0x42, 0x81, 0xFF }, 1 )
+bitarray.blit( fb, 64, 13, 2, glyph, 8 )
+assert( bitarray.popcount( fb ) == bitarray.popcount( glyph ) )
+assert( bitarray.findset( fb ) == 2 * 64 + 13 + 3 )
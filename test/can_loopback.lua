@@ -0,0 +1,65 @@
+-- CAN receive queue test
+-- Needs a CAN interface that receives its own frames: the loopback CAN of the
+-- simulator, or a board with the CAN controller in loopback mode. Checks the
+-- acceptance filters, can.recvmany and the dropped frames counter.
+-- Run it with 'lua /host/test/can_loopback.lua [<id>]'.
+
+local args = { ... }
+local sf = string.format
+local id = tonumber( args[ 1 ] ) or 0
+local STD, EXT = can.ID_STD, can.ID_EXT
+
+can.setup( id, 500000 )
+
+-- Receive all the frames that are waiting
+local function drain()
+  return can.recvmany( id )
+end
+
+-- Default configuration: all the frames are accepted
+for i = 1, 4 do
+  can.send( id, 0x100 + i, STD, sf( "std%d", i ) )
+end
+can.send( id, 0x12345, EXT, "ext" )
+local frames = drain()
+assert( #frames == 5, "expected 5 frames with the default filter" )
+for i = 1, 4 do
+  local f = frames[ i ]
+  assert( f[ 1 ] == 0x100 + i and f[ 2 ] == STD and f[ 3 ] == sf( "std%d", i ) )
+end
+assert( frames[ 5 ][ 1 ] == 0x12345 and frames[ 5 ][ 2 ] == EXT )
+print( "default filter: ok" )
+
+-- Only the standard identifiers 0x200-0x20F and the extended identifier 0x1000
+can.setfilter( id, 0 )
+can.setfilter( id, 1, 0x200, 0x7F0, STD )
+can.setfilter( id, 2, 0x1000, 0x1FFFFFFF, EXT )
+for _, canid in ipairs{ 0x1FF, 0x200, 0x20F, 0x210, 0x1000 } do
+  can.send( id, canid, STD, "x" )
+  can.send( id, canid, EXT, "x" )
+end
+frames = drain()
+local got = {}
+for _, f in ipairs( frames ) do
+  got[ #got + 1 ] = sf( "%s%X", f[ 2 ] == STD and "s" or "e", f[ 1 ] )
+end
+print( "filtered frames: " .. table.concat( got, " " ) )
+assert( table.concat( got, " " ) == "s200 s20F e1000", "wrong frames after filtering" )
+
+-- Limit the number of frames returned by recvmany
+can.setfilter( id, 0, 0, 0, STD )
+for i = 1, 6 do
+  can.send( id, i, STD, "" )
+end
+assert( #can.recvmany( id, 4 ) == 4 and #can.recvmany( id, 4 ) == 2 and #drain() == 0 )
+print( "recvmany limit: ok" )
+
+-- Send more frames than the queue can keep without reading them
+local dropped = can.dropped( id )
+for i = 1, 100 do
+  can.send( id, i, STD, "" )
+end
+local kept = #drain()
+print( sf( "sent 100 frames, received %d, dropped %d", kept, can.dropped( id ) - dropped ) )
+assert( kept + can.dropped( id ) - dropped == 100, "lost frames not counted" )
+assert( can.dropped( id ) > dropped, "expected dropped frames" )
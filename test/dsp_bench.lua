@@ -0,0 +1,115 @@
+-- DSP kernels benchmark
+-- Runs the same processing on a sample buffer with plain Lua loops and with
+-- the 'dsp' module and reports the number of samples processed per second.
+-- Run it from the eLua shell with 'lua /rom/dsp_bench.lua [<samples>]' (or
+-- '/host/test/dsp_bench.lua' on the simulator).
+
+local args = { ... }
+local sf = string.format
+local timer = 0
+local nsamples = tonumber( args[ 1 ] ) or 2048
+
+-- Time stamps (in microseconds)
+local now, timediff
+if tmr then
+  now = function() return tmr.read( timer ) end
+  timediff = function( t1, t2 ) return tmr.gettimediff( timer, t1, t2 ) end
+else
+  now = os.clock
+  timediff = function( t1, t2 ) return ( t1 - t2 ) * 1000000 end
+end
+
+-- Test signal: a sine wave with some noise, like a 12-bit ADC capture
+local buf = sbuf.new( nsamples )
+local seed = 1
+for i = 1, nsamples do
+  seed = ( seed * 1103515245 + 12345 ) % 2147483648
+  buf[ i ] = math.floor( 2048 + 1500 * math.sin( i / 20 ) + seed % 64 )
+end
+local coefs = { 0.02, 0.06, 0.12, 0.18, 0.24, 0.18, 0.12, 0.06, 0.02 }
+local fftsize = 256
+while fftsize * 2 <= nsamples and fftsize < 1024 do fftsize = fftsize * 2 end
+local fftbuf = sbuf.sub( buf, 1, fftsize )
+
+-- Lua versions
+local lua_tests =
+{
+  stats = function()
+    local mn, mx, sum, sumsq = buf[ 1 ], buf[ 1 ], 0, 0
+    for i = 1, nsamples do
+      local v = buf[ i ]
+      if v < mn then mn = v end
+      if v > mx then mx = v end
+      sum, sumsq = sum + v, sumsq + v * v
+    end
+    return mn, mx, sum / nsamples, math.sqrt( sumsq / nsamples )
+  end,
+
+  movavg = function()
+    local out, sum = sbuf.new( nsamples ), 0
+    for i = 1, nsamples do
+      sum = sum + buf[ i ]
+      if i > 16 then sum = sum - buf[ i - 16 ] end
+      out[ i ] = math.floor( sum / ( i < 16 and i or 16 ) )
+    end
+    return out
+  end,
+
+  fir = function()
+    local out, ntaps = sbuf.new( nsamples ), #coefs
+    for n = 1, nsamples do
+      local acc = 0
+      for k = 1, ntaps do
+        if n - k >= 0 then acc = acc + coefs[ k ] * buf[ n - k + 1 ] end
+      end
+      out[ n ] = math.floor( acc + 0.5 )
+    end
+    return out
+  end,
+
+  crossings = function()
+    local res, state = {}, 0
+    for i = 1, nsamples do
+      local v = buf[ i ]
+      if v >= 2048 then
+        if state < 0 then res[ #res + 1 ] = i end
+        state = 1
+      elseif v < 2048 - 100 then
+        state = -1
+      end
+    end
+    return res
+  end
+}
+
+-- dsp module versions
+local dsp_tests =
+{
+  stats = function() return dsp.stats( buf ) end,
+  movavg = function() return dsp.movavg( buf, 16 ) end,
+  fir = function() return dsp.fir( buf, coefs ) end,
+  iir = function() return dsp.iir( buf, { 0.0675, 0.135, 0.0675, -1.143, 0.413 } ) end,
+  crossings = function() return dsp.crossings( buf, 2048, dsp.RISING, 100 ) end,
+  fft = function() return dsp.fft( fftbuf ) end
+}
+
+local function run( f, count )
+  collectgarbage( "collect" )
+  local start = now()
+  f()
+  local us = timediff( now(), start )
+  return count * 1000000 / ( us > 0 and us or 1 ), us
+end
+
+print( sf( "%d samples (FFT size %d)", nsamples, fftsize ) )
+print( sf( "%-10s %14s %14s %8s", "kernel", "Lua smp/s", "dsp smp/s", "speedup" ) )
+for _, name in ipairs{ "stats", "movavg", "fir", "iir", "crossings", "fft" } do
+  local count = name == "fft" and fftsize or nsamples
+  local dsprate = run( dsp_tests[ name ], count )
+  if lua_tests[ name ] then
+    local luarate = run( lua_tests[ name ], count )
+    print( sf( "%-10s %14d %14d %7dx", name, luarate, dsprate, dsprate / luarate ) )
+  else
+    print( sf( "%-10s %14s %14d %8s", name, "-", dsprate, "-" ) )
+  end
+end
@@ -0,0 +1,57 @@
+-- I2C block transfers test
+-- Reads and writes the registers of a register based device (like most I2C
+-- sensors) with i2c.transfer and with the byte level functions, checks that
+-- the results are the same and compares the time needed for a 14 bytes burst
+-- read (the size of an IMU sample). On the simulator the device is emulated
+-- (see i2c_sim.c). Run it with
+-- 'lua /host/test/i2c_transfer.lua [<id>] [<address>] [<first register>]'.
+-- WARNING: on real hardware the test writes 4 registers starting with
+-- <first register> + 16, use it only on a device that can take that!
+
+local args = { ... }
+local sf = string.format
+local id = tonumber( args[ 1 ] ) or 0
+local addr = tonumber( args[ 2 ] ) or 0xD0
+local reg = tonumber( args[ 3 ] ) or 0x3B
+local timer = 0
+local count = 100
+
+i2c.setup( id, i2c.FAST )
+
+-- Register read with the byte level functions (what i2c.transfer replaces)
+local function readreg( r, n )
+  i2c.start( id )
+  if not i2c.address( id, addr, i2c.TRANSMITTER ) then i2c.stop( id ) return end
+  i2c.write( id, r )
+  i2c.start( id )
+  if not i2c.address( id, addr, i2c.RECEIVER ) then i2c.stop( id ) return end
+  local data = i2c.read( id, n )
+  i2c.stop( id )
+  return data
+end
+
+-- Presence check and detection of missing devices
+assert( i2c.transfer( id, addr, "" ) == "", "no device at the given address" )
+assert( i2c.transfer( id, addr + 2, "" ) == nil, sf( "unexpected device at address 0x%02X", addr + 2 ) )
+
+-- Burst read: both methods must return the same data
+local data = i2c.transfer( id, addr, reg, 14 )
+assert( data and #data == 14, "burst read failed" )
+assert( data == readreg( reg, 14 ), "different data from i2c.transfer and the byte functions" )
+print( "burst read: " .. data:gsub( ".", function( c ) return sf( "%02X ", c:byte() ) end ) )
+
+-- Write (register address followed by the data) and read back
+local wdata = string.char( 0x12, 0x34, 0x56, 0x78 )
+assert( i2c.transfer( id, addr, string.char( reg + 16 ) .. wdata ) == "" )
+assert( i2c.transfer( id, addr, { reg + 16 }, #wdata ) == wdata, "wrong data read back" )
+print( "write and read back: ok" )
+
+-- Timing
+local function bench( f )
+  local start = tmr.read( timer )
+  for i = 1, count do f() end
+  return tmr.gettimediff( timer, tmr.read( timer ), start ) / count
+end
+local t1 = bench( function() readreg( reg, 14 ) end )
+local t2 = bench( function() i2c.transfer( id, addr, reg, 14 ) end )
+print( sf( "14 bytes register read: %d us with the byte functions, %d us with i2c.transfer", t1, t2 ) )
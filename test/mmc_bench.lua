@@ -0,0 +1,120 @@
+-- SD/MMC file system benchmark
+-- Measures sequential and random read/write speeds on /mmc and checks the
+-- data that was read back. On the simulator /mmc is an image file on the
+-- host (see src/platform/sim/mmc_sim.c), copy this file to the image
+-- ('mcopy -i elua_mmc.img test/mmc_bench.lua ::') and run it from the eLua
+-- shell with 'lua /mmc/mmc_bench.lua [<kbytes>] [<random ops>] [<tmr id>]'.
+
+local args = { ... }
+local sf = string.format
+local kbytes = tonumber( args[ 1 ] ) or 256
+local nrandom = tonumber( args[ 2 ] ) or 500
+local timer = tonumber( args[ 3 ] ) or 0
+local fname = "/mmc/bench.dat"
+local rblock = 64
+local size = kbytes * 1024
+
+-- Test data (a single 1K block, the file contains 'kbytes' copies of it)
+local t = {}
+for i = 0, 1023 do
+  t[ #t + 1 ] = string.char( ( i * 7 + math.floor( i / 256 ) ) % 256 )
+end
+local block = table.concat( t )
+t = nil
+
+-- Expected contents of the file at the given offset
+local function expected( offset, len )
+  local s = block:sub( offset % 1024 + 1, offset % 1024 + len )
+  while #s < len do
+    s = s .. block:sub( 1, len - #s )
+  end
+  return s
+end
+
+-- Print the speed of a test
+local function report( name, bytes, start )
+  local ms = math.max( 1, math.floor( tmr.gettimediff( timer, tmr.read( timer ), start ) / 1000 ) )
+  print( sf( "%-28s %7d bytes %7d ms %6d KB/s", name, bytes, ms, math.floor( math.floor( bytes / 1024 ) * 1000 / ms ) ) )
+end
+
+local function fail( msg )
+  error( "ERROR: " .. msg )
+end
+
+-- Simple LCG (works with both integer and floating point Lua numbers)
+local seed = 1
+local function rand( n )
+  seed = ( seed * 75 + 74 ) % 65537
+  return seed % n
+end
+
+print( sf( "MMC benchmark: %d KB file, %d random operations of %d bytes", kbytes, nrandom, rblock ) )
+
+-- Sequential write (1K chunks)
+local f = io.open( fname, "wb" ) or fail( "unable to create " .. fname )
+local start = tmr.start( timer )
+for i = 1, kbytes do
+  f:write( block )
+end
+f:close()
+report( "sequential write (1K)", size, start )
+
+-- Sequential read with small chunks
+f = io.open( fname, "rb" ) or fail( "unable to open " .. fname )
+start = tmr.start( timer )
+local pos = 0
+while true do
+  local d = f:read( 100 )
+  if not d then break end
+  if d ~= expected( pos, #d ) then fail( sf( "data mismatch at %d", pos ) ) end
+  pos = pos + #d
+end
+f:close()
+if pos ~= size then fail( sf( "read %d bytes instead of %d", pos, size ) ) end
+report( "sequential read (100 bytes)", size, start )
+
+-- Sequential read with large chunks
+f = io.open( fname, "rb" ) or fail( "unable to open " .. fname )
+start = tmr.start( timer )
+pos = 0
+while true do
+  local d = f:read( 4096 )
+  if not d then break end
+  pos = pos + #d
+end
+f:close()
+report( "sequential read (4K)", pos, start )
+
+-- Random reads
+f = io.open( fname, "rb" ) or fail( "unable to open " .. fname )
+start = tmr.start( timer )
+for i = 1, nrandom do
+  pos = rand( size / rblock ) * rblock
+  f:seek( "set", pos )
+  if f:read( rblock ) ~= expected( pos, rblock ) then fail( sf( "data mismatch at %d", pos ) ) end
+end
+f:close()
+report( "random read", nrandom * rblock, start )
+
+-- Random writes (the same data is written back, so the file stays valid)
+f = io.open( fname, "r+b" ) or fail( "unable to open " .. fname )
+start = tmr.start( timer )
+for i = 1, nrandom do
+  pos = rand( size / rblock ) * rblock
+  f:seek( "set", pos )
+  f:write( expected( pos, rblock ) )
+end
+f:close()
+report( "random write", nrandom * rblock, start )
+
+-- Check the file after the random writes
+f = io.open( fname, "rb" ) or fail( "unable to open " .. fname )
+pos = 0
+while true do
+  local d = f:read( 1024 )
+  if not d then break end
+  if d ~= block:sub( 1, #d ) then fail( sf( "data mismatch at %d", pos ) ) end
+  pos = pos + #d
+end
+f:close()
+print "Done"
@@ -0,0 +1,376 @@
+// Serial multiplexer throughput benchmark
+// Runs the 'mux' program on pseudo terminal pairs (one for the transport and
+// one for each service) and measures the throughput in both directions:
+//   - 'in':  multiplexed data written to the transport is checked on each service
+//   - 'out': data written to the services is demultiplexed and checked on the transport
+//   - 'drop': one service is closed by its other side, then 'out' runs on the
+//     other services (the mux must keep running)
+// The test data contains all the byte values, so it exercises the escape
+// sequences too. The CPU time used by the mux process is also reported.
+// Build with 'lua mux.lua bench=true' (POSIX only), then run it as
+// 'mux_bench <mux executable> [<services>] [<kbytes per service>]'.
+
+#define _XOPEN_SOURCE 600
+#include "sermux.h"
+#include "type.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <termios.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MB_MAX_SERVICES       ( SERMUX_SERVICE_ID_LAST - SERMUX_SERVICE_ID_FIRST + 1 )
+#define MB_DEFAULT_SERVICES   2
+#define MB_DEFAULT_KBYTES     1024
+#define MB_CHUNK_SIZE         256
+#define MB_TIMEOUT_MS         5000
+
+// Pseudo terminal pair
+typedef struct
+{
+  int master;
+  int slave;
+  char name[ 64 ];
+} MB_PTY;
+
+static MB_PTY mb_transport, mb_services[ MB_MAX_SERVICES ];
+static unsigned mb_nservices = MB_DEFAULT_SERVICES;
+static u32 mb_size = MB_DEFAULT_KBYTES * 1024;
+static const char *mb_muxname;
+static pid_t mb_muxpid = -1;
+
+// ****************************************************************************
+// Helpers
+
+// Test data: byte 'i' of service 's'
+static u8 mb_data( unsigned s, u32 i )
+{
+  return ( u8 )( i * 7 + ( i >> 8 ) + s * 13 );
+}
+
+static int mb_needs_escape( u8 c )
+{
+  return c == SERMUX_ESCAPE_CHAR || c == SERMUX_FORCE_SID_CHAR || ( c >= SERMUX_SERVICE_ID_FIRST && c <= SERMUX_SERVICE_ID_LAST );
+}
+
+static double mb_time()
+{
+  struct timeval tv;
+
+  gettimeofday( &tv, NULL );
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static double mb_child_cpu()
+{
+  struct rusage ru;
+
+  getrusage( RUSAGE_CHILDREN, &ru );
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
+}
+
+static int mb_open_pty( MB_PTY *p )
+{
+  struct termios tio;
+  const char *name;
+
+  if( ( p->master = posix_openpt( O_RDWR | O_NOCTTY ) ) == -1 )
+    return 0;
+  if( grantpt( p->master ) == -1 || unlockpt( p->master ) == -1 || ( name = ptsname( p->master ) ) == NULL )
+    return 0;
+  strncpy( p->name, name, sizeof( p->name ) - 1 );
+  // Keep the slave open, so the master doesn't get a hangup between the tests
+  if( ( p->slave = open( p->name, O_RDWR | O_NOCTTY ) ) == -1 )
+    return 0;
+  tcgetattr( p->slave, &tio );
+  tio.c_iflag &= ~( IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON );
+  tio.c_oflag &= ~OPOST;
+  tio.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
+  tio.c_cflag = ( tio.c_cflag & ~( CSIZE | PARENB ) ) | CS8;
+  tcsetattr( p->slave, TCSANOW, &tio );
+  fcntl( p->master, F_SETFL, fcntl( p->master, F_GETFL ) | O_NONBLOCK );
+  // The mux process must not inherit them, or closing them here won't close
+  // the pseudo terminal
+  fcntl( p->master, F_SETFD, FD_CLOEXEC );
+  fcntl( p->slave, F_SETFD, FD_CLOEXEC );
+  return 1;
+}
+
+// Discard any data left in a pseudo terminal
+static void mb_drain( MB_PTY *p )
+{
+  u8 buf[ 1024 ];
+
+  while( read( p->master, buf, sizeof( buf ) ) > 0 );
+}
+
+// Start the multiplexer on the pseudo terminals
+static int mb_start_mux()
+{
+  char *argv[ MB_MAX_SERVICES + 4 ];
+  char transport[ 80 ];
+  unsigned i;
+
+  snprintf( transport, sizeof( transport ), "%s,115200,none", mb_transport.name );
+  argv[ 0 ] = ( char* )mb_muxname;
+  argv[ 1 ] = "mux";
+  argv[ 2 ] = transport;
+  for( i = 0; i < mb_nservices; i ++ )
+    argv[ i + 3 ] = mb_services[ i ].name;
+  argv[ i + 3 ] = NULL;
+  if( ( mb_muxpid = fork() ) == -1 )
+    return 0;
+  if( mb_muxpid == 0 )
+  {
+    execv( mb_muxname, argv );
+    fprintf( stderr, "Unable to run %s\n", mb_muxname );
+    exit( 1 );
+  }
+  // Give it time to open and setup its ports
+  usleep( 1000000 + 250000 * mb_nservices );
+  mb_drain( &mb_transport );
+  for( i = 0; i < mb_nservices; i ++ )
+    mb_drain( mb_services + i );
+  return 1;
+}
+
+static void mb_stop_mux()
+{
+  if( mb_muxpid != -1 )
+  {
+    kill( mb_muxpid, SIGTERM );
+    waitpid( mb_muxpid, NULL, 0 );
+    mb_muxpid = -1;
+  }
+}
+
+// ****************************************************************************
+// Tests
+
+// Transport -> services
+static int mb_test_in()
+{
+  u8 *stream, *p, buf[ 4096 ];
+  u32 streamlen, sent = 0, total = 0, sidx[ MB_MAX_SERVICES ], ridx[ MB_MAX_SERVICES ];
+  struct pollfd pfds[ MB_MAX_SERVICES + 1 ];
+  unsigned i, s, cnt;
+  ssize_t res;
+  int n;
+
+  // Build the multiplexed stream (chunks from each service in turn)
+  if( ( stream = ( u8* )malloc( mb_size * mb_nservices * 2 + mb_size / MB_CHUNK_SIZE * mb_nservices + 16 ) ) == NULL )
+    return 0;
+  memset( sidx, 0, sizeof( sidx ) );
+  for( p = stream; sidx[ mb_nservices - 1 ] < mb_size; )
+    for( s = 0; s < mb_nservices; s ++ )
+    {
+      *p ++ = SERMUX_SERVICE_ID_FIRST + s;
+      for( cnt = 0; cnt < MB_CHUNK_SIZE && sidx[ s ] < mb_size; cnt ++, sidx[ s ] ++ )
+      {
+        u8 c = mb_data( s, sidx[ s ] );
+        if( mb_needs_escape( c ) )
+        {
+          *p ++ = SERMUX_ESCAPE_CHAR;
+          c ^= SERMUX_ESCAPE_XOR_MASK;
+        }
+        *p ++ = c;
+      }
+    }
+  streamlen = p - stream;
+  memset( ridx, 0, sizeof( ridx ) );
+  while( total < mb_size * mb_nservices )
+  {
+    pfds[ 0 ].fd = mb_transport.master;
+    pfds[ 0 ].events = sent < streamlen ? POLLOUT : 0;
+    for( i = 0; i < mb_nservices; i ++ )
+    {
+      pfds[ i + 1 ].fd = mb_services[ i ].master;
+      pfds[ i + 1 ].events = POLLIN;
+    }
+    if( ( n = poll( pfds, mb_nservices + 1, MB_TIMEOUT_MS ) ) <= 0 )
+    {
+      fprintf( stderr, "in: timeout (%u of %u bytes received)\n", ( unsigned )total, ( unsigned )( mb_size * mb_nservices ) );
+      free( stream );
+      return 0;
+    }
+    if( pfds[ 0 ].revents & POLLOUT )
+      if( ( res = write( mb_transport.master, stream + sent, streamlen - sent ) ) > 0 )
+        sent += res;
+    for( i = 0; i < mb_nservices; i ++ )
+      if( pfds[ i + 1 ].revents & POLLIN )
+      {
+        if( ( res = read( mb_services[ i ].master, buf, sizeof( buf ) ) ) <= 0 )
+          continue;
+        for( cnt = 0; cnt < res; cnt ++, ridx[ i ] ++ )
+          if( ridx[ i ] >= mb_size || buf[ cnt ] != mb_data( i, ridx[ i ] ) )
+          {
+            fprintf( stderr, "in: invalid data on service %u at offset %u\n", i, ( unsigned )ridx[ i ] );
+            free( stream );
+            return 0;
+          }
+        total += res;
+      }
+  }
+  free( stream );
+  return 1;
+}
+
+// Services -> transport
+static int mb_test_out()
+{
+  u8 buf[ 4096 ];
+  u32 total = 0, sidx[ MB_MAX_SERVICES ], ridx[ MB_MAX_SERVICES ];
+  struct pollfd pfds[ MB_MAX_SERVICES + 1 ];
+  unsigned i, s, cnt;
+  int sid = -1, got_esc = 0, c, n;
+  ssize_t res;
+
+  memset( sidx, 0, sizeof( sidx ) );
+  memset( ridx, 0, sizeof( ridx ) );
+  while( total < mb_size * mb_nservices )
+  {
+    pfds[ 0 ].fd = mb_transport.master;
+    pfds[ 0 ].events = POLLIN;
+    for( i = 0; i < mb_nservices; i ++ )
+    {
+      pfds[ i + 1 ].fd = mb_services[ i ].master;
+      pfds[ i + 1 ].events = sidx[ i ] < mb_size ? POLLOUT : 0;
+    }
+    if( ( n = poll( pfds, mb_nservices + 1, MB_TIMEOUT_MS ) ) <= 0 )
+    {
+      fprintf( stderr, "out: timeout (%u of %u bytes received)\n", ( unsigned )total, ( unsigned )( mb_size * mb_nservices ) );
+      return 0;
+    }
+    for( i = 0; i < mb_nservices; i ++ )
+      if( pfds[ i + 1 ].revents & POLLOUT )
+      {
+        for( cnt = 0; cnt < MB_CHUNK_SIZE && sidx[ i ] + cnt < mb_size; cnt ++ )
+          buf[ cnt ] = mb_data( i, sidx[ i ] + cnt );
+        if( ( res = write( mb_services[ i ].master, buf, cnt ) ) > 0 )
+          sidx[ i ] += res;
+      }
+    if( pfds[ 0 ].revents & POLLIN )
+    {
+      if( ( res = read( mb_transport.master, buf, sizeof( buf ) ) ) <= 0 )
+        continue;
+      for( cnt = 0; cnt < res; cnt ++ )
+      {
+        c = buf[ cnt ];
+        if( got_esc )
+        {
+          c ^= SERMUX_ESCAPE_XOR_MASK;
+          got_esc = 0;
+        }
+        else if( c == SERMUX_ESCAPE_CHAR )
+        {
+          got_esc = 1;
+          continue;
+        }
+        else if( c >= SERMUX_SERVICE_ID_FIRST && c <= SERMUX_SERVICE_ID_LAST )
+        {
+          sid = c - SERMUX_SERVICE_ID_FIRST;
+          continue;
+        }
+        s = ( unsigned )sid;
+        if( sid < 0 || s >= mb_nservices || ridx[ s ] >= mb_size || c != mb_data( s, ridx[ s ] ) )
+        {
+          fprintf( stderr, "out: invalid data for service %d\n", sid );
+          return 0;
+        }
+        ridx[ s ] ++;
+        total ++;
+      }
+    }
+  }
+  return 1;
+}
+
+// A service port closed by its other side
+static int mb_test_drop()
+{
+  MB_PTY *p = mb_services + mb_nservices - 1;
+
+  close( p->master );
+  close( p->slave );
+  usleep( 250000 );
+  if( waitpid( mb_muxpid, NULL, WNOHANG ) != 0 )
+  {
+    fprintf( stderr, "drop: the mux stopped after a service was closed\n" );
+    mb_muxpid = -1;
+    return 0;
+  }
+  mb_nservices --;
+  return mb_test_out();
+}
+
+static int mb_run( const char *name, int ( *ptest )() )
+{
+  double start, cpu;
+  int res;
+
+  if( !mb_start_mux() )
+  {
+    fprintf( stderr, "Unable to start %s\n", mb_muxname );
+    return 0;
+  }
+  cpu = mb_child_cpu();
+  start = mb_time();
+  res = ptest();
+  start = mb_time() - start;
+  mb_stop_mux();
+  cpu = mb_child_cpu() - cpu;
+  if( res )
+    printf( "%-4s %u x %u bytes: %.3fs, %.2f MB/s, mux CPU time %.3fs\n", name, mb_nservices, ( unsigned )mb_size,
+            start, mb_size * mb_nservices / start / ( 1024 * 1024 ), cpu );
+  return res;
+}
+
+// ****************************************************************************
+// Entry point
+
+int main( int argc, char **argv )
+{
+  unsigned i;
+  int res;
+
+  if( argc < 2 )
+  {
+    fprintf( stderr, "Usage: %s <mux executable> [<services>] [<kbytes per service>]\n", argv[ 0 ] );
+    return 1;
+  }
+  mb_muxname = argv[ 1 ];
+  if( argc > 2 )
+    mb_nservices = atoi( argv[ 2 ] );
+  if( argc > 3 )
+    mb_size = atoi( argv[ 3 ] ) * 1024;
+  if( mb_nservices < 1 || mb_nservices > MB_MAX_SERVICES || mb_size == 0 )
+  {
+    fprintf( stderr, "Invalid arguments\n" );
+    return 1;
+  }
+  signal( SIGPIPE, SIG_IGN );
+  if( !mb_open_pty( &mb_transport ) )
+  {
+    fprintf( stderr, "Unable to create pseudo terminals\n" );
+    return 1;
+  }
+  for( i = 0; i < mb_nservices; i ++ )
+    if( !mb_open_pty( mb_services + i ) )
+    {
+      fprintf( stderr, "Unable to create pseudo terminals\n" );
+      return 1;
+    }
+  res = mb_run( "in", mb_test_in ) && mb_run( "out", mb_test_out );
+  if( res && mb_nservices > 1 )
+    res = mb_run( "drop", mb_test_drop );
+  mb_stop_mux();
+  printf( res ? "OK\n" : "FAILED\n" );
+  return res ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+-- Lua compiler memory benchmark
+-- Compiles a set of Lua sources and reports the peak heap usage during the
+-- compilation (from collectgarbage( "peak" )) and the memory kept by the
+-- compiled chunk. On the simulator the repository is visible as /host (see
+-- src/platform/sim/hostfs.c), so the default set of scripts is read from there.
+-- Run it from the eLua shell with 'lua /host/test/parse_bench.lua [<file>...]'.
+-- Compare the results of images built with and without LUA_LOWMEM_PARSER
+-- (see luaconf.h).
+
+local args = { ... }
+local sf = string.format
+local timer = 0
+
+local files = #args > 0 and args or
+{
+  "/host/utils/build.lua",
+  "/host/build_elua.lua",
+  "/host/utils/utils.lua",
+  "/host/utils/mkfs.lua",
+  "/host/test/mmc_bench.lua"
+}
+
+-- Time stamps (in microseconds)
+local now, timediff
+if tmr then
+  now = function() return tmr.read( timer ) end
+  timediff = function( t1, t2 ) return tmr.gettimediff( timer, t1, t2 ) end
+else
+  now = os.clock
+  timediff = function( t1, t2 ) return ( t1 - t2 ) * 1000000 end
+end
+
+-- The source is read in memory first (loadfile could use a cached .lc)
+local function readsrc( name )
+  local f = io.open( name, "rb" )
+  if not f then return end
+  local s = f:read( "*a" )
+  f:close()
+  -- Skip the '#!' line like loadfile does (and keep the line numbers)
+  if s:sub( 1, 1 ) == "#" then s = "--" .. s end
+  return s
+end
+
+print( sf( "%-24s %8s %8s %8s %8s", "file", "size", "peak KB", "kept KB", "ms" ) )
+local totpeak, totkept, totms = 0, 0, 0
+for _, name in ipairs( files ) do
+  local src = readsrc( name )
+  if not src then
+    print( sf( "%-24s not found", name ) )
+  else
+    collectgarbage( "collect" )
+    local base = collectgarbage( "count" )
+    collectgarbage( "peak" )
+    local start = now()
+    local f, err = loadstring( src, "@" .. name )
+    local ms = timediff( now(), start ) / 1000
+    local peak = collectgarbage( "peak" ) - base
+    if not f then
+      print( sf( "%-24s error: %s", name, err ) )
+    else
+      collectgarbage( "collect" )
+      local kept = collectgarbage( "count" ) - base
+      print( sf( "%-24s %8d %8.1f %8.1f %8d", name:match( "[^/]*$" ), #src, peak, kept, ms ) )
+      totpeak, totkept, totms = totpeak + peak, totkept + kept, totms + ms
+    end
+    f, src = nil, nil
+  end
+end
+print( sf( "%-24s %8s %8.1f %8.1f %8d", "total", "", totpeak, totkept, totms ) )
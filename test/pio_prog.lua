@@ -0,0 +1,62 @@
+-- PIO pin programs test
+-- Builds the bit programs of a WS2812 LED driver (an 800kHz single wire
+-- protocol with ~150ns of tolerance) and sends a 24-bit color with them. On the
+-- simulator the generated waveform is recorded (see pio_sim.c) and its timing
+-- is checked, on real hardware the pin can be checked with a scope.
+-- Run it with 'lua /host/test/pio_prog.lua'.
+
+local sf = string.format
+local prog = pio.prog
+local pin, clk, data = pio.PA_0, pio.PB_1, pio.PB_2
+
+pio.pin.setdir( pio.OUTPUT, pin, clk, data )
+pio.pin.setlow( pin, clk, data )
+if sim then sim.pio.record() end
+
+-- WS2812 bits: 0 is 400ns high and 850ns low, 1 is 800ns high and 450ns low
+local bit0 = prog.new( { prog.SETHIGH, pin }, { prog.DELAY, 400 }, { prog.SETLOW, pin }, { prog.DELAY, 850 } )
+local bit1 = prog.new( { prog.SETHIGH, pin }, { prog.DELAY, 800 }, { prog.SETLOW, pin }, { prog.DELAY, 450 } )
+local color = string.char( 0xFF, 0x00, 0xA5 )
+prog.send( bit0, bit1, color )
+
+if sim then
+  local events, lost = sim.pio.record()
+  assert( lost == 0 and #events == 48, sf( "expected 48 changes, got %d (%d lost)", #events, lost ) )
+  for i = 0, 23 do
+    local b = math.floor( color:byte( math.floor( i / 8 ) + 1 ) / 2 ^ ( 7 - i % 8 ) ) % 2
+    local rise, fall = events[ 2 * i + 1 ], events[ 2 * i + 2 ]
+    assert( rise[ 1 ] == i * 1250, sf( "bit %d starts at %d ns", i, rise[ 1 ] ) )
+    assert( rise[ 3 ] == 1 and fall[ 3 ] == 0 )
+    assert( fall[ 1 ] - rise[ 1 ] == ( b == 1 and 800 or 400 ), sf( "wrong high time for bit %d", i ) )
+  end
+  print( "WS2812 timing: ok" )
+end
+
+-- Several pins change at the same time, programs can include other programs
+local clock = prog.new( { prog.SETHIGH, clk, data }, { prog.DELAY, 500 }, { prog.SETLOW, clk }, { prog.DELAY, 500 } )
+local frame = prog.new( clock, { prog.SETPORT, pio.PB, 0, 6 }, { prog.DELAY, 1000 } )
+frame:run( 3 )
+if sim then
+  local events = sim.pio.record()
+  assert( #events == 9, sf( "expected 9 changes, got %d", #events ) )
+  for i = 0, 2 do
+    local e = { events[ 3 * i + 1 ], events[ 3 * i + 2 ], events[ 3 * i + 3 ] }
+    assert( e[ 1 ][ 1 ] == i * 2000 and e[ 1 ][ 2 ] == pio.PB and e[ 1 ][ 3 ] == 6 )
+    assert( e[ 2 ][ 1 ] == i * 2000 + 500 and e[ 2 ][ 3 ] == 4 )
+    assert( e[ 3 ][ 1 ] == i * 2000 + 1000 and e[ 3 ][ 3 ] == 0 )
+  end
+  print( "multi-pin changes: ok" )
+end
+
+-- Speed of the program engine compared with the pin functions
+local timer, count = 0, 1000
+local function bench( f )
+  local start = tmr.read( timer )
+  for i = 1, count do f() end
+  return tmr.gettimediff( timer, tmr.read( timer ), start ) / count
+end
+local toggle = prog.new( { prog.SETHIGH, pin }, { prog.SETLOW, pin } )
+local t1 = bench( function() pio.pin.sethigh( pin ) pio.pin.setlow( pin ) end )
+local t2 = bench( function() toggle:run() end )
+if sim then sim.pio.record() end
+print( sf( "pin toggle: %.2f us with the pin functions, %.2f us with a program", t1, t2 ) )
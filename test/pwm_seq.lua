@@ -0,0 +1,67 @@
+-- PWM sequences test
+-- Plays a LED fade (one shot) and a square wave modulation (loop) on a PWM
+-- channel. On the simulator the duty changes are recorded with the host time
+-- at which they were applied (see pwm_sim.c) and each one is checked against
+-- its nominal time: it can't be early and it can be late by at most 'slack'
+-- microseconds (the sequences are polled). On real hardware the output can be
+-- checked with a scope. Run it with 'lua /host/test/pwm_seq.lua [<id>]'.
+
+local args = { ... }
+local sf = string.format
+local id = tonumber( args[ 1 ] ) or 0
+local timer = 0
+local freq, rate, steps = 20000, 1000, 100
+local slack = 2000
+
+-- Wait until the sequence stops or 'us' microseconds pass
+local function wait( us, passes )
+  local start = tmr.read( timer )
+  while tmr.gettimediff( timer, tmr.read( timer ), start ) < us do
+    local playing, n = pwm.seqstatus( id )
+    if not playing or ( passes and n >= passes ) then return n end
+  end
+end
+
+-- Check the time of the duty change for step 'n' (0 based)
+local function check_time( ev, n, realrate )
+  local nominal = n * 1000000 / realrate
+  assert( ev[ 1 ] >= math.floor( nominal ) and ev[ 1 ] <= nominal + slack,
+          sf( "change %d at %d us, expected %.1f us", n + 1, ev[ 1 ], nominal ) )
+end
+
+freq = pwm.setup( id, freq, 0 )
+pwm.start( id )
+
+-- Fade: 'steps' values from 0 to pwm.SEQ_MAX
+local fade = {}
+for i = 0, steps - 1 do fade[ i + 1 ] = math.floor( i * pwm.SEQ_MAX / ( steps - 1 ) ) end
+local realrate = pwm.seqstart( id, sbuf.new( fade ), rate )
+print( sf( "PWM at %d Hz, sequence at %d Hz", freq, realrate ) )
+assert( wait( 2 * steps * 1000000 / realrate ) == 1, "the sequence didn't finish in time" )
+if sim then
+  local events, lost = sim.pwm.record( id )
+  assert( lost == 0 and #events == steps, sf( "expected %d duty changes, got %d", steps, #events ) )
+  for i = 1, steps do
+    check_time( events[ i ], i - 1, realrate )
+    assert( events[ i ][ 2 ] == fade[ i ], sf( "wrong duty for change %d", i ) )
+  end
+  print( "fade timeline: ok" )
+end
+
+-- Loop: 50% modulation at rate / 4 until 3 passes are done
+realrate = pwm.seqstart( id, { 0, 0, pwm.SEQ_MAX, pwm.SEQ_MAX }, rate, pwm.LOOP )
+assert( wait( 1000000, 3 ) >= 3, "the sequence didn't loop" )
+assert( pwm.seqstatus( id ), "the sequence stopped" )
+pwm.seqstop( id )
+assert( not pwm.seqstatus( id ) )
+if sim then
+  local events = sim.pwm.record( id )
+  assert( #events >= 12 )
+  for i = 1, 12 do
+    check_time( events[ i ], i - 1, realrate )
+    assert( events[ i ][ 2 ] == ( ( i - 1 ) % 4 < 2 and 0 or pwm.SEQ_MAX ) )
+  end
+  print( "loop timeline: ok" )
+end
+
+pwm.stop( id )
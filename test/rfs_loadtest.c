@@ -0,0 +1,558 @@
+// RFS server load test
+// Drives the RFS server with several simulated clients at the same time,
+// either directly in memory ('mem') or over UDP ('udp'). In UDP mode the
+// server runs in a child process with the same event loop as rfs_server.
+// Each client writes a file with its own data pattern, reads it back and
+// checks it, so any mix-up between the clients' file tables is detected.
+// Then it lists the directory and checks that its file is there with the
+// right size.
+// The 'bench' mode transfers a file with and without compression (in memory)
+// and reports the amount of data on the wire and the estimated serial time.
+// Build with 'lua rfs_server.lua loadtest=true' (POSIX only).
+
+#include "net.h"
+#include "remotefs.h"
+#include "eluarpc.h"
+#include "server.h"
+#include "type.h"
+#include "log.h"
+#include "os_io.h"
+#include "rfs.h"
+#include "deskutils.h"
+#include "rfs_transports.h"
+#include "lzf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+
+#define LT_MAX_CLIENTS        RFS_MAX_CLIENTS
+#define LT_BLOCK_SIZE         512
+#define LT_NUM_BLOCKS         8
+#define LT_TIMEOUT_MS         2000
+
+// 'bench' mode: request size of a client with BUF_SIZE_512 and serial speed
+#define LT_BENCH_BLOCK_SIZE   ( 512 - ELUARPC_WRITE_REQUEST_EXTRA )
+#define LT_BENCH_BAUD         115200
+#define LT_BENCH_MAX_SIZE     ( 1 << 20 )
+
+// Client states
+enum
+{
+  LT_STATE_OPEN,
+  LT_STATE_WRITE,
+  LT_STATE_SEEK,
+  LT_STATE_READ,
+  LT_STATE_BADFD,
+  LT_STATE_CLOSE,
+  LT_STATE_OPENDIR,
+  LT_STATE_READDIR,
+  LT_STATE_CLOSEDIR,
+  LT_STATE_DONE
+};
+
+// Simulated client data
+typedef struct
+{
+  int id;
+  int state;
+  int fd;
+  int block;
+  int iter;
+  u32 dir;
+  int found;
+  SERVER_CLIENT sdata;                  // server data ('mem' mode)
+  int sock;                             // client socket ('udp' mode)
+  u8 buf[ MAX_PACKET_SIZE + ELUARPC_WRITE_REQUEST_EXTRA ];
+} LT_CLIENT;
+
+static LT_CLIENT lt_clients[ LT_MAX_CLIENTS ];
+static int lt_num_clients = 4;
+static int lt_iterations = 20;
+static unsigned lt_requests;
+
+// ****************************************************************************
+// Request generation and response checking
+
+static void lt_fill_block( const LT_CLIENT *pc, int block, u8 *p )
+{
+  unsigned i;
+
+  for( i = 0; i < LT_BLOCK_SIZE; i ++ )
+    p[ i ] = ( u8 )( pc->id * 31 + block * 7 + i );
+}
+
+static void lt_make_request( LT_CLIENT *pc )
+{
+  char name[ 32 ];
+  u8 data[ LT_BLOCK_SIZE ];
+
+  switch( pc->state )
+  {
+    case LT_STATE_OPEN:
+      sprintf( name, "/lt%d.bin", pc->id );
+      remotefs_open_write_request( pc->buf, name, RFS_OPEN_FLAG_CREAT | RFS_OPEN_FLAG_TRUNC | RFS_OPEN_FLAG_RDWR, 0 );
+      break;
+
+    case LT_STATE_WRITE:
+      lt_fill_block( pc, pc->block, data );
+      remotefs_write_write_request( pc->buf, pc->fd, data, LT_BLOCK_SIZE );
+      break;
+
+    case LT_STATE_SEEK:
+      remotefs_lseek_write_request( pc->buf, pc->fd, 0, RFS_LSEEK_SET );
+      break;
+
+    case LT_STATE_READ:
+      remotefs_read_write_request( pc->buf, pc->fd, LT_BLOCK_SIZE );
+      break;
+
+    case LT_STATE_BADFD:
+      // This descriptor was never returned to this client
+      remotefs_close_write_request( pc->buf, pc->fd + 1 );
+      break;
+
+    case LT_STATE_CLOSE:
+      remotefs_close_write_request( pc->buf, pc->fd );
+      break;
+
+    case LT_STATE_OPENDIR:
+      remotefs_opendir_write_request( pc->buf, "/" );
+      break;
+
+    case LT_STATE_READDIR:
+      remotefs_readdir_write_request( pc->buf, pc->dir );
+      break;
+
+    case LT_STATE_CLOSEDIR:
+      remotefs_closedir_write_request( pc->buf, pc->dir );
+      break;
+  }
+  lt_requests ++;
+}
+
+// Check the response and advance to the next state, returns 0 for error
+static int lt_check_response( LT_CLIENT *pc )
+{
+  u32 count, ftime;
+  s32 offset;
+  int res;
+  const u8 *pdata;
+  const char *fname;
+  char name[ 32 ];
+  u8 data[ LT_BLOCK_SIZE ];
+
+  switch( pc->state )
+  {
+    case LT_STATE_OPEN:
+      if( remotefs_open_read_response( pc->buf, &pc->fd ) == ELUARPC_ERR || pc->fd == -1 )
+        return 0;
+      pc->block = 0;
+      pc->state = LT_STATE_WRITE;
+      break;
+
+    case LT_STATE_WRITE:
+      if( remotefs_write_read_response( pc->buf, &count ) == ELUARPC_ERR || count != LT_BLOCK_SIZE )
+        return 0;
+      if( ++ pc->block == LT_NUM_BLOCKS )
+        pc->state = LT_STATE_SEEK;
+      break;
+
+    case LT_STATE_SEEK:
+      if( remotefs_lseek_read_response( pc->buf, &offset ) == ELUARPC_ERR || offset != 0 )
+        return 0;
+      pc->block = 0;
+      pc->state = LT_STATE_READ;
+      break;
+
+    case LT_STATE_READ:
+      if( remotefs_read_read_response( pc->buf, &pdata, &count ) == ELUARPC_ERR || count != LT_BLOCK_SIZE )
+        return 0;
+      lt_fill_block( pc, pc->block, data );
+      if( memcmp( pdata, data, LT_BLOCK_SIZE ) )
+      {
+        fprintf( stderr, "client %d: data mismatch in block %d\n", pc->id, pc->block );
+        return 0;
+      }
+      if( ++ pc->block == LT_NUM_BLOCKS )
+        pc->state = LT_STATE_BADFD;
+      break;
+
+    case LT_STATE_BADFD:
+      if( remotefs_close_read_response( pc->buf, &res ) == ELUARPC_ERR || res != -1 )
+      {
+        fprintf( stderr, "client %d: was able to close a descriptor it doesn't own\n", pc->id );
+        return 0;
+      }
+      pc->state = LT_STATE_CLOSE;
+      break;
+
+    case LT_STATE_CLOSE:
+      if( remotefs_close_read_response( pc->buf, &res ) == ELUARPC_ERR || res != 0 )
+        return 0;
+      pc->state = LT_STATE_OPENDIR;
+      break;
+
+    case LT_STATE_OPENDIR:
+      if( remotefs_opendir_read_response( pc->buf, &pc->dir ) == ELUARPC_ERR || pc->dir == 0 )
+        return 0;
+      pc->found = 0;
+      pc->state = LT_STATE_READDIR;
+      break;
+
+    case LT_STATE_READDIR:
+      if( remotefs_readdir_read_response( pc->buf, &fname, &count, &ftime ) == ELUARPC_ERR )
+        return 0;
+      if( fname == NULL )
+      {
+        if( !pc->found )
+        {
+          fprintf( stderr, "client %d: file not found in the directory listing\n", pc->id );
+          return 0;
+        }
+        pc->state = LT_STATE_CLOSEDIR;
+        break;
+      }
+      sprintf( name, "lt%d.bin", pc->id );
+      if( !strcmp( fname, name ) )
+      {
+        if( count != LT_BLOCK_SIZE * LT_NUM_BLOCKS )
+        {
+          fprintf( stderr, "client %d: wrong size in the directory listing (%u)\n", pc->id, ( unsigned )count );
+          return 0;
+        }
+        pc->found = 1;
+      }
+      break;
+
+    case LT_STATE_CLOSEDIR:
+      if( remotefs_closedir_read_response( pc->buf, &res ) == ELUARPC_ERR || res != 0 )
+        return 0;
+      pc->state = ++ pc->iter == lt_iterations ? LT_STATE_DONE : LT_STATE_OPEN;
+      break;
+  }
+  return 1;
+}
+
+// ****************************************************************************
+// 'mem' mode: requests of all the clients are executed in turns
+
+static int lt_run_mem()
+{
+  int i, active;
+  LT_CLIENT *pc;
+
+  for( i = 0; i < lt_num_clients; i ++ )
+    server_client_init( &lt_clients[ i ].sdata );
+  do
+  {
+    active = 0;
+    for( i = 0, pc = lt_clients; i < lt_num_clients; i ++, pc ++ )
+    {
+      if( pc->state == LT_STATE_DONE )
+        continue;
+      active = 1;
+      lt_make_request( pc );
+      if( server_execute_client_request( &pc->sdata, pc->buf ) != SERVER_OK || !lt_check_response( pc ) )
+      {
+        fprintf( stderr, "client %d: error in state %d\n", pc->id, pc->state );
+        return 0;
+      }
+    }
+  } while( active );
+  for( i = 0; i < lt_num_clients; i ++ )
+    server_client_cleanup( &lt_clients[ i ].sdata );
+  return 1;
+}
+
+// ****************************************************************************
+// 'udp' mode: all the clients send their requests, then wait for responses
+
+static int lt_run_udp( unsigned port )
+{
+  int i, active;
+  u16 temp16;
+  LT_CLIENT *pc;
+  struct sockaddr_in server;
+  struct pollfd pfd;
+
+  memset( &server, 0, sizeof( server ) );
+  server.sin_family = AF_INET;
+  server.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+  server.sin_port = htons( port );
+  for( i = 0; i < lt_num_clients; i ++ )
+    if( ( lt_clients[ i ].sock = socket( AF_INET, SOCK_DGRAM, 0 ) ) == -1 )
+    {
+      fprintf( stderr, "Unable to create socket\n" );
+      return 0;
+    }
+  do
+  {
+    active = 0;
+    for( i = 0, pc = lt_clients; i < lt_num_clients; i ++, pc ++ )
+    {
+      if( pc->state == LT_STATE_DONE )
+        continue;
+      active = 1;
+      lt_make_request( pc );
+      eluarpc_get_packet_size( pc->buf, &temp16 );
+      sendto( pc->sock, pc->buf, temp16, 0, ( struct sockaddr* )&server, sizeof( server ) );
+    }
+    for( i = 0, pc = lt_clients; i < lt_num_clients; i ++, pc ++ )
+    {
+      if( pc->state == LT_STATE_DONE )
+        continue;
+      pfd.fd = pc->sock;
+      pfd.events = POLLIN;
+      if( poll( &pfd, 1, LT_TIMEOUT_MS ) <= 0 || recv( pc->sock, pc->buf, sizeof( pc->buf ), 0 ) <= 0 )
+      {
+        fprintf( stderr, "client %d: timeout in state %d\n", pc->id, pc->state );
+        return 0;
+      }
+      if( !lt_check_response( pc ) )
+      {
+        fprintf( stderr, "client %d: error in state %d\n", pc->id, pc->state );
+        return 0;
+      }
+    }
+  } while( active );
+  for( i = 0; i < lt_num_clients; i ++ )
+    close( lt_clients[ i ].sock );
+  return 1;
+}
+
+// ****************************************************************************
+// 'bench' mode: a single client writes a file to the server and reads it back,
+// with and without compression
+
+static u8 lt_bench_buf[ MAX_PACKET_SIZE + ELUARPC_WRITE_REQUEST_EXTRA ];
+static u32 lt_bench_wire;
+
+// Execute the request in lt_bench_buf, count the bytes sent in both directions
+// The requests must fit in the client buffer (LT_BENCH_BLOCK_SIZE plus the
+// write request overhead)
+static int lt_bench_exec()
+{
+  u16 temp16;
+
+  eluarpc_get_packet_size( lt_bench_buf, &temp16 );
+  if( temp16 > LT_BENCH_BLOCK_SIZE + ELUARPC_WRITE_REQUEST_EXTRA )
+  {
+    fprintf( stderr, "bench: request of %u bytes doesn't fit in the client buffer\n", ( unsigned )temp16 );
+    return 0;
+  }
+  lt_bench_wire += temp16;
+  if( server_execute_request( lt_bench_buf ) != SERVER_OK )
+    return 0;
+  eluarpc_get_packet_size( lt_bench_buf, &temp16 );
+  lt_bench_wire += temp16;
+  lt_requests ++;
+  return 1;
+}
+
+// Write 'data' to the server, then read it back in 'readback'
+// 'pwire' gets the number of bytes on the wire for the write and read phases
+static int lt_bench_run( const u8 *data, u32 size, int compress, u8 *readback, u32 *pwire )
+{
+  int fd, method, res;
+  u32 pos, count, datalen, actual;
+  s32 offset;
+  const u8 *pdata;
+
+  lt_bench_wire = 0;
+  remotefs_open_write_request( lt_bench_buf, "/bench.bin", RFS_OPEN_FLAG_CREAT | RFS_OPEN_FLAG_TRUNC | RFS_OPEN_FLAG_RDWR | ( compress ? RFS_OPEN_FLAG_COMPRESS : 0 ), 0 );
+  if( !lt_bench_exec() || remotefs_open_read_response_method( lt_bench_buf, &fd, &method ) == ELUARPC_ERR || fd == -1 )
+    return 0;
+  if( compress && method != LZF_METHOD_LZF )
+    return 0;
+  for( pos = 0; pos < size; pos += count )
+  {
+    count = size - pos > LT_BENCH_BLOCK_SIZE ? LT_BENCH_BLOCK_SIZE : size - pos;
+    // Same as the eLua RFS client: compress directly in the request buffer,
+    // send the data that doesn't compress with a regular write request
+    datalen = 0;
+    if( compress && count > ELUARPC_U32_SIZE )
+      datalen = lzf_compress( data + pos, count, lt_bench_buf + ELUARPC_WRITE_BUF_OFFSET, count - ELUARPC_U32_SIZE );
+    if( datalen != 0 )
+    {
+      remotefs_writez_write_request( lt_bench_buf, fd, NULL, datalen, count );
+      if( !lt_bench_exec() || remotefs_writez_read_response( lt_bench_buf, &actual ) == ELUARPC_ERR )
+        return 0;
+    }
+    else
+    {
+      remotefs_write_write_request( lt_bench_buf, fd, data + pos, count );
+      if( !lt_bench_exec() || remotefs_write_read_response( lt_bench_buf, &actual ) == ELUARPC_ERR )
+        return 0;
+    }
+    if( actual != count )
+      return 0;
+  }
+  pwire[ 0 ] = lt_bench_wire;
+  lt_bench_wire = 0;
+  remotefs_lseek_write_request( lt_bench_buf, fd, 0, RFS_LSEEK_SET );
+  if( !lt_bench_exec() || remotefs_lseek_read_response( lt_bench_buf, &offset ) == ELUARPC_ERR || offset != 0 )
+    return 0;
+  for( pos = 0; pos < size; pos += count )
+  {
+    count = size - pos > LT_BENCH_BLOCK_SIZE ? LT_BENCH_BLOCK_SIZE : size - pos;
+    if( compress )
+    {
+      remotefs_readz_write_request( lt_bench_buf, fd, count );
+      if( !lt_bench_exec() || remotefs_readz_read_response( lt_bench_buf, &pdata, &datalen, &actual ) == ELUARPC_ERR || actual != count )
+        return 0;
+      if( datalen == actual )
+        memcpy( readback + pos, pdata, actual );
+      else if( lzf_decompress( pdata, datalen, readback + pos, actual ) != actual )
+        return 0;
+    }
+    else
+    {
+      remotefs_read_write_request( lt_bench_buf, fd, count );
+      if( !lt_bench_exec() || remotefs_read_read_response( lt_bench_buf, &pdata, &actual ) == ELUARPC_ERR || actual != count )
+        return 0;
+      memcpy( readback + pos, pdata, actual );
+    }
+  }
+  remotefs_close_write_request( lt_bench_buf, fd );
+  if( !lt_bench_exec() || remotefs_close_read_response( lt_bench_buf, &res ) == ELUARPC_ERR || res != 0 )
+    return 0;
+  pwire[ 1 ] = lt_bench_wire;
+  return memcmp( data, readback, size ) == 0;
+}
+
+static int lt_bench( const char *fname )
+{
+  FILE *fp;
+  u8 *data, *readback;
+  u32 size, wire[ 2 ];
+  int compress, res = 1;
+  struct timeval start, end;
+  double elapsed;
+
+  data = malloc( LT_BENCH_MAX_SIZE );
+  readback = malloc( LT_BENCH_MAX_SIZE );
+  if( data == NULL || readback == NULL || ( fp = fopen( fname, "rb" ) ) == NULL )
+  {
+    log_err( "Unable to read %s\n", fname );
+    return 0;
+  }
+  size = fread( data, 1, LT_BENCH_MAX_SIZE, fp );
+  fclose( fp );
+  printf( "%s: %u bytes, %u bytes per request\n", fname, ( unsigned )size, ( unsigned )LT_BENCH_BLOCK_SIZE );
+  for( compress = 0; compress <= 1 && res; compress ++ )
+  {
+    gettimeofday( &start, NULL );
+    res = lt_bench_run( data, size, compress, readback, wire );
+    gettimeofday( &end, NULL );
+    elapsed = ( end.tv_sec - start.tv_sec ) + ( end.tv_usec - start.tv_usec ) / 1000000.0;
+    if( res )
+      printf( "  %-12s write: %7u bytes on the wire (%6.2fs at %d baud), read: %7u bytes on the wire (%6.2fs), CPU time %.4fs\n",
+              compress ? "compressed" : "plain", ( unsigned )wire[ 0 ], wire[ 0 ] * 10.0 / LT_BENCH_BAUD, LT_BENCH_BAUD,
+              ( unsigned )wire[ 1 ], wire[ 1 ] * 10.0 / LT_BENCH_BAUD, elapsed );
+  }
+  free( data );
+  free( readback );
+  return res;
+}
+
+// ****************************************************************************
+// Entry point
+
+int main( int argc, const char **argv )
+{
+  char dirname[] = "/tmp/rfs_loadtestXXXXXX";
+  char portspec[ 32 ], fname[ 64 ];
+  const char *srvargs[] = { "rfs_loadtest", portspec, dirname, NULL };
+  long mode_udp = 0, mode_bench = 0, tempi, port = 0;
+  int i, res;
+  pid_t pid = 0;
+  struct timeval start, end;
+  double elapsed;
+
+  if( argc == 3 && !strcmp( argv[ 1 ], "bench" ) )
+    mode_bench = 1;
+  else if( argc < 2 || ( strcmp( argv[ 1 ], "mem" ) && strncmp( argv[ 1 ], "udp:", 4 ) ) )
+  {
+    log_err( "Usage: %s mem|udp:<port> [<clients>] [<iterations>]\n", argv[ 0 ] );
+    log_err( "       %s bench <file>\n", argv[ 0 ] );
+    return 1;
+  }
+  if( argv[ 1 ][ 0 ] == 'u' )
+  {
+    mode_udp = 1;
+    if( secure_atoi( argv[ 1 ] + 4, &port ) == 0 )
+    {
+      log_err( "Invalid port number\n" );
+      return 1;
+    }
+  }
+  if( !mode_bench && argc > 2 && secure_atoi( argv[ 2 ], &tempi ) && tempi > 0 && tempi <= LT_MAX_CLIENTS )
+    lt_num_clients = tempi;
+  if( argc > 3 && secure_atoi( argv[ 3 ], &tempi ) && tempi > 0 )
+    lt_iterations = tempi;
+  for( i = 0; i < lt_num_clients; i ++ )
+    lt_clients[ i ].id = i;
+
+  if( mkdtemp( dirname ) == NULL )
+  {
+    log_err( "Unable to create directory\n" );
+    return 1;
+  }
+  if( mode_udp )
+  {
+    // Start the server in a child process
+    sprintf( portspec, "udp:%ld", port );
+    if( ( pid = fork() ) == 0 )
+    {
+      if( rfs_init( 3, srvargs ) != 0 )
+        exit( 1 );
+      exit( rfs_server_loop() );
+    }
+    usleep( 200000 );
+  }
+  else
+  {
+    log_init( LOG_NONE );
+    server_setup( dirname );
+  }
+
+  if( mode_bench )
+  {
+    res = lt_bench( argv[ 2 ] );
+    server_cleanup();
+    sprintf( fname, "%s/bench.bin", dirname );
+    unlink( fname );
+    rmdir( dirname );
+    printf( "%s\n", res ? "PASSED" : "FAILED" );
+    return res ? 0 : 1;
+  }
+  gettimeofday( &start, NULL );
+  res = mode_udp ? lt_run_udp( port ) : lt_run_mem();
+  gettimeofday( &end, NULL );
+  elapsed = ( end.tv_sec - start.tv_sec ) + ( end.tv_usec - start.tv_usec ) / 1000000.0;
+
+  if( mode_udp )
+  {
+    kill( pid, SIGTERM );
+    waitpid( pid, NULL, 0 );
+  }
+  else
+    server_cleanup();
+  for( i = 0; i < lt_num_clients; i ++ )
+  {
+    sprintf( fname, "%s/lt%d.bin", dirname, i );
+    unlink( fname );
+  }
+  rmdir( dirname );
+
+  printf( "%s: %d clients, %u requests in %.3f seconds (%.0f requests/s)\n", res ? "PASSED" : "FAILED",
+          lt_num_clients, lt_requests, elapsed, elapsed > 0 ? lt_requests / elapsed : 0 );
+  return res ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+-- Timebase test
+-- Checks tmr.cycles/tmr.elapsed against a hardware timer and os.clock, then
+-- uses them to profile a few Lua operations.
+-- Run it with 'lua /host/test/tmr_cycles.lua [<hw timer id>]'.
+
+local args = { ... }
+local sf = string.format
+local hw = tonumber( args[ 1 ] ) or 0
+
+-- The timebase is monotonic and agrees with the hardware timer
+local last = tmr.cycles()
+for i = 1, 1000 do
+  local now = tmr.cycles()
+  assert( now >= last, "the timebase went back" )
+  last = now
+end
+local c0, t0 = tmr.cycles(), tmr.read( hw )
+tmr.delay( hw, 200000 )
+local c1, t1 = tmr.cycles(), tmr.read( hw )
+local us, hwus = tmr.elapsed( c0, c1 ), tmr.gettimediff( hw, t1, t0 )
+print( sf( "200ms delay: %d us (timebase), %d us (timer %d)", us, hwus, hw ) )
+assert( math.abs( us - hwus ) < 1000, "the timebase doesn't agree with the hardware timer" )
+
+-- os.clock uses the same timebase
+local clk = os.clock()
+tmr.delay( hw, 100000 )
+clk = os.clock() - clk
+print( sf( "os.clock: %.3f s for a 100ms delay", clk ) )
+assert( clk >= 0.09 and clk < 0.2, "os.clock doesn't use the timebase" )
+
+-- Cost of the timebase itself and of some Lua operations
+local function profile( name, f, count )
+  local start = tmr.cycles()
+  for i = 1, count do f() end
+  local total = tmr.elapsed( start )
+  print( sf( "%-22s %10.3f us", name, total / count ) )
+end
+profile( "tmr.cycles()", tmr.cycles, 1000 )
+profile( "empty function", function() end, 1000 )
+profile( "table creation", function() local t = { 1, 2, 3 } end, 1000 )
+profile( "string concatenation", function() local s = "a" .. tostring( 1 ) end, 1000 )
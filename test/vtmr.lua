@@ -0,0 +1,56 @@
+-- Virtual timers test
+-- Checks the resolution of the virtual timers and the accuracy of their delays
+-- against a hardware timer. If the timer match interrupts are available, also
+-- checks one shot and cyclic matches on several virtual timers at once.
+-- Run it with 'lua /host/test/vtmr.lua [<hw timer id>]'.
+
+local args = { ... }
+local sf = string.format
+local hw = tonumber( args[ 1 ] ) or 0
+local vt = { tmr.VIRT0, tmr.VIRT1, tmr.VIRT2, tmr.VIRT3 }
+
+local clock = tmr.getclock( vt[ 1 ] )
+print( sf( "virtual timers clock: %d Hz, delays from %d us to %d us", clock, tmr.getmindelay( vt[ 1 ] ), tmr.getmaxdelay( vt[ 1 ] ) ) )
+if sim then assert( clock == 1000000, "the virtual timers should count microseconds" ) end
+
+-- Delays, measured with the hardware timer
+local resolution = math.max( 1000000 / clock, 1 )
+for _, us in ipairs{ 100, 1000, 20000, 300000 } do
+  if us >= resolution then
+    local start = tmr.read( hw )
+    tmr.delay( vt[ 1 ], us )
+    local real = tmr.gettimediff( hw, tmr.read( hw ), start )
+    print( sf( "delay %d us: %d us", us, real ) )
+    assert( real >= us - resolution, "the delay is too short" )
+  end
+end
+
+-- Read: the timers count from their own start
+tmr.start( vt[ 2 ] )
+tmr.delay( vt[ 1 ], 50000 )
+tmr.start( vt[ 3 ] )
+tmr.delay( vt[ 1 ], 50000 )
+local t2, t3 = tmr.read( vt[ 2 ] ), tmr.read( vt[ 3 ] )
+assert( t2 > t3, "the virtual timers aren't independent" )
+local d = tmr.gettimediff( vt[ 2 ], t2, t3 )
+assert( d >= 50000 - 2 * resolution and d <= 100000, sf( "wrong time between the starts: %d us", d ) )
+print( "read: ok" )
+
+-- Match interrupts
+if not ( tmr.set_match_int and cpu.set_int_handler ) then return end
+local count = { 0, 0, 0, 0 }
+local prev = cpu.set_int_handler( cpu.INT_TMR_MATCH, function( id )
+  for i = 1, 4 do
+    if vt[ i ] == id then count[ i ] = count[ i ] + 1 end
+  end
+end )
+tmr.set_match_int( vt[ 1 ], 100000, tmr.INT_CYCLIC )
+tmr.set_match_int( vt[ 2 ], 250000, tmr.INT_ONESHOT )
+tmr.set_match_int( vt[ 3 ], 300000, tmr.INT_CYCLIC )
+tmr.delay( hw, 1050000 )
+tmr.set_match_int( vt[ 1 ], 0, tmr.INT_CYCLIC )
+tmr.set_match_int( vt[ 3 ], 0, tmr.INT_CYCLIC )
+cpu.set_int_handler( cpu.INT_TMR_MATCH, prev )
+print( sf( "matches: %d, %d, %d", count[ 1 ], count[ 2 ], count[ 3 ] ) )
+assert( count[ 1 ] == 10 and count[ 2 ] == 1 and count[ 3 ] == 3 and count[ 4 ] == 0, "wrong number of matches" )
+print( "match interrupts: ok" )
@@ -0,0 +1,8 @@
+// Platform configuration for the host build of the WOFS test
+
+#ifndef __PLATFORM_CONF_H__
+#define __PLATFORM_CONF_H__
+
+#define BUILD_WOFS
+
+#endif // #ifndef __PLATFORM_CONF_H__
@@ -0,0 +1,16 @@
+// Minimal replacement of the Newlib reentrancy structure for the host build
+// of the WOFS test (the device functions only use '_errno')
+
+#ifndef __REENT_H__
+#define __REENT_H__
+
+#include <sys/types.h>
+
+struct _reent
+{
+  int _errno;
+};
+
+typedef ssize_t _ssize_t;
+
+#endif
@@ -0,0 +1,354 @@
+// WOFS power cut test
+// Runs the WOFS code (src/wofs.c) on the host with an emulated NOR flash
+// (erase sets the bytes to 0xFF, writes can only clear bits) and does random
+// appends and rewrites (O_TRUNC) of a few files, checked against a model of
+// their contents. Some operations are cut at a random point of a flash write
+// or erase (an erase is left half done). The file system is then mounted
+// again and every file must have its last complete contents, except the file
+// that was being changed: a cut append can leave a part of the new data and a
+// cut rewrite can leave the old file, no file or an empty file.
+// The second phase rewrites files until the 16-bit file IDs wrap around, while
+// a few other files stay unchanged, and checks that no file gets the ID of
+// another one (also across mounts).
+// Build with 'gcc -m32 -Wall -Itest/wofs_host -Iinc -Iinc/newlib
+// test/wofs_powercut.c src/wofs.c -o wofs_powercut', then run it as
+// 'wofs_powercut [<seed>] [<operations>]'.
+
+#define _GNU_SOURCE
+#include "type.h"
+#include "devman.h"
+#include "platform.h"
+#include "wofs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define WT_NUM_SECTORS        16
+#define WT_SECTOR_SIZE        1024
+#define WT_FLASH_SIZE         ( WT_NUM_SECTORS * WT_SECTOR_SIZE )
+#define WT_NUM_FILES          6
+#define WT_MAX_FILE_SIZE      10000
+#define WT_MAX_APPEND         1500
+#define WT_MAX_REWRITE        300
+#define WT_CUT_CHANCE         50        // one operation in WT_CUT_CHANCE is cut
+#define WT_ERASE_COST         64        // budget used by an erase
+
+// ID wrap phase
+#define WT_ID_KEEP            3         // files that are not changed
+#define WT_ID_REWRITES        70000
+#define WT_ID_REMOUNT         5000
+
+#ifdef MAP_32BIT
+#define WT_MAP_FLAGS          ( MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT )
+#else
+#define WT_MAP_FLAGS          ( MAP_PRIVATE | MAP_ANONYMOUS )
+#endif
+
+// Used by the WOFS code
+struct dm_dirent dm_shared_dirent;
+char dm_shared_fname[ DM_MAX_FNAME_LENGTH + 1 ];
+
+static struct _reent wt_reent;
+static const DM_DEVICE *wt_dev;
+static u8 *wt_flash;
+static long wt_budget = -1;             // bytes that can be written before the cut (-1 for no cut)
+static jmp_buf wt_cut;
+static long wt_writes, wt_erases;
+
+// Model of the files
+static char wt_names[ WT_NUM_FILES ][ DM_MAX_FNAME_LENGTH + 1 ];
+static u8 wt_data[ WT_NUM_FILES ][ WT_MAX_FILE_SIZE ];
+static int wt_size[ WT_NUM_FILES ];     // -1 if the file doesn't exist
+static u8 wt_buf[ WT_MAX_FILE_SIZE ];
+
+static void wt_fail( const char *msg, const char *name, int n, int expected )
+{
+  printf( "FAIL: %s (%s: %d, expected %d)\n", msg, name, n, expected );
+  exit( 1 );
+}
+
+// *****************************************************************************
+// Flash emulation with power cuts
+
+u32 platform_flash_get_num_sectors()
+{
+  return WT_NUM_SECTORS;
+}
+
+u32 platform_flash_get_sector_start( u32 sectid )
+{
+  return ( u32 )( size_t )( wt_flash + sectid * WT_SECTOR_SIZE );
+}
+
+// The first sector has the "firmware"
+u32 platform_flash_get_first_free_sector()
+{
+  return 1;
+}
+
+int platform_flash_erase( u32 sectid )
+{
+  u8 *p = wt_flash + sectid * WT_SECTOR_SIZE;
+
+  if( sectid == 0 || sectid >= WT_NUM_SECTORS )
+    wt_fail( "erase of an invalid sector", "sector", sectid, 0 );
+  wt_erases ++;
+  if( wt_budget >= 0 )
+  {
+    if( wt_budget < WT_ERASE_COST )
+    {
+      memset( p + WT_SECTOR_SIZE / 2, 0xFF, WT_SECTOR_SIZE / 2 );
+      longjmp( wt_cut, 1 );
+    }
+    wt_budget -= WT_ERASE_COST;
+  }
+  memset( p, 0xFF, WT_SECTOR_SIZE );
+  return PLATFORM_OK;
+}
+
+int platform_flash_write( const void *from, u32 toaddr, u32 size )
+{
+  u8 *pdest = ( u8* )( size_t )toaddr;
+  const u8 *psrc = ( const u8* )from;
+
+  if( ( toaddr & 3 ) || ( size & 3 ) || pdest < wt_flash + WT_SECTOR_SIZE || pdest + size > wt_flash + WT_FLASH_SIZE )
+    wt_fail( "invalid flash write", "size", size, 0 );
+  wt_writes ++;
+  while( size -- )
+  {
+    if( wt_budget == 0 )
+      longjmp( wt_cut, 1 );
+    if( wt_budget > 0 )
+      wt_budget --;
+    *pdest ++ &= *psrc ++;
+  }
+  return PLATFORM_OK;
+}
+
+// *****************************************************************************
+// Helpers
+
+static void wt_mount()
+{
+  wt_budget = -1;
+  if( ( wt_dev = wofs_init() ) == NULL )
+  {
+    printf( "FAIL: mount\n" );
+    exit( 1 );
+  }
+}
+
+// Read a whole file in chunks of random size. Returns its size or -1 if it doesn't exist.
+static int wt_read( const char *name, u8 *buf )
+{
+  int fd, n, total = 0, chunk;
+
+  if( ( fd = wt_dev->p_open_r( &wt_reent, name, O_RDONLY, 0 ) ) < 0 )
+  {
+    if( wt_reent._errno != ENOENT )
+      wt_fail( "open for reading", name, wt_reent._errno, ENOENT );
+    return -1;
+  }
+  while( 1 )
+  {
+    chunk = 1 + rand() % 200;
+    if( chunk > WT_MAX_FILE_SIZE - total )
+      chunk = WT_MAX_FILE_SIZE - total;
+    if( ( n = wt_dev->p_read_r( &wt_reent, fd, buf + total, chunk ) ) < 0 )
+      wt_fail( "read", name, wt_reent._errno, 0 );
+    if( n == 0 )
+      break;
+    total += n;
+  }
+  wt_dev->p_close_r( &wt_reent, fd );
+  return total;
+}
+
+// Write data to a file (opened with the given flags). Returns the number of
+// bytes written (the file system can be full).
+static int wt_write( const char *name, int flags, const u8 *data, int len )
+{
+  int fd, n = 0;
+
+  if( ( fd = wt_dev->p_open_r( &wt_reent, name, O_WRONLY | O_CREAT | flags, 0 ) ) < 0 )
+    return -1;
+  if( len > 0 && ( n = wt_dev->p_write_r( &wt_reent, fd, data, len ) ) < 0 )
+    n = 0;
+  wt_dev->p_close_r( &wt_reent, fd );
+  return n;
+}
+
+// Check all the files against the model. 'cut' is the file that was being
+// changed when the power was cut (-1 if none), 'append' is true if it was an
+// append, 'oldsize' is the size of the file before the operation (-1 if it
+// didn't exist) and 'newsize' the size it would have after it.
+// The model of the cut file is updated with what was found.
+static void wt_verify( int cut, int append, int oldsize, int newsize )
+{
+  int i, n;
+
+  for( i = 0; i < WT_NUM_FILES; i ++ )
+  {
+    n = wt_read( wt_names[ i ], wt_buf );
+    if( i == cut && append )
+    {
+      if( n < oldsize || n > newsize || ( n > 0 && memcmp( wt_buf, wt_data[ i ], n ) ) )
+        wt_fail( "cut append", wt_names[ i ], n, oldsize );
+      wt_size[ i ] = n;
+    }
+    else if( i == cut )
+    {
+      if( n > 0 && ( n != oldsize || memcmp( wt_buf, wt_data[ i ], n ) ) )
+        wt_fail( "cut rewrite", wt_names[ i ], n, oldsize );
+      wt_size[ i ] = n;
+    }
+    else if( n != wt_size[ i ] || ( n > 0 && memcmp( wt_buf, wt_data[ i ], n ) ) )
+      wt_fail( "file contents", wt_names[ i ], n, wt_size[ i ] );
+  }
+}
+
+// *****************************************************************************
+// Test phases
+
+static int wt_power_cuts( long nops )
+{
+  volatile int cut, append, oldsize, newsize, ncuts = 0;
+  long op;
+  int i, n, k;
+
+  for( i = 0; i < WT_NUM_FILES; i ++ )
+  {
+    sprintf( wt_names[ i ], "f%d.dat", i );
+    wt_size[ i ] = -1;
+  }
+  for( op = 0; op < nops; op ++ )
+  {
+    i = rand() % WT_NUM_FILES;
+    k = rand() % 10;
+    cut = -1;
+    if( rand() % WT_CUT_CHANCE == 0 )
+      wt_budget = rand() % 300;
+    if( setjmp( wt_cut ) )
+    {
+      ncuts ++;
+      wt_mount();
+      wt_verify( cut, append, oldsize, newsize );
+      continue;
+    }
+    if( k < 2 )
+    {
+      // Rewrite
+      n = rand() % WT_MAX_REWRITE;
+      cut = i;
+      append = 0;
+      oldsize = wt_size[ i ];
+      newsize = n;
+      // The old contents are still needed if the rewrite is cut before the old file is removed
+      if( wt_write( wt_names[ i ], O_TRUNC, NULL, 0 ) < 0 )
+      {
+        // The file system is full, the old file may be removed
+        wt_size[ i ] = wt_read( wt_names[ i ], wt_buf );
+        continue;
+      }
+      wt_size[ i ] = 0;
+      append = 1;
+      oldsize = 0;
+      for( k = 0; k < n; k ++ )
+        wt_data[ i ][ k ] = rand();
+      wt_size[ i ] = wt_write( wt_names[ i ], O_APPEND, wt_data[ i ], n );
+    }
+    else if( k < 8 )
+    {
+      // Append
+      if( wt_size[ i ] > WT_MAX_FILE_SIZE - WT_MAX_APPEND )
+        continue;
+      cut = i;
+      append = 1;
+      oldsize = wt_size[ i ];
+      if( wt_size[ i ] < 0 )
+        wt_size[ i ] = 0;
+      n = 1 + rand() % WT_MAX_APPEND;
+      for( k = 0; k < n; k ++ )
+        wt_data[ i ][ wt_size[ i ] + k ] = rand();
+      newsize = wt_size[ i ] + n;
+      if( ( n = wt_write( wt_names[ i ], O_APPEND, wt_data[ i ] + wt_size[ i ], n ) ) < 0 )
+        wt_fail( "open for appending", wt_names[ i ], wt_reent._errno, 0 );
+      wt_size[ i ] += n;
+    }
+    else
+    {
+      wt_budget = -1;
+      if( rand() % 5 == 0 )
+        wt_mount();
+      wt_verify( -1, 0, 0, 0 );
+    }
+    wt_budget = -1;
+  }
+  wt_mount();
+  wt_verify( -1, 0, 0, 0 );
+  return ncuts;
+}
+
+static void wt_id_wrap()
+{
+  char name[ DM_MAX_FNAME_LENGTH + 1 ];
+  u8 data[ 8 ];
+  long i;
+  int n, k;
+
+  memset( wt_flash + WT_SECTOR_SIZE, 0xFF, WT_FLASH_SIZE - WT_SECTOR_SIZE );
+  wt_mount();
+  for( k = 0; k < WT_ID_KEEP; k ++ )
+  {
+    sprintf( name, "keep%d", k );
+    memset( data, 'a' + k, sizeof( data ) );
+    if( wt_write( name, 0, data, sizeof( data ) ) != sizeof( data ) )
+      wt_fail( "write", name, 0, sizeof( data ) );
+  }
+  for( i = 0; i < WT_ID_REWRITES; i ++ )
+  {
+    sprintf( name, "tmp%ld", i % 2 );
+    memcpy( data, &i, sizeof( i ) < sizeof( data ) ? sizeof( i ) : sizeof( data ) );
+    if( wt_write( name, O_TRUNC, data, sizeof( data ) ) != sizeof( data ) )
+      wt_fail( "rewrite", name, i, 0 );
+    if( i % WT_ID_REMOUNT == 0 )
+      wt_mount();
+    // Check the files that were not changed and the file that was written
+    for( k = 0; k < WT_ID_KEEP; k ++ )
+    {
+      sprintf( name, "keep%d", k );
+      memset( data, 'a' + k, sizeof( data ) );
+      if( ( n = wt_read( name, wt_buf ) ) != sizeof( data ) || memcmp( wt_buf, data, sizeof( data ) ) )
+        wt_fail( "unchanged file", name, n, sizeof( data ) );
+    }
+    sprintf( name, "tmp%ld", i % 2 );
+    memcpy( data, &i, sizeof( i ) < sizeof( data ) ? sizeof( i ) : sizeof( data ) );
+    if( ( n = wt_read( name, wt_buf ) ) != sizeof( data ) || memcmp( wt_buf, data, sizeof( data ) ) )
+      wt_fail( "rewritten file", name, n, i );
+  }
+}
+
+int main( int argc, char **argv )
+{
+  long nops = argc > 2 ? atol( argv[ 2 ] ) : 20000;
+  int ncuts;
+
+  wt_flash = mmap( NULL, WT_FLASH_SIZE, PROT_READ | PROT_WRITE, WT_MAP_FLAGS, -1, 0 );
+  if( wt_flash == MAP_FAILED || ( size_t )wt_flash + WT_FLASH_SIZE > 0xFFFFFFFFUL )
+  {
+    printf( "Unable to map the flash in the 32-bit address space\n" );
+    return 1;
+  }
+  memset( wt_flash, 0xFF, WT_FLASH_SIZE );
+  srand( argc > 1 ? atoi( argv[ 1 ] ) : 1 );
+  wt_mount();
+  ncuts = wt_power_cuts( nops );
+  printf( "power cuts: %ld operations, %d cuts, %ld writes, %ld erases: ok\n", nops, ncuts, wt_writes, wt_erases );
+  wt_id_wrap();
+  printf( "ID wrap: %d rewrites: ok\n", WT_ID_REWRITES );
+  return 0;
+}
@@ -0,0 +1,88 @@
+-- Compress a file before sending it to eLua with the 'recv' shell command
+-- (the eLua image must be built with XMODEM_COMPRESS, see src/lzf.c for the format)
+-- Usage: lua utils/lzfpack.lua <infile> <outfile>
+
+local args = { ... }
+local sf = string.format
+
+if #args ~= 2 then
+  print "Usage: lzfpack <infile> <outfile>"
+  os.exit( 1 )
+end
+
+local MAX_LIT, MAX_OFF, MAX_REF = 32, 8192, 264
+
+-- Return 'v' as 4 bytes (little endian)
+local function u32_to_str( v )
+  local t = {}
+  for i = 1, 4 do
+    t[ i ] = string.char( v % 256 )
+    v = math.floor( v / 256 )
+  end
+  return table.concat( t )
+end
+
+local function compress( data )
+  local out, lit, last = {}, {}, {}
+  local n, ip = #data, 1
+
+  -- Write the pending literals (in runs of at most MAX_LIT bytes)
+  local function flush_lit()
+    local i = 1
+    while i <= #lit do
+      local cnt = math.min( MAX_LIT, #lit - i + 1 )
+      out[ #out + 1 ] = string.char( cnt - 1 ) .. table.concat( lit, "", i, i + cnt - 1 )
+      i = i + cnt
+    end
+    lit = {}
+  end
+
+  while ip <= n do
+    local ref
+    if ip + 2 <= n then
+      local key = data:sub( ip, ip + 2 )
+      ref = last[ key ]
+      last[ key ] = ip
+    end
+    if ref and ip - ref - 1 < MAX_OFF then
+      local off, len, maxlen = ip - ref - 1, 3, math.min( n - ip + 1, MAX_REF )
+      while len < maxlen and data:byte( ref + len ) == data:byte( ip + len ) do
+        len = len + 1
+      end
+      flush_lit()
+      ip = ip + len
+      len = len - 2
+      if len < 7 then
+        out[ #out + 1 ] = string.char( math.floor( off / 256 ) + len * 32, off % 256 )
+      else
+        out[ #out + 1 ] = string.char( math.floor( off / 256 ) + 7 * 32, len - 7, off % 256 )
+      end
+    else
+      lit[ #lit + 1 ] = data:sub( ip, ip )
+      ip = ip + 1
+    end
+  end
+  flush_lit()
+  return table.concat( out )
+end
+
+local f = io.open( args[ 1 ], "rb" )
+if not f then
+  print( sf( "Unable to open %s", args[ 1 ] ) )
+  os.exit( 1 )
+end
+local data = f:read( "*a" )
+f:close()
+if #data == 0 then
+  print "Empty input file"
+  os.exit( 1 )
+end
+local packed = "\27LZF" .. u32_to_str( #data ) .. compress( data )
+f = io.open( args[ 2 ], "wb" )
+if not f then
+  print( sf( "Unable to create %s", args[ 2 ] ) )
+  os.exit( 1 )
+end
+f:write( packed )
+f:close()
+print( sf( "%s: %d bytes -> %d bytes (%.1f%%)", args[ 1 ], #data, #packed, 100 * #packed / #data ) )
@@ -1,6 +1,5 @@
 -- A module to convert an entire directory to a C array, in the "romfs" format
 module( ..., package.seeall )
-require "pack"
 local sf = string.format
 local b = require "utils.build"
 local utils = b.utils
@@ -11,6 +10,10 @@ local _bytecnt = 0
 local maxlen = 30
 local outfile
 
+-- Image format constants (see inc/romfs.h)
+local ROMFS_MAGIC = "eRFS"
+local ROMFS_ALIGN = 4
+
 -- Line output function
 local function _add_data( data, outfile, moredata )
   if moredata == nil then moredata = true end
@@ -28,9 +31,100 @@ local function _add_data( data, outfile, moredata )
   end
 end
 
+-- Write a 16-bit or a 32-bit number (little endian)
+local function _add_number( data, nbytes )
+  for i = 1, nbytes do
+    _add_data( data % 256, outfile )
+    data = math.floor( data / 256 )
+  end
+end
+
+-- Write 0s until the image size is a multiple of 'align'
+local function _add_padding( align )
+  while _bytecnt % align ~= 0 do
+    _add_data( 0, outfile )
+  end
+end
+
+-- Hash of a file name (must match ROMFS_HASH_STEP in inc/romfs.h)
+local function _hash( name )
+  local h = 0
+  name = name:lower()
+  for i = 1, #name do
+    h = ( h * 33 + name:byte( i ) ) % 2^32
+  end
+  return h
+end
+
+-- Check the length of each part of a file name ('a/b/c.lua')
+local function _check_name( name )
+  for part in name:gmatch( "[^/]+" ) do
+    if #part > maxlen then return false end
+  end
+  return true
+end
+
+-- Write the whole image: header, hash buckets, directory, names and data
+local function _write_image( files )
+  local nbuckets = 1
+  while nbuckets < #files do
+    nbuckets = nbuckets * 2
+  end
+  -- Sort the files by bucket
+  for i, f in ipairs( files ) do
+    f.bucket, f.idx = _hash( f.name ) % nbuckets, i
+  end
+  table.sort( files, function( a, b ) return a.bucket < b.bucket or ( a.bucket == b.bucket and a.idx < b.idx ) end )
+  -- Header
+  for i = 1, #ROMFS_MAGIC do
+    _add_data( ROMFS_MAGIC:byte( i ), outfile )
+  end
+  _add_number( #files, 2 )
+  _add_number( nbuckets, 2 )
+  -- Bucket table: index of the first file in each bucket
+  local crt = 1
+  for b = 0, nbuckets do
+    while crt <= #files and files[ crt ].bucket < b do
+      crt = crt + 1
+    end
+    _add_number( crt - 1, 2 )
+  end
+  _add_padding( ROMFS_ALIGN )
+  -- Compute the name and data offsets
+  local offset = _bytecnt + #files * 12
+  for _, f in ipairs( files ) do
+    f.nameoffset = offset
+    offset = offset + #f.name + 1
+  end
+  for _, f in ipairs( files ) do
+    offset = math.ceil( offset / ROMFS_ALIGN ) * ROMFS_ALIGN
+    f.dataoffset = offset
+    offset = offset + #f.data
+  end
+  -- Directory
+  for _, f in ipairs( files ) do
+    _add_number( f.nameoffset, 4 )
+    _add_number( f.dataoffset, 4 )
+    _add_number( #f.data, 4 )
+  end
+  -- Names and data
+  for _, f in ipairs( files ) do
+    for i = 1, #f.name do
+      _add_data( f.name:byte( i ), outfile )
+    end
+    _add_data( 0, outfile ) -- ASCIIZ
+  end
+  for _, f in ipairs( files ) do
+    _add_padding( ROMFS_ALIGN )
+    for i = 1, #f.data do
+      _add_data( f.data:byte( i ), outfile )
+    end
+  end
+end
+
 -- dirname - the directory where the files are located.
 -- outname - the name of the C output
--- flist - list of files
+-- flist - list of files (names relative to 'dirname', subdirectories are kept in the image)
 -- mode - preprocess the file system:
 --   "verbatim" - copy the files directly to the FS as they are
 --   "compile" - precompile all files to Lua bytecode and then copy them
@@ -57,8 +151,11 @@ function mkfs( dirname, outname, flist, mode, compcmd )
   outfile:write( sf( "const unsigned char %s_fs[] = \n{\n", outname:lower() ) )
   
   -- Process all files
+  local files = {}
   for _, fname in pairs( flist ) do
-    if #fname > maxlen then
+    -- The directory separator in the image is always '/'
+    fname = fname:gsub( "\\", "/" ):gsub( "^/+", "" )
+    if not _check_name( fname ) then
       print( sf( "Skipping %s (name longer than %d chars)", fname, maxlen ) )
     else 
       -- Get actual file name
@@ -112,26 +209,15 @@ function mkfs( dirname, outname, flist, mode, compcmd )
         if fextpart == ".lua" and mode ~= "verbatim" then
           os.remove( newname )
         end
-        -- Write name, size, id, numpars
-        for i = 1, #fname do
-          _add_data( fname:byte( i ), outfile )
-        end
-        _add_data( 0, outfile ) -- ASCIIZ
-        local plen = string.pack( "<h", #filedata )
-        _add_data( plen:byte( 1 ), outfile )
-        _add_data( plen:byte( 2 ), outfile )
-        -- Then write the rest of the file
-        for i = 1, #filedata do
-          _add_data( filedata:byte( i ), outfile )
-        end
-        -- Report
+        table.insert( files, { name = fname, data = filedata } )
         print( sf( "Encoded file %s (%d bytes)", fname, #filedata ) )
       end
     end
   end
     
-  -- All done, write the final "0" (terminator)
-  _add_data( 0, outfile, false )
+  -- All done, write the image
+  _write_image( files )
+  _add_data( 0, outfile, false ) -- the array can't be empty
   outfile:write( "};\n\n#endif\n" );
   outfile:close()
   print( sf( "Done, total size is %d bytes", _bytecnt ) )